@@ -20,7 +20,7 @@
 #pragma diag_suppress=Pm086
 #endif /* __ICCARM__ */
 
-#define FAIL(s) test_Fail(AT##": "##s)
+#define FAIL(s) test_Fail(AT ": " s)
 
 #define PERF(s) test_Perf(s)
 
@@ -16,6 +16,12 @@
 */
 static uint32_t snCriticalRegionState = 0u;
 
+#if defined(APP_TRACE_EN) && (APP_TRACE_EN > 0u)
+/* Trace recorder hooks, in the application's app_hooks.c */
+extern void App_TraceIsrEnter(uint32_t nIntNum);
+extern void App_TraceIsrExit(uint32_t nIntNum);
+#endif
+
 void _adi_osal_stdWrapper (void)
 {
     /* Get the interrupt number */
@@ -28,9 +34,18 @@ void _adi_osal_stdWrapper (void)
     OSIntNesting++; 
     CPU_CRITICAL_EXIT();
 
+#if defined(APP_TRACE_EN) && (APP_TRACE_EN > 0u)
+    App_TraceIsrEnter(nIntNum);
+#endif
+
      /* Call the higher level callback */
     _adi_osal_gHandlerTable[nIntNum].pfOSALHandler(ADI_NVIC_IRQ_SID(nIntNum),  _adi_osal_gHandlerTable[nIntNum].pOSALArg);
 
+#if defined(APP_TRACE_EN) && (APP_TRACE_EN > 0u)
+    /* Before OSIntExit(), which may switch to another task */
+    App_TraceIsrExit(nIntNum);
+#endif
+
     /* Tell uC/OS-III that we are leaving the ISR */
     OSIntExit(); 
    
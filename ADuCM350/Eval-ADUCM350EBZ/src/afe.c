@@ -9,6 +9,7 @@
 #include <stdlib.h>  /* for 'NULL" definition */
 #include "dma.h"
 #include "afe.h"
+#include "afe_seqcrc.h"
 
 /*! \cond PRIVATE */
 
@@ -99,9 +100,6 @@ ADI_INT_HANDLER(DMA_AFE_RX_Int_Handler);
 /* Calbration registers password */
 #define CALDATA_UNLOCK                  0xDE87A5AF                  /*!< Password to unlock calibration registers.          */
 
-/* Polynomial for sequencer CRC-8 */
-#define ADI_AFE_SEQ_CRC8_POLYNOMIAL     0x07                        /*!< Sequencer CRC8 polynomial.                         */
-
 
 
 /*! \endcond */
@@ -744,30 +742,13 @@ ADI_AFE_RESULT_TYPE adi_AFE_ProgramRxDMA(ADI_AFE_DEV_HANDLE const hDevice, uint1
 /***************************************************************************/
 
 
-static void crc8(uint8_t *crc, uint32_t word) {
-    uint8_t     i;
-    uint32_t    data;
-
-    data = word;
-    for (i = 0; i < 32; i++) {
-        if (((data & 0x80000000) >> 24) ^ (*crc & 0x80)) {
-            *crc = *crc << 1;
-            *crc = *crc ^ ADI_AFE_SEQ_CRC8_POLYNOMIAL;
-        }
-        else {
-            *crc = *crc << 1;
-        }
-        data = data << 1;
-    }
-}
-
 static uint8_t sequenceCRC(const uint32_t *const data, uint32_t size) {
     uint32_t i;
     uint8_t crc;
 
-    crc = 0x01;
+    crc = ADI_AFE_SEQ_CRC8_INITIAL;
     for (i = 0; i < size; i++) {
-        crc8(&crc, data[i]);
+        crc = adi_AFE_SeqCrc8Word(crc, data[i]);
     }
 
     return crc;
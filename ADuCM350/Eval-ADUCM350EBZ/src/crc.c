@@ -705,8 +705,10 @@ ADI_CRC_RESULT_TYPE adi_CRC_BufferSubmit(ADI_CRC_DEV_HANDLE const hDevice,uint32
      }
      else
      {
-	 /* Only one iteration */
+	 /* Only one iteration; nothing left for the interrupt handler to
+	    schedule, or it would feed the buffer to the CRC a second time */
          hDevice->pBuffer = pBuff;
+         hDevice->unscheduledCnt = 0;
      }
       /*Initialize the address in DMA descriptor*/
      gDmaDescriptor.pSrcData    = pBuff;
@@ -54,12 +54,12 @@ License Agreement.
 /* BOOLEAN UNWAIT */
 #if (ADI_CFG_ENABLE_RTOS_SUPPORT == 1)
 #define BOOLEAN_UNWAIT(hDev, field) {                                                   \
-	hDev->##field = true;                                                           \
+	hDev->field = true;                                                             \
 	adi_osal_SemPost(hDev->hSem);                                                   \
 }
 #else
 #define BOOLEAN_UNWAIT(hDev, field) {                                                   \
-	hDev->##field = true;                                                           \
+	hDev->field = true;                                                             \
 	SystemExitLowPowerMode(&hDev->bLowPowerExitFlag);                               \
 }
 #endif /* ADI_CFG_ENABLE_RTOS_SUPPORT */
@@ -0,0 +1,157 @@
+#include <math.h>
+#include <string.h>
+
+#include "BeatDetector.h"
+
+// Coefficients are Q31 scaled down by 2^BEAT_POST_SHIFT, so that the
+// feedback coefficients (up to 2) fit.
+#define BEAT_POST_SHIFT 1
+
+#define BEAT_PI 3.14159265358979
+
+#define BEAT_THRESHOLD_Q15 ((BEAT_THRESHOLD_PERMILLE * 32768 + 500) / 1000)
+
+static q31_t beat_Coefficient(double value) {
+  return (q31_t) floor(value * (double) (1u << (31 - BEAT_POST_SHIFT)) + 0.5);
+}
+
+// One second-order Butterworth stage, in the CMSIS order b0 b1 b2 a1 a2
+// (feedback coefficients negated).  Runs only when the rate changes, so
+// floating point is fine here.
+static void beat_DesignStage(q31_t *coefficients, double corner_hz,
+                             double rate_hz, bool highpass) {
+  double w0 = 2.0 * BEAT_PI * corner_hz / rate_hz;
+  double alpha = sin(w0) / (2.0 * 0.70710678);
+  double a0 = 1.0 + alpha;
+  double b1 = highpass ? -(1.0 + cos(w0)) : 1.0 - cos(w0);
+  double b0 = (highpass ? -b1 : b1) / 2.0;
+
+  coefficients[0] = beat_Coefficient(b0 / a0);
+  coefficients[1] = beat_Coefficient(b1 / a0);
+  coefficients[2] = beat_Coefficient(b0 / a0);
+  coefficients[3] = beat_Coefficient(2.0 * cos(w0) / a0);
+  coefficients[4] = beat_Coefficient(-(1.0 - alpha) / a0);
+}
+
+static q31_t beat_Threshold(const BeatDetector *detector) {
+  return (q31_t) (((int64_t) detector->level * BEAT_THRESHOLD_Q15) >> 15);
+}
+
+void BeatDetector_Init(BeatDetector *detector, uint32_t rate_mhz) {
+  memset(detector, 0, sizeof(*detector));
+  detector->refractory_us = BEAT_REFRACTORY_US;
+  BeatDetector_SetRate(detector, rate_mhz);
+}
+
+void BeatDetector_SetRate(BeatDetector *detector, uint32_t rate_mhz) {
+  double rate_hz = rate_mhz / 1000.0;
+  double lowpass_hz = BEAT_LOWPASS_HZ;
+
+  if (lowpass_hz > 0.4 * rate_hz) {
+    lowpass_hz = 0.4 * rate_hz;
+  }
+  beat_DesignStage(&detector->coefficients[0], BEAT_HIGHPASS_HZ, rate_hz,
+                   true);
+  beat_DesignStage(&detector->coefficients[5], lowpass_hz, rate_hz, false);
+  arm_biquad_cascade_df1_init_q31(&detector->filter, BEAT_STAGES,
+                                  detector->coefficients, detector->state,
+                                  BEAT_POST_SHIFT);
+
+  // level * (1 - decay) per sample is exp(-period / BEAT_DECAY_US).
+  detector->decay = (uint32_t) ((1000000000.0 / rate_mhz) / BEAT_DECAY_US
+                                * 4294967296.0);
+
+  // Restart: the filter state was cleared by the init call.
+  detector->started = false;
+  detector->settled = false;
+  detector->in_peak = false;
+}
+
+bool BeatDetector_Add(BeatDetector *detector, uint32_t timestamp_us,
+                      int32_t magnitude, Beat *beat) {
+  q31_t input;
+  q31_t output;
+  int64_t scaled;
+  bool found = false;
+
+  if (!detector->started) {
+    // Filter deviations from the first magnitude, so the high-pass starts
+    // without a step and large magnitudes keep their headroom.
+    detector->started = true;
+    detector->offset = magnitude;
+    detector->start_us = timestamp_us;
+    detector->trough = 0;
+  }
+
+  // A pulse lowers the impedance: invert, so that beats are positive peaks.
+  scaled = ((int64_t) detector->offset - magnitude) << BEAT_INPUT_SHIFT;
+  if (scaled > INT32_MAX) {
+    scaled = INT32_MAX;
+  } else if (scaled < INT32_MIN) {
+    scaled = INT32_MIN;
+  }
+  input = (q31_t) scaled;
+  arm_biquad_cascade_df1_q31(&detector->filter, &input, &output, 1);
+
+  if (!detector->settled) {
+    // Learn the first peak level while the filter settles.
+    if (output > detector->level && detector->beats == 0) {
+      detector->level = output;
+    }
+    if (timestamp_us - detector->start_us < BEAT_SETTLE_US) {
+      return false;
+    }
+    detector->settled = true;
+    detector->trough = output;
+  }
+
+  detector->level -= (q31_t) (((uint64_t) detector->level * detector->decay)
+                              >> 32);
+  if (output < detector->trough) {
+    detector->trough = output;
+  }
+
+  if (detector->in_peak) {
+    if (output > detector->peak) {
+      detector->peak = output;
+      detector->peak_us = timestamp_us;
+    } else if (output < beat_Threshold(detector)) {
+      // Peak complete.
+      detector->in_peak = false;
+      beat->timestamp_us = detector->peak_us;
+      beat->interval_us = 0;
+      beat->rate = 0;
+      if (detector->have_beat) {
+        beat->interval_us = detector->peak_us - detector->last_beat_us;
+        if (beat->interval_us <= BEAT_MAX_INTERVAL_US) {
+          beat->rate = (uint16_t) ((60000000u * BEAT_RATE_PER_BPM
+                                    + beat->interval_us / 2)
+                                   / beat->interval_us);
+        }
+      }
+      beat->amplitude = (int32_t) (((int64_t) detector->peak
+                                    - detector->trough) >> BEAT_INPUT_SHIFT);
+      // Wait for most of the last interval before looking for the next
+      // beat, which keeps the dicrotic notch and noise from passing as one.
+      detector->refractory_us = BEAT_REFRACTORY_US;
+      if (beat->rate != 0 && beat->interval_us * 5 / 8 > BEAT_REFRACTORY_US) {
+        detector->refractory_us = beat->interval_us * 5 / 8;
+      }
+      detector->level += (detector->peak - detector->level) / 4;
+      detector->have_beat = true;
+      detector->last_beat_us = detector->peak_us;
+      detector->trough = output;
+      detector->beats++;
+      found = true;
+    }
+  } else if (output > beat_Threshold(detector)
+             && (!detector->have_beat
+                 || timestamp_us - detector->last_beat_us
+                    >= detector->refractory_us)) {
+    detector->in_peak = true;
+    detector->peak = output;
+    detector->peak_us = timestamp_us;
+  }
+
+  return found;
+}
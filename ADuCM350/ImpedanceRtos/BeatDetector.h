@@ -0,0 +1,109 @@
+#ifndef __BEAT_DETECTOR_H__
+#define __BEAT_DETECTOR_H__
+
+// Heart beats from the impedance magnitude.
+//
+// Every arterial pulse lowers the impedance under the electrodes a little.
+// BeatDetector_Add() takes one calibrated magnitude per output sample and
+// band-passes it with a two-stage CMSIS biquad (high-pass at
+// BEAT_HIGHPASS_HZ, low-pass at BEAT_LOWPASS_HZ), inverted so that a pulse
+// is a positive peak.  A beat is a peak above an adaptive threshold, a
+// fraction of the recent peak level, at least BEAT_REFRACTORY_US after the
+// previous beat, or 5/8 of the last interval if that is longer.  For each
+// beat it reports the time of the peak, the interval to the previous beat
+// with the heart rate from it, and the trough-to-peak amplitude.
+//
+// The filter is designed for the sample rate in BeatDetector_SetRate(), which
+// also restarts it; the detector then waits BEAT_SETTLE_US before it looks
+// for beats again.  Per sample the cost is the two biquad stages and a few
+// comparisons; only a beat costs a division.  Magnitudes use the 28.4 fixed-point
+// format of fixed32_t.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arm_math.h"
+
+// Band-pass corners, in Hz.  The low-pass is moved down to 40% of the
+// sample rate if needed.
+#ifndef BEAT_HIGHPASS_HZ
+#define BEAT_HIGHPASS_HZ 0.5
+#endif
+#ifndef BEAT_LOWPASS_HZ
+#define BEAT_LOWPASS_HZ 5.0
+#endif
+
+// Shortest and longest time between beats (200 bpm and 30 bpm).
+#ifndef BEAT_REFRACTORY_US
+#define BEAT_REFRACTORY_US 300000u
+#endif
+#ifndef BEAT_MAX_INTERVAL_US
+#define BEAT_MAX_INTERVAL_US 2000000u
+#endif
+
+// Threshold in permille of the peak level, and the time constant with which
+// the peak level decays between beats.
+#ifndef BEAT_THRESHOLD_PERMILLE
+#define BEAT_THRESHOLD_PERMILLE 500
+#endif
+#ifndef BEAT_DECAY_US
+#define BEAT_DECAY_US 3000000u
+#endif
+
+// Time after a (re)start without detection, while the filter settles and
+// the first peak level is learned.
+#ifndef BEAT_SETTLE_US
+#define BEAT_SETTLE_US 2000000u
+#endif
+
+// Magnitude LSBs are scaled up by this shift before filtering.
+#define BEAT_INPUT_SHIFT 16
+
+// Heart rate units.
+#define BEAT_RATE_PER_BPM 10
+
+#define BEAT_STAGES 2
+
+typedef struct {
+  uint32_t timestamp_us;  // Time of the peak.
+  uint32_t interval_us;   // Time since the previous beat, 0 if none.
+  uint16_t rate;          // Heart rate, 1/BEAT_RATE_PER_BPM bpm, 0 if none.
+  int32_t amplitude;      // Trough to peak, 28.4 like the magnitude.
+} Beat;
+
+typedef struct {
+  arm_biquad_casd_df1_inst_q31 filter;
+  q31_t coefficients[5 * BEAT_STAGES];
+  q31_t state[4 * BEAT_STAGES];
+  uint32_t decay;            // Peak level decay per sample, Q32.
+
+  bool started;
+  int32_t offset;            // First magnitude after a restart.
+  uint32_t start_us;
+  bool settled;
+
+  q31_t level;               // Recent peak level.
+  bool in_peak;
+  q31_t peak;
+  uint32_t peak_us;
+  q31_t trough;              // Lowest point since the last beat.
+  bool have_beat;
+  uint32_t last_beat_us;
+  uint32_t refractory_us;    // Time after a beat before the next one.
+
+  uint32_t beats;
+} BeatDetector;
+
+// Starts detection for samples at rate_mhz.
+extern void BeatDetector_Init(BeatDetector *detector, uint32_t rate_mhz);
+
+// Designs the filter for a new sample rate and restarts it.  The peak level
+// and the time of the last beat are kept.
+extern void BeatDetector_SetRate(BeatDetector *detector, uint32_t rate_mhz);
+
+// Adds one magnitude.  Returns true, with the beat in beat, once a peak is
+// complete.
+extern bool BeatDetector_Add(BeatDetector *detector, uint32_t timestamp_us,
+                             int32_t magnitude, Beat *beat);
+
+#endif  // __BEAT_DETECTOR_H__
@@ -0,0 +1,199 @@
+#include <string.h>
+
+#include "BpEstimator.h"
+
+// Fractional bits kept in the filter state.
+#define BP_FILTER_SHIFT 8
+
+// Q16 coefficient of a first-order low-pass with time constant tau_us, for
+// samples period_us apart.
+static int32_t bp_Alpha(uint32_t period_us, uint32_t tau_us) {
+  return (int32_t) (((uint64_t) period_us << 16) / ((uint64_t) tau_us
+                                                     + period_us));
+}
+
+static int32_t bp_Filter(int32_t state, int32_t input, int32_t alpha) {
+  return state + (int32_t) (((int64_t) (input - state) * alpha) >> 16);
+}
+
+// Halves the envelope, and the window with it, to make room.
+static void bp_Merge(BpEstimator *estimator) {
+  BpEnvelopePoint *points = estimator->points;
+  uint8_t i;
+
+  for (i = 0; i < BP_MAX_POINTS / 2; i++) {
+    points[i].pressure = (points[2 * i].pressure
+                          + points[2 * i + 1].pressure) / 2;
+    points[i].amplitude = (points[2 * i].amplitude
+                           + points[2 * i + 1].amplitude) / 2;
+  }
+  estimator->count = BP_MAX_POINTS / 2;
+  estimator->window_us *= 2;
+  estimator->merges++;
+}
+
+static void bp_EndWindow(BpEstimator *estimator) {
+  BpEnvelopePoint *point;
+  int32_t pressure = estimator->pressure_sum / estimator->window_samples;
+
+  if (pressure > estimator->highest_pressure) {
+    estimator->highest_pressure = pressure;
+  }
+
+  // Only record while deflating, and only pressures below the ones already
+  // recorded, so the envelope is ordered by falling pressure.
+  if (pressure < estimator->highest_pressure
+                 - BP_DEFLATION_MMHG * BP_PRESSURE_SCALE
+      && (estimator->count == 0
+          || pressure < estimator->points[estimator->count - 1].pressure)) {
+    if (estimator->count == BP_MAX_POINTS) {
+      bp_Merge(estimator);
+    }
+    point = &estimator->points[estimator->count++];
+    point->pressure = pressure;
+    point->amplitude = (estimator->window_max - estimator->window_min)
+                       >> BP_FILTER_SHIFT;
+  }
+}
+
+static void bp_StartWindow(BpEstimator *estimator, uint32_t timestamp_us) {
+  estimator->window_start_us = timestamp_us;
+  estimator->window_max = INT32_MIN;
+  estimator->window_min = INT32_MAX;
+  estimator->pressure_sum = 0;
+  estimator->window_samples = 0;
+}
+
+void BpEstimator_Init(BpEstimator *estimator, uint16_t systolic_permille,
+                      uint16_t diastolic_permille) {
+  memset(estimator, 0, sizeof(*estimator));
+  estimator->systolic_permille = systolic_permille;
+  estimator->diastolic_permille = diastolic_permille;
+  estimator->window_us = BP_WINDOW_US;
+  estimator->highest_pressure = INT32_MIN;
+}
+
+void BpEstimator_Add(BpEstimator *estimator, uint32_t timestamp_us,
+                     int32_t pressure) {
+  int32_t input = pressure << BP_FILTER_SHIFT;
+  uint32_t period_us;
+  int32_t oscillation;
+
+  if (!estimator->started) {
+    // Start both filters on the first sample, so the band-pass starts at 0.
+    estimator->started = true;
+    estimator->fast = estimator->slow = input;
+    estimator->last_us = timestamp_us;
+    bp_StartWindow(estimator, timestamp_us);
+    return;
+  }
+
+  period_us = timestamp_us - estimator->last_us;
+  estimator->last_us = timestamp_us;
+  if (period_us != estimator->period_us) {
+    estimator->period_us = period_us;
+    estimator->fast_alpha = bp_Alpha(period_us, BP_LOWPASS_TAU_US);
+    estimator->slow_alpha = bp_Alpha(period_us, BP_HIGHPASS_TAU_US);
+  }
+  estimator->fast = bp_Filter(estimator->fast, input, estimator->fast_alpha);
+  estimator->slow = bp_Filter(estimator->slow, input, estimator->slow_alpha);
+  oscillation = estimator->fast - estimator->slow;
+
+  if (oscillation > estimator->window_max) {
+    estimator->window_max = oscillation;
+  }
+  if (oscillation < estimator->window_min) {
+    estimator->window_min = oscillation;
+  }
+  estimator->pressure_sum += pressure;
+  estimator->window_samples++;
+
+  if (timestamp_us - estimator->window_start_us >= estimator->window_us) {
+    bp_EndWindow(estimator);
+    bp_StartWindow(estimator, timestamp_us);
+  }
+}
+
+// Envelope at point i, smoothed over its neighbours with weights 1 2 1.
+static int32_t bp_Envelope(const BpEstimator *estimator, int i) {
+  const BpEnvelopePoint *points = estimator->points;
+  int32_t previous = points[i > 0 ? i - 1 : i].amplitude;
+  int32_t next = points[i + 1 < estimator->count ? i + 1 : i].amplitude;
+
+  return (previous + 2 * points[i].amplitude + next) / 4;
+}
+
+// Pressure between points i and j where the envelope is at threshold.
+static int32_t bp_Crossing(const BpEstimator *estimator, int i, int j,
+                           int32_t threshold) {
+  int32_t envelope_i = bp_Envelope(estimator, i);
+  int32_t envelope_j = bp_Envelope(estimator, j);
+  int32_t pressure_i = estimator->points[i].pressure;
+  int32_t pressure_j = estimator->points[j].pressure;
+
+  if (envelope_i == envelope_j) {
+    return pressure_i;
+  }
+  return pressure_i + (int32_t) ((int64_t) (pressure_j - pressure_i)
+                                 * (threshold - envelope_i)
+                                 / (envelope_j - envelope_i));
+}
+
+bool BpEstimator_Result(const BpEstimator *estimator, BpResult *result) {
+  int32_t envelope;
+  int32_t threshold;
+  int peak = 0;
+  int i;
+
+  memset(result, 0, sizeof(*result));
+  if (estimator->count < 3) {
+    return false;
+  }
+
+  // MAP at the peak of the envelope.
+  result->amplitude = bp_Envelope(estimator, 0);
+  for (i = 1; i < estimator->count; i++) {
+    envelope = bp_Envelope(estimator, i);
+    if (envelope > result->amplitude) {
+      result->amplitude = envelope;
+      peak = i;
+    }
+  }
+  result->map = estimator->points[peak].pressure;
+  if (peak > 0 && peak + 1 < estimator->count) {
+    // Between two windows: put MAP at the vertex of the parabola through
+    // the peak and its neighbours.
+    int32_t before = bp_Envelope(estimator, peak - 1);
+    int32_t after = bp_Envelope(estimator, peak + 1);
+    int32_t curvature = before - 2 * result->amplitude + after;
+
+    if (curvature < 0) {
+      result->map += (int32_t) ((int64_t) (before - after)
+                                * (estimator->points[peak + 1].pressure
+                                   - estimator->points[peak - 1].pressure)
+                                / (4 * (int64_t) curvature));
+    }
+  }
+
+  // Systolic above MAP, recorded before the peak.
+  threshold = (int32_t) ((int64_t) result->amplitude
+                         * estimator->systolic_permille / 1000);
+  for (i = peak - 1; i >= 0; i--) {
+    if (bp_Envelope(estimator, i) < threshold) {
+      result->systolic = bp_Crossing(estimator, i, i + 1, threshold);
+      break;
+    }
+  }
+
+  // Diastolic below MAP, recorded after the peak.
+  threshold = (int32_t) ((int64_t) result->amplitude
+                         * estimator->diastolic_permille / 1000);
+  for (i = peak + 1; i < estimator->count; i++) {
+    if (bp_Envelope(estimator, i) < threshold) {
+      result->diastolic = bp_Crossing(estimator, i, i - 1, threshold);
+      break;
+    }
+  }
+
+  return result->systolic != 0 && result->diastolic != 0;
+}
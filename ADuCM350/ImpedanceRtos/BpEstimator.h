@@ -0,0 +1,117 @@
+#ifndef __BP_ESTIMATOR_H__
+#define __BP_ESTIMATOR_H__
+
+// Oscillometric blood pressure estimate from the cuff pressure.
+//
+// MainTask feeds every output sample (timestamp and cuff pressure) to
+// BpEstimator_Add().  The pressure is band-passed by the difference of two
+// first-order low-pass filters, which leaves the oscillations the arterial
+// pulse causes in the cuff and turns the deflation ramp into a constant
+// offset.  Their peak-to-peak amplitude over a window of at least one beat
+// gives one point of the envelope, stored with the mean cuff pressure of the
+// window, once the cuff deflates.  The filter coefficients follow the time
+// between samples, so the output rate may change during a session.
+//
+// BpEstimator_Result() smooths the envelope and puts the mean arterial
+// pressure (MAP) at its peak.  Systolic and diastolic pressure are where the
+// envelope falls to a fixed fraction of the peak, above and below MAP.
+//
+// Memory is fixed: when the envelope fills up, pairs of points are merged
+// and the window doubles.  Each sample costs a handful of multiplications
+// and, only when the sample period changes, two divisions.  Pressures are
+// in 1/16 mmHg.  Depends on the C standard library only.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Points kept of the envelope.  Must be even.
+#ifndef BP_MAX_POINTS
+#define BP_MAX_POINTS 48
+#endif
+
+// Initial window, long enough to hold one beat at 40 bpm.
+#ifndef BP_WINDOW_US
+#define BP_WINDOW_US 1500000u
+#endif
+
+// Time constants of the band-pass, for about 0.4 Hz to 4 Hz.
+#ifndef BP_HIGHPASS_TAU_US
+#define BP_HIGHPASS_TAU_US 400000u
+#endif
+#ifndef BP_LOWPASS_TAU_US
+#define BP_LOWPASS_TAU_US 40000u
+#endif
+
+// How far below the highest pressure the cuff has to be before the
+// envelope is recorded, so that inflation and hold are left out.
+#ifndef BP_DEFLATION_MMHG
+#define BP_DEFLATION_MMHG 5
+#endif
+
+// Default characteristic ratios: envelope at systolic and diastolic pressure
+// relative to the envelope at MAP.
+#define BP_SYSTOLIC_RATIO_PERMILLE 550
+#define BP_DIASTOLIC_RATIO_PERMILLE 750
+
+// Pressure units of the estimator.
+#define BP_PRESSURE_SCALE 16
+
+#if (BP_MAX_POINTS % 2) != 0
+#error "BP_MAX_POINTS must be even"
+#endif
+
+typedef struct {
+  int32_t pressure;   // Mean cuff pressure over the window.
+  int32_t amplitude;  // Peak-to-peak oscillation over the window.
+} BpEnvelopePoint;
+
+typedef struct {
+  uint16_t systolic_permille;
+  uint16_t diastolic_permille;
+
+  // Band-pass, in 1/16 mmHg << BP_FILTER_SHIFT.
+  bool started;
+  uint32_t last_us;
+  uint32_t period_us;  // Sample period the coefficients are for.
+  int32_t fast_alpha;  // Q16 coefficients.
+  int32_t slow_alpha;
+  int32_t fast;
+  int32_t slow;
+
+  // Current window.
+  uint32_t window_us;
+  uint32_t window_start_us;
+  int32_t window_max;
+  int32_t window_min;
+  int32_t pressure_sum;
+  uint16_t window_samples;
+
+  int32_t highest_pressure;
+  BpEnvelopePoint points[BP_MAX_POINTS];
+  uint8_t count;
+  uint8_t merges;  // Times the envelope was halved.
+} BpEstimator;
+
+typedef struct {
+  int32_t map;        // Mean arterial pressure.
+  int32_t systolic;
+  int32_t diastolic;
+  int32_t amplitude;  // Envelope at MAP, peak-to-peak.
+} BpResult;
+
+// Starts a new estimate.  The ratios are in permille of the envelope at MAP.
+extern void BpEstimator_Init(BpEstimator *estimator,
+                             uint16_t systolic_permille,
+                             uint16_t diastolic_permille);
+
+// Adds one cuff pressure sample.
+extern void BpEstimator_Add(BpEstimator *estimator, uint32_t timestamp_us,
+                            int32_t pressure);
+
+// Estimates from the envelope recorded so far; the window in progress is
+// left out.  Returns false, with whatever was found in result, if the
+// envelope has no peak with both crossings around it.
+extern bool BpEstimator_Result(const BpEstimator *estimator,
+                               BpResult *result);
+
+#endif  // __BP_ESTIMATOR_H__
@@ -0,0 +1,286 @@
+#include <string.h>
+
+#include "CrcService.h"
+
+#if (CRC_SERVICE_HW == 1)
+#include "crc.h"
+#endif
+
+// CRC-32 of one byte, reflected polynomial 0xEDB88320.
+static const uint32_t crc32_table[256] = {
+    0x00000000u, 0x77073096u, 0xEE0E612Cu, 0x990951BAu,
+    0x076DC419u, 0x706AF48Fu, 0xE963A535u, 0x9E6495A3u,
+    0x0EDB8832u, 0x79DCB8A4u, 0xE0D5E91Eu, 0x97D2D988u,
+    0x09B64C2Bu, 0x7EB17CBDu, 0xE7B82D07u, 0x90BF1D91u,
+    0x1DB71064u, 0x6AB020F2u, 0xF3B97148u, 0x84BE41DEu,
+    0x1ADAD47Du, 0x6DDDE4EBu, 0xF4D4B551u, 0x83D385C7u,
+    0x136C9856u, 0x646BA8C0u, 0xFD62F97Au, 0x8A65C9ECu,
+    0x14015C4Fu, 0x63066CD9u, 0xFA0F3D63u, 0x8D080DF5u,
+    0x3B6E20C8u, 0x4C69105Eu, 0xD56041E4u, 0xA2677172u,
+    0x3C03E4D1u, 0x4B04D447u, 0xD20D85FDu, 0xA50AB56Bu,
+    0x35B5A8FAu, 0x42B2986Cu, 0xDBBBC9D6u, 0xACBCF940u,
+    0x32D86CE3u, 0x45DF5C75u, 0xDCD60DCFu, 0xABD13D59u,
+    0x26D930ACu, 0x51DE003Au, 0xC8D75180u, 0xBFD06116u,
+    0x21B4F4B5u, 0x56B3C423u, 0xCFBA9599u, 0xB8BDA50Fu,
+    0x2802B89Eu, 0x5F058808u, 0xC60CD9B2u, 0xB10BE924u,
+    0x2F6F7C87u, 0x58684C11u, 0xC1611DABu, 0xB6662D3Du,
+    0x76DC4190u, 0x01DB7106u, 0x98D220BCu, 0xEFD5102Au,
+    0x71B18589u, 0x06B6B51Fu, 0x9FBFE4A5u, 0xE8B8D433u,
+    0x7807C9A2u, 0x0F00F934u, 0x9609A88Eu, 0xE10E9818u,
+    0x7F6A0DBBu, 0x086D3D2Du, 0x91646C97u, 0xE6635C01u,
+    0x6B6B51F4u, 0x1C6C6162u, 0x856530D8u, 0xF262004Eu,
+    0x6C0695EDu, 0x1B01A57Bu, 0x8208F4C1u, 0xF50FC457u,
+    0x65B0D9C6u, 0x12B7E950u, 0x8BBEB8EAu, 0xFCB9887Cu,
+    0x62DD1DDFu, 0x15DA2D49u, 0x8CD37CF3u, 0xFBD44C65u,
+    0x4DB26158u, 0x3AB551CEu, 0xA3BC0074u, 0xD4BB30E2u,
+    0x4ADFA541u, 0x3DD895D7u, 0xA4D1C46Du, 0xD3D6F4FBu,
+    0x4369E96Au, 0x346ED9FCu, 0xAD678846u, 0xDA60B8D0u,
+    0x44042D73u, 0x33031DE5u, 0xAA0A4C5Fu, 0xDD0D7CC9u,
+    0x5005713Cu, 0x270241AAu, 0xBE0B1010u, 0xC90C2086u,
+    0x5768B525u, 0x206F85B3u, 0xB966D409u, 0xCE61E49Fu,
+    0x5EDEF90Eu, 0x29D9C998u, 0xB0D09822u, 0xC7D7A8B4u,
+    0x59B33D17u, 0x2EB40D81u, 0xB7BD5C3Bu, 0xC0BA6CADu,
+    0xEDB88320u, 0x9ABFB3B6u, 0x03B6E20Cu, 0x74B1D29Au,
+    0xEAD54739u, 0x9DD277AFu, 0x04DB2615u, 0x73DC1683u,
+    0xE3630B12u, 0x94643B84u, 0x0D6D6A3Eu, 0x7A6A5AA8u,
+    0xE40ECF0Bu, 0x9309FF9Du, 0x0A00AE27u, 0x7D079EB1u,
+    0xF00F9344u, 0x8708A3D2u, 0x1E01F268u, 0x6906C2FEu,
+    0xF762575Du, 0x806567CBu, 0x196C3671u, 0x6E6B06E7u,
+    0xFED41B76u, 0x89D32BE0u, 0x10DA7A5Au, 0x67DD4ACCu,
+    0xF9B9DF6Fu, 0x8EBEEFF9u, 0x17B7BE43u, 0x60B08ED5u,
+    0xD6D6A3E8u, 0xA1D1937Eu, 0x38D8C2C4u, 0x4FDFF252u,
+    0xD1BB67F1u, 0xA6BC5767u, 0x3FB506DDu, 0x48B2364Bu,
+    0xD80D2BDAu, 0xAF0A1B4Cu, 0x36034AF6u, 0x41047A60u,
+    0xDF60EFC3u, 0xA867DF55u, 0x316E8EEFu, 0x4669BE79u,
+    0xCB61B38Cu, 0xBC66831Au, 0x256FD2A0u, 0x5268E236u,
+    0xCC0C7795u, 0xBB0B4703u, 0x220216B9u, 0x5505262Fu,
+    0xC5BA3BBEu, 0xB2BD0B28u, 0x2BB45A92u, 0x5CB36A04u,
+    0xC2D7FFA7u, 0xB5D0CF31u, 0x2CD99E8Bu, 0x5BDEAE1Du,
+    0x9B64C2B0u, 0xEC63F226u, 0x756AA39Cu, 0x026D930Au,
+    0x9C0906A9u, 0xEB0E363Fu, 0x72076785u, 0x05005713u,
+    0x95BF4A82u, 0xE2B87A14u, 0x7BB12BAEu, 0x0CB61B38u,
+    0x92D28E9Bu, 0xE5D5BE0Du, 0x7CDCEFB7u, 0x0BDBDF21u,
+    0x86D3D2D4u, 0xF1D4E242u, 0x68DDB3F8u, 0x1FDA836Eu,
+    0x81BE16CDu, 0xF6B9265Bu, 0x6FB077E1u, 0x18B74777u,
+    0x88085AE6u, 0xFF0F6A70u, 0x66063BCAu, 0x11010B5Cu,
+    0x8F659EFFu, 0xF862AE69u, 0x616BFFD3u, 0x166CCF45u,
+    0xA00AE278u, 0xD70DD2EEu, 0x4E048354u, 0x3903B3C2u,
+    0xA7672661u, 0xD06016F7u, 0x4969474Du, 0x3E6E77DBu,
+    0xAED16A4Au, 0xD9D65ADCu, 0x40DF0B66u, 0x37D83BF0u,
+    0xA9BCAE53u, 0xDEBB9EC5u, 0x47B2CF7Fu, 0x30B5FFE9u,
+    0xBDBDF21Cu, 0xCABAC28Au, 0x53B39330u, 0x24B4A3A6u,
+    0xBAD03605u, 0xCDD70693u, 0x54DE5729u, 0x23D967BFu,
+    0xB3667A2Eu, 0xC4614AB8u, 0x5D681B02u, 0x2A6F2B94u,
+    0xB40BBE37u, 0xC30C8EA1u, 0x5A05DF1Bu, 0x2D02EF8Du,
+};
+
+CrcServiceStats crc_service_stats;
+
+// Submitted jobs, oldest first; the first one is in the peripheral.
+static CrcJob *crc_queue_head;
+static CrcJob *crc_queue_tail;
+static uint32_t crc_queue_depth;
+
+uint32_t CrcService_Crc32Soft(uint32_t crc, const uint8_t *data,
+                              size_t length) {
+  crc = ~crc;
+  while (length--) {
+    crc = (crc >> 8) ^ crc32_table[(crc ^ *data++) & 0xFFu];
+  }
+  return ~crc;
+}
+
+static uint32_t crc_Reverse(uint32_t x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+  x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+// The peripheral shifts the most significant bit first and keeps the CRC
+// uninverted, so its result register holds the reflected CRC bit reversed.
+static uint32_t crc_ToRegister(uint32_t crc) {
+  return crc_Reverse(~crc);
+}
+
+static uint32_t crc_FromRegister(uint32_t value) {
+  return ~crc_Reverse(value);
+}
+
+#if (CRC_SERVICE_HW == 1)
+ADI_CRC_DEV_HANDLE hCrcDevice;
+
+static bool crc_Open(void) {
+  // Bit, byte and half-word mirroring together reverse each word, so the
+  // little-endian words read by the DMA go in in memory order.  The result
+  // register is seeded for each job, so it must not be reset on enable.
+  return ADI_CRC_SUCCESS == adi_CRC_Init(ADI_CRC_DEVID_0, &hCrcDevice)
+         && ADI_CRC_SUCCESS == adi_CRC_SetAutoReset(hCrcDevice,
+                                                    ADI_CRC_CKSUM_NONE)
+         && ADI_CRC_SUCCESS == adi_CRC_SetBitMirroring(hCrcDevice, true)
+         && ADI_CRC_SUCCESS == adi_CRC_SetByteMirroring(hCrcDevice, true)
+         && ADI_CRC_SUCCESS == adi_CRC_SetWordSwap(hCrcDevice, true)
+         && ADI_CRC_SUCCESS == adi_CRC_SetDmaMode(hCrcDevice, true);
+}
+
+static void crc_Start(const CrcJob *job) {
+  adi_CRC_SetResult(hCrcDevice, crc_ToRegister(job->crc));
+  adi_CRC_BufferSubmit(hCrcDevice, (uint32_t *) job->word_data, job->words);
+  adi_CRC_Enable(hCrcDevice, true);
+}
+
+static bool crc_Finished(uint32_t *value) {
+  bool_t available;
+
+  adi_CRC_IsResultAvailable(hCrcDevice, &available);
+  if (!available) {
+    return false;
+  }
+  adi_CRC_GetResult(hCrcDevice, value);
+  adi_CRC_Enable(hCrcDevice, false);
+  return true;
+}
+#else
+// Bit-level model of the peripheral: each word reversed, then shifted in
+// most significant bit first with polynomial 0x04C11DB7.
+static uint32_t crc_model_result;
+
+static bool crc_Open(void) {
+  return true;
+}
+
+static void crc_Start(const CrcJob *job) {
+  uint32_t value = crc_ToRegister(job->crc);
+  uint32_t i;
+  uint8_t bit;
+
+  for (i = 0; i < job->words; i++) {
+    value ^= crc_Reverse(job->word_data[i]);
+    for (bit = 0; bit < 32; bit++) {
+      value = (value & 0x80000000u) ? (value << 1) ^ 0x04C11DB7u
+                                    : value << 1;
+    }
+  }
+  crc_model_result = value;
+}
+
+static bool crc_Finished(uint32_t *value) {
+  *value = crc_model_result;
+  return true;
+}
+#endif /* CRC_SERVICE_HW */
+
+static void crc_Complete(CrcJob *job) {
+  job->busy = false;
+  if (job->done != NULL) {
+    job->done(job->context, job);
+  }
+}
+
+void CrcService_Submit(CrcJob *job) {
+  uint32_t head = 0;
+
+  crc_service_stats.jobs++;
+  job->busy = true;
+  job->words = 0;
+  if (crc_service_stats.hw_ok && job->length >= CRC_SERVICE_MIN_BYTES) {
+    head = (4u - ((uint32_t) (size_t) job->data & 3u)) & 3u;
+    job->words = (job->length - head) / 4;
+  }
+  if (job->words == 0) {
+    job->crc = CrcService_Crc32Soft(job->crc, job->data, job->length);
+    crc_service_stats.sw_bytes += job->length;
+    crc_Complete(job);
+    return;
+  }
+
+  // The bytes before the first word go first, so the peripheral starts
+  // from their CRC.
+  job->crc = CrcService_Crc32Soft(job->crc, job->data, head);
+  job->word_data = (const uint32_t *) (job->data + head);
+  job->next = NULL;
+  if (crc_queue_tail != NULL) {
+    crc_queue_tail->next = job;
+  } else {
+    crc_queue_head = job;
+  }
+  crc_queue_tail = job;
+  if (++crc_queue_depth > crc_service_stats.max_queue) {
+    crc_service_stats.max_queue = crc_queue_depth;
+  }
+  if (crc_queue_head == job) {
+    crc_Start(job);
+  }
+}
+
+void CrcService_Poll(void) {
+  CrcJob *job = crc_queue_head;
+  const uint8_t *tail;
+  uint32_t value;
+
+  if (job == NULL || !crc_Finished(&value)) {
+    return;
+  }
+
+  crc_queue_head = job->next;
+  if (crc_queue_head == NULL) {
+    crc_queue_tail = NULL;
+  }
+  crc_queue_depth--;
+  if (crc_queue_head != NULL) {
+    crc_Start(crc_queue_head);
+  }
+
+  tail = (const uint8_t *) (job->word_data + job->words);
+  job->crc = CrcService_Crc32Soft(crc_FromRegister(value), tail,
+                                  (size_t) (job->data + job->length - tail));
+  crc_service_stats.hw_bytes += job->words * 4;
+  crc_service_stats.sw_bytes += job->length - job->words * 4;
+  crc_Complete(job);
+}
+
+uint32_t CrcService_Wait(CrcJob *job) {
+  while (job->busy) {
+    CrcService_Poll();
+  }
+  return job->crc;
+}
+
+uint32_t CrcService_Crc32(uint32_t crc, const uint8_t *data, size_t length) {
+  CrcJob job;
+
+  job.data = data;
+  job.length = (uint32_t) length;
+  job.crc = crc;
+  job.done = NULL;
+  job.context = NULL;
+  CrcService_Submit(&job);
+  return CrcService_Wait(&job);
+}
+
+bool CrcService_Init(void) {
+  static union {
+    uint32_t align;
+    uint8_t bytes[CRC_SERVICE_MIN_BYTES + 7];
+  } check;
+  uint32_t expected;
+  uint32_t i;
+
+  memset(&crc_service_stats, 0, sizeof(crc_service_stats));
+  for (i = 0; i < sizeof(check.bytes); i++) {
+    check.bytes[i] = (uint8_t) (i * 167u + 13u);
+  }
+  expected = CrcService_Crc32Soft(0x12345678u, check.bytes + 1,
+                                  sizeof(check.bytes) - 1);
+
+  // Unaligned at both ends, from a non-zero CRC.
+  crc_service_stats.hw_ok = crc_Open();
+  if (crc_service_stats.hw_ok) {
+    crc_service_stats.hw_ok =
+        CrcService_Crc32(0x12345678u, check.bytes + 1,
+                         sizeof(check.bytes) - 1) == expected;
+  }
+  memset(&crc_service_stats, 0, offsetof(CrcServiceStats, hw_ok));
+  return crc_service_stats.hw_ok;
+}
@@ -0,0 +1,91 @@
+#ifndef __CRC_SERVICE_H__
+#define __CRC_SERVICE_H__
+
+// CRC-32 (IEEE 802.3, as zlib) on the CRC peripheral.
+//
+// Buffers are queued as CrcJobs and fed to the peripheral by DMA one after
+// the other, so the core is free while a page of flash or a block of
+// telemetry is checked.  The peripheral only takes whole, aligned 32-bit
+// words: the bytes before the first and after the last of them, and jobs
+// shorter than CRC_SERVICE_MIN_BYTES, are done by the table-driven software
+// kernel, CrcService_Crc32Soft().  The peripheral is set up to reverse each
+// word it reads, so that it sees the bytes in memory order, least
+// significant bit first, as the reflected CRC-32 does.  CrcService_Init()
+// checks it against the software kernel, and if the two ever differ
+// everything is done in software.
+//
+// Without the peripheral (CRC_SERVICE_HW 0, on a host) the same queue runs
+// against a bit-level model of it, so the splitting, seeding and word order
+// are checked by tools/crcservice.c.  Depends on the C standard library, and
+// on crc.c with CRC_SERVICE_HW.  Call from one task only.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CRC_SERVICE_HW
+#if defined(__ICCARM__)
+#define CRC_SERVICE_HW 1
+#else
+#define CRC_SERVICE_HW 0
+#endif
+#endif
+
+// Shorter jobs are not worth setting up a DMA transfer for.
+#ifndef CRC_SERVICE_MIN_BYTES
+#define CRC_SERVICE_MIN_BYTES 64
+#endif
+
+typedef struct CrcJob CrcJob;
+
+// Called by CrcService_Poll() when job is done, with its CRC.
+typedef void (*CrcDoneFn)(void *context, const CrcJob *job);
+
+struct CrcJob {
+  const uint8_t *data;      // Must stay unchanged until the job is done.
+  uint32_t length;
+  uint32_t crc;             // CRC so far (0 to start); the result when done.
+  CrcDoneFn done;           // May be NULL.
+  void *context;
+
+  // Owned by the service.
+  volatile bool busy;
+  const uint32_t *word_data;  // Aligned words for the peripheral.
+  uint32_t words;
+  CrcJob *next;
+};
+
+typedef struct {
+  uint32_t jobs;
+  uint32_t hw_bytes;        // Bytes that went through the peripheral.
+  uint32_t sw_bytes;
+  uint32_t max_queue;
+  bool hw_ok;               // Passed the check in CrcService_Init.
+} CrcServiceStats;
+
+extern CrcServiceStats crc_service_stats;
+
+// Opens the peripheral and checks it.  Returns false, and leaves all the
+// work to the software kernel, if it gives a different result.
+extern bool CrcService_Init(void);
+
+// Queues job; never waits.  A job the peripheral is not used for is done
+// before this returns.
+extern void CrcService_Submit(CrcJob *job);
+
+// Finishes the job in the peripheral, if it is done, and starts the next.
+extern void CrcService_Poll(void);
+
+// Waits for job, polling the service, and returns its CRC.
+extern uint32_t CrcService_Wait(CrcJob *job);
+
+// CRC of data, continuing from crc (0 to start): queued behind the jobs
+// already submitted, and waited for.
+extern uint32_t CrcService_Crc32(uint32_t crc, const uint8_t *data,
+                                 size_t length);
+
+// The software kernel, one table lookup per byte.
+extern uint32_t CrcService_Crc32Soft(uint32_t crc, const uint8_t *data,
+                                     size_t length);
+
+#endif  // __CRC_SERVICE_H__
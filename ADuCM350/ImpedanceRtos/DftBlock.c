@@ -0,0 +1,38 @@
+#include <string.h>
+
+#include "DftBlock.h"
+
+void DftBlock_Init(DftBlock *block, uint32_t period_us) {
+  memset(block, 0, sizeof(*block));
+  block->period_us = period_us;
+}
+
+uint16_t *DftBlock_Filling(DftBlock *block) {
+  return block->buffer[block->filling];
+}
+
+uint16_t *DftBlock_Next(DftBlock *block) {
+  block->filling ^= 1;
+  return block->buffer[block->filling];
+}
+
+bool DftBlock_Publish(DftBlock *block, DftRing *ring, uint32_t now_us) {
+  const uint16_t *words = block->buffer[block->filling ^ 1];
+  uint32_t timestamp_us;
+  bool wake = false;
+  int i;
+
+  // The last result of the block completed just now; the ones before it
+  // one DFT period apart.
+  timestamp_us = now_us - (DFT_BLOCK_RESULTS - 1) * block->period_us;
+  for (i = 0; i < DFT_BLOCK_RESULTS; i++) {
+    if (DftRing_Push(ring, (int16_t) words[2 * i], (int16_t) words[2 * i + 1],
+                     timestamp_us)) {
+      wake = true;
+    }
+    timestamp_us += block->period_us;
+  }
+
+  block->blocks++;
+  return wake;
+}
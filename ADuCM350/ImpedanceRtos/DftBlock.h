@@ -0,0 +1,51 @@
+#ifndef __DFT_BLOCK_H__
+#define __DFT_BLOCK_H__
+
+// Block acquisition of DFT results through the AFE data FIFO and RX DMA.
+//
+// The AFE writes every DFT result to the data FIFO as two words (real, then
+// imaginary), and the RX DMA channel moves them into one half of a two-half
+// buffer.  When a half is full the DMA done interrupt re-arms the DMA on the
+// other half (DftBlock_Next) and then moves the DFT_BLOCK_RESULTS results of
+// the full half into the DFT ring (DftBlock_Publish), so the task is
+// signalled once per block instead of once per result.  Depends on the C
+// standard library only, so the bookkeeping can be driven on a host.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "DftRing.h"
+
+// DFT results per DMA block (half buffer).  A block is 2 words per result
+// and one DMA cycle moves at most 1024 words.
+#ifndef DFT_BLOCK_RESULTS
+#define DFT_BLOCK_RESULTS 8
+#endif
+
+#define DFT_BLOCK_WORDS (2 * DFT_BLOCK_RESULTS)
+
+#if DFT_BLOCK_WORDS > 1024
+#error "DFT_BLOCK_RESULTS is too large for a single DMA cycle"
+#endif
+
+typedef struct {
+  uint16_t buffer[2][DFT_BLOCK_WORDS];  // DMA destination.
+  uint8_t filling;                      // Half the DMA is writing to.
+  uint32_t period_us;                   // Time between DFT results.
+  uint32_t blocks;                      // Blocks published so far.
+} DftBlock;
+
+extern void DftBlock_Init(DftBlock *block, uint32_t period_us);
+
+// Half to program the DMA with.  After DftBlock_Init, the first half.
+extern uint16_t *DftBlock_Filling(DftBlock *block);
+
+// Called when the DMA has filled the current half.  Returns the half to
+// re-arm the DMA with, which must happen before DftBlock_Publish.
+extern uint16_t *DftBlock_Next(DftBlock *block);
+
+// Pushes the results of the half that was just completed at now_us into the
+// ring.  Returns true if the consumer has to be woken up.
+extern bool DftBlock_Publish(DftBlock *block, DftRing *ring, uint32_t now_us);
+
+#endif  // __DFT_BLOCK_H__
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "DftRate.h"
+
+// 1000 / sqrt(n) for n = 1 .. DFT_RATE_MAX_AVERAGE, rounded.
+static const uint16_t noise_permille[16] = {
+    1000, 707, 577, 500, 447, 408, 378, 354,
+    333,  316, 302, 289, 277, 267, 258, 250,
+};
+
+#if DFT_RATE_MAX_AVERAGE > 16
+#error "Extend noise_permille for DFT_RATE_MAX_AVERAGE"
+#endif
+
+bool DftRate_Plan(DftRatePlan *plan, uint32_t rate_mhz) {
+  uint64_t sample_period_ns;
+  uint32_t dft_period_us;
+  uint32_t average;
+
+  if (rate_mhz == 0 || rate_mhz > DFT_RATE_MAX_MHZ) {
+    return false;
+  }
+
+  // Average as many DFTs as fit in one output period, then spread what is
+  // left of the period over them as idle time.
+  sample_period_ns = 1000000000000ull / rate_mhz;
+  average = (uint32_t) (sample_period_ns / (DFT_WAIT_US * 1000ull));
+  if (average > DFT_RATE_MAX_AVERAGE) {
+    average = DFT_RATE_MAX_AVERAGE;
+  }
+  if (average == 0) {
+    average = 1;
+  }
+  dft_period_us = (uint32_t) (sample_period_ns / average / 1000u);
+  if (dft_period_us < DFT_WAIT_US) {
+    dft_period_us = DFT_WAIT_US;
+  }
+  if (dft_period_us - DFT_WAIT_US > DFT_RATE_MAX_IDLE_US) {
+    return false;
+  }
+
+  plan->requested_mhz = rate_mhz;
+  plan->average = (uint8_t) average;
+  plan->idle_us = dft_period_us - DFT_WAIT_US;
+  plan->dft_period_us = dft_period_us;
+  plan->achieved_mhz = (uint32_t) (1000000000ull / (average * dft_period_us));
+  plan->dfts_per_rcal = (uint16_t) (((RCAL_INTERVAL + average - 1) / average)
+                                    * average);
+  plan->noise_permille = noise_permille[average - 1];
+  return true;
+}
+
+uint16_t DftRate_BuildLoop(const DftRatePlan *plan, uint32_t *sequence) {
+  uint32_t *word = &sequence[1];
+  uint16_t i;
+
+  memcpy(word, seq_loop_head, sizeof(seq_loop_head));
+  word += SEQ_LOOP_HEAD_LENGTH;
+  for (i = 0; i < plan->dfts_per_rcal; i++) {
+    memcpy(word, seq_loop_dft, sizeof(seq_loop_dft));
+    word += SEQ_LOOP_DFT_LENGTH;
+    if (plan->idle_us > 0) {
+      // Sequencer wait command: timer in 16 MHz cycles, bit 31 clear.
+      *word++ = plan->idle_us * 16u;
+    }
+  }
+
+  // Safety word: command count only, the CRC is never checked.
+  sequence[0] = (uint32_t) (word - &sequence[1]) << 16;
+  return (uint16_t) (word - sequence);
+}
@@ -0,0 +1,59 @@
+#ifndef __DFT_RATE_H__
+#define __DFT_RATE_H__
+
+// Output rate control for the measurement loop.
+//
+// The DFT of the ADuCM350 always runs over 2048 ADC samples, so one DFT
+// takes DFT_WAIT_US and the loop cannot produce more than about 78 results
+// per second.  Lower output rates are reached by averaging several DFTs per
+// output sample, which also lowers the noise by the square root of their
+// number, and by an idle wait after each DFT (ADC and DFT off) to hit the
+// requested rate.  DftRate_Plan() picks both for a requested rate and
+// reports the rate and relative noise actually achieved; DftRate_BuildLoop()
+// writes the matching loop sequence, built from the fragments in
+// Sequences.seq.  Depends on the C standard library only.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Sequences.h"
+
+// Most DFTs averaged into one output sample.
+#ifndef DFT_RATE_MAX_AVERAGE
+#define DFT_RATE_MAX_AVERAGE 16
+#endif
+
+// Fastest output rate, in mHz: one DFT per sample, no idle time.
+#define DFT_RATE_MAX_MHZ (1000000000u / DFT_WAIT_US)
+
+// Longest idle wait the sequencer can do (2^30 - 1 cycles at 16 MHz).
+#define DFT_RATE_MAX_IDLE_US (0x3FFFFFFFu / 16u)
+
+// Words in the largest loop sequence, safety word included.  The AFE3-AFE4
+// DFTs between two RCALs are rounded up to a multiple of the average.
+#define DFT_RATE_MAX_LENGTH                                        \
+  (1 + SEQ_LOOP_HEAD_LENGTH                                        \
+   + (RCAL_INTERVAL + DFT_RATE_MAX_AVERAGE - 1) * (SEQ_LOOP_DFT_LENGTH + 1))
+
+typedef struct {
+  uint32_t requested_mhz;   // Requested output rate.
+  uint32_t achieved_mhz;    // Output rate of the plan, RCAL DFTs aside.
+  uint8_t average;          // DFTs averaged per output sample.
+  uint32_t idle_us;         // Idle time after each DFT.
+  uint32_t dft_period_us;   // Time between two DFT results, idle included.
+  uint16_t dfts_per_rcal;   // AFE3-AFE4 DFTs between two RCAL DFTs.
+  uint16_t noise_permille;  // Output noise relative to a single DFT.
+} DftRatePlan;
+
+// Plans for rate_mhz.  Returns false, leaving the plan untouched, if the
+// rate is 0, above DFT_RATE_MAX_MHZ or needs a longer idle wait than the
+// sequencer can do.
+extern bool DftRate_Plan(DftRatePlan *plan, uint32_t rate_mhz);
+
+// Writes the loop sequence for the plan into sequence, which must hold
+// DFT_RATE_MAX_LENGTH words.  Returns the number of words written.  The
+// safety word carries the command count only: the loop never ends, so its
+// CRC is never checked.
+extern uint16_t DftRate_BuildLoop(const DftRatePlan *plan, uint32_t *sequence);
+
+#endif  // __DFT_RATE_H__
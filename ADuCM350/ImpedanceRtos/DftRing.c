@@ -0,0 +1,86 @@
+#include <string.h>
+
+#include "DftRing.h"
+
+// Orders the record writes before the index update that publishes them.
+#if defined(__ICCARM__)
+#include <intrinsics.h>
+#define RING_BARRIER() __DMB()
+#elif defined(__GNUC__)
+#define RING_BARRIER() __sync_synchronize()
+#else
+#define RING_BARRIER()
+#endif
+
+#define RING_MASK (DFT_RING_SIZE - 1)
+
+void DftRing_Init(DftRing *ring, DftRingPolicy policy) {
+  memset(ring, 0, sizeof(*ring));
+  ring->policy = policy;
+}
+
+bool DftRing_Push(DftRing *ring, int16_t real, int16_t imag,
+                  uint32_t timestamp_us) {
+  uint32_t head = ring->head;
+  uint32_t depth = head - ring->tail;
+  DftRecord *record;
+
+  if (depth >= DFT_RING_SIZE) {
+    if (ring->policy == DFT_RING_DROP_NEWEST) {
+      ring->sequence++;
+      ring->dropped++;
+      return false;
+    }
+    // Overwrite the oldest record; the consumer notices and skips it.
+  } else if (depth + 1 > ring->max_depth) {
+    ring->max_depth = depth + 1;
+  }
+
+  record = &ring->records[head & RING_MASK];
+  record->real = real;
+  record->imag = imag;
+  record->timestamp_us = timestamp_us;
+  record->sequence = ring->sequence++;
+  RING_BARRIER();
+  ring->head = head + 1;
+
+  return depth == 0;
+}
+
+const DftRecord *DftRing_Peek(DftRing *ring) {
+  uint32_t tail = ring->tail;
+  uint32_t depth = ring->head - tail;
+
+  if (depth == 0) {
+    return NULL;
+  }
+  if (depth > DFT_RING_SIZE) {
+    // The producer lapped us; skip what it overwrote.
+    ring->overwritten += depth - DFT_RING_SIZE;
+    tail += depth - DFT_RING_SIZE;
+    ring->tail = tail;
+  }
+
+  RING_BARRIER();
+  return &ring->records[tail & RING_MASK];
+}
+
+bool DftRing_Release(DftRing *ring) {
+  uint32_t tail = ring->tail;
+  bool intact;
+
+  // The slot was reused if the producer got more than a lap ahead of it.
+  RING_BARRIER();
+  intact = ring->head - tail <= DFT_RING_SIZE;
+  if (!intact) {
+    ring->overwritten++;
+  }
+  ring->tail = tail + 1;
+  return intact;
+}
+
+uint32_t DftRing_Depth(const DftRing *ring) {
+  uint32_t depth = ring->head - ring->tail;
+
+  return depth > DFT_RING_SIZE ? DFT_RING_SIZE : depth;
+}
@@ -0,0 +1,77 @@
+#ifndef __DFT_RING_H__
+#define __DFT_RING_H__
+
+// Ring of DFT results from the AFE interrupt to MainTask.
+//
+// The ISR is the only producer and writes only the head index; MainTask is
+// the only consumer and writes only the tail index.  Records are read in
+// place (DftRing_Peek/DftRing_Release), so nothing is copied on the way
+// through, and the ring never fails when it fills up: depending on the
+// policy either the newest result is dropped or the oldest is overwritten,
+// and either way the loss is counted.  Every result gets a sequence number,
+// so the consumer can also see gaps directly.
+//
+// DftRing_Push() reports when the ring goes from empty to non-empty; only
+// then does the ISR need to wake the consumer, which drains everything
+// queued before it waits again.  Depends on the C standard library only.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of records in the ring; must be a power of two.
+#ifndef DFT_RING_SIZE
+#define DFT_RING_SIZE 32
+#endif
+
+#if (DFT_RING_SIZE & (DFT_RING_SIZE - 1)) != 0
+#error "DFT_RING_SIZE must be a power of two"
+#endif
+
+typedef struct {
+  int16_t real;
+  int16_t imag;
+  uint32_t timestamp_us;
+  uint32_t sequence;
+} DftRecord;
+
+typedef enum {
+  DFT_RING_DROP_NEWEST,       // Keep what is queued; discard new results.
+  DFT_RING_OVERWRITE_OLDEST,  // Keep the freshest results.
+} DftRingPolicy;
+
+typedef struct {
+  DftRecord records[DFT_RING_SIZE];
+  volatile uint32_t head;     // Written by the producer only.
+  volatile uint32_t tail;     // Written by the consumer only.
+  DftRingPolicy policy;
+
+  // Written by the producer only.
+  uint32_t sequence;          // Sequence number of the next result.
+  uint32_t dropped;           // Results discarded (DFT_RING_DROP_NEWEST).
+  uint32_t max_depth;         // Largest number of queued records seen.
+
+  // Written by the consumer only.
+  uint32_t overwritten;       // Results lost (DFT_RING_OVERWRITE_OLDEST).
+} DftRing;
+
+// Must not run concurrently with either side.
+extern void DftRing_Init(DftRing *ring, DftRingPolicy policy);
+
+// Producer side.  Returns true if the ring was empty, i.e. if the consumer
+// has to be woken up.
+extern bool DftRing_Push(DftRing *ring, int16_t real, int16_t imag,
+                         uint32_t timestamp_us);
+
+// Consumer side.  Returns the oldest queued record, in place, or NULL if the
+// ring is empty.  The record stays valid until DftRing_Release().
+extern const DftRecord *DftRing_Peek(DftRing *ring);
+
+// Consumer side.  Frees the record returned by DftRing_Peek().  Returns false
+// if the producer overwrote it in the meantime, in which case whatever was
+// read from it must be discarded.
+extern bool DftRing_Release(DftRing *ring);
+
+// Number of queued records.
+extern uint32_t DftRing_Depth(const DftRing *ring);
+
+#endif  // __DFT_RING_H__
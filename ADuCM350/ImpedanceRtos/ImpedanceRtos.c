@@ -2,6 +2,7 @@
 
 OS_STK g_TaskMainStack[TASK_MAIN_STK_SIZE];
 OS_STK g_TaskPumpStack[TASK_PUMP_STK_SIZE];
+OS_STK g_TaskTelemetryStack[TASK_TELEMETRY_STK_SIZE];
 OS_STK g_TaskUxStack[TASK_UX_STK_SIZE];
 
 OS_EVENT *i2c_mutex;
@@ -22,6 +23,9 @@ int main(void) {
   test_Init();
   adi_initpinmux();
 
+  // Start the microsecond clock for DFT, pressure and telemetry timestamps.
+  Timestamp_Init();
+
   OSInit();
 
   // Create a mutex indicating that I2C is initialized.
@@ -36,6 +40,19 @@ int main(void) {
     FAIL("Error creating the button semaphore\n");
   }
 
+  // Create the semaphore the I2C interrupt posts when a transfer is done.
+  pressure_semaphore = OSSemCreate(0);
+  if (pressure_semaphore == (void *) 0) {
+    FAIL("Error creating the pressure semaphore\n");
+  }
+
+  // Create the ring and semaphore MainTask uses to hand off telemetry.
+  TelemetryRing_Init(&telemetry_ring);
+  telemetry_semaphore = OSSemCreate(0);
+  if (telemetry_semaphore == (void *) 0) {
+    FAIL("Error creating the telemetry semaphore\n");
+  }
+
   // Create the main task.
   OSRetVal = OSTaskCreate(MainTask, NULL,
                           (OS_STK*)&g_TaskMainStack[TASK_MAIN_STK_SIZE - 1],
@@ -52,6 +69,15 @@ int main(void) {
     FAIL("Error creating the pump task.\n");
   }
 
+  // Create the task that formats and sends telemetry for the main task.
+  OSRetVal = OSTaskCreate(TelemetryTask, NULL,
+                          (OS_STK*)&g_TaskTelemetryStack[
+                              TASK_TELEMETRY_STK_SIZE - 1],
+                          TASK_TELEMETRY_PRIO);
+  if (OSRetVal != OS_ERR_NONE) {
+    FAIL("Error creating the telemetry task.\n");
+  }
+
   // Create the low-priority UX task.
   OSRetVal =
       OSTaskCreate(UX_Task, NULL, (OS_STK*)&g_TaskUxStack[TASK_UX_STK_SIZE - 1],
@@ -60,6 +86,19 @@ int main(void) {
     FAIL("Error creating the UX task.\n");
   }
 
+  // Names for the trace dump (see Trace.h).
+  OSTaskNameSet(TASK_MAIN_PRIO, (INT8U *) "MainTask", &OSRetVal);
+  OSTaskNameSet(TASK_PUMP_PRIO, (INT8U *) "PumpTask", &OSRetVal);
+  OSTaskNameSet(TASK_TELEMETRY_PRIO, (INT8U *) "TelemetryTask", &OSRetVal);
+  OSTaskNameSet(TASK_UX_PRIO, (INT8U *) "UX_Task", &OSRetVal);
+  OSEventNameSet(i2c_mutex, (INT8U *) "i2c_mutex", &OSRetVal);
+  OSEventNameSet(ux_button_semaphore, (INT8U *) "ux_button_semaphore",
+                 &OSRetVal);
+  OSEventNameSet(pressure_semaphore, (INT8U *) "pressure_semaphore",
+                 &OSRetVal);
+  OSEventNameSet(telemetry_semaphore, (INT8U *) "telemetry_semaphore",
+                 &OSRetVal);
+
   SysTick_Config(M3_FREQ / SYSTICKS_PER_SECOND);
   OSStart();
 
@@ -54,6 +54,8 @@
 #define TASK_MAIN_PRIO 5
 #define TASK_PUMP_STK_SIZE 512u
 #define TASK_PUMP_PRIO 6
+#define TASK_TELEMETRY_STK_SIZE 512u
+#define TASK_TELEMETRY_PRIO 7
 #define TASK_UX_STK_SIZE 512u
 #define TASK_UX_PRIO 8
 
@@ -84,7 +86,7 @@ extern volatile bool ux_is_engaged;
 // serial clocks are possible, at the cost of higher power consumption.
 #define I2C_MASTER_CLOCK 100000
 
-// Maximum I2C TX/RX buffer size.
+// Size of the target pressure command, without the data address byte.
 #define I2C_BUFFER_SIZE 3
 
 // Slave address of the Arduino pump module.
@@ -107,17 +109,169 @@ extern volatile bool ux_is_engaged;
 #define CUFF_DEFLATE_DELAY_S 2
 #define CUFF_NORMALIZE_AFTER_INFLATE_DELAY_S 3
 
+// Rate at which PumpTask reads the cuff pressure while the cuff is up, in
+// Hz; must divide OS_TICKS_PER_SEC.  Each read brings the samples the
+// Arduino took since the one before, 4 at 50 Hz, and takes ~3 ms of the bus.
+#define PRESSURE_POLL_HZ 50
+#define PRESSURE_POLL_TICKS (OS_TICKS_PER_SEC / PRESSURE_POLL_HZ)
+
+#if (OS_TICKS_PER_SEC % PRESSURE_POLL_HZ) != 0
+#error "PRESSURE_POLL_HZ must divide OS_TICKS_PER_SEC"
+#endif
+
+// Longest an I2C transfer to the Arduino may take, in ticks.
+#define PRESSURE_I2C_TIMEOUT_TICKS 5
+
+// Samples the Arduino sends in bursts (see PressureBurst.h), published by
+// PumpTask's I2C interrupt (see PressureSlot.h).
+#include "PressureBurst.h"
+#include "PressureSlot.h"
+
+extern PressureSlot pressure_slot;
+extern OS_EVENT *pressure_semaphore;
+
 extern void PumpTask(void *arg);
+extern void PumpTask_Deflate(void);
+extern void PumpTask_I2CCallback(void *pCBParam, uint32_t Event, void *pArg);
 
 extern uint16_t mmhg_to_transducer(uint32_t pressure);
 extern uint32_t transducer_to_mmhg(uint16_t transducer);
+extern int32_t transducer_to_mmhg16(uint16_t transducer);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Timestamps (implemented in Timestamp.c). ////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Timestamp.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace recorder (implemented in Trace.c). ////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Enable with APP_TRACE_EN (os_cfg.h; on in the Debug configuration); size
+// with TRACE_RING_SIZE (see Trace.h).
+#include "Trace.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Impedance task (implemented in MainTask.c). /////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
+// Fractional LSB size for the fixed32_t type defined below, used for printing
+// only.
+#define FIXED32_LSB_SIZE (625)
+#define MSG_MAXLEN (50)
+
+// Helper macro for printing strings to UART or Std. Output.
+#define PRINT(s) test_print(s)
+
+// Custom fixed-point type used for final results, to keep track of the
+// decimal point position.  Signed number with 28 integer bits and 4
+// fractional bits.
+typedef union {
+  int32_t full;
+  struct {
+    uint8_t fpart : 4;
+    int32_t ipart : 28;
+  } parts;
+} fixed32_t;
+
+// Size the DFT result ring with DFT_RING_SIZE (see DftRing.h).
+#include "DftRing.h"
+
+// Size DFT blocks with DFT_BLOCK_RESULTS (see DftBlock.h).
+#include "DftBlock.h"
+#include "Sweep.h"
+
+// Sequencer programs, generated from Sequences.seq by tools/afeseq.cpp.
+#include "Sequences.h"
+#include "DftRate.h"
+#include "BpEstimator.h"
+#include "BeatDetector.h"
+#include "Pipeline.h"
+
 extern void MainTask(void *arg);
+extern void MainTask_SetDecimation(uint16_t ratio);
+
+// Hooks for the host simulations in tools/ (MainTask_SetRates); the
+// firmware keeps the rates fixed.  sessionsim builds with -DUSE_SIM_HOOKS=1.
+#ifndef USE_SIM_HOOKS
+#define USE_SIM_HOOKS (0)
+#endif
+
+#if (1 == USE_SIM_HOOKS)
+extern bool MainTask_SetRates(uint32_t window_mhz, uint32_t outside_mhz);
+#endif
+
+extern void test_print(char *pBuffer);
+extern void test_write(const void *pBuffer, int16_t size);
+extern void test_service(void);
+extern void test_flush(void);
+extern int16_t test_read(void *pBuffer, int16_t size);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CRC-32 service (implemented in CrcService.c). ///////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#include "CrcService.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Telemetry framing (implemented in Telemetry.c). /////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Select the wire format with TELEMETRY_FORMAT (see Telemetry.h).
+#include "Telemetry.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// UART transmit queue (implemented in UartTx.c). //////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#include "UartTx.h"
+
+extern UartTx uart_tx;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Session store (implemented in SessionStore.c). //////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SessionStore.h"
+
+// Keep a copy of every session in flash, and answer the bulk-read commands
+// 'L' and 'D' on the UART (see telemetry_Command in TelemetryTask.c).
+#define USE_SESSION_STORE (1)
+
+// The upper 112K of flash block 1.  iar/ImpedanceRtos.icf ends ROM just
+// below it, so an image that grows into it fails to link.
+#define SESSION_FLASH_BASE 0x00044000u
+#define SESSION_FLASH_PAGES 56
+
+extern SessionStore session_store;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Telemetry task (implemented in TelemetryTask.c). ////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Size the ring with TELEMETRY_RING_SIZE (see TelemetryRing.h).
+#include "TelemetryRing.h"
+
+// Records queued before MainTask wakes the telemetry task.
+#define TELEMETRY_BURST_SIZE 8
+
+// Longest a partial burst waits before it is sent anyway, in ticks.
+#define TELEMETRY_FLUSH_TICKS 10
+
+extern void TelemetryTask(void *arg);
+extern void TelemetryTask_Post(uint8_t type, const TelemetrySample *sample);
+
+extern TelemetryRing telemetry_ring;
+extern OS_EVENT *telemetry_semaphore;
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -5,22 +5,25 @@
 /*      0 = return AFE data on SW (Std Output)               */
 #define USE_UART_FOR_DATA (1)
 
-/* Excitation frequency in Hz */
-#define FREQ (50000)
-/* Peak voltage in mV */
-#define VPEAK (599)  //(12.73)
+/* Excitation frequency (FREQ) and peak voltage (VPEAK) are set in
+ * Sequences.seq, together with the sequences that use them. */
+
 /* RCAL value, in ohms */
 #define RCAL (1000)
 
-/* FCW = FREQ * 2^26 / 16e6 */
-#define FCW ((uint32_t)(((uint64_t)FREQ << 26) / 16000000 + 0.5))
-
 /* DAC LSB size in mV, before attenuator (1.6V / (2^12 - 1)) */
 #define DAC_LSB_SIZE (0.39072)
 
 /* Sine amplitude in DAC codes */
 #define SINE_AMPLITUDE ((uint16_t)((VPEAK) / DAC_LSB_SIZE + 0.5))
 
+/* Excitation frequencies of the impedance spectrum measured at startup, in
+ * Hz (at most SWEEP_MAX_POINTS, each up to SWEEP_MAX_FREQUENCY_HZ) */
+#define SWEEP_FREQUENCIES {1000, 5000, 10000, 20000, 50000, 80000}
+
+/* Passes through SWEEP_FREQUENCIES at startup; 0 disables the sweep */
+#define SWEEP_ROUNDS (4)
+
 /* If both real and imaginary result are within the interval
  * (DFT_RESULTS_OPEN_MIN_THR, DFT_RESULTS_OPEN_MAX_THR),  */
 /* it is considered an open circuit and results for both magnitude and phase
@@ -32,34 +35,6 @@
  * results */
 #define DFT_RESULTS_COUNT (8)
 
-/* Fractional LSB size for the fixed32_t type defined below, used for printing
- * only. */
-#define FIXED32_LSB_SIZE (625)
-#define MSG_MAXLEN (50)
-
-/* Helper macro for printing strings to UART or Std. Output */
-#define PRINT(s) test_print(s)
-
-/* Custom fixed-point type used for final results,              */
-/* to keep track of the decimal point position.                 */
-/* Signed number with 28 integer bits and 4 fractional bits.    */
-typedef union {
-  int32_t full;
-  struct {
-    uint8_t fpart : 4;
-    int32_t ipart : 28;
-  } parts;
-} fixed32_t;
-
-// Type used for passing impedance results through the message queue.
-typedef union {
-  void *pointer;
-  struct {
-    int16_t magnitude : 16;
-    int16_t phase : 16;
-  } parts;
-} packed32_t;
-
 // Time stuff
 
 // leap-year compute macro (ignores leap-seconds)
@@ -88,69 +63,169 @@ uint32_t BuildSeconds(void);
 
 /* callbacks */
 void rtcCallback(void *pCBParam, uint32_t Event, void *EventArg);
-void wutCallback(void *pCBParam, uint32_t Event, void *EventArg);
+static void wutCallback(void *pCBParam, uint32_t Event, void *EventArg);
 
-void AFE_DFT_Callback(void *pCBParam, uint32_t Event, void *pArg);
+static void AFE_DFT_Callback(void *pCBParam, uint32_t Event, void *pArg);
+void AFE_DFT_BlockCallback(void *pCBParam, uint32_t Event, void *pArg);
 
 ADI_UART_HANDLE hUartDevice = NULL;
 ADI_I2C_DEV_HANDLE i2cDevice = NULL;
 
+/* Internal buffers for the UART driver (interrupt mode). */
+#define UART_DRIVER_RX_SIZE 16
+#define UART_DRIVER_TX_SIZE 256
+uint8_t uart_rx_buffer[UART_DRIVER_RX_SIZE];
+uint8_t uart_tx_buffer[UART_DRIVER_TX_SIZE];
+
+/* Double-buffered transmit queue in front of the UART driver, used by the
+   telemetry task only. */
+UartTx uart_tx;
+
 /* Function prototypes */
 q15_t arctan(q15_t imag, q15_t real);
 fixed32_t calculate_magnitude(q31_t magnitude_rcal, q31_t magnitude_z);
 fixed32_t calculate_phase(q15_t phase_rcal, q15_t phase_z);
 void convert_dft_results(int16_t *dft_results, q15_t *dft_results_q15,
                          q31_t *dft_results_q31);
-void sprintf_fixed32(char *out, fixed32_t in);
-void print_PressureMagnitudePhase(char *text, uint16_t pressure,
-                                  fixed32_t magnitude, fixed32_t phase,
-                                  int queue_size);
-void test_print(char *pBuffer);
+uint16_t uart_TxWrite(void *context, const uint8_t *data, uint16_t size);
 ADI_UART_RESULT_TYPE uart_Init(void);
 ADI_UART_RESULT_TYPE uart_UnInit(void);
 void i2c_Init(ADI_I2C_DEV_HANDLE *i2cDevice);
+void sweep_Measure(ADI_AFE_DEV_HANDLE hDevice, uint16_t rounds);
 
-/* Sequence for AC measurement, performs 4 DFTs:        */
-/*     RCAL, AFE3-AFE4, AFE4-AFE5, AFE3-AFE5            */
-uint32_t seq_afe_acmeas2wire[] = {
-    0x00120043, /* Safety word: bits 31:16 = command count, bits 7:0 =
-                   CRC */
-    0x84005818, /* AFE_FIFO_CFG: DATA_FIFO_SOURCE_SEL = 10 */
-    0x8A000034, /* AFE_WG_CFG: TYPE_SEL = 10 */
-    0x98000000, /* AFE_WG_CFG: SINE_FCW = 0 (placeholder, user
-                   programmable) */
-    0x9E000000, /* AFE_WG_AMPLITUDE: SINE_AMPLITUDE = 0 (placeholder,
-                   user programmable) */
-    0x88000F00, /* AFE_DAC_CFG: DAC_ATTEN_EN = 0 */
-    0xA0000002, /* AFE_ADC_CFG: MUX_SEL = 00010, GAIN_OFFS_SEL = 00 */
-    /* RCAL */
-    0x86008811, /* DMUX_STATE = 1, PMUX_STATE = 1, NMUX_STATE = 8,
-                   TMUX_STATE = 8 */
-    0x00000640, /* Wait 100us */
-    0x80024EF0, /* AFE_CFG: WAVEGEN_EN = 1 */
-    0x00000C80, /* Wait 200us */
-    0x8002CFF0, /* AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1 */
-    0x00032340, /* Wait 13ms */
-    0x80024EF0, /* AFE_CFG: ADC_CONV_EN = 0, DFT_EN = 0 */
-    /* AFE3 - AFE4 */
-    0x86003344, /* DMUX_STATE = 3, PMUX_STATE = 3, NMUX_STATE = 4,
-                   TMUX_STATE = 4 */
-    0x00000640, /* Wait 100us */
-    0x8002CFF0, /* AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1 */
-    0x00032340, /* Wait 13ms */
-
-    0x82000002, /* AFE_SEQ_CFG: SEQ_EN = 0 */
-};
+#if (SWEEP_ROUNDS > 0)
+/* Sequences for the startup sweep, built once */
+const uint32_t sweep_frequencies[] = SWEEP_FREQUENCIES;
+Sweep sweep;
+#endif
+
+/* Macro to select the AFE program used during a session.                  */
+/*      1 = loop: one RCAL DFT every RCAL_INTERVAL or so AFE3-AFE4 DFTs,   */
+/*          at an output rate that follows the cuff pressure              */
+/*      0 = free-running DFT on AFE3-AFE4 left by seq_afe_acmeas2wire      */
+#define USE_RCAL_LOOP (1)
+
+/* Weight of a new RCAL result in magnitudecal/phasecal: 1 / 2^shift */
+#define RCAL_FILTER_SHIFT (2)
+
+/* Output rate in mHz while the cuff pressure is in the window where the
+   oscillations around mean arterial pressure are, and outside of it. Below
+   the fastest rate, DFTs are averaged (see DftRate.h). With USE_SIM_HOOKS,
+   MainTask_SetRates changes both rates at runtime. */
+#define DFT_RATE_WINDOW_MHZ (76000)
+#define DFT_RATE_OUTSIDE_MHZ (19000)
+#define DFT_RATE_WINDOW_LOW_MMHG (50)
+#define DFT_RATE_WINDOW_HIGH_MMHG (150)
+/* How far the pressure has to leave the window to switch back */
+#define DFT_RATE_WINDOW_HYSTERESIS_MMHG (5)
+
+#if (1 == USE_SIM_HOOKS)
+/* Rates of the next session; MainTask_SetRates changes them at runtime. */
+volatile uint32_t dft_rate_window_mhz = DFT_RATE_WINDOW_MHZ;
+volatile uint32_t dft_rate_outside_mhz = DFT_RATE_OUTSIDE_MHZ;
+#endif
+
+/* Current rate plan, and the loop sequence built from it. */
+DftRatePlan dft_rate;
+uint32_t seq_afe_loop[DFT_RATE_MAX_LENGTH];
+
+/* Ring sequence number of the first result (an RCAL) of the running loop. */
+uint32_t dft_rcal_base;
+
+/* Set while the loop runs; the TX DMA callback only re-arms while set. */
+volatile bool afe_loop_running;
+
+/* TX DMA re-arms the driver refused, and loop restarts after a stall. */
+volatile uint32_t afe_loop_refill_errors;
+uint32_t afe_loop_restarts;
 
-#define DFT_QUEUE_SIZE 20
+void dft_SetRate(ADI_AFE_DEV_HANDLE hDevice, uint32_t rate_mhz);
+void afe_StartLoop(ADI_AFE_DEV_HANDLE hDevice);
+void afe_StopLoop(ADI_AFE_DEV_HANDLE hDevice);
+void AFE_Loop_TxCallback(void *pCBParam, uint32_t Event, void *pArg);
+
+/* What the DFT ring does when MainTask falls behind: keep the freshest
+   results (DFT_RING_OVERWRITE_OLDEST) or the queued ones (DFT_RING_DROP_NEWEST). */
+#define DFT_RING_POLICY DFT_RING_OVERWRITE_OLDEST
 
 uint32_t nummeasurements;
 uint8_t done;
 
-OS_EVENT *dft_queue;
-void *dft_queue_msg[DFT_QUEUE_SIZE];
+/* Macro to select how DFT results are read from the AFE.                 */
+/*      1 = data FIFO + RX DMA, one interrupt per DFT_BLOCK_RESULTS       */
+/*      0 = one DFT result interrupt per result                           */
+#define USE_DFT_BLOCK_ACQUISITION (1)
+
+/* Time between DFT results, in us (13 ms DFT plus settling, ~76 Hz). */
+#define DFT_PERIOD_US (13158)
+
+/* If no DFT result arrives for this many DFT periods (a few blocks), the
+   loop is restarted; if it stalls again before it has delivered as many
+   results, the session ends and the cuff is deflated. */
+#define DFT_STALL_RESULTS (4 * DFT_BLOCK_RESULTS)
+
+INT32U dft_StallTicks(void);
+
+/* DFT results from the AFE callbacks, and the semaphore they post when the
+   ring goes from empty to non-empty. */
+DftRing dft_ring;
+OS_EVENT *dft_semaphore;
+
+#if (1 == USE_DFT_BLOCK_ACQUISITION)
+/* RX DMA destination for block acquisition. */
+DftBlock dft_block;
+#endif
+
+/* Blood pressure estimate from the cuff pressure of the session. */
+BpEstimator bp_estimator;
+
+void bp_Report(void);
+
+/* Heart beats from the impedance magnitude, sent as BEAT frames. */
+BeatDetector beat_detector;
+
+/* Processing between the DFT conversion and the output, run in the order
+   below (see pipeline_Start). To add a stage, give it an index here, bump
+   PIPELINE_STAGES and configure it in pipeline_Start. */
+#define PIPELINE_STAGE_DECIMATE (0)
+#define PIPELINE_STAGE_CLAMP (1)
+#define PIPELINE_STAGES (2)
+
+/* Output samples are means of OUTPUT_DECIMATION times the DFT results the
+   rate plan already averages (DftRatePlan.average), pressure included.
+   MainTask_SetDecimation changes the factor at runtime. The filter is a
+   boxcar for DECIMATION_ORDER 1 and a CIC of that order for 2 or 3. */
+#define OUTPUT_DECIMATION (1)
+#define DECIMATION_ORDER (1)
+
+volatile uint16_t output_decimation = OUTPUT_DECIMATION;
+uint16_t decimation_applied;
+uint16_t decimation_ratio;
+uint32_t raw_rate_mhz;
+uint32_t output_rate_mhz;
+
+void decimation_Update(void);
+void decimation_Post(uint8_t type);
+
+/* Largest change of the magnitude between two samples, in 28.4 ohms; a
+   bigger step (electrode contact, I2C glitch) is cut to this. 0 = off. */
+#define PIPELINE_CLAMP_STEP (0)
 
-uint8_t i2c_rx[I2C_BUFFER_SIZE];
+PipelineStage pipeline_stages[PIPELINE_STAGES];
+Pipeline pipeline;
+
+/* Time between a DFT result and the pressure reading paired with it. */
+uint32_t pressure_lag_max_us;
+uint64_t pressure_lag_sum_us;
+uint32_t pressure_readings;
+
+void pipeline_Start(void);
+void pipeline_Report(void);
+uint32_t pipeline_Cycles(void);
+
+void dft_InitAcquisition(ADI_AFE_DEV_HANDLE hDevice);
+void dft_StartAcquisition(ADI_AFE_DEV_HANDLE hDevice);
+void dft_StopAcquisition(ADI_AFE_DEV_HANDLE hDevice);
 
 void MainTask(void *arg) {
   ADI_AFE_DEV_HANDLE hDevice;
@@ -158,17 +233,30 @@ void MainTask(void *arg) {
   q15_t dft_results_q15[DFT_RESULTS_COUNT];
   q31_t dft_results_q31[DFT_RESULTS_COUNT];
   q31_t magnitude[DFT_RESULTS_COUNT / 2];
-  q15_t phase[DFT_RESULTS_COUNT / 2];
-  fixed32_t magnitude_result[DFT_RESULTS_COUNT / 2 - 1];
-  fixed32_t phase_result[DFT_RESULTS_COUNT / 2 - 1];
-  char msg[MSG_MAXLEN];
   uint8_t err;
   done = 0;
-  uint16_t pressure_analog;
+  PressureReading pressure_reading;
   uint32_t pressure;
   nummeasurements = 0;
   uint32_t rtcCount;
-  ADI_I2C_RESULT_TYPE i2cResult;
+  TelemetrySample sample;
+  bool is_rcal;
+  Beat beat;
+  PipelineSample processed;
+  int32_t pressure16;
+  int32_t pressure_lag_us;
+  q31_t rcal_magnitude;
+  q15_t rcal_phase;
+  fixed32_t magnituderesult;
+  fixed32_t phasecalibrated;
+  q15_t phaseresult;
+  uint32_t recovering;
+#if (1 == USE_RCAL_LOOP)
+  uint32_t rate_mhz;
+  uint32_t margin;
+  uint32_t window_mhz;
+  uint32_t outside_mhz;
+#endif
 
   // Initialize driver.
   rtc_Init();
@@ -217,15 +305,10 @@ void MainTask(void *arg) {
     FAIL("adi_AFE_ExciteChanCalAtten");
   }
 
-  // Update FCW in the sequence.
-  seq_afe_acmeas2wire[3] = SEQ_MMR_WRITE(REG_AFE_AFE_WG_FCW, FCW);
-  // Update sine amplitude in the sequence.
-  seq_afe_acmeas2wire[4] =
-      SEQ_MMR_WRITE(REG_AFE_AFE_WG_AMPLITUDE, SINE_AMPLITUDE);
-
-  // Recalculate CRC in software for the AC measurement, because we changed.
-  // FCW and sine amplitude settings.
-  adi_AFE_EnableSoftwareCRC(hDevice, true);
+#if (SWEEP_ROUNDS > 0)
+  // Impedance spectrum first; seq_afe_acmeas2wire below restores FCW.
+  sweep_Measure(hDevice, SWEEP_ROUNDS);
+#endif
 
   // Perform the impedance measurement.
   if (adi_AFE_RunSequence(hDevice, seq_afe_acmeas2wire, (uint16_t *)dft_results,
@@ -249,38 +332,29 @@ void MainTask(void *arg) {
   q15_t phasecal;
 
   convert_dft_results(dft_results, dft_results_q15, dft_results_q31);
-  arm_cmplx_mag_q31(dft_results_q31, &magnitudecal, 2);
+  arm_cmplx_mag_q31(dft_results_q31, &magnitudecal, 1);
 
   phasecal = arctan(dft_results[1], dft_results[0]);
 
   printf("raw rcal data: %d, %d\r\n", dft_results[1], dft_results[0]);
   printf("rcal (magnitude, phase) = (%d, %d)\r\n", magnitudecal, phasecal);
 
-  // Create the message queue for communicating between the ISR and this task.
-  dft_queue = OSQCreate(&dft_queue_msg[0], DFT_QUEUE_SIZE);
-
-  // Hook into the DFT interrupt.
-  if (ADI_AFE_SUCCESS !=
-      adi_AFE_RegisterAfeCallback(
-          hDevice, ADI_AFE_INT_GROUP_CAPTURE, AFE_DFT_Callback,
-          BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN)) {
-    FAIL("adi_AFE_RegisterAfeCallback");
-  }
-  if (ADI_AFE_SUCCESS !=
-      adi_AFE_ClearInterruptSource(
-          hDevice, ADI_AFE_INT_GROUP_CAPTURE,
-          BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN)) {
-    FAIL("adi_AFE_ClearInterruptSource (1)");
+  // Create the semaphore the ISR uses to wake this task.
+  dft_semaphore = OSSemCreate(0);
+  if (dft_semaphore == (void *) 0) {
+    FAIL("OSSemCreate: dft_semaphore");
   }
+  OSEventNameSet(dft_semaphore, (INT8U *) "dft_semaphore", &err);
+
+  // Hook into the DFT interrupt or the RX DMA.
+  dft_InitAcquisition(hDevice);
 
-  packed32_t q_result;
-  void *q_result_void;
-  OS_Q_DATA q_data;
-  uint16_t q_size;
+  const DftRecord *dft_record;
   bool inflated = false;
   while (true) {
     // Wait for the user to press the button.
     printf("MainTask: waiting for button.\n");
+    TRACE_SEM(TRACE_SEM_PEND, ux_button_semaphore);
     OSSemPend(ux_button_semaphore, 0, &err);
     if (err != OS_ERR_NONE) {
       FAIL("OSSemPend: MainTask");
@@ -301,102 +375,233 @@ void MainTask(void *arg) {
       FAIL("OSTimeDlyHMSM: MainTask (3)");
     }
     
-    // Enable the DFT interrupt.
-    printf("MainTask: enabling DFT interrupt.\n");
-    if (ADI_AFE_SUCCESS !=
-        adi_AFE_EnableInterruptSource(
-            hDevice, ADI_AFE_INT_GROUP_CAPTURE,
-            BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN, true)) {
-      FAIL("adi_AFE_EnableInterruptSource");
+    // Start the session with an empty ring; acquisition is still off.
+    DftRing_Init(&dft_ring, DFT_RING_POLICY);
+    BpEstimator_Init(&bp_estimator, BP_SYSTOLIC_RATIO_PERMILLE,
+                     BP_DIASTOLIC_RATIO_PERMILLE);
+    pressure_lag_max_us = 0;
+    pressure_lag_sum_us = 0;
+    pressure_readings = 0;
+
+    printf("MainTask: starting DFT acquisition.\n");
+#if (1 == USE_RCAL_LOOP)
+    // The rates hold for the whole session. The cuff is deflated, so start
+    // outside the window.
+#if (1 == USE_SIM_HOOKS)
+    window_mhz = dft_rate_window_mhz;
+    outside_mhz = dft_rate_outside_mhz;
+#else
+    window_mhz = DFT_RATE_WINDOW_MHZ;
+    outside_mhz = DFT_RATE_OUTSIDE_MHZ;
+#endif
+    if (!DftRate_Plan(&dft_rate, outside_mhz)) {
+      FAIL("DftRate_Plan: outside_mhz");
     }
-    
-    PRINT("START\r\n");
-    printf("START\r\n");
 
+    // Start the loop first, so that the first result collected is its RCAL.
+    afe_StartLoop(hDevice);
+#endif
+    pipeline_Start();
+    BeatDetector_Init(&beat_detector, output_rate_mhz);
+    dft_StartAcquisition(hDevice);
+    
+    // The START frame is the session header: DFT and output rates.
+    decimation_Post(TELEMETRY_FRAME_START);
+    printf("START (%u mHz DFT, %u mHz out)\r\n", (unsigned) raw_rate_mhz,
+           (unsigned) output_rate_mhz);
+
+    recovering = 0;
+    afe_loop_restarts = 0;
+    afe_loop_refill_errors = 0;
     while (true) {
-      // Wait on the queue to get DFT data from the ISR (~76 Hz).
-      //printf("MainTask: pending on DFT queue.\n");
-      q_result_void = OSQPend(dft_queue, 0, &err);
-      q_result.pointer = q_result_void;
-      if (err != OS_ERR_NONE) {
-        FAIL("OSQPend: dft_queue");
+      // Take the oldest DFT result from the ISR (~76 Hz). Only sleep once
+      // the ring is empty; the ISR posts once per batch, not per result.
+      dft_record = DftRing_Peek(&dft_ring);
+      if (dft_record == NULL) {
+        TRACE_SEM(TRACE_SEM_PEND, dft_semaphore);
+        OSSemPend(dft_semaphore, dft_StallTicks(), &err);
+        if (err == OS_ERR_TIMEOUT && recovering == 0) {
+          // The AFE went quiet (e.g. the sequencer stopped). Start over.
+          printf("MainTask: no DFT results, restarting the loop.\n");
+          recovering = DFT_STALL_RESULTS;
+          afe_loop_restarts++;
+#if (1 == USE_RCAL_LOOP)
+          dft_SetRate(hDevice, dft_rate.requested_mhz);
+#else
+          dft_StopAcquisition(hDevice);
+          dft_StartAcquisition(hDevice);
+#endif
+        } else if (err == OS_ERR_TIMEOUT) {
+          // Stalled again so soon: give up on the session rather than
+          // leave the cuff inflated.
+          printf("MainTask: no DFT results, ending the session.\n");
+          TelemetryTask_Post(TELEMETRY_FRAME_END, NULL);
+          inflated = false;
+          break;
+        } else if (err != OS_ERR_NONE) {
+          FAIL("OSSemPend: dft_semaphore");
+        }
+        continue;
       }
-      OSQQuery(dft_queue, &q_data);
-      q_size = q_data.OSNMsgs;
-    
-      // Right after we get this data, get the transducer's value from the
-      // Arduino.
-      //printf("MainTask: getting transducer value via I2C.\n");
-      i2cResult = adi_I2C_MasterReceive(i2cDevice, I2C_PUMP_SLAVE_ADDRESS, 0x0,
-                                        ADI_I2C_8_BIT_DATA_ADDRESS_WIDTH,
-                                        i2c_rx, 3, false);
-      if (i2cResult != ADI_I2C_SUCCESS) {
-        FAIL("adi_I2C_MasterReceive: get pressure from Arduino");
+      if (recovering > 0) {
+        recovering--;
       }
-
-      // Get the analog pressure value from the Arduino.
-      if (i2c_rx[0] == ARDUINO_PRESSURE_AVAILABLE
-          || i2c_rx[0] == ARDUINO_STILL_INFLATING) {
-        pressure_analog = i2c_rx[1] | (i2c_rx[2] << 8);
-      } else {
-        FAIL("Corrupted or unexpected data from Arduino.");
+      dft_results[0] = dft_record->real;
+      dft_results[1] = dft_record->imag;
+      sample.timestamp_us = dft_record->timestamp_us;
+#if (1 == USE_RCAL_LOOP)
+      // The loop measures RCAL first, then dfts_per_rcal times AFE3-AFE4.
+      is_rcal = (dft_record->sequence - dft_rcal_base)
+                % (dft_rate.dfts_per_rcal + 1) == 0;
+#else
+      is_rcal = false;
+#endif
+      if (!DftRing_Release(&dft_ring)) {
+        // Overwritten by the ISR while we read it; counted in the ring.
+        continue;
       }
-      
-      // Convert the analog value to mmHg.
-      pressure = transducer_to_mmhg(pressure_analog);
-      //printf("MainTask: got pressure value: %d mmHg.\n", pressure);
-      
-      // If the pressure is below the threshold, we're done; break the loop.
-      if (inflated && pressure < LOWEST_PRESSURE_THRESHOLD_MMHG) {
-        PRINT("END\r\n");
-        printf("END\r\n");
-        inflated = false;
-        break;
-      } else if (pressure > LOWEST_PRESSURE_THRESHOLD_MMHG * 1.1) {
-        inflated = true;
+      TRACE_EVENT(TRACE_QUEUE_PEND, TRACE_QUEUE_DFT_RING,
+                  DftRing_Depth(&dft_ring));
+
+      if (is_rcal) {
+        // Fresh RCAL result: let the calibration follow slow drift.
+        convert_dft_results(dft_results, dft_results_q15, dft_results_q31);
+        arm_cmplx_mag_q31(dft_results_q31, &rcal_magnitude, 1);
+        rcal_phase = arctan(dft_results[1], dft_results[0]);
+        magnitudecal += (q31_t)(((q63_t)rcal_magnitude - magnitudecal)
+                                >> RCAL_FILTER_SHIFT);
+        phasecal += (q15_t)(((int32_t)rcal_phase - phasecal)
+                            >> RCAL_FILTER_SHIFT);
+        continue;
       }
 
       // Convert DFT results to 1.15 and 1.31 formats.
-      dft_results[0] = q_result.parts.magnitude;
-      dft_results[1] = q_result.parts.phase;
       convert_dft_results(dft_results, dft_results_q15, dft_results_q31);
 
       // Compute the magnitude using CMSIS.
       arm_cmplx_mag_q31(dft_results_q31, magnitude, DFT_RESULTS_COUNT / 2);
 
       // Calculate final magnitude values, calibrated with RCAL.
-      fixed32_t magnituderesult;
       magnituderesult = calculate_magnitude(magnitudecal, magnitude[0]);
-      q15_t phaseresult;
       phaseresult = arctan(dft_results[1], dft_results[0]);
-      fixed32_t phasecalibrated;
 
       // Calibrate with phase from rcal.
       phasecalibrated = calculate_phase(phasecal, phaseresult);
+
+      // Pair the result with the pressure reading taken nearest to it.
+      // PumpTask polls the Arduino on its own, so this never waits for I2C;
+      // there is nothing to pair with only before its first read.
+      if (!PressureSlot_Nearest(&pressure_slot, sample.timestamp_us,
+                                &pressure_reading)) {
+        continue;
+      }
+      pressure_lag_us =
+          (int32_t) (pressure_reading.timestamp_us - sample.timestamp_us);
+      if (pressure_lag_us < 0) {
+        pressure_lag_us = -pressure_lag_us;
+      }
+      if ((uint32_t) pressure_lag_us > pressure_lag_max_us) {
+        pressure_lag_max_us = (uint32_t) pressure_lag_us;
+      }
+      pressure_lag_sum_us += (uint32_t) pressure_lag_us;
+      pressure_readings++;
+
+      // Filter and decimate, the pressure (in 1/16 mmHg) with the same
+      // weights as the impedance; below the fastest rate, one sample is
+      // the mean of several DFTs.
+      processed.timestamp_us = sample.timestamp_us;
+      processed.value[PIPELINE_MAGNITUDE] = magnituderesult.full;
+      processed.value[PIPELINE_PHASE] = phasecalibrated.full;
+      processed.value[PIPELINE_PRESSURE] =
+          transducer_to_mmhg16(pressure_reading.analog);
+      if (Pipeline_Process(&pipeline, &processed, 1) == 0) {
+        continue;
+      }
+      sample.timestamp_us = processed.timestamp_us;
+      magnituderesult.full = processed.value[PIPELINE_MAGNITUDE];
+      phasecalibrated.full = processed.value[PIPELINE_PHASE];
+      pressure16 = processed.value[PIPELINE_PRESSURE];
+
+      // Convert to whole mmHg.
+      pressure = pressure16 > 0 ? (uint32_t) (pressure16 + 8) / 16 : 0;
+      //printf("MainTask: got pressure value: %d mmHg.\n", pressure);
+      BpEstimator_Add(&bp_estimator, sample.timestamp_us, pressure16);
       
-      // TODO: dispatch to another thread?
-      //printf("MainTask: sending data via UART.\n");;
-      print_PressureMagnitudePhase("", pressure, magnituderesult, phasecalibrated,
-                                   q_size);
+      // If the pressure is below the threshold, we're done; break the loop.
+      if (inflated && pressure < LOWEST_PRESSURE_THRESHOLD_MMHG) {
+        TelemetryTask_Post(TELEMETRY_FRAME_END, NULL);
+        printf("END\r\n");
+        bp_Report();
+        inflated = false;
+        break;
+      } else if (pressure > LOWEST_PRESSURE_THRESHOLD_MMHG * 1.1) {
+        inflated = true;
+      }
+
+      // Hand the result to the telemetry task, which formats and sends it.
+      sample.pressure = pressure;
+      sample.magnitude = magnituderesult.full;
+      sample.phase = phasecalibrated.full;
+      TelemetryTask_Post(TELEMETRY_FRAME_SAMPLE, &sample);
       nummeasurements++;
+
+      if (BeatDetector_Add(&beat_detector, sample.timestamp_us,
+                           magnituderesult.full, &beat)) {
+        sample.timestamp_us = beat.timestamp_us;
+        sample.pressure = beat.rate;
+        sample.magnitude = beat.amplitude;
+        sample.phase = 0;
+        TelemetryTask_Post(TELEMETRY_FRAME_BEAT, &sample);
+      }
+
+#if (1 == USE_RCAL_LOOP)
+      // Sample faster while the pressure is in the window, with some
+      // hysteresis so that noise on the pressure doesn't restart the loop.
+      margin = dft_rate.requested_mhz == window_mhz
+                   ? DFT_RATE_WINDOW_HYSTERESIS_MMHG : 0;
+      if (pressure + margin >= DFT_RATE_WINDOW_LOW_MMHG
+          && pressure <= DFT_RATE_WINDOW_HIGH_MMHG + margin) {
+        rate_mhz = window_mhz;
+      } else {
+        rate_mhz = outside_mhz;
+      }
+      if (rate_mhz != dft_rate.requested_mhz) {
+        dft_SetRate(hDevice, rate_mhz);
+        decimation_applied = 0;
+      }
+#endif
+
+      // New rate plan or decimation: restart the pipeline and tell the host.
+      if (decimation_applied != output_decimation) {
+        decimation_Update();
+        BeatDetector_SetRate(&beat_detector, output_rate_mhz);
+        decimation_Post(TELEMETRY_FRAME_RATE);
+      }
     }
 
     
-    // We're done measuring, for now. Disable the DFT interrupts.
-    printf("MainTask: disabling DFT interrupts.\n");
-    if (ADI_AFE_SUCCESS !=
-        adi_AFE_EnableInterruptSource(
-            hDevice, ADI_AFE_INT_GROUP_CAPTURE,
-            BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN, false)) {
-      FAIL("adi_AFE_EnableInterruptSource (false)");
+    // We're done measuring, for now. Stop the DFT interrupts or DMA.
+    printf("MainTask: stopping DFT acquisition.\n");
+#if (1 == USE_RCAL_LOOP)
+    afe_StopLoop(hDevice);
+    printf("MainTask: rcal (magnitude, phase) = (%d, %d)\r\n", magnitudecal,
+           phasecal);
+#endif
+    dft_StopAcquisition(hDevice);
+    pipeline_Report();
+    printf("MainTask: %u DFT results, %u dropped, %u overwritten "
+           "(max depth %u/%u).\n", (unsigned) dft_ring.sequence,
+           (unsigned) dft_ring.dropped, (unsigned) dft_ring.overwritten,
+           (unsigned) dft_ring.max_depth, (unsigned) DFT_RING_SIZE);
+    if (afe_loop_restarts != 0 || afe_loop_refill_errors != 0) {
+      printf("MainTask: %u loop restarts, %u TX DMA re-arm errors.\n",
+             (unsigned) afe_loop_restarts,
+             (unsigned) afe_loop_refill_errors);
     }
     
-    // Tell the pump task to deflate the cuff.
-    printf("MainTask: resuming pump task to deflate the cuff.\n");
-    err = OSTaskResume(TASK_PUMP_PRIO);
-    if (err != OS_ERR_NONE) {
-      FAIL("OSTaskResume: MainTask (2)");
-    }
+    // Tell the pump task to stop reading the pressure and deflate the cuff.
+    printf("MainTask: asking pump task to deflate the cuff.\n");
+    PumpTask_Deflate();
 
     // Suspend until the pump finishes deflating. We can then go back to
     // listening for the user input.
@@ -411,25 +616,372 @@ void MainTask(void *arg) {
   }
 }
 
-packed32_t pend_dft_results;
 
 static void AFE_DFT_Callback(void *pCBParam, uint32_t Event, void *pArg) {
   OSIntEnter();
   
-  if (pADI_AFE->AFE_DFT_RESULT_REAL != pADI_AFE->AFE_DFT_RESULT_REAL & 0xFF  
-    || pADI_AFE->AFE_DFT_RESULT_IMAG != pADI_AFE->AFE_DFT_RESULT_IMAG & 0xFF) {
-    FAIL("lost data");
+  // Never fails: if MainTask is behind, the ring drops or overwrites and
+  // counts it. Only wake MainTask if it may be waiting for data.
+  if (DftRing_Push(&dft_ring, (int16_t) pADI_AFE->AFE_DFT_RESULT_REAL,
+                   (int16_t) pADI_AFE->AFE_DFT_RESULT_IMAG, Timestamp_Now32())) {
+    TRACE_SEM(TRACE_SEM_POST, dft_semaphore);
+    OSSemPost(dft_semaphore);
   }
+  TRACE_EVENT(TRACE_QUEUE_POST, TRACE_QUEUE_DFT_RING, DftRing_Depth(&dft_ring));
+
+  OSIntExit();
+}
+
+/* RX DMA done: one half of dft_block holds DFT_BLOCK_RESULTS results. */
+void AFE_DFT_BlockCallback(void *pCBParam, uint32_t Event, void *pArg) {
+  ADI_AFE_DEV_HANDLE hDevice = (ADI_AFE_DEV_HANDLE) pCBParam;
+
+  OSIntEnter();
+
+  // Re-arm on the other half first; the data FIFO holds the results that
+  // arrive meanwhile. The driver disables this interrupt after every cycle.
+  adi_AFE_ProgramRxDMA(hDevice, DftBlock_Next(&dft_block), DFT_BLOCK_WORDS);
+  ADI_ENABLE_INT(DMA_AFE_RX_IRQn);
 
-  pend_dft_results.parts.magnitude = pADI_AFE->AFE_DFT_RESULT_REAL;
-  pend_dft_results.parts.phase = pADI_AFE->AFE_DFT_RESULT_IMAG;
-  if (OS_ERR_NONE != OSQPost(dft_queue, pend_dft_results.pointer)) {
-    FAIL("AFE_DFT_Callback: OSQPost");
+  // One semaphore post per block, at most.
+  if (DftBlock_Publish(&dft_block, &dft_ring, Timestamp_Now32())) {
+    TRACE_SEM(TRACE_SEM_POST, dft_semaphore);
+    OSSemPost(dft_semaphore);
   }
+  TRACE_EVENT(TRACE_QUEUE_POST, TRACE_QUEUE_DFT_RING, DftRing_Depth(&dft_ring));
 
   OSIntExit();
 }
 
+/* Registers the callback for the selected acquisition mode */
+void dft_InitAcquisition(ADI_AFE_DEV_HANDLE hDevice) {
+#if (1 == USE_DFT_BLOCK_ACQUISITION)
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_RegisterCallbackOnReceiveDMA(hDevice, AFE_DFT_BlockCallback,
+                                           0)) {
+    FAIL("adi_AFE_RegisterCallbackOnReceiveDMA");
+  }
+#else
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_RegisterAfeCallback(
+          hDevice, ADI_AFE_INT_GROUP_CAPTURE, AFE_DFT_Callback,
+          BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN)) {
+    FAIL("adi_AFE_RegisterAfeCallback");
+  }
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_ClearInterruptSource(
+          hDevice, ADI_AFE_INT_GROUP_CAPTURE,
+          BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN)) {
+    FAIL("adi_AFE_ClearInterruptSource (1)");
+  }
+#endif /* USE_DFT_BLOCK_ACQUISITION */
+}
+
+/* Starts delivering DFT results to dft_ring */
+void dft_StartAcquisition(ADI_AFE_DEV_HANDLE hDevice) {
+#if (1 == USE_DFT_BLOCK_ACQUISITION)
+#if (1 == USE_RCAL_LOOP)
+  DftBlock_Init(&dft_block, dft_rate.dft_period_us);
+#else
+  DftBlock_Init(&dft_block, DFT_PERIOD_US);
+#endif
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_ProgramRxDMA(hDevice, DftBlock_Filling(&dft_block),
+                           DFT_BLOCK_WORDS)) {
+    FAIL("adi_AFE_ProgramRxDMA");
+  }
+  ADI_ENABLE_INT(DMA_AFE_RX_IRQn);
+
+  // The sequencer left the data FIFO source on the DFT but disabled the
+  // FIFO when it stopped. Re-enabling it starts from an empty FIFO, so the
+  // first block starts on a real/imaginary boundary.
+  pADI_AFE->AFE_FIFO_CFG &= ~(BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN
+                              | BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_DMA_REQ_EN);
+  pADI_AFE->AFE_FIFO_CFG |= BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN
+                            | BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_DMA_REQ_EN;
+#else
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_EnableInterruptSource(
+          hDevice, ADI_AFE_INT_GROUP_CAPTURE,
+          BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN, true)) {
+    FAIL("adi_AFE_EnableInterruptSource");
+  }
+#endif /* USE_DFT_BLOCK_ACQUISITION */
+}
+
+/* Stops delivering DFT results; a partially filled block is discarded */
+void dft_StopAcquisition(ADI_AFE_DEV_HANDLE hDevice) {
+#if (1 == USE_DFT_BLOCK_ACQUISITION)
+  pADI_AFE->AFE_FIFO_CFG &= ~(BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN
+                              | BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_DMA_REQ_EN);
+  ADI_DISABLE_INT(DMA_AFE_RX_IRQn);
+  printf("MainTask: %u DFT blocks of %u results.\n",
+         (unsigned) dft_block.blocks, (unsigned) DFT_BLOCK_RESULTS);
+#else
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_EnableInterruptSource(
+          hDevice, ADI_AFE_INT_GROUP_CAPTURE,
+          BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN, false)) {
+    FAIL("adi_AFE_EnableInterruptSource (false)");
+  }
+#endif /* USE_DFT_BLOCK_ACQUISITION */
+}
+
+#if (SWEEP_ROUNDS > 0)
+/* Runs the sweep sequences, each with its own RCAL, and sends one SWEEP */
+/* frame per frequency. The frames are not framed by START and END: to the */
+/* host and the session store, a session is a blood pressure measurement. */
+void sweep_Measure(ADI_AFE_DEV_HANDLE hDevice, uint16_t rounds) {
+  int16_t results[DFT_RESULTS_COUNT];
+  q15_t results_q15[DFT_RESULTS_COUNT];
+  q31_t results_q31[DFT_RESULTS_COUNT];
+  q31_t magnitude[DFT_RESULTS_COUNT / 2];
+  const SweepPoint *point;
+  TelemetrySample sample;
+
+  if (!Sweep_Init(&sweep, sweep_frequencies,
+                  sizeof(sweep_frequencies) / sizeof(sweep_frequencies[0]),
+                  SINE_AMPLITUDE)) {
+    FAIL("Sweep_Init: SWEEP_FREQUENCIES");
+  }
+
+  // Only the first SWEEP_RESULTS_COUNT results are written by a sweep.
+  memset(results, 0, sizeof(results));
+
+  while (sweep.sweeps < rounds) {
+    point = Sweep_Next(&sweep);
+    if (adi_AFE_RunSequence(hDevice, point->sequence, (uint16_t *)results,
+                            SWEEP_RESULTS_COUNT)) {
+      FAIL("adi_AFE_RunSequence: sweep");
+    }
+
+    convert_dft_results(results, results_q15, results_q31);
+    arm_cmplx_mag_q31(results_q31, magnitude, SWEEP_RESULTS_COUNT / 2);
+
+    // RCAL was measured at the same frequency, just before.
+    sample.timestamp_us = Timestamp_Now32();
+    sample.pressure = (uint16_t)(point->frequency / TELEMETRY_SWEEP_HZ_PER_LSB);
+    sample.magnitude = calculate_magnitude(magnitude[0], magnitude[1]).full;
+    sample.phase = calculate_phase(arctan(results[1], results[0]),
+                                   arctan(results[3], results[2])).full;
+    TelemetryTask_Post(TELEMETRY_FRAME_SWEEP, &sample);
+  }
+}
+#endif
+
+/* Prints the blood pressure estimate of the session and shows it on the */
+/* LCD as systolic / diastolic. */
+void bp_Report(void) {
+  BpResult result;
+  char message[12];
+
+  if (!BpEstimator_Result(&bp_estimator, &result)) {
+    printf("MainTask: no blood pressure estimate (%u envelope points).\n",
+           (unsigned) bp_estimator.count);
+    UX_LCD_ShowMessage("NO BP   ");
+    return;
+  }
+
+  printf("MainTask: blood pressure %d/%d mmHg, MAP %d mmHg.\n",
+         (result.systolic + BP_PRESSURE_SCALE / 2) / BP_PRESSURE_SCALE,
+         (result.diastolic + BP_PRESSURE_SCALE / 2) / BP_PRESSURE_SCALE,
+         (result.map + BP_PRESSURE_SCALE / 2) / BP_PRESSURE_SCALE);
+  snprintf(message, sizeof(message), "%3d/%3d ",
+           (result.systolic + BP_PRESSURE_SCALE / 2) / BP_PRESSURE_SCALE,
+           (result.diastolic + BP_PRESSURE_SCALE / 2) / BP_PRESSURE_SCALE);
+  UX_LCD_ShowMessage((uint8_t *) message);  // Must be 8 characters long.
+}
+
+/* Configures the processing pipeline for a new session, at the current DFT */
+/* rate plan. */
+void pipeline_Start(void) {
+  if (!Pipeline_DecimateStage(&pipeline_stages[PIPELINE_STAGE_DECIMATE],
+                              PIPELINE_ALL_CHANNELS, 1, DECIMATION_ORDER)) {
+    FAIL("Pipeline_DecimateStage: DECIMATION_ORDER");
+  }
+  Pipeline_ClampStage(&pipeline_stages[PIPELINE_STAGE_CLAMP],
+                      PIPELINE_CLAMP_STEP > 0
+                      ? PIPELINE_CHANNEL(PIPELINE_MAGNITUDE) : 0,
+                      PIPELINE_CLAMP_STEP);
+
+  // Count cycles with the DWT cycle counter (SysTick belongs to the OS).
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  Pipeline_Init(&pipeline, pipeline_stages, PIPELINE_STAGES, pipeline_Cycles);
+  decimation_Update();
+}
+
+/* Selects how many output samples of the rate plan are averaged into one */
+/* (at least 1). Takes effect with the next DFT result. */
+void MainTask_SetDecimation(uint16_t ratio) {
+  output_decimation = ratio > 0 ? ratio : 1;
+}
+
+#if (1 == USE_SIM_HOOKS)
+/* Selects the output rates, in mHz, inside and outside the pressure window */
+/* (DFT_RATE_WINDOW_MHZ and DFT_RATE_OUTSIDE_MHZ until then). Takes effect */
+/* with the next session. Returns false, changing nothing, if DftRate_Plan */
+/* can't plan either rate. */
+bool MainTask_SetRates(uint32_t window_mhz, uint32_t outside_mhz) {
+  DftRatePlan plan;
+
+  if (!DftRate_Plan(&plan, window_mhz) || !DftRate_Plan(&plan, outside_mhz)) {
+    return false;
+  }
+  dft_rate_window_mhz = window_mhz;
+  dft_rate_outside_mhz = outside_mhz;
+  return true;
+}
+#endif
+
+/* Works out the DFT and output rates from the rate plan and */
+/* output_decimation, and restarts the pipeline at that ratio. */
+void decimation_Update(void) {
+  decimation_applied = output_decimation;
+#if (1 == USE_RCAL_LOOP)
+  decimation_ratio = dft_rate.average * decimation_applied;
+  raw_rate_mhz = 1000000000u / dft_rate.dft_period_us;
+#else
+  decimation_ratio = decimation_applied;
+  raw_rate_mhz = 1000000000u / DFT_PERIOD_US;
+#endif
+  output_rate_mhz = raw_rate_mhz / decimation_ratio;
+  Pipeline_Reset(&pipeline);
+  Pipeline_SetRatio(&pipeline_stages[PIPELINE_STAGE_DECIMATE],
+                    decimation_ratio);
+}
+
+/* Sends the rates in a START (session header) or RATE frame. */
+void decimation_Post(uint8_t type) {
+  TelemetrySample header;
+
+  header.timestamp_us = output_rate_mhz;
+  header.pressure = decimation_ratio;
+  header.magnitude = (int32_t) raw_rate_mhz;
+  header.phase = DECIMATION_ORDER;
+  TelemetryTask_Post(type, &header);
+}
+
+uint32_t pipeline_Cycles(void) {
+  return DWT->CYCCNT;
+}
+
+/* Prints what every stage of the pipeline did during the session. */
+void pipeline_Report(void) {
+  const PipelineStats *stats;
+  uint8_t i;
+
+  for (i = 0; i < pipeline.count; i++) {
+    stats = &pipeline.stages[i].stats;
+    printf("MainTask: pipeline %u (%s): %u in, %u out, %u cycles/sample, "
+           "max %u cycles/call.\n", (unsigned) i,
+           Pipeline_StageName(&pipeline.stages[i]),
+           (unsigned) stats->samples_in, (unsigned) stats->samples_out,
+           (unsigned) (stats->samples_in
+                       ? stats->cycles / stats->samples_in : 0),
+           (unsigned) stats->max_cycles);
+  }
+  if (pressure_readings > 0) {
+    printf("MainTask: pressure read %u us from the DFT result on average, "
+           "%u us at most.\n",
+           (unsigned) (pressure_lag_sum_us / pressure_readings),
+           (unsigned) pressure_lag_max_us);
+  }
+}
+
+/* TX DMA done: the whole loop body is in (or through) the command FIFO */
+void AFE_Loop_TxCallback(void *pCBParam, uint32_t Event, void *pArg) {
+  ADI_AFE_DEV_HANDLE hDevice = (ADI_AFE_DEV_HANDLE) pCBParam;
+
+  if (afe_loop_running) {
+    // Feed the same body again; the FIFO covers the re-arm latency, and if
+    // it runs dry anyway the sequencer waits (see afe_StartLoop). If the
+    // re-arm fails, MainTask sees the results stop and restarts the loop.
+    if (ADI_AFE_SUCCESS != adi_AFE_ProgramTxDMA(hDevice, NULL, 0)) {
+      afe_loop_refill_errors++;
+      return;
+    }
+    ADI_ENABLE_INT(DMA_AFE_TX_IRQn);
+  }
+}
+
+/* How long MainTask waits for a DFT result before it restarts the loop. */
+INT32U dft_StallTicks(void) {
+#if (1 == USE_RCAL_LOOP)
+  uint32_t period_us = dft_rate.dft_period_us;
+#else
+  uint32_t period_us = DFT_PERIOD_US;
+#endif
+
+  return (INT32U) ((uint64_t) period_us * DFT_STALL_RESULTS
+                   * OS_TICKS_PER_SEC / 1000000u) + 1u;
+}
+
+/* Restarts the loop at a new output rate; queued results are dropped */
+void dft_SetRate(ADI_AFE_DEV_HANDLE hDevice, uint32_t rate_mhz) {
+  if (!DftRate_Plan(&dft_rate, rate_mhz)) {
+    FAIL("DftRate_Plan");
+  }
+
+  afe_StopLoop(hDevice);
+  dft_StopAcquisition(hDevice);
+
+  // What is still queued belongs to the old loop and its RCAL pattern.
+  while (DftRing_Peek(&dft_ring) != NULL) {
+    DftRing_Release(&dft_ring);
+  }
+
+  afe_StartLoop(hDevice);
+  dft_StartAcquisition(hDevice);
+}
+
+/* Starts the sequencer on a loop built from dft_rate, without waiting */
+void afe_StartLoop(ADI_AFE_DEV_HANDLE hDevice) {
+  // Stop the DFT left free-running on AFE3-AFE4 by seq_afe_acmeas2wire.
+  adi_AFE_SeqAbort(hDevice);
+
+  DftRate_BuildLoop(&dft_rate, seq_afe_loop);
+  printf("MainTask: %u.%03u Hz requested, %u.%03u Hz achieved, "
+         "%u DFTs per sample, noise %u/1000.\n",
+         (unsigned) (dft_rate.requested_mhz / 1000),
+         (unsigned) (dft_rate.requested_mhz % 1000),
+         (unsigned) (dft_rate.achieved_mhz / 1000),
+         (unsigned) (dft_rate.achieved_mhz % 1000),
+         (unsigned) dft_rate.average, (unsigned) dft_rate.noise_permille);
+
+  // Acquisition is stopped, so the ring's sequence number is stable.
+  dft_rcal_base = dft_ring.sequence;
+
+  // The init sequence leaves SEQ_STOP_ON_FIFO_EMPTY set, which would turn
+  // off the sequencer for good if one TX DMA re-arm came late. Without it
+  // an empty command FIFO only stalls the loop until the refill arrives.
+  pADI_AFE->AFE_SEQ_CFG &= ~BITM_AFE_AFE_SEQ_CFG_SEQ_STOP_ON_FIFO_EMPTY;
+
+  // Results are collected by dft_StartAcquisition, not by the driver.
+  afe_loop_running = true;
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_RegisterCallbackOnTransmitDMA(hDevice, AFE_Loop_TxCallback, 0)) {
+    FAIL("adi_AFE_RegisterCallbackOnTransmitDMA");
+  }
+  adi_AFE_SetRunSequenceBlockingMode(hDevice, false);
+  if (ADI_AFE_SUCCESS !=
+      adi_AFE_RunSequence(hDevice, seq_afe_loop, NULL, 0)) {
+    FAIL("adi_AFE_RunSequence: seq_afe_loop");
+  }
+  adi_AFE_SetRunSequenceBlockingMode(hDevice, true);
+}
+
+/* Stops the loop; the AFE is left with the wavegen and DFT off */
+void afe_StopLoop(ADI_AFE_DEV_HANDLE hDevice) {
+  afe_loop_running = false;
+  ADI_DISABLE_INT(DMA_AFE_TX_IRQn);
+  adi_AFE_SeqAbort(hDevice);
+  adi_AFE_RegisterCallbackOnTransmitDMA(hDevice, NULL, 0);
+
+  // One-shot sequences (the sweep, afe_lib.c) end on an empty FIFO.
+  pADI_AFE->AFE_SEQ_CFG |= BITM_AFE_AFE_SEQ_CFG_SEQ_STOP_ON_FIFO_EMPTY;
+}
+
 /* Arctan Implementation */
 /* ===================== */
 /* Arctan is calculated using the formula: */
@@ -605,82 +1157,96 @@ fixed32_t calculate_phase(q15_t phase_rcal, q15_t phase_z) {
   return out;
 }
 
-/* Simple conversion of a fixed32_t variable to string format. */
-void sprintf_fixed32(char *out, fixed32_t in) {
-  fixed32_t tmp;
+/* Helper function for printing a string to UART or Std. Output */
+void test_print(char *pBuffer) {
+  test_write(pBuffer, strlen(pBuffer));
+}
 
-  if (in.full < 0) {
-    tmp.parts.fpart = (16 - in.parts.fpart) & 0x0F;
-    tmp.parts.ipart = in.parts.ipart;
-    if (0 != in.parts.fpart) {
-      tmp.parts.ipart++;
-    }
-    if (0 == tmp.parts.ipart) {
-      sprintf(out, "      -0.%04d", tmp.parts.fpart * FIXED32_LSB_SIZE);
-    } else {
-      sprintf(out, "%8d.%04d", tmp.parts.ipart,
-              tmp.parts.fpart * FIXED32_LSB_SIZE);
-    }
-  } else {
-    sprintf(out, "%8d.%04d", in.parts.ipart, in.parts.fpart * FIXED32_LSB_SIZE);
-  }
+/* Helper function for writing raw bytes to UART or Std. Output */
+void test_write(const void *pBuffer, int16_t size) {
+#if (1 == USE_UART_FOR_DATA)
+  /* Queue for the UART; never waits. Records that don't fit are dropped and
+     counted in uart_tx.overflow_count. */
+  UartTx_Append(&uart_tx, pBuffer, (uint16_t) size);
+  UartTx_Service(&uart_tx);
+
+#elif (0 == USE_UART_FOR_DATA)
+  /* Print  to console */
+  fwrite(pBuffer, 1, size, stdout);
+
+#endif /* USE_UART_FOR_DATA */
 }
 
-/* Helper function for printing fixed32_t (magnitude & phase) and uint15_t
- * (pressure) results. */
-void print_PressureMagnitudePhase(char *text, uint16_t pressure,
-                                  fixed32_t magnitude, fixed32_t phase,
-                                  int queue_size) {
-  char msg[MSG_MAXLEN];
-  char tmp[MSG_MAXLEN];
-//  sprintf(msg, "%d: %d\r\n", pressure, queue_size);
-  
-  sprintf(msg, "%d", pressure);
-  
-  sprintf_fixed32(tmp, magnitude);
-  strcat(msg, tmp);
-  
-  sprintf_fixed32(tmp, phase);
-  strcat(msg, tmp);
-  
-  //sprintf(tmp, "(%d,%d)\r\n",  queue_size, DFT_QUEUE_SIZE);
-  //strcat(msg, tmp);
-  strcat(msg, "\r\n");
-  
-  
-  
-  //sprintf(msg, "%s %d: %d %d (%d/%d)\r\n", text, pressure, magnitude,
-  //        phase, queue_size, DFT_QUEUE_SIZE);
+/* Hands the UART what test_write queued and it had no room for then; */
+/* never waits. */
+void test_service(void) {
+#if (1 == USE_UART_FOR_DATA)
+  UartTx_Service(&uart_tx);
+#endif /* USE_UART_FOR_DATA */
+}
 
-  PRINT(msg);
+/* Waits until everything queued by test_write has been handed to the UART */
+void test_flush(void) {
+#if (1 == USE_UART_FOR_DATA)
+  UartTx_Service(&uart_tx);
+  while (UartTx_Pending(&uart_tx) > 0) {
+    OSTimeDly(1);
+    UartTx_Service(&uart_tx);
+  }
+#endif /* USE_UART_FOR_DATA */
 }
 
-/* Helper function for printing a string to UART or Std. Output */
-void test_print(char *pBuffer) {
+/* Helper function for reading the bytes received so far from the UART;
+   never waits. Returns the number of bytes read. */
+int16_t test_read(void *pBuffer, int16_t size) {
 #if (1 == USE_UART_FOR_DATA)
-  int16_t size;
-  /* Print to UART */
-  size = strlen(pBuffer);
-  if (ADI_UART_SUCCESS != adi_UART_BufTx(hUartDevice, pBuffer, &size)) {
-    FAIL("test_print: ADI_UART_SUCCESS");
+  if (0 == adi_UART_GetNumRxBytes(hUartDevice)) {
+    return 0;
   }
+  if (ADI_UART_SUCCESS != adi_UART_BufRx(hUartDevice, pBuffer, &size)) {
+    FAIL("test_read: ADI_UART_SUCCESS");
+  }
+  return size;
 
 #elif (0 == USE_UART_FOR_DATA)
-  /* Print  to console */
-  printf(pBuffer);
+  return 0;
 
 #endif /* USE_UART_FOR_DATA */
 }
 
+/* Transport for uart_tx: copies as much as fits into the driver's internal
+   transmit buffer, which the UART interrupt drains. */
+uint16_t uart_TxWrite(void *context, const uint8_t *data, uint16_t size) {
+  int16_t count = (int16_t) size;
+
+  if (ADI_UART_SUCCESS != adi_UART_BufTx(hUartDevice, data, &count)) {
+    FAIL("uart_TxWrite: ADI_UART_SUCCESS");
+  }
+  return (uint16_t) count;
+}
+
 /* Initialize the UART, set the baud rate and enable */
 ADI_UART_RESULT_TYPE uart_Init(void) {
   ADI_UART_RESULT_TYPE result = ADI_UART_SUCCESS;
+  ADI_UART_INIT_DATA init_data;
+
+  /* Open UART in interrupt mode by supplying internal buffers. The driver
+     has no DMA support (adi_UART_SetDmaMode is not implemented). */
+  init_data.pRxBufferData = uart_rx_buffer;
+  init_data.RxBufferSize = UART_DRIVER_RX_SIZE;
+  init_data.pTxBufferData = uart_tx_buffer;
+  init_data.TxBufferSize = UART_DRIVER_TX_SIZE;
+  if (ADI_UART_SUCCESS !=
+      (result = adi_UART_Init(ADI_UART_DEVID_0, &hUartDevice, &init_data))) {
+    return result;
+  }
 
-  /* Open UART in blocking, non-intrrpt mode by supplying no internal buffs */
+  /* Non-blocking: adi_UART_BufTx only takes what fits in the buffer */
   if (ADI_UART_SUCCESS !=
-      (result = adi_UART_Init(ADI_UART_DEVID_0, &hUartDevice, NULL))) {
+      (result = adi_UART_SetBlockingMode(hUartDevice, false))) {
     return result;
   }
+  UartTx_Init(&uart_tx, uart_TxWrite, NULL);
 
   /* Set UART baud rate to 115200 */
   // if (ADI_UART_SUCCESS != (result = adi_UART_SetBaudRate(hUartDevice,
@@ -731,10 +1297,19 @@ void i2c_Init(ADI_I2C_DEV_HANDLE *i2cDevice) {
     FAIL("adi_I2C_SetMasterClock");
   }
 
-  // Disable blocking mode... i.e., poll for completion.
-  //if (ADI_I2C_SUCCESS != adi_I2C_SetBlockingMode(*i2cDevice, false)) {
-  //  FAIL("adi_I2C_SetBlockingMode");
-  //}
+  // Disable blocking mode and move the data by DMA; PumpTask sleeps until
+  // the DMA interrupt calls it back.
+  if (ADI_I2C_SUCCESS != adi_I2C_SetBlockingMode(*i2cDevice, false)) {
+    FAIL("adi_I2C_SetBlockingMode");
+  }
+  if (ADI_I2C_SUCCESS != adi_I2C_SetDmaMode(*i2cDevice, true)) {
+    FAIL("adi_I2C_SetDmaMode");
+  }
+  if (ADI_I2C_SUCCESS != adi_I2C_RegisterCallback(*i2cDevice,
+                                                  PumpTask_I2CCallback,
+                                                  NULL)) {
+    FAIL("adi_I2C_RegisterCallback");
+  }
 }
 
 void rtc_Init(void) {
@@ -0,0 +1,304 @@
+#include <string.h>
+
+#include "Pipeline.h"
+
+static void pipeline_Clear(PipelineStage *stage, PipelineStageType type,
+                           uint8_t channels) {
+  memset(stage, 0, sizeof(*stage));
+  stage->type = type;
+  stage->channels = channels;
+}
+
+bool Pipeline_DecimateStage(PipelineStage *stage, uint8_t channels,
+                            uint16_t ratio, uint8_t order) {
+  if (order == 0 || order > PIPELINE_MAX_CIC_ORDER) {
+    return false;
+  }
+  pipeline_Clear(stage, PIPELINE_DECIMATE, channels);
+  stage->u.decimate.order = order;
+  Pipeline_SetRatio(stage, ratio);
+  return true;
+}
+
+void Pipeline_BiquadStage(PipelineStage *stage, uint8_t channels,
+                          const int32_t coefficients[5], uint8_t post_shift) {
+  pipeline_Clear(stage, PIPELINE_BIQUAD, channels);
+  stage->u.biquad.b0 = coefficients[0];
+  stage->u.biquad.b1 = coefficients[1];
+  stage->u.biquad.b2 = coefficients[2];
+  stage->u.biquad.a1 = coefficients[3];
+  stage->u.biquad.a2 = coefficients[4];
+  stage->u.biquad.post_shift = post_shift;
+}
+
+bool Pipeline_MovingAverageStage(PipelineStage *stage, uint8_t channels,
+                                 uint8_t length) {
+  if (length == 0 || length > PIPELINE_MAX_AVERAGE) {
+    return false;
+  }
+  pipeline_Clear(stage, PIPELINE_MOVING_AVERAGE, channels);
+  stage->u.average.length = length;
+  return true;
+}
+
+void Pipeline_ClampStage(PipelineStage *stage, uint8_t channels,
+                         int32_t max_step) {
+  pipeline_Clear(stage, PIPELINE_CLAMP, channels);
+  stage->u.clamp.max_step = max_step;
+}
+
+void Pipeline_SetRatio(PipelineStage *stage, uint16_t ratio) {
+  uint8_t k;
+
+  stage->u.decimate.ratio = ratio > 0 ? ratio : 1;
+  stage->u.decimate.gain = 1;
+  for (k = 0; k < stage->u.decimate.order; k++) {
+    stage->u.decimate.gain *= stage->u.decimate.ratio;
+  }
+  stage->u.decimate.warmup = stage->u.decimate.order - 1;
+  stage->u.decimate.count = 0;
+  memset(stage->u.decimate.integrator, 0,
+         sizeof(stage->u.decimate.integrator));
+  memset(stage->u.decimate.comb, 0, sizeof(stage->u.decimate.comb));
+}
+
+void Pipeline_Init(Pipeline *pipeline, PipelineStage *stages, uint8_t count,
+                   uint32_t (*cycles)(void)) {
+  pipeline->stages = stages;
+  pipeline->count = count;
+  pipeline->cycles = cycles;
+}
+
+void Pipeline_Reset(Pipeline *pipeline) {
+  PipelineStage *stage;
+  uint8_t i;
+
+  for (i = 0; i < pipeline->count; i++) {
+    stage = &pipeline->stages[i];
+    switch (stage->type) {
+      case PIPELINE_DECIMATE:
+        Pipeline_SetRatio(stage, stage->u.decimate.ratio);
+        break;
+      case PIPELINE_BIQUAD:
+        memset(stage->u.biquad.state, 0, sizeof(stage->u.biquad.state));
+        break;
+      case PIPELINE_MOVING_AVERAGE:
+        stage->u.average.index = 0;
+        stage->u.average.count = 0;
+        memset(stage->u.average.sum, 0, sizeof(stage->u.average.sum));
+        break;
+      case PIPELINE_CLAMP:
+        stage->u.clamp.primed = false;
+        break;
+    }
+  }
+}
+
+void Pipeline_ResetStats(Pipeline *pipeline) {
+  uint8_t i;
+
+  for (i = 0; i < pipeline->count; i++) {
+    memset(&pipeline->stages[i].stats, 0, sizeof(PipelineStats));
+  }
+}
+
+static uint16_t pipeline_Decimate(PipelineStage *stage,
+                                  PipelineSample *samples, uint16_t count) {
+  uint8_t order = stage->u.decimate.order;
+  uint64_t *integrator;
+  uint64_t *comb;
+  uint64_t value;
+  uint64_t delayed;
+  uint16_t out = 0;
+  uint16_t i;
+  uint8_t k;
+  int c;
+
+  for (i = 0; i < count; i++) {
+    if (stage->u.decimate.count == 0) {
+      stage->u.decimate.first_us = samples[i].timestamp_us;
+    }
+    for (c = 0; c < PIPELINE_CHANNELS; c++) {
+      if (stage->channels & PIPELINE_CHANNEL(c)) {
+        integrator = stage->u.decimate.integrator[c];
+        integrator[0] += (uint64_t) (int64_t) samples[i].value[c];
+        for (k = 1; k < order; k++) {
+          integrator[k] += integrator[k - 1];
+        }
+      }
+    }
+    if (++stage->u.decimate.count < stage->u.decimate.ratio) {
+      continue;
+    }
+    stage->u.decimate.count = 0;
+
+    for (c = 0; c < PIPELINE_CHANNELS; c++) {
+      if (!(stage->channels & PIPELINE_CHANNEL(c))) {
+        samples[out].value[c] = samples[i].value[c];
+        continue;
+      }
+      // Combs at the output rate; the differences are exact modulo 2^64.
+      value = stage->u.decimate.integrator[c][order - 1];
+      comb = stage->u.decimate.comb[c];
+      for (k = 0; k < order; k++) {
+        delayed = comb[k];
+        comb[k] = value;
+        value -= delayed;
+      }
+      samples[out].value[c] = (int32_t) ((int64_t) value
+                                         / (int64_t) stage->u.decimate.gain);
+    }
+
+    // The weights are centred order * (ratio - 1) / 2 inputs back, which is
+    // order / 2 of this block's span before its last input.
+    samples[out].timestamp_us = samples[i].timestamp_us
+        - (samples[i].timestamp_us - stage->u.decimate.first_us) * order / 2;
+
+    if (stage->u.decimate.warmup > 0) {
+      stage->u.decimate.warmup--;
+      continue;
+    }
+    out++;
+  }
+  return out;
+}
+
+static void pipeline_Biquad(PipelineStage *stage, PipelineSample *samples,
+                            uint16_t count) {
+  int shift = 31 - stage->u.biquad.post_shift;
+  int32_t *state;
+  int64_t acc;
+  int32_t x;
+  uint16_t i;
+  int c;
+
+  for (c = 0; c < PIPELINE_CHANNELS; c++) {
+    if (!(stage->channels & PIPELINE_CHANNEL(c))) {
+      continue;
+    }
+    state = stage->u.biquad.state[c];
+    for (i = 0; i < count; i++) {
+      x = samples[i].value[c];
+      acc = (int64_t) stage->u.biquad.b0 * x
+            + (int64_t) stage->u.biquad.b1 * state[0]
+            + (int64_t) stage->u.biquad.b2 * state[1]
+            + (int64_t) stage->u.biquad.a1 * state[2]
+            + (int64_t) stage->u.biquad.a2 * state[3];
+      state[1] = state[0];
+      state[0] = x;
+      state[3] = state[2];
+      state[2] = (int32_t) (acc >> shift);
+      samples[i].value[c] = state[2];
+    }
+  }
+}
+
+static void pipeline_MovingAverage(PipelineStage *stage,
+                                   PipelineSample *samples, uint16_t count) {
+  uint8_t length = stage->u.average.length;
+  uint8_t index;
+  uint16_t i;
+  int c;
+
+  for (i = 0; i < count; i++) {
+    index = stage->u.average.index;
+    if (stage->u.average.count < length) {
+      stage->u.average.count++;
+    }
+    for (c = 0; c < PIPELINE_CHANNELS; c++) {
+      if (!(stage->channels & PIPELINE_CHANNEL(c))) {
+        continue;
+      }
+      // Until the history is full, the mean is over what is there.
+      if (stage->u.average.count == length) {
+        stage->u.average.sum[c] -= stage->u.average.history[c][index];
+      }
+      stage->u.average.history[c][index] = samples[i].value[c];
+      stage->u.average.sum[c] += samples[i].value[c];
+      samples[i].value[c] = (int32_t) (stage->u.average.sum[c]
+                                       / stage->u.average.count);
+    }
+    stage->u.average.index = (uint8_t) ((index + 1) % length);
+  }
+}
+
+static void pipeline_Clamp(PipelineStage *stage, PipelineSample *samples,
+                           uint16_t count) {
+  int32_t max_step = stage->u.clamp.max_step;
+  int32_t *previous = stage->u.clamp.previous;
+  uint16_t i;
+  int c;
+
+  for (i = 0; i < count; i++) {
+    for (c = 0; c < PIPELINE_CHANNELS; c++) {
+      if (!(stage->channels & PIPELINE_CHANNEL(c))) {
+        continue;
+      }
+      if (stage->u.clamp.primed) {
+        if (samples[i].value[c] > previous[c] + max_step) {
+          samples[i].value[c] = previous[c] + max_step;
+        } else if (samples[i].value[c] < previous[c] - max_step) {
+          samples[i].value[c] = previous[c] - max_step;
+        }
+      }
+      previous[c] = samples[i].value[c];
+    }
+    stage->u.clamp.primed = true;
+  }
+}
+
+uint16_t Pipeline_Process(Pipeline *pipeline, PipelineSample *samples,
+                          uint16_t count) {
+  PipelineStage *stage;
+  uint32_t start = 0;
+  uint32_t cycles;
+  uint8_t i;
+
+  for (i = 0; i < pipeline->count && count > 0; i++) {
+    stage = &pipeline->stages[i];
+    if (pipeline->cycles != NULL) {
+      start = pipeline->cycles();
+    }
+    stage->stats.calls++;
+    stage->stats.samples_in += count;
+
+    switch (stage->type) {
+      case PIPELINE_DECIMATE:
+        count = pipeline_Decimate(stage, samples, count);
+        break;
+      case PIPELINE_BIQUAD:
+        pipeline_Biquad(stage, samples, count);
+        break;
+      case PIPELINE_MOVING_AVERAGE:
+        pipeline_MovingAverage(stage, samples, count);
+        break;
+      case PIPELINE_CLAMP:
+        pipeline_Clamp(stage, samples, count);
+        break;
+    }
+
+    stage->stats.samples_out += count;
+    if (pipeline->cycles != NULL) {
+      cycles = pipeline->cycles() - start;
+      stage->stats.cycles += cycles;
+      if (cycles > stage->stats.max_cycles) {
+        stage->stats.max_cycles = cycles;
+      }
+    }
+  }
+  return count;
+}
+
+const char *Pipeline_StageName(const PipelineStage *stage) {
+  switch (stage->type) {
+    case PIPELINE_DECIMATE:
+      return "decimate";
+    case PIPELINE_BIQUAD:
+      return "biquad";
+    case PIPELINE_MOVING_AVERAGE:
+      return "average";
+    case PIPELINE_CLAMP:
+      return "clamp";
+  }
+  return "?";
+}
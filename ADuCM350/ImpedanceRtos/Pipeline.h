@@ -0,0 +1,146 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+// Chain of fixed-point processing stages between the DFT conversion and the
+// output of MainTask.
+//
+// A pipeline is an array of stages, each configured once with one of the
+// Pipeline_*Stage() calls and then run in order by Pipeline_Process() over an
+// array of samples, in place.  Stages that reduce the rate (decimation) leave
+// fewer samples for the ones after them; a stage that has nothing to pass on
+// ends the run early.  Every stage works on the channels in its mask and
+// keeps its state in the stage itself, so a pipeline is as static as the
+// array it lives in.
+//
+// If the pipeline has a cycle counter, each stage counts the samples it got
+// and passed on and the cycles it spent, so a pipeline can be profiled on the
+// target (DWT cycle counter) or on the host (tools/pipebench.c).  Depends on
+// the C standard library only.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Channels of a sample.
+#define PIPELINE_MAGNITUDE 0
+#define PIPELINE_PHASE 1
+#define PIPELINE_PRESSURE 2
+#define PIPELINE_CHANNELS 3
+
+#define PIPELINE_CHANNEL(channel) ((uint8_t) (1u << (channel)))
+#define PIPELINE_ALL_CHANNELS ((uint8_t) ((1u << PIPELINE_CHANNELS) - 1))
+
+// Highest order of a CIC decimation stage.
+#ifndef PIPELINE_MAX_CIC_ORDER
+#define PIPELINE_MAX_CIC_ORDER 3
+#endif
+
+// Longest moving average.
+#ifndef PIPELINE_MAX_AVERAGE
+#define PIPELINE_MAX_AVERAGE 16
+#endif
+
+typedef struct {
+  uint32_t timestamp_us;
+  int32_t value[PIPELINE_CHANNELS];
+} PipelineSample;
+
+typedef enum {
+  PIPELINE_DECIMATE,        // Boxcar or CIC mean, one out per ratio in.
+  PIPELINE_BIQUAD,          // Second-order IIR section, direct form I.
+  PIPELINE_MOVING_AVERAGE,  // Mean of the last length samples.
+  PIPELINE_CLAMP,           // Limits the change from the previous output.
+} PipelineStageType;
+
+typedef struct {
+  uint32_t calls;
+  uint32_t samples_in;
+  uint32_t samples_out;
+  uint64_t cycles;
+  uint32_t max_cycles;      // Most cycles in one call.
+} PipelineStats;
+
+typedef struct {
+  PipelineStageType type;
+  uint8_t channels;         // Mask of PIPELINE_CHANNEL() bits.
+  PipelineStats stats;
+  union {
+    struct {
+      uint16_t ratio;
+      uint8_t order;        // 1 = boxcar, more = CIC.
+      uint8_t warmup;       // Outputs still to drop while the combs fill.
+      uint16_t count;
+      uint32_t first_us;
+      uint64_t gain;        // ratio^order.
+      // Integrators and comb delays, modulo 2^64 as usual for a CIC.
+      uint64_t integrator[PIPELINE_CHANNELS][PIPELINE_MAX_CIC_ORDER];
+      uint64_t comb[PIPELINE_CHANNELS][PIPELINE_MAX_CIC_ORDER];
+    } decimate;
+    struct {
+      int32_t b0, b1, b2, a1, a2;  // Q31 >> post_shift, a1/a2 negated.
+      uint8_t post_shift;
+      int32_t state[PIPELINE_CHANNELS][4];  // x[n-1] x[n-2] y[n-1] y[n-2]
+    } biquad;
+    struct {
+      uint8_t length;
+      uint8_t index;
+      uint8_t count;
+      int32_t history[PIPELINE_CHANNELS][PIPELINE_MAX_AVERAGE];
+      int64_t sum[PIPELINE_CHANNELS];
+    } average;
+    struct {
+      int32_t max_step;
+      bool primed;
+      int32_t previous[PIPELINE_CHANNELS];
+    } clamp;
+  } u;
+} PipelineStage;
+
+typedef struct {
+  PipelineStage *stages;
+  uint8_t count;
+  uint32_t (*cycles)(void);  // Free-running cycle counter, or NULL.
+} Pipeline;
+
+// Stage configuration.  Each clears the stage's state and statistics.
+// Channels outside the mask pass through a stage unchanged, except that
+// decimation keeps their newest value.
+//
+// A decimation stage of order 1 is a boxcar: each output is the mean of the
+// last ratio inputs.  Higher orders are a CIC filter of that many stages
+// (a boxcar applied order times), which suppresses what would alias more
+// strongly; each output then covers order * (ratio - 1) + 1 inputs, and the
+// first order - 1 outputs after a (re)start are dropped.  Outputs are
+// normalized to the input scale and timestamped at the centre of their
+// weights.  Returns false if the order is 0 or above PIPELINE_MAX_CIC_ORDER.
+extern bool Pipeline_DecimateStage(PipelineStage *stage, uint8_t channels,
+                                   uint16_t ratio, uint8_t order);
+extern void Pipeline_BiquadStage(PipelineStage *stage, uint8_t channels,
+                                 const int32_t coefficients[5],
+                                 uint8_t post_shift);
+extern bool Pipeline_MovingAverageStage(PipelineStage *stage,
+                                        uint8_t channels, uint8_t length);
+extern void Pipeline_ClampStage(PipelineStage *stage, uint8_t channels,
+                                int32_t max_step);
+
+// Changes the ratio of a decimation stage and restarts it.
+extern void Pipeline_SetRatio(PipelineStage *stage, uint16_t ratio);
+
+// Chains count configured stages.  cycles may be NULL.
+extern void Pipeline_Init(Pipeline *pipeline, PipelineStage *stages,
+                          uint8_t count, uint32_t (*cycles)(void));
+
+// Clears the state of every stage, keeping configuration and statistics.
+extern void Pipeline_Reset(Pipeline *pipeline);
+
+// Clears the statistics of every stage.
+extern void Pipeline_ResetStats(Pipeline *pipeline);
+
+// Runs count samples through the pipeline, in place.  Returns the number of
+// samples left at the end, at the start of samples.
+extern uint16_t Pipeline_Process(Pipeline *pipeline, PipelineSample *samples,
+                                 uint16_t count);
+
+// Name of a stage type, for reports.
+extern const char *Pipeline_StageName(const PipelineStage *stage);
+
+#endif  // __PIPELINE_H__
@@ -0,0 +1,66 @@
+#include <string.h>
+
+#include "PressureBurst.h"
+
+void PressureBurst_Init(PressureBurst *burst) {
+  memset(burst, 0, sizeof(*burst));
+}
+
+uint8_t PressureBurst_Crc8(const uint8_t *data, uint32_t length) {
+  uint8_t crc = 0;
+  int bit;
+
+  while (length--) {
+    crc ^= *data++;
+    for (bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x07) : (uint8_t) (crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint32_t PressureBurst_Decode(PressureBurst *burst, const uint8_t *frame,
+                              uint32_t request_us, PressureSlot *slot) {
+  PressureReading reading;
+  uint32_t count = frame[1] & PRESSURE_BURST_COUNT_MASK;
+  uint32_t size = PRESSURE_BURST_HEADER_SIZE + 2 * count;
+  uint16_t sequence;
+  uint16_t gap;
+  uint32_t newest_us;
+  uint32_t i;
+
+  if (frame[0] != PRESSURE_BURST_MARKER
+      || count > PRESSURE_BURST_MAX_SAMPLES
+      || PressureBurst_Crc8(frame, size) != frame[size]) {
+    burst->bad_frames++;
+    return 0;
+  }
+  burst->frames++;
+  if (count == 0) {
+    return 0;
+  }
+
+  // Anything between the last sample and this frame's first was dropped,
+  // here or by the Arduino.
+  sequence = (uint16_t) (frame[2] | (frame[3] << 8));
+  gap = (uint16_t) (sequence - burst->next_sequence);
+  if (burst->synced && gap < 0x8000u) {
+    burst->lost += gap;
+  }
+  burst->next_sequence = (uint16_t) (sequence + count);
+  burst->synced = true;
+
+  newest_us = request_us - (uint32_t) (frame[4] | (frame[5] << 8))
+                               * PRESSURE_BURST_AGE_UNIT_US;
+  reading.status = frame[1] & PRESSURE_BURST_REACHED;
+  for (i = 0; i < count; i++) {
+    reading.timestamp_us =
+        newest_us - (count - 1 - i) * PRESSURE_BURST_PERIOD_US;
+    reading.analog = (uint16_t) (frame[PRESSURE_BURST_HEADER_SIZE + 2 * i]
+                                 | (frame[PRESSURE_BURST_HEADER_SIZE + 2 * i
+                                          + 1] << 8));
+    PressureSlot_Publish(slot, &reading);
+  }
+  burst->samples += count;
+  return count;
+}
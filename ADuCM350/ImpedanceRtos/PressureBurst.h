@@ -0,0 +1,75 @@
+#ifndef __PRESSURE_BURST_H__
+#define __PRESSURE_BURST_H__
+
+// Burst pressure protocol of the Arduino pump module.
+//
+// The Arduino samples the transducer every PRESSURE_BURST_PERIOD_US into a
+// ring, and numbers the samples.  Once it has had the burst command
+//     00 PRESSURE_BURST_COMMAND max_samples
+// (the 00 is the data address the Arduino skips), every read of
+// PRESSURE_BURST_FRAME_SIZE bytes gets the samples taken since the read
+// before, up to max_samples, in one frame:
+//     marker (PRESSURE_BURST_MARKER)
+//     flags and count (PRESSURE_BURST_REACHED | number of samples)
+//     sequence number of the first sample, 16 bit
+//     age of the newest sample sent when the read came in, 16 bit, in
+//         PRESSURE_BURST_AGE_UNIT_US
+//     the samples, 10-bit ADC values in 16 bits, oldest first
+//     CRC-8 (polynomial 0x07, initial value 0) of everything before it
+// all little-endian; the rest of the read is padding.  Samples the Arduino
+// had to drop because nobody read them in time show up as a gap in the
+// sequence numbers.
+//
+// The frame carries one time only: the samples are evenly spaced, so
+// PressureBurst_Decode() dates them back from the newest on the local clock,
+// and clock drift between the two boards never adds up beyond one frame.
+// Depends on PressureSlot.c.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "PressureSlot.h"
+
+#define PRESSURE_BURST_COMMAND 0x43
+#define PRESSURE_BURST_MARKER 0x25
+
+// Set in the flags while the cuff is at its target pressure.
+#define PRESSURE_BURST_REACHED 0x80
+#define PRESSURE_BURST_COUNT_MASK 0x1F
+
+// Sample period of the Arduino.
+#define PRESSURE_BURST_PERIOD_US 5000u
+
+// Unit of the age; 16 bits of it cover more than a full ring on the Arduino.
+#define PRESSURE_BURST_AGE_UNIT_US 4u
+
+// Most samples in one frame; the frame fits the Arduino's 32-byte I2C
+// buffer.
+#define PRESSURE_BURST_MAX_SAMPLES 12
+#define PRESSURE_BURST_HEADER_SIZE 6
+#define PRESSURE_BURST_FRAME_SIZE \
+  (PRESSURE_BURST_HEADER_SIZE + 2 * PRESSURE_BURST_MAX_SAMPLES + 1)
+
+typedef struct {
+  uint16_t next_sequence;     // Sequence number expected next.
+  bool synced;                // False until the first good frame.
+
+  uint32_t frames;
+  uint32_t bad_frames;        // Wrong marker, count or CRC; dropped.
+  uint32_t samples;           // Samples published.
+  uint32_t lost;              // Samples missing from the sequence.
+} PressureBurst;
+
+extern void PressureBurst_Init(PressureBurst *burst);
+
+// Decodes a frame, read from the Arduino at request_us on the local clock,
+// and publishes its samples to slot, each with the time it was taken.
+// Returns the number of samples published; a bad frame publishes none.
+extern uint32_t PressureBurst_Decode(PressureBurst *burst,
+                                     const uint8_t *frame,
+                                     uint32_t request_us, PressureSlot *slot);
+
+// CRC-8 of a frame, as the Arduino computes it.
+extern uint8_t PressureBurst_Crc8(const uint8_t *data, uint32_t length);
+
+#endif  // __PRESSURE_BURST_H__
@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "PressureSlot.h"
+
+// Orders the reading writes between the two sequence updates, and the
+// reads between the two sequence checks.
+#if defined(__ICCARM__)
+#include <intrinsics.h>
+#define SLOT_BARRIER() __DMB()
+#elif defined(__GNUC__)
+#define SLOT_BARRIER() __sync_synchronize()
+#else
+#define SLOT_BARRIER()
+#endif
+
+#define SLOT_MASK (PRESSURE_SLOT_HISTORY - 1)
+
+void PressureSlot_Init(PressureSlot *slot) {
+  memset(slot, 0, sizeof(*slot));
+}
+
+void PressureSlot_Publish(PressureSlot *slot,
+                          const PressureReading *reading) {
+  uint32_t sequence = slot->sequence;
+
+  slot->sequence = sequence + 1;
+  SLOT_BARRIER();
+  slot->readings[(sequence / 2) & SLOT_MASK] = *reading;
+  SLOT_BARRIER();
+  slot->sequence = sequence + 2;
+}
+
+bool PressureSlot_Nearest(PressureSlot *slot, uint32_t timestamp_us,
+                          PressureReading *reading) {
+  uint32_t sequence;
+  uint32_t count;
+  uint32_t distance;
+  uint32_t best_distance;
+  uint32_t best;
+  uint32_t i;
+  int32_t offset;
+
+  while (true) {
+    sequence = slot->sequence;
+    SLOT_BARRIER();
+    if ((sequence & 1) == 0) {
+      count = sequence / 2;
+      if (count == 0) {
+        return false;
+      }
+
+      // Newest first; timestamps are 32-bit and compared as differences.
+      best = (count - 1) & SLOT_MASK;
+      best_distance = UINT32_MAX;
+      for (i = 0; i < count && i < PRESSURE_SLOT_HISTORY; i++) {
+        offset = (int32_t) (slot->readings[(count - 1 - i) & SLOT_MASK]
+                                .timestamp_us - timestamp_us);
+        distance = offset < 0 ? (uint32_t) -offset : (uint32_t) offset;
+        if (distance < best_distance) {
+          best_distance = distance;
+          best = (count - 1 - i) & SLOT_MASK;
+        } else if (offset < 0) {
+          // Older readings are only further away.
+          break;
+        }
+      }
+      *reading = slot->readings[best];
+
+      SLOT_BARRIER();
+      if (slot->sequence == sequence) {
+        return true;
+      }
+    }
+    slot->retries++;
+  }
+}
+
+uint32_t PressureSlot_Count(const PressureSlot *slot) {
+  return slot->sequence / 2;
+}
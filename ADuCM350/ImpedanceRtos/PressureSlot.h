@@ -0,0 +1,63 @@
+#ifndef __PRESSURE_SLOT_H__
+#define __PRESSURE_SLOT_H__
+
+// Cuff pressure readings, from the I2C interrupt to MainTask.
+//
+// PumpTask polls the Arduino at a fixed rate, and the interrupt that
+// completes each read publishes the samples it brought (see PressureBurst.h)
+// here, each with the time it was taken.  MainTask pairs every DFT result
+// with the reading nearest to it in time, without ever waiting for the I2C
+// bus.  The last PRESSURE_SLOT_HISTORY readings are kept, so a result that
+// MainTask only gets to a block later is still paired with the pressure of
+// its own time.
+//
+// The slot is a seqlock: the writer makes the sequence odd, writes, and
+// makes it even again; a reader reads in place and starts over if the
+// sequence was odd or has changed since.  The writer never waits for a
+// reader.  It must not be preempted by a reader either, which is why it is
+// the interrupt: a task reading on the same core cannot run while the
+// sequence is odd, and only has to read again if the interrupt came in the
+// middle of it.  One writer only.  Depends on the C standard library only.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of readings kept; must be a power of two.
+#ifndef PRESSURE_SLOT_HISTORY
+#define PRESSURE_SLOT_HISTORY 32
+#endif
+
+#if (PRESSURE_SLOT_HISTORY & (PRESSURE_SLOT_HISTORY - 1)) != 0
+#error "PRESSURE_SLOT_HISTORY must be a power of two"
+#endif
+
+typedef struct {
+  uint32_t timestamp_us;      // When the Arduino took the sample.
+  uint16_t analog;            // Transducer value.
+  uint8_t status;             // PRESSURE_BURST_REACHED or 0.
+} PressureReading;
+
+typedef struct {
+  PressureReading readings[PRESSURE_SLOT_HISTORY];
+  volatile uint32_t sequence; // Twice the readings published; odd in between.
+
+  // Written by the reader only.
+  uint32_t retries;           // Reads started over.
+} PressureSlot;
+
+// Must not run concurrently with either side.
+extern void PressureSlot_Init(PressureSlot *slot);
+
+// Writer side.
+extern void PressureSlot_Publish(PressureSlot *slot,
+                                 const PressureReading *reading);
+
+// Reader side.  Copies the reading taken nearest to timestamp_us, before or
+// after it, to reading.  Returns false if nothing has been published yet.
+extern bool PressureSlot_Nearest(PressureSlot *slot, uint32_t timestamp_us,
+                                 PressureReading *reading);
+
+// Number of readings published.
+extern uint32_t PressureSlot_Count(const PressureSlot *slot);
+
+#endif  // __PRESSURE_SLOT_H__
@@ -14,25 +14,142 @@ uint32_t transducer_to_mmhg(uint16_t transducer) {
   return (((uint32_t) transducer) * 77 / 192) - 21;
 }
 
-uint8_t i2c_pump_rx[I2C_BUFFER_SIZE];
-uint8_t i2c_pump_tx[I2C_BUFFER_SIZE];
+int32_t transducer_to_mmhg16(uint16_t transducer) {
+  // Same approximation, in 1/16 mmHg to keep the transducer's resolution.
+  return (((int32_t) transducer) * 77 / 12) - 21 * 16;
+}
+
+// Readings from the Arduino, published by the I2C interrupt, and the
+// semaphore it posts when a transfer is done.
+PressureSlot pressure_slot;
+OS_EVENT *pressure_semaphore;
+
+// Decoder of the burst frames the Arduino answers reads with.
+PressureBurst pressure_burst;
+
+// Set by MainTask to end the polling and deflate the cuff.
+volatile bool pump_deflate;
+
+// I2C runs in DMA mode (see i2c_Init): PumpTask starts a transfer and
+// sleeps until the interrupt posts pressure_semaphore.  Nothing else uses
+// the bus.  The data address byte the Arduino skips is sent as part of the
+// data, as a data addressing phase would block in the driver.
+uint8_t i2c_pump_rx[PRESSURE_BURST_FRAME_SIZE];
+uint8_t i2c_pump_tx[I2C_BUFFER_SIZE + 1];
+
+volatile bool pressure_is_read;
+volatile uint32_t pressure_events;
+uint32_t pressure_request_us;
+
+// Reads that could not start on time, because the one before took too long.
+uint32_t pressure_overruns;
 
 uint16_t targetValue;
 ADI_I2C_RESULT_TYPE i2cResult;
 
+void PumpTask_I2CCallback(void *pCBParam, uint32_t Event, void *pArg) {
+  OSIntEnter();
+
+  // A read is done once its DMA is; publish its samples right here, so
+  // that no task can preempt the writes to the slot.
+  if (Event == ADI_I2C_EVENT_DMA_COMPLETE && pressure_is_read) {
+    PressureBurst_Decode(&pressure_burst, i2c_pump_rx, pressure_request_us,
+                         &pressure_slot);
+  }
+  pressure_events |= Event;
+  TRACE_SEM(TRACE_SEM_POST, pressure_semaphore);
+  OSSemPost(pressure_semaphore);
+
+  OSIntExit();
+}
+
+// Waits for the transfer started last to finish.
+static bool i2c_Wait(void) {
+  uint8_t err;
+
+  TRACE_SEM(TRACE_SEM_PEND, pressure_semaphore);
+  OSSemPend(pressure_semaphore, PRESSURE_I2C_TIMEOUT_TICKS, &err);
+  return err == OS_ERR_NONE
+         && (pressure_events & ADI_I2C_EVENT_DMA_COMPLETE) != 0;
+}
+
+// Starts a transfer with no posts left over from an earlier one.
+static void i2c_Start(bool is_read) {
+  uint8_t err;
+
+  OSSemSet(pressure_semaphore, 0, &err);
+  pressure_events = 0;
+  pressure_is_read = is_read;
+}
+
+// Sends the command in i2c_pump_tx[1..size - 1].
+static void SendCommand(uint16_t size) {
+  i2c_pump_tx[0] = 0x0;
+  i2c_Start(false);
+  i2cResult = adi_I2C_MasterTransmit(i2cDevice, I2C_PUMP_SLAVE_ADDRESS, 0x0,
+                                     ADI_I2C_NO_DATA_ADDRESSING_PHASE,
+                                     i2c_pump_tx, size, false);
+  if (i2cResult != ADI_I2C_SUCCESS || !i2c_Wait()) {
+    FAIL("adi_I2C_MasterTransmit: send command to Arduino");
+  }
+}
+
 void SetTargetPressure(int32_t targetPressure) {
   targetValue = targetPressure ? mmhg_to_transducer(targetPressure) : 0;
-  i2c_pump_tx[0] = SET_PRESSURE_COMMAND;
-  i2c_pump_tx[1] = targetValue & 0xFFu;
-  i2c_pump_tx[2] = (targetValue >> 8) & 0x3u;
-  i2cResult = adi_I2C_MasterTransmit(i2cDevice, I2C_PUMP_SLAVE_ADDRESS, 0x0,
-                                     ADI_I2C_8_BIT_DATA_ADDRESS_WIDTH,
-                                     i2c_pump_tx, 3, false);
-  if (i2cResult != ADI_I2C_SUCCESS) {
-    FAIL("adi_I2C_MasterTransmit: send pressure command to Arduino");
+  i2c_pump_tx[1] = SET_PRESSURE_COMMAND;
+  i2c_pump_tx[2] = targetValue & 0xFFu;
+  i2c_pump_tx[3] = (targetValue >> 8) & 0x3u;
+  SendCommand(4);
+}
+
+// Has the Arduino answer reads with bursts of up to
+// PRESSURE_BURST_MAX_SAMPLES samples.
+static void StartBursts(void) {
+  i2c_pump_tx[1] = PRESSURE_BURST_COMMAND;
+  i2c_pump_tx[2] = PRESSURE_BURST_MAX_SAMPLES;
+  SendCommand(3);
+}
+
+// Reads the samples the Arduino took since the last read; the interrupt
+// publishes them.  A bad frame is counted and dropped, and its samples show
+// up as lost in the next one.
+static void ReadPressure(void) {
+  i2c_Start(true);
+  pressure_request_us = Timestamp_Now32();
+  i2cResult = adi_I2C_MasterReceive(i2cDevice, I2C_PUMP_SLAVE_ADDRESS, 0x0,
+                                    ADI_I2C_NO_DATA_ADDRESSING_PHASE,
+                                    i2c_pump_rx, PRESSURE_BURST_FRAME_SIZE,
+                                    false);
+  if (i2cResult != ADI_I2C_SUCCESS || !i2c_Wait()) {
+    FAIL("adi_I2C_MasterReceive: get pressure from Arduino");
+  }
+}
+
+// Reads the pressure every PRESSURE_POLL_TICKS until MainTask asks for the
+// cuff to be deflated.  Sleeps up to the next tick of a fixed schedule, so
+// the time a read takes doesn't add up.
+static void PollPressure(void) {
+  INT32U next;
+  INT32U now;
+
+  next = OSTimeGet();
+  while (!pump_deflate) {
+    ReadPressure();
+    next += PRESSURE_POLL_TICKS;
+    now = OSTimeGet();
+    if ((INT32S) (next - now) > 0) {
+      OSTimeDly((INT16U) (next - now));
+    } else {
+      next = now;
+      pressure_overruns++;
+    }
   }
 }
 
+void PumpTask_Deflate(void) {
+  pump_deflate = true;
+}
+
 void PumpTask(void* arg) {
   uint8_t err;
 
@@ -48,23 +165,21 @@ void PumpTask(void* arg) {
     printf("PumpTask: inflating to %d.\n", HIGH_PRESSURE);
     SetTargetPressure(HIGH_PRESSURE);
     
-
-    
-    // Resume the main task.
-/*    printf("PumpTask: resuming main task.\n");
-    err = OSTaskResume(TASK_MAIN_PRIO);
-    if (err != OS_ERR_NONE) {
-      FAIL("OSTaskResume: PumpTaskRun");
-    }*/
-    
-    // Suspend this task until the main task finishes measuring. At that point,
-    // the main task will resume this task (and suspend itself) so that we
-    // can fully deflate the cuff.
-    printf("PumpTask: suspending self.\n");
-    err = OSTaskSuspend(OS_PRIO_SELF);
-    if (err != OS_ERR_NONE) {
-      FAIL("OSTaskResume: OSTaskSuspend (2)");
-    }
+    // Read the pressure for MainTask until it finishes measuring. At that
+    // point, the main task will call PumpTask_Deflate (and suspend itself)
+    // so that we can fully deflate the cuff.
+    printf("PumpTask: reading the pressure at %d Hz.\n", PRESSURE_POLL_HZ);
+    PressureSlot_Init(&pressure_slot);
+    PressureBurst_Init(&pressure_burst);
+    pressure_overruns = 0;
+    pump_deflate = false;
+    StartBursts();
+    PollPressure();
+    printf("PumpTask: %u pressure samples in %u frames, %u lost, %u bad "
+           "frames, %u late reads, %u read retries.\n",
+           (unsigned) pressure_burst.samples, (unsigned) pressure_burst.frames,
+           (unsigned) pressure_burst.lost, (unsigned) pressure_burst.bad_frames,
+           (unsigned) pressure_overruns, (unsigned) pressure_slot.retries);
 
     // Once we reach the low value, send "0" to the Arduino to deflate the cuff.
     printf("PumpTask: fully deflating cuff.\n");
@@ -0,0 +1,51 @@
+/* Generated by tools/afeseq.cpp from Sequences.seq; do not edit. */
+
+#include "Sequences.h"
+
+const uint32_t seq_afe_acmeas2wire[SEQ_AFE_ACMEAS2WIRE_LENGTH] = {
+    0x00120030, /* Safety word: command count = 18, CRC = 0x30 */
+    0x84005818, /* AFE_FIFO_CFG: DATA_FIFO_SOURCE_SEL = 10 */
+    0x8A000034, /* AFE_WG_CFG: TYPE_SEL = 10 */
+    0x98033333, /* AFE_WG_FCW: SINE_FCW = 209715 (50000 Hz) */
+    0x9E0005FD, /* AFE_WG_AMPLITUDE: SINE_AMPLITUDE = 1533 (599 mV) */
+    0x88000F00, /* AFE_DAC_CFG: DAC_ATTEN_EN = 0 */
+    0xA0000002, /* AFE_ADC_CFG: MUX_SEL = 00010, GAIN_OFFS_SEL = 00 */
+    /* RCAL */
+    0x86008811, /* AFE_SW_CFG: DMUX_STATE = 1, PMUX_STATE = 1, NMUX_STATE = 8,
+                   TMUX_STATE = 8 */
+    0x00000640, /* Wait 100us */
+    0x80024EF0, /* AFE_CFG: WAVEGEN_EN = 1 */
+    0x00000C80, /* Wait 200us */
+    0x8002CFF0, /* AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1 */
+    0x00032340, /* Wait 13ms */
+    0x80024EF0, /* AFE_CFG: ADC_CONV_EN = 0, DFT_EN = 0 */
+    /* AFE3 - AFE4 */
+    0x86003344, /* AFE_SW_CFG: DMUX_STATE = 4, PMUX_STATE = 4, NMUX_STATE = 3,
+                   TMUX_STATE = 3 */
+    0x00000640, /* Wait 100us */
+    0x8002CFF0, /* AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1 */
+    0x00032340, /* Wait 13ms */
+    0x82000002, /* AFE_SEQ_CFG: SEQ_EN = 0 */
+};
+
+const uint32_t seq_loop_head[SEQ_LOOP_HEAD_LENGTH] = {
+    /* RCAL */
+    0x86008811, /* AFE_SW_CFG: DMUX_STATE = 1, PMUX_STATE = 1, NMUX_STATE = 8,
+                   TMUX_STATE = 8 */
+    0x00000640, /* Wait 100us */
+    0x80024EF0, /* AFE_CFG: WAVEGEN_EN = 1 */
+    0x00000C80, /* Wait 200us */
+    0x8002CFF0, /* AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1 */
+    0x00032340, /* Wait 13ms */
+    0x80024EF0, /* AFE_CFG: ADC_CONV_EN = 0, DFT_EN = 0 */
+    /* AFE3 - AFE4 */
+    0x86003344, /* AFE_SW_CFG: DMUX_STATE = 4, PMUX_STATE = 4, NMUX_STATE = 3,
+                   TMUX_STATE = 3 */
+    0x00000640, /* Wait 100us */
+};
+
+const uint32_t seq_loop_dft[SEQ_LOOP_DFT_LENGTH] = {
+    0x8002CFF0, /* AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1 */
+    0x00032340, /* Wait 13ms */
+    0x80024EF0, /* AFE_CFG: ADC_CONV_EN = 0, DFT_EN = 0 */
+};
@@ -0,0 +1,34 @@
+/* Generated by tools/afeseq.cpp from Sequences.seq; do not edit. */
+
+#ifndef __SEQUENCES_H__
+#define __SEQUENCES_H__
+
+#include <stdint.h>
+
+/* Excitation frequency in Hz */
+#define FREQ (50000)
+/* Peak voltage in mV */
+#define VPEAK (599)
+/* AFE3-AFE4 DFTs between two RCAL DFTs in the measurement loop */
+#define RCAL_INTERVAL (15)
+/* Time for one DFT (2048 ADC samples at 160 kSPS, plus margin), in us */
+#define DFT_WAIT_US (12852)
+
+/* AC measurement, performs 2 DFTs: RCAL, AFE3-AFE4. The DFT keeps running on */
+/* AFE3-AFE4 after the sequence ends. */
+#define SEQ_AFE_ACMEAS2WIRE_LENGTH (19)
+extern const uint32_t seq_afe_acmeas2wire[SEQ_AFE_ACMEAS2WIRE_LENGTH];
+
+/* Start of the measurement loop: RCAL, then switch to AFE3-AFE4. Relies on */
+/* the wavegen, DAC and ADC setup of seq_afe_acmeas2wire. MainTask appends */
+/* seq_loop_dft as often as the DFT rate plan asks for (see DftRate.h) and */
+/* feeds the result to the command FIFO again every time the TX DMA */
+/* completes, so the sequencer never finishes. */
+#define SEQ_LOOP_HEAD_LENGTH (9)
+extern const uint32_t seq_loop_head[SEQ_LOOP_HEAD_LENGTH];
+
+/* One DFT on the current mux setting. */
+#define SEQ_LOOP_DFT_LENGTH (3)
+extern const uint32_t seq_loop_dft[SEQ_LOOP_DFT_LENGTH];
+
+#endif /* __SEQUENCES_H__ */
@@ -0,0 +1,459 @@
+#include <string.h>
+
+#include "SessionStore.h"
+#include "Telemetry.h"
+
+// CRC-32 of one nibble, reflected polynomial 0xEDB88320.  A 16-entry table
+// is a quarter of the work of the bitwise loop for 64 bytes of flash.
+static const uint32_t crc32_table[16] = {
+    0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu,
+    0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+    0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu,
+    0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+};
+
+uint32_t SessionStore_Crc32(uint32_t crc, const uint8_t *data, size_t length) {
+  crc = ~crc;
+  while (length--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ crc32_table[crc & 0x0Fu];
+    crc = (crc >> 4) ^ crc32_table[crc & 0x0Fu];
+  }
+  return ~crc;
+}
+
+static uint32_t store_Crc32(const SessionStore *store, const uint8_t *data,
+                            size_t length) {
+  if (store->flash.crc32 != NULL) {
+    return store->flash.crc32(0, data, length);
+  }
+  return SessionStore_Crc32(0, data, length);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+  return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16)
+         | ((uint32_t) p[3] << 24);
+}
+
+static void put_u16(uint8_t *p, uint16_t value) {
+  p[0] = (uint8_t) value;
+  p[1] = (uint8_t) (value >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+  put_u16(p, (uint16_t) value);
+  put_u16(p + 2, (uint16_t) (value >> 16));
+}
+
+static const uint8_t *store_Page(const SessionStore *store, uint16_t page) {
+  return store->flash.memory + (uint32_t) page * SESSION_STORE_PAGE_SIZE;
+}
+
+static uint16_t store_RecordSize(uint16_t length) {
+  return (uint16_t) (SESSION_STORE_RECORD_HEADER_SIZE + ((length + 7u) & ~7u));
+}
+
+static uint16_t store_RecordCrc(const uint8_t *record, const uint8_t *payload,
+                                uint16_t length) {
+  return Telemetry_Crc16(Telemetry_Crc16(0xFFFF, record, 6), payload, length);
+}
+
+// Size of the intact record at offset of page, or 0.
+static uint16_t store_CheckRecord(const SessionStore *store, uint16_t page,
+                                  uint16_t offset) {
+  const uint8_t *record = store_Page(store, page) + offset;
+  uint16_t length = get_u16(record + 2);
+  uint16_t size;
+
+  if (record[0] < SESSION_RECORD_START || record[0] > SESSION_RECORD_END
+      || length > SESSION_STORE_RECORD_MAX) {
+    return 0;
+  }
+  size = store_RecordSize(length);
+  if (offset + size > SESSION_STORE_PAGE_SIZE - SESSION_STORE_TRAILER_SIZE
+      || store_RecordCrc(record, record + SESSION_STORE_RECORD_HEADER_SIZE,
+                         length) != get_u16(record + 6)) {
+    return 0;
+  }
+  return size;
+}
+
+static void store_DropPage(SessionStore *store, uint16_t page) {
+  uint8_t i = 0;
+
+  while (i < store->sessions) {
+    if (store->index[i].page == page) {
+      store->sessions--;
+      memmove(&store->index[i], &store->index[i + 1],
+              (store->sessions - i) * sizeof(SessionIndexEntry));
+    } else {
+      i++;
+    }
+  }
+}
+
+static void store_AddSession(SessionStore *store, uint16_t session,
+                             uint16_t page, uint16_t offset) {
+  SessionIndexEntry *entry;
+
+  if (store->sessions == SESSION_STORE_MAX_SESSIONS) {
+    store->sessions--;
+    memmove(&store->index[0], &store->index[1],
+            store->sessions * sizeof(SessionIndexEntry));
+  }
+  entry = &store->index[store->sessions++];
+  entry->session = session;
+  entry->page = page;
+  entry->offset = offset;
+  entry->complete = false;
+  entry->bytes = 0;
+}
+
+// Index entry of session if it is the newest, which is the only one that can
+// still grow.
+static SessionIndexEntry *store_Newest(SessionStore *store, uint16_t session) {
+  if (store->sessions == 0
+      || store->index[store->sessions - 1].session != session) {
+    return NULL;
+  }
+  return &store->index[store->sessions - 1];
+}
+
+static void store_IndexRecord(SessionStore *store, uint16_t page,
+                              uint16_t offset) {
+  const uint8_t *record = store_Page(store, page) + offset;
+  uint16_t session = get_u16(record + 4);
+  SessionIndexEntry *entry;
+
+  if (record[0] == SESSION_RECORD_START) {
+    store_AddSession(store, session, page, offset);
+    store->next_session = (uint16_t) (session + 1);
+    return;
+  }
+  entry = store_Newest(store, session);
+  if (entry == NULL) {
+    return;
+  }
+  if (record[0] == SESSION_RECORD_DATA) {
+    entry->bytes += get_u16(record + 2);
+  } else {
+    entry->complete = true;
+  }
+}
+
+static bool store_Write(SessionStore *store, uint32_t offset,
+                        const void *data, uint32_t size) {
+  if (!store->flash.write(store->flash.context, offset, data, size)) {
+    store->write_errors++;
+    return false;
+  }
+  return true;
+}
+
+static bool store_Seal(SessionStore *store, uint16_t page) {
+  uint8_t trailer[SESSION_STORE_TRAILER_SIZE];
+
+  put_u32(trailer, store->used[page]);
+  put_u32(trailer + 4, store_Crc32(store, store_Page(store, page),
+                                   store->used[page]));
+  store->state[page] = SESSION_PAGE_SEALED;
+  return store_Write(store, (uint32_t) (page + 1) * SESSION_STORE_PAGE_SIZE
+                            - SESSION_STORE_TRAILER_SIZE,
+                     trailer, sizeof(trailer));
+}
+
+// Erases the page after head, which holds the oldest data once the ring is
+// full, and makes it the open page.
+static bool store_OpenPage(SessionStore *store) {
+  uint16_t page = (uint16_t) ((store->head + 1) % store->flash.pages);
+  uint8_t header[SESSION_STORE_HEADER_SIZE];
+
+  store_DropPage(store, page);
+  store->state[page] = SESSION_PAGE_FREE;
+  store->used[page] = 0;
+  if (!store->flash.erase(store->flash.context, page)) {
+    store->write_errors++;
+    return false;
+  }
+  store->erases++;
+
+  put_u32(header, SESSION_STORE_MAGIC);
+  put_u32(header + 4, store->sequence++);
+  if (!store_Write(store, (uint32_t) page * SESSION_STORE_PAGE_SIZE, header,
+                   sizeof(header))) {
+    return false;
+  }
+  store->head = page;
+  store->state[page] = SESSION_PAGE_OPEN;
+  store->used[page] = SESSION_STORE_HEADER_SIZE;
+  return true;
+}
+
+// Writes the record buffer, with length bytes of payload, to the open page.
+static bool store_Commit(SessionStore *store, uint8_t type, uint16_t length) {
+  uint8_t *record = store->record.bytes;
+  uint16_t size = store_RecordSize(length);
+  uint16_t offset;
+
+  record[0] = type;
+  record[1] = 0;
+  put_u16(record + 2, length);
+  put_u16(record + 4, store->session);
+  put_u16(record + 6, store_RecordCrc(record,
+                                      record + SESSION_STORE_RECORD_HEADER_SIZE,
+                                      length));
+  memset(record + SESSION_STORE_RECORD_HEADER_SIZE + length, 0,
+         size - SESSION_STORE_RECORD_HEADER_SIZE - length);
+
+  if (store->state[store->head] != SESSION_PAGE_OPEN
+      || store->used[store->head] + size
+         > SESSION_STORE_PAGE_SIZE - SESSION_STORE_TRAILER_SIZE) {
+    if (store->state[store->head] == SESSION_PAGE_OPEN
+        && !store_Seal(store, store->head)) {
+      return false;
+    }
+    if (!store_OpenPage(store)) {
+      return false;
+    }
+  }
+
+  offset = store->used[store->head];
+  if (!store_Write(store,
+                   (uint32_t) store->head * SESSION_STORE_PAGE_SIZE + offset,
+                   record, size)) {
+    return false;
+  }
+  store->used[store->head] += size;
+  store_IndexRecord(store, store->head, offset);
+  return true;
+}
+
+bool SessionStore_Mount(SessionStore *store, const SessionFlash *flash) {
+  const uint8_t *page_memory;
+  const uint8_t *trailer;
+  uint32_t sequence;
+  uint32_t used;
+  uint32_t oldest_sequence = 0;
+  uint32_t newest_sequence = 0;
+  uint16_t oldest = 0;
+  uint16_t offset;
+  uint16_t size;
+  uint16_t page;
+  uint16_t i;
+  bool any = false;
+
+  memset(store, 0, sizeof(*store));
+  if (flash->pages == 0 || flash->pages > SESSION_STORE_MAX_PAGES) {
+    return false;
+  }
+  store->flash = *flash;
+
+  for (page = 0; page < flash->pages; page++) {
+    page_memory = store_Page(store, page);
+    if (get_u32(page_memory) != SESSION_STORE_MAGIC) {
+      continue;
+    }
+    trailer = page_memory + SESSION_STORE_PAGE_SIZE
+              - SESSION_STORE_TRAILER_SIZE;
+    used = get_u32(trailer);
+    if (used == 0xFFFFFFFFu) {
+      store->state[page] = SESSION_PAGE_OPEN;
+    } else if (used < SESSION_STORE_HEADER_SIZE
+               || used > SESSION_STORE_PAGE_SIZE - SESSION_STORE_TRAILER_SIZE
+               || store_Crc32(store, page_memory, used)
+                  != get_u32(trailer + 4)) {
+      store->state[page] = SESSION_PAGE_BAD;
+      store->bad_pages++;
+    } else {
+      store->state[page] = SESSION_PAGE_SEALED;
+      store->used[page] = (uint16_t) used;
+    }
+
+    // Sequence numbers grow along the ring; unsigned differences keep the
+    // order across a wrap of the counter.
+    sequence = get_u32(page_memory + 4);
+    if (!any || (int32_t) (sequence - newest_sequence) > 0) {
+      newest_sequence = sequence;
+      store->head = page;
+    }
+    if (!any || (int32_t) (sequence - oldest_sequence) < 0) {
+      oldest_sequence = sequence;
+      oldest = page;
+    }
+    any = true;
+  }
+
+  if (!any) {
+    // Empty region: the first page opened is page 0.
+    store->head = (uint16_t) (flash->pages - 1);
+    return true;
+  }
+  store->sequence = newest_sequence + 1;
+
+  // Index the records from the oldest page on.  A page left open by a reset
+  // ends at its last intact record and is sealed there.  So does a bad page
+  // (a reset while it was sealed), whose records are still checked one by
+  // one.
+  for (i = 0; i < flash->pages; i++) {
+    page = (uint16_t) ((oldest + i) % flash->pages);
+    if (store->state[page] == SESSION_PAGE_FREE) {
+      continue;
+    }
+    offset = SESSION_STORE_HEADER_SIZE;
+    while ((store->state[page] != SESSION_PAGE_SEALED
+            || offset < store->used[page])
+           && (size = store_CheckRecord(store, page, offset)) > 0) {
+      store_IndexRecord(store, page, offset);
+      offset += size;
+    }
+    if (store->state[page] != SESSION_PAGE_SEALED) {
+      store->used[page] = offset;
+      if (store->state[page] == SESSION_PAGE_OPEN
+          && !store_Seal(store, page)) {
+        return false;
+      }
+      store->state[page] = SESSION_PAGE_SEALED;
+    }
+  }
+  return true;
+}
+
+bool SessionStore_End(SessionStore *store, const void *summary,
+                      uint16_t size) {
+  if (!store->in_session) {
+    return true;
+  }
+  store->in_session = false;
+  if (store->pending > 0
+      && !store_Commit(store, SESSION_RECORD_DATA, store->pending)) {
+    return false;
+  }
+  store->pending = 0;
+
+  if (size > SESSION_STORE_RECORD_MAX) {
+    size = SESSION_STORE_RECORD_MAX;
+  }
+  if (size > 0) {
+    memcpy(store->record.bytes + SESSION_STORE_RECORD_HEADER_SIZE, summary,
+           size);
+  }
+  return store_Commit(store, SESSION_RECORD_END, size);
+}
+
+bool SessionStore_Begin(SessionStore *store, const void *header,
+                        uint16_t size) {
+  if (store->in_session && !SessionStore_End(store, NULL, 0)) {
+    return false;
+  }
+  store->session = store->next_session;
+  store->pending = 0;
+
+  if (size > SESSION_STORE_RECORD_MAX) {
+    size = SESSION_STORE_RECORD_MAX;
+  }
+  if (size > 0) {
+    memcpy(store->record.bytes + SESSION_STORE_RECORD_HEADER_SIZE, header,
+           size);
+  }
+  if (!store_Commit(store, SESSION_RECORD_START, size)) {
+    return false;
+  }
+  store->in_session = true;
+  return true;
+}
+
+bool SessionStore_Append(SessionStore *store, const void *data,
+                         uint16_t size) {
+  const uint8_t *bytes = (const uint8_t *) data;
+  uint16_t count;
+
+  if (!store->in_session) {
+    return false;
+  }
+  while (size > 0) {
+    count = SESSION_STORE_RECORD_MAX - store->pending;
+    if (count > size) {
+      count = size;
+    }
+    memcpy(store->record.bytes + SESSION_STORE_RECORD_HEADER_SIZE
+           + store->pending, bytes, count);
+    store->pending += count;
+    bytes += count;
+    size -= count;
+
+    if (store->pending == SESSION_STORE_RECORD_MAX) {
+      store->pending = 0;
+      if (!store_Commit(store, SESSION_RECORD_DATA,
+                        SESSION_STORE_RECORD_MAX)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+const SessionIndexEntry *SessionStore_Find(const SessionStore *store,
+                                           uint16_t session) {
+  uint8_t i;
+
+  for (i = 0; i < store->sessions; i++) {
+    if (store->index[i].session == session) {
+      return &store->index[i];
+    }
+  }
+  return NULL;
+}
+
+void SessionStore_Open(const SessionStore *store,
+                       const SessionIndexEntry *entry,
+                       SessionReader *reader) {
+  reader->store = store;
+  reader->session = entry->session;
+  reader->page = entry->page;
+  reader->offset = entry->offset;
+  reader->pages_left = store->flash.pages;
+  reader->done = false;
+}
+
+bool SessionStore_Read(SessionReader *reader, uint8_t *type,
+                       const uint8_t **data, uint16_t *size) {
+  const SessionStore *store = reader->store;
+  const uint8_t *record;
+  uint16_t used;
+
+  while (!reader->done) {
+    used = 0;
+    if (store->state[reader->page] == SESSION_PAGE_OPEN
+        || store->state[reader->page] == SESSION_PAGE_SEALED) {
+      used = store->used[reader->page];
+    }
+    if (reader->offset >= used) {
+      // On to the next page of the ring, unless this was the newest.
+      if (reader->page == store->head || --reader->pages_left == 0) {
+        reader->done = true;
+        break;
+      }
+      reader->page = (uint16_t) ((reader->page + 1) % store->flash.pages);
+      reader->offset = SESSION_STORE_HEADER_SIZE;
+      continue;
+    }
+
+    record = store_Page(store, reader->page) + reader->offset;
+    reader->offset += store_RecordSize(get_u16(record + 2));
+    if (get_u16(record + 4) != reader->session) {
+      continue;
+    }
+    *type = record[0];
+    *data = record + SESSION_STORE_RECORD_HEADER_SIZE;
+    *size = get_u16(record + 2);
+    if (*type == SESSION_RECORD_END) {
+      reader->done = true;
+    }
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,169 @@
+#ifndef __SESSION_STORE_H__
+#define __SESSION_STORE_H__
+
+// Log-structured store of measurement sessions in flash.
+//
+// The store owns a region of SESSION_STORE_PAGE_SIZE pages that are used as
+// a ring: records are only ever appended to the open page, a full page is
+// sealed with a trailer holding its length and CRC-32, and the next page in
+// the ring is erased and opened.  Once the ring is full the page with the
+// oldest data is the next to be erased, so every page is erased equally
+// often and nothing is ever rewritten in place.
+//
+// Page:    header (magic, sequence number, 8 bytes), records, and in the last
+//          8 bytes a trailer (bytes used, CRC-32 of them), all ones until the
+//          page is sealed.  The sequence number orders the pages of the ring.
+// Record:  type, 0, payload length, session number, CRC-16/CCITT-FALSE of the
+//          header and payload (8 bytes), then the payload, padded to 8 bytes.
+//
+// A session is a START record, any number of DATA records and an END record.
+// SessionStore_Append() collects data in RAM and writes it as one DATA record
+// of up to SESSION_STORE_RECORD_MAX bytes, so the flash sees few, large
+// writes, and every 8-byte flash word is written exactly once after an erase.
+//
+// SessionStore_Mount() scans the region, checks the CRC of every sealed page,
+// seals a page that was left open by a reset at its last intact record, and
+// rebuilds the session index in RAM: one small entry per stored session with
+// the place of its START record, so a session is found without reading the
+// flash.  Reading is zero-copy, since the flash is memory mapped.
+//
+// The flash itself is reached through SessionFlash, so the store runs on the
+// device (flash.c) and against RAM on a host (tools/sessionstore.c).  Depends
+// on the C standard library and Telemetry_Crc16 only.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SESSION_STORE_PAGE_SIZE
+#define SESSION_STORE_PAGE_SIZE 2048
+#endif
+
+// Largest number of pages in the region.
+#ifndef SESSION_STORE_MAX_PAGES
+#define SESSION_STORE_MAX_PAGES 64
+#endif
+
+// Largest payload of one record; a multiple of 8.
+#ifndef SESSION_STORE_RECORD_MAX
+#define SESSION_STORE_RECORD_MAX 248
+#endif
+
+// Sessions kept in the index; the oldest entry goes first.
+#ifndef SESSION_STORE_MAX_SESSIONS
+#define SESSION_STORE_MAX_SESSIONS 32
+#endif
+
+#if (SESSION_STORE_RECORD_MAX % 8) != 0
+#error "SESSION_STORE_RECORD_MAX must be a multiple of 8"
+#endif
+
+#define SESSION_STORE_MAGIC 0x53455353u  // "SSES"
+#define SESSION_STORE_HEADER_SIZE 8
+#define SESSION_STORE_TRAILER_SIZE 8
+#define SESSION_STORE_RECORD_HEADER_SIZE 8
+
+// Record types.
+#define SESSION_RECORD_START ((uint8_t) 0x01)
+#define SESSION_RECORD_DATA ((uint8_t) 0x02)
+#define SESSION_RECORD_END ((uint8_t) 0x03)
+
+// Page states, as found by SessionStore_Mount().
+#define SESSION_PAGE_FREE 0       // Erased or never used.
+#define SESSION_PAGE_OPEN 1       // Being written.
+#define SESSION_PAGE_SEALED 2     // Full, CRC checked.
+#define SESSION_PAGE_BAD 3        // CRC mismatch; only intact records count.
+
+// Flash access.  memory is where the region can be read.  erase erases one
+// page of the region; write programs size bytes at offset from the start of
+// the region, both multiples of 8, into erased flash.  Both return false on
+// failure.  crc32 computes the page CRCs, as SessionStore_Crc32 does (used
+// if NULL), e.g. on a CRC peripheral.
+typedef struct {
+  const uint8_t *memory;
+  uint16_t pages;
+  bool (*erase)(void *context, uint16_t page);
+  bool (*write)(void *context, uint32_t offset, const void *data,
+                uint32_t size);
+  uint32_t (*crc32)(uint32_t crc, const uint8_t *data, size_t length);
+  void *context;
+} SessionFlash;
+
+typedef struct {
+  uint16_t session;
+  uint16_t page;            // Where the START record is.
+  uint16_t offset;
+  bool complete;            // END record written.
+  uint32_t bytes;           // Payload of the DATA records.
+} SessionIndexEntry;
+
+typedef struct {
+  SessionFlash flash;
+  uint8_t state[SESSION_STORE_MAX_PAGES];
+  uint16_t used[SESSION_STORE_MAX_PAGES];    // Bytes of sealed/open pages.
+  uint16_t head;            // Newest page.
+  uint32_t sequence;        // Sequence number of the next page.
+  uint16_t next_session;
+
+  bool in_session;
+  uint16_t session;
+  uint16_t pending;         // Payload bytes collected in record.
+  union {
+    uint32_t align;
+    uint8_t bytes[SESSION_STORE_RECORD_HEADER_SIZE
+                  + SESSION_STORE_RECORD_MAX];
+  } record;
+
+  SessionIndexEntry index[SESSION_STORE_MAX_SESSIONS];
+  uint8_t sessions;         // Entries in index, oldest first.
+
+  // Statistics.
+  uint32_t erases;
+  uint32_t bad_pages;
+  uint32_t write_errors;
+} SessionStore;
+
+typedef struct {
+  const SessionStore *store;
+  uint16_t session;
+  uint16_t page;
+  uint16_t offset;
+  uint16_t pages_left;
+  bool done;
+} SessionReader;
+
+// CRC-32 (IEEE 802.3, as zlib), as used for pages.
+extern uint32_t SessionStore_Crc32(uint32_t crc, const uint8_t *data,
+                                   size_t length);
+
+// Scans the region and rebuilds the index.  Returns false if flash->pages
+// is above SESSION_STORE_MAX_PAGES or a flash write fails.
+extern bool SessionStore_Mount(SessionStore *store, const SessionFlash *flash);
+
+// Starts a session whose START record holds header.  Ends a session that is
+// still open first.  Returns false if the flash fails.
+extern bool SessionStore_Begin(SessionStore *store, const void *header,
+                               uint16_t size);
+
+// Adds data to the current session.
+extern bool SessionStore_Append(SessionStore *store, const void *data,
+                                uint16_t size);
+
+// Writes what is pending and an END record holding summary.
+extern bool SessionStore_End(SessionStore *store, const void *summary,
+                             uint16_t size);
+
+// Index lookup.  SessionStore_Find returns NULL for an unknown session.
+extern const SessionIndexEntry *SessionStore_Find(const SessionStore *store,
+                                                  uint16_t session);
+
+// Reads the records of an indexed session in order, START to END.  Each call
+// returns false once there are no more, or sets type, data (pointing into
+// flash) and size.
+extern void SessionStore_Open(const SessionStore *store,
+                              const SessionIndexEntry *entry,
+                              SessionReader *reader);
+extern bool SessionStore_Read(SessionReader *reader, uint8_t *type,
+                              const uint8_t **data, uint16_t *size);
+
+#endif  // __SESSION_STORE_H__
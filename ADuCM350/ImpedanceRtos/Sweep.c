@@ -0,0 +1,97 @@
+#include <string.h>
+
+#include "Sweep.h"
+#include "afe_seqcrc.h"
+
+// Sequencer command words used below (see afe.h, SEQ_MMR_WRITE).
+#define SWEEP_WG_FCW_WRITE 0x98000000u
+#define SWEEP_WG_AMPLITUDE_WRITE 0x9E000000u
+
+#define SWEEP_FCW_INDEX 3
+#define SWEEP_AMPLITUDE_INDEX 4
+
+// Same measurement as the RCAL and AFE3-AFE4 part of seq_afe_acmeas2wire in
+// MainTask.c, but the DFT is switched off again before the sequence ends, so
+// nothing keeps filling the data FIFO between two points.
+static const uint32_t sweep_template[SWEEP_SEQ_LENGTH] = {
+    0x00000000, // Safety word (computed by Sweep_Init).
+    0x84005818, // AFE_FIFO_CFG: DATA_FIFO_SOURCE_SEL = 10
+    0x8A000034, // AFE_WG_CFG: TYPE_SEL = 10
+    0x98000000, // AFE_WG_FCW: SINE_FCW (per point)
+    0x9E000000, // AFE_WG_AMPLITUDE: SINE_AMPLITUDE (per sweep)
+    0x88000F00, // AFE_DAC_CFG: DAC_ATTEN_EN = 0
+    0xA0000002, // AFE_ADC_CFG: MUX_SEL = 00010, GAIN_OFFS_SEL = 00
+    // RCAL
+    0x86008811, // DMUX_STATE = 1, PMUX_STATE = 1, NMUX_STATE = 8,
+                // TMUX_STATE = 8
+    0x00000640, // Wait 100us
+    0x80024EF0, // AFE_CFG: WAVEGEN_EN = 1
+    0x00000C80, // Wait 200us
+    0x8002CFF0, // AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1
+    0x00032340, // Wait 13ms
+    0x80024EF0, // AFE_CFG: ADC_CONV_EN = 0, DFT_EN = 0
+    // AFE3 - AFE4
+    0x86003344, // DMUX_STATE = 3, PMUX_STATE = 3, NMUX_STATE = 4,
+                // TMUX_STATE = 4
+    0x00000640, // Wait 100us
+    0x8002CFF0, // AFE_CFG: ADC_CONV_EN = 1, DFT_EN = 1
+    0x00032340, // Wait 13ms
+    0x80024EF0, // AFE_CFG: ADC_CONV_EN = 0, DFT_EN = 0
+    0x82000002, // AFE_SEQ_CFG: SEQ_EN = 0
+};
+
+bool Sweep_Init(Sweep *sweep, const uint32_t *frequencies, uint8_t count,
+                uint16_t amplitude) {
+  SweepPoint *point;
+  uint32_t commands = SWEEP_SEQ_LENGTH - 1;
+  uint8_t i;
+
+  memset(sweep, 0, sizeof(*sweep));
+  if (count == 0 || count > SWEEP_MAX_POINTS) {
+    return false;
+  }
+  for (i = 0; i < count; i++) {
+    if (frequencies[i] == 0 || frequencies[i] > SWEEP_MAX_FREQUENCY_HZ) {
+      return false;
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    point = &sweep->points[i];
+    point->frequency = frequencies[i];
+    memcpy(point->sequence, sweep_template, sizeof(sweep_template));
+    point->sequence[SWEEP_FCW_INDEX] =
+        SWEEP_WG_FCW_WRITE | Sweep_Fcw(frequencies[i]);
+    point->sequence[SWEEP_AMPLITUDE_INDEX] =
+        SWEEP_WG_AMPLITUDE_WRITE | amplitude;
+    point->sequence[0] = (commands << 16)
+        | Sweep_SequenceCrc(&point->sequence[1], commands);
+  }
+
+  sweep->count = count;
+  return true;
+}
+
+const SweepPoint *Sweep_Next(Sweep *sweep) {
+  const SweepPoint *point = &sweep->points[sweep->next];
+
+  if (++sweep->next == sweep->count) {
+    sweep->next = 0;
+    sweep->sweeps++;
+  }
+  return point;
+}
+
+uint32_t Sweep_Fcw(uint32_t frequency) {
+  return (uint32_t) ((((uint64_t) frequency << 26) + 8000000u) / 16000000u);
+}
+
+uint8_t Sweep_SequenceCrc(const uint32_t *commands, uint32_t count) {
+  uint8_t crc = ADI_AFE_SEQ_CRC8_INITIAL;
+  uint32_t i;
+
+  for (i = 0; i < count; i++) {
+    crc = adi_AFE_SeqCrc8Word(crc, commands[i]);
+  }
+  return crc;
+}
@@ -0,0 +1,62 @@
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+// Multi-frequency impedance sweep.
+//
+// Sweep_Init() builds one complete AFE sequence per excitation frequency,
+// with the FCW and sine amplitude written in and the CRC in the safety word
+// computed, once.  Sweep_Next() then hands out the cached sequences in turn,
+// so they can be run as they are with the hardware CRC check, without
+// patching a shared sequence or recomputing its CRC in software every run.
+//
+// Each sequence measures RCAL and then AFE3-AFE4 at its frequency, so every
+// point of the sweep brings its own calibration.  Depends on the C standard
+// library only.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Largest number of frequencies in a sweep.
+#ifndef SWEEP_MAX_POINTS
+#define SWEEP_MAX_POINTS 8
+#endif
+
+// Highest excitation frequency the waveform generator is specified for.
+#define SWEEP_MAX_FREQUENCY_HZ 80000
+
+// Words per sequence, including the safety word.
+#define SWEEP_SEQ_LENGTH 20
+
+// DFT results per sequence: RCAL then AFE3-AFE4, real and imaginary each.
+#define SWEEP_RESULTS_COUNT 4
+
+typedef struct {
+  uint32_t frequency;                   // Excitation frequency in Hz.
+  uint32_t sequence[SWEEP_SEQ_LENGTH];  // Ready to run, CRC included.
+} SweepPoint;
+
+typedef struct {
+  SweepPoint points[SWEEP_MAX_POINTS];
+  uint8_t count;                        // Points in use.
+  uint8_t next;                         // Point returned by Sweep_Next().
+  uint32_t sweeps;                      // Complete passes handed out.
+} Sweep;
+
+// Builds the sequences for count frequencies, in that order.  amplitude is
+// the sine amplitude in DAC codes.  Returns false, leaving the sweep empty,
+// if count is 0 or too large, or a frequency is 0 or too high.
+extern bool Sweep_Init(Sweep *sweep, const uint32_t *frequencies,
+                       uint8_t count, uint16_t amplitude);
+
+// Next point of the sweep, wrapping around to the first after the last.
+extern const SweepPoint *Sweep_Next(Sweep *sweep);
+
+// Waveform generator frequency control word: frequency * 2^26 / 16 MHz.
+extern uint32_t Sweep_Fcw(uint32_t frequency);
+
+// Sequencer CRC-8 (polynomial 0x07, initial value 0x01, 32 bits per word,
+// MSB first) over count commands, as checked against the safety word;
+// adi_AFE_SeqCrc8Word (afe_seqcrc.h) does the work.
+extern uint8_t Sweep_SequenceCrc(const uint32_t *commands, uint32_t count);
+
+#endif  // __SWEEP_H__
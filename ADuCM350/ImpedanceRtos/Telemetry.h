@@ -0,0 +1,190 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+// Telemetry framing for the UART link to the host.  This header only depends
+// on the C standard library so that the same encoder can be built on a host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Telemetry formats, selected at compile time with TELEMETRY_FORMAT.
+//   TELEMETRY_FORMAT_ASCII:  legacy "pressure magnitude phase\r\n" lines.
+//   TELEMETRY_FORMAT_BINARY: fixed-size binary frames (see below).
+//   TELEMETRY_FORMAT_COMPRESSED: periodic binary key frames with
+//                                delta-encoded blocks in between.
+#define TELEMETRY_FORMAT_ASCII 0
+#define TELEMETRY_FORMAT_BINARY 1
+#define TELEMETRY_FORMAT_COMPRESSED 2
+
+#ifndef TELEMETRY_FORMAT
+#define TELEMETRY_FORMAT TELEMETRY_FORMAT_BINARY
+#endif
+
+// Binary frame layout (all multi-byte fields little-endian):
+//
+//   offset  size  field
+//        0     2  sync word (0xA5, 0x5A)
+//        2     1  frame type (TELEMETRY_FRAME_*)
+//        3     2  sequence number, incremented for every frame sent
+//        5     4  timestamp in microseconds (wraps)
+//        9     2  cuff pressure in mmHg
+//       11     3  impedance magnitude, unsigned 20.4 fixed point (ohms)
+//       14     2  impedance phase, signed 12.4 fixed point (degrees)
+//       16     2  CRC-16/CCITT-FALSE over bytes 2..15
+//
+// START and END frames carry the same layout so that the host only ever has
+// to deal with one frame size.  END carries the CRC-32 (as zlib) of every
+// byte of the session sent before it, from the START frame on, as timestamp
+// (0 if unknown), and zeros otherwise; START is the
+// session header, with the output sample rate in mHz as timestamp, the
+// number of DFT results averaged into one sample (decimation ratio) as
+// pressure, the raw DFT result rate in mHz as magnitude and the order of the
+// decimation filter as phase.  RATE frames repeat the header when the rates
+// change in the middle of a session.  SWEEP frames (one point of
+// a multi-frequency sweep) also use it, but carry the excitation frequency in
+// units of TELEMETRY_SWEEP_HZ_PER_LSB instead of the cuff pressure.  So do
+// BEAT frames (one detected heart beat): the timestamp of the beat, the heart
+// rate in units of 1/TELEMETRY_BEAT_RATE_PER_BPM bpm (0 for the first beat)
+// instead of the pressure, the beat amplitude as magnitude and a zero phase.
+#define TELEMETRY_SYNC_0 ((uint8_t) 0xA5)
+#define TELEMETRY_SYNC_1 ((uint8_t) 0x5A)
+
+#define TELEMETRY_FRAME_SAMPLE ((uint8_t) 0x01)
+#define TELEMETRY_FRAME_START ((uint8_t) 0x02)
+#define TELEMETRY_FRAME_END ((uint8_t) 0x03)
+#define TELEMETRY_FRAME_DELTA ((uint8_t) 0x04)
+#define TELEMETRY_FRAME_SWEEP ((uint8_t) 0x05)
+#define TELEMETRY_FRAME_BEAT ((uint8_t) 0x06)
+#define TELEMETRY_FRAME_RATE ((uint8_t) 0x07)
+
+#define TELEMETRY_SWEEP_HZ_PER_LSB 10
+#define TELEMETRY_BEAT_RATE_PER_BPM 10
+
+#define TELEMETRY_FRAME_SIZE 18
+
+// Largest 20.4 magnitude that fits the 24-bit field; larger values saturate.
+#define TELEMETRY_MAGNITUDE_MAX 0x00FFFFFF
+
+// One calibrated measurement.  Magnitude and phase use the 28.4 fixed-point
+// representation of fixed32_t in MainTask.c.
+typedef struct {
+  uint32_t timestamp_us;
+  uint16_t pressure;
+  int32_t magnitude;
+  int32_t phase;
+} TelemetrySample;
+
+// Compressed stream (TELEMETRY_FORMAT_COMPRESSED).
+//
+// Every TELEMETRY_KEYFRAME_INTERVAL samples the encoder sends a regular
+// SAMPLE frame carrying absolute values.  The samples in between are sent in
+// DELTA frames of up to TELEMETRY_DELTA_BLOCK_SAMPLES samples each:
+//
+//   offset  size  field
+//        0     2  sync word (0xA5, 0x5A)
+//        2     1  frame type (TELEMETRY_FRAME_DELTA)
+//        3     2  sequence number of the first sample in the block
+//        5     1  number of samples in the block
+//        6     1  payload length in bytes (n)
+//        7     n  payload
+//      7+n     2  CRC-16/CCITT-FALSE over bytes 2..6+n
+//
+// For each sample the payload holds four zig-zag encoded varints: the change
+// in timestamp delta (delta-of-delta), and the deltas of pressure, magnitude
+// and phase, all relative to the previous sample.  A receiver that misses a
+// frame (sequence gap or CRC error) discards deltas until the next key frame.
+#ifndef TELEMETRY_KEYFRAME_INTERVAL
+#define TELEMETRY_KEYFRAME_INTERVAL 64
+#endif
+
+#ifndef TELEMETRY_DELTA_BLOCK_SAMPLES
+#define TELEMETRY_DELTA_BLOCK_SAMPLES 8
+#endif
+
+#define TELEMETRY_DELTA_HEADER_SIZE 7
+#define TELEMETRY_DELTA_PAYLOAD_MAX (TELEMETRY_DELTA_BLOCK_SAMPLES * 4 * 5)
+
+// The payload length is sent in one byte (and kept in block_length).
+#if TELEMETRY_DELTA_PAYLOAD_MAX > 255
+#error "TELEMETRY_DELTA_BLOCK_SAMPLES must be 12 or less"
+#endif
+
+// Worst case output of one encoder call: a full delta block plus a key frame.
+#define TELEMETRY_STREAM_MAX_OUTPUT                               \
+  (TELEMETRY_DELTA_HEADER_SIZE + TELEMETRY_DELTA_PAYLOAD_MAX + 2 + \
+   TELEMETRY_FRAME_SIZE)
+
+typedef struct {
+  TelemetrySample previous;    // Last sample, as seen by the receiver.
+  int32_t previous_dt;         // Last timestamp delta.
+  uint16_t sequence;           // Sequence number of the next sample.
+  uint16_t since_key;          // Samples since the last key frame.
+  uint16_t block_sequence;     // Sequence number of the first block sample.
+  uint8_t block_count;         // Samples in the pending block.
+  uint8_t block_length;        // Payload bytes in the pending block.
+  uint8_t block[TELEMETRY_DELTA_PAYLOAD_MAX];
+} TelemetryStream;
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+extern uint16_t Telemetry_Crc16(uint16_t crc, const uint8_t *data,
+                                size_t length);
+
+// Encodes a frame into out, which must hold TELEMETRY_FRAME_SIZE bytes.
+// Returns the number of bytes written.
+extern size_t Telemetry_EncodeFrame(uint8_t *out, uint8_t type,
+                                    uint16_t sequence,
+                                    const TelemetrySample *sample);
+
+// Resets the stream; the next sample is sent as a key frame with sequence 0.
+extern void Telemetry_StreamReset(TelemetryStream *stream);
+
+// Adds a sample to the stream.  Any frames that became complete are written
+// to out, which must hold TELEMETRY_STREAM_MAX_OUTPUT bytes.  Returns the
+// number of bytes written, which is often 0 while a block is filling up.
+extern size_t Telemetry_StreamEncode(TelemetryStream *stream,
+                                     const TelemetrySample *sample,
+                                     uint8_t *out);
+
+// Writes out the pending delta block, if any.  Returns the number of bytes.
+extern size_t Telemetry_StreamFlush(TelemetryStream *stream, uint8_t *out);
+
+// Delta payload encoding, shared by the encoder and TelemetryDecoder.h.
+
+// Maps small signed values to small unsigned ones: 0, -1, 1, -2 -> 0, 1, 2, 3.
+static inline uint32_t Telemetry_ZigZag(int32_t value) {
+  return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static inline int32_t Telemetry_UnZigZag(uint32_t value) {
+  return (int32_t) (value >> 1) ^ -(int32_t) (value & 1u);
+}
+
+// Appends value as an unsigned LEB128 varint (at most 5 bytes).
+static inline uint8_t *Telemetry_PutVarint(uint8_t *out, uint32_t value) {
+  while (value >= 0x80u) {
+    *out++ = (uint8_t) (value | 0x80u);
+    value >>= 7;
+  }
+  *out++ = (uint8_t) value;
+  return out;
+}
+
+// Reads a varint written by Telemetry_PutVarint from in, not past end.
+// Returns the byte after it, or NULL if it runs past end.
+static inline const uint8_t *Telemetry_GetVarint(const uint8_t *in,
+                                                 const uint8_t *end,
+                                                 uint32_t *value) {
+  uint32_t shift = 0;
+
+  *value = 0;
+  while (in < end && shift < 35u) {
+    *value |= (uint32_t) (*in & 0x7Fu) << shift;
+    if ((*in++ & 0x80u) == 0) {
+      return in;
+    }
+    shift += 7;
+  }
+  return NULL;
+}
+
+#endif  // __TELEMETRY_H__
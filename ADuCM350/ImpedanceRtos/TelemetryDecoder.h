@@ -0,0 +1,254 @@
+#ifndef __TELEMETRY_DECODER_H__
+#define __TELEMETRY_DECODER_H__
+
+// Host decoder for the telemetry stream (see Telemetry.h), in C++.  Frames
+// are checked with Telemetry_Crc16, delta blocks are unpacked with the
+// varint helpers the encoder uses, and sessions are checked against the
+// CRC-32 in their END frame with CrcService_Crc32Soft, so Telemetry.c and
+// CrcService.c must be linked in.  clientConnector/telemetry.py is the same
+// decoder for the Python client.
+//
+// usage:
+//   TelemetryDecoder decoder;
+//   std::vector<TelemetryFrame> frames;
+//   decoder.Feed(data, size, &frames);
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "CrcService.h"
+#include "Telemetry.h"
+
+// One decoded frame.  For SAMPLE frames, sample holds the measurement, with
+// magnitude and phase in 28.4 fixed point as given to the encoder; other
+// frame types reuse its fields as described in Telemetry.h.
+struct TelemetryFrame {
+  uint8_t type;
+  uint16_t sequence;
+  TelemetrySample sample;
+};
+
+class TelemetryDecoder {
+ public:
+  TelemetryDecoder()
+      : crc_errors(0), lost_frames(0), skipped_bytes(0), skipped_deltas(0),
+        sessions_verified(0), session_crc_errors(0), length_(0),
+        in_session_(false), session_crc_(0), have_sequence_(false),
+        last_sequence_(0), have_previous_(false), previous_dt_(0) {}
+
+  // Appends the complete, CRC-checked frames found in data, and in what was
+  // left over from earlier calls, to frames.  DELTA frames are expanded into
+  // SAMPLE frames.
+  void Feed(const uint8_t *data, size_t size,
+            std::vector<TelemetryFrame> *frames) {
+    size_t n;
+    size_t frame_size;
+    size_t start;
+
+    while (size != 0) {
+      n = sizeof(buffer_) - length_;
+      if (n > size) {
+        n = size;
+      }
+      memcpy(buffer_ + length_, data, n);
+      length_ += n;
+      data += n;
+      size -= n;
+
+      start = 0;
+      while ((frame_size = Next(start)) != 0) {
+        Decode(buffer_ + start, frame_size, frames);
+        start += frame_size;
+      }
+      // Next() stops at a partial frame or sync word; keep it for later.
+      length_ -= start;
+      memmove(buffer_, buffer_ + start, length_);
+    }
+  }
+
+  uint32_t crc_errors;
+  uint32_t lost_frames;
+  uint32_t skipped_bytes;
+  uint32_t skipped_deltas;
+  // Sessions whose END frame CRC did (not) match the bytes received.
+  uint32_t sessions_verified;
+  uint32_t session_crc_errors;
+
+ private:
+  enum { MAX_FRAME_SIZE = TELEMETRY_DELTA_HEADER_SIZE + 255 + 2 };
+
+  static uint16_t GetU16(const uint8_t *in) {
+    return (uint16_t) (in[0] | in[1] << 8);
+  }
+
+  static uint32_t GetU32(const uint8_t *in) {
+    return (uint32_t) GetU16(in) | (uint32_t) GetU16(in + 2) << 16;
+  }
+
+  // Skips to the next valid frame in buffer_ from start on and returns its
+  // size, leaving start at it; or returns 0 if there is no complete frame.
+  size_t Next(size_t &start) {
+    size_t size;
+
+    for (;;) {
+      while (start + 1 < length_ && (buffer_[start] != TELEMETRY_SYNC_0 ||
+                                     buffer_[start + 1] != TELEMETRY_SYNC_1)) {
+        start++;
+        skipped_bytes++;
+      }
+      if (start + 1 >= length_) {
+        // Keep a trailing 0xA5 in case the sync word is split.
+        if (start < length_ && buffer_[start] != TELEMETRY_SYNC_0) {
+          start++;
+          skipped_bytes++;
+        }
+        return 0;
+      }
+      if (length_ - start < 3) {
+        return 0;
+      }
+      if (buffer_[start + 2] != TELEMETRY_FRAME_DELTA) {
+        size = TELEMETRY_FRAME_SIZE;
+      } else if (length_ - start < TELEMETRY_DELTA_HEADER_SIZE) {
+        return 0;
+      } else {
+        size = TELEMETRY_DELTA_HEADER_SIZE + buffer_[start + 6] + 2;
+      }
+      if (length_ - start < size) {
+        return 0;
+      }
+      if (Telemetry_Crc16(0xFFFF, buffer_ + start + 2, size - 4)
+          == GetU16(buffer_ + start + size - 2)) {
+        return size;
+      }
+      // Not a frame (or a corrupted one); resync on the next byte.
+      crc_errors++;
+      skipped_bytes++;
+      start++;
+    }
+  }
+
+  void Decode(const uint8_t *frame, size_t size,
+              std::vector<TelemetryFrame> *frames) {
+    TelemetryFrame decoded;
+
+    TrackSessionCrc(frame, size);
+    decoded.type = frame[2];
+    decoded.sequence = GetU16(frame + 3);
+    if (decoded.type == TELEMETRY_FRAME_DELTA) {
+      DecodeDelta(frame, size, frames);
+      return;
+    }
+    decoded.sample.timestamp_us = GetU32(frame + 5);
+    decoded.sample.pressure = GetU16(frame + 9);
+    decoded.sample.magnitude =
+        (int32_t) (frame[11] | frame[12] << 8 | frame[13] << 16);
+    decoded.sample.phase = (int16_t) GetU16(frame + 14);
+
+    if (decoded.type == TELEMETRY_FRAME_START) {
+      have_sequence_ = false;
+      have_previous_ = false;
+    } else if (decoded.type == TELEMETRY_FRAME_SAMPLE) {
+      TrackSequence(decoded.sequence, 1);
+      // Absolute values: (re)synchronizes the delta decoder.
+      previous_ = decoded.sample;
+      previous_dt_ = 0;
+      have_previous_ = true;
+    }
+    frames->push_back(decoded);
+  }
+
+  // END carries the CRC-32 of the session's bytes from START on; a frame
+  // lost or dropped on the way shows up as a mismatch.
+  void TrackSessionCrc(const uint8_t *frame, size_t size) {
+    uint32_t expected;
+
+    if (frame[2] == TELEMETRY_FRAME_START) {
+      session_crc_ = CrcService_Crc32Soft(0, frame, size);
+      in_session_ = true;
+    } else if (frame[2] == TELEMETRY_FRAME_END) {
+      expected = GetU32(frame + 5);
+      if (expected != 0 && in_session_) {
+        if (expected == session_crc_) {
+          sessions_verified++;
+        } else {
+          session_crc_errors++;
+        }
+      }
+      in_session_ = false;
+    } else if (in_session_) {
+      session_crc_ = CrcService_Crc32Soft(session_crc_, frame, size);
+    }
+  }
+
+  // Returns false if frames were lost since the previous one.
+  bool TrackSequence(uint16_t sequence, uint8_t count) {
+    uint16_t lost = 0;
+
+    if (have_sequence_) {
+      lost = (uint16_t) (sequence - last_sequence_ - 1u);
+      lost_frames += lost;
+    }
+    last_sequence_ = (uint16_t) (sequence + count - 1u);
+    have_sequence_ = true;
+    return lost == 0;
+  }
+
+  void DecodeDelta(const uint8_t *frame, size_t size,
+                   std::vector<TelemetryFrame> *frames) {
+    const uint8_t *p = frame + TELEMETRY_DELTA_HEADER_SIZE;
+    const uint8_t *end = frame + size - 2;
+    TelemetryFrame decoded;
+    uint32_t fields[4];
+    uint8_t count = frame[5];
+    uint8_t i;
+    int j;
+
+    if (!TrackSequence(GetU16(frame + 3), count)) {
+      have_previous_ = false;
+    }
+    if (!have_previous_) {
+      // Cannot apply deltas without a base; wait for the next key frame.
+      skipped_deltas += count;
+      return;
+    }
+
+    decoded.type = TELEMETRY_FRAME_SAMPLE;
+    for (i = 0; i < count; i++) {
+      for (j = 0; j < 4; j++) {
+        p = Telemetry_GetVarint(p, end, &fields[j]);
+        if (p == NULL) {
+          // Truncated payload behind a valid CRC: treat it as a gap.
+          skipped_deltas += count - i;
+          have_previous_ = false;
+          return;
+        }
+      }
+      previous_dt_ += Telemetry_UnZigZag(fields[0]);
+      previous_.timestamp_us += (uint32_t) previous_dt_;
+      previous_.pressure =
+          (uint16_t) (previous_.pressure + Telemetry_UnZigZag(fields[1]));
+      previous_.magnitude += Telemetry_UnZigZag(fields[2]);
+      previous_.phase += Telemetry_UnZigZag(fields[3]);
+      decoded.sequence = (uint16_t) (GetU16(frame + 3) + i);
+      decoded.sample = previous_;
+      frames->push_back(decoded);
+    }
+  }
+
+  uint8_t buffer_[2 * MAX_FRAME_SIZE];
+  size_t length_;
+  bool in_session_;
+  uint32_t session_crc_;
+  bool have_sequence_;
+  uint16_t last_sequence_;
+  // Last decoded sample, needed to apply deltas; valid if have_previous_.
+  bool have_previous_;
+  TelemetrySample previous_;
+  int32_t previous_dt_;
+};
+
+#endif  // __TELEMETRY_DECODER_H__
@@ -0,0 +1,54 @@
+#include <string.h>
+
+#include "TelemetryRing.h"
+
+// Orders the record copy before the index update that publishes it.
+#if defined(__ICCARM__)
+#include <intrinsics.h>
+#define RING_BARRIER() __DMB()
+#elif defined(__GNUC__)
+#define RING_BARRIER() __sync_synchronize()
+#else
+#define RING_BARRIER()
+#endif
+
+void TelemetryRing_Init(TelemetryRing *ring) {
+  memset(ring, 0, sizeof(*ring));
+}
+
+bool TelemetryRing_Push(TelemetryRing *ring, const TelemetryRecord *record) {
+  uint32_t head = ring->head;
+  uint32_t depth = head - ring->tail;
+
+  if (depth >= TELEMETRY_RING_SIZE) {
+    ring->dropped++;
+    return false;
+  }
+
+  ring->records[head & (TELEMETRY_RING_SIZE - 1)] = *record;
+  RING_BARRIER();
+  ring->head = head + 1;
+
+  if (depth + 1 > ring->max_depth) {
+    ring->max_depth = depth + 1;
+  }
+  return true;
+}
+
+bool TelemetryRing_Pop(TelemetryRing *ring, TelemetryRecord *record) {
+  uint32_t tail = ring->tail;
+
+  if (tail == ring->head) {
+    return false;
+  }
+
+  RING_BARRIER();
+  *record = ring->records[tail & (TELEMETRY_RING_SIZE - 1)];
+  RING_BARRIER();
+  ring->tail = tail + 1;
+  return true;
+}
+
+uint32_t TelemetryRing_Depth(const TelemetryRing *ring) {
+  return ring->head - ring->tail;
+}
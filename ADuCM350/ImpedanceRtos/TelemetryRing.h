@@ -0,0 +1,53 @@
+#ifndef __TELEMETRY_RING_H__
+#define __TELEMETRY_RING_H__
+
+// Lock-free single-producer/single-consumer ring of telemetry records.
+//
+// MainTask is the only producer and the telemetry task the only consumer.
+// Each side writes only its own index (head for the producer, tail for the
+// consumer), so no lock or critical section is needed.  The indices run
+// freely and are masked on access, so TELEMETRY_RING_SIZE must be a power of
+// two.  Like Telemetry.c, this depends on the C standard library only.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Telemetry.h"
+
+// Number of records in the ring; must be a power of two.
+#ifndef TELEMETRY_RING_SIZE
+#define TELEMETRY_RING_SIZE 64
+#endif
+
+#if (TELEMETRY_RING_SIZE & (TELEMETRY_RING_SIZE - 1)) != 0
+#error "TELEMETRY_RING_SIZE must be a power of two"
+#endif
+
+typedef struct {
+  uint8_t type;             // TELEMETRY_FRAME_SAMPLE, _START or _END.
+  TelemetrySample sample;   // Unused for START and END.
+} TelemetryRecord;
+
+typedef struct {
+  TelemetryRecord records[TELEMETRY_RING_SIZE];
+  volatile uint32_t head;   // Written by the producer only.
+  volatile uint32_t tail;   // Written by the consumer only.
+
+  // Statistics, written by the producer only.
+  uint32_t dropped;         // Records lost because the ring was full.
+  uint32_t max_depth;       // Largest number of queued records seen.
+} TelemetryRing;
+
+extern void TelemetryRing_Init(TelemetryRing *ring);
+
+// Producer side.  Returns false, and counts a drop, if the ring is full.
+extern bool TelemetryRing_Push(TelemetryRing *ring,
+                               const TelemetryRecord *record);
+
+// Consumer side.  Returns false if the ring is empty.
+extern bool TelemetryRing_Pop(TelemetryRing *ring, TelemetryRecord *record);
+
+// Number of queued records; safe to call from either side.
+extern uint32_t TelemetryRing_Depth(const TelemetryRing *ring);
+
+#endif  // __TELEMETRY_RING_H__
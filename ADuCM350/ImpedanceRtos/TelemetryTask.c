@@ -0,0 +1,550 @@
+#include "ImpedanceRtos.h"
+
+// Records from MainTask, drained by TelemetryTask.
+TelemetryRing telemetry_ring;
+
+// Posted by MainTask once a burst of records is queued.
+OS_EVENT *telemetry_semaphore;
+
+// Sequence number of the next telemetry frame.
+uint16_t telemetry_sequence;
+
+// CRC-32 of the bytes sent since the START frame, sent in the END frame.
+uint32_t telemetry_crc;
+
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_COMPRESSED)
+// Delta encoder state and its output buffer.
+TelemetryStream telemetry_stream;
+uint8_t telemetry_stream_tx[TELEMETRY_STREAM_MAX_OUTPUT];
+#endif
+
+#if (1 == USE_SESSION_STORE)
+// The flash copy of the sessions, with its own delta encoder so it is stored
+// compressed whatever goes out on the UART.
+SessionStore session_store;
+TelemetryStream session_stream;
+uint8_t session_stream_tx[TELEMETRY_STREAM_MAX_OUTPUT];
+uint32_t session_crc;
+// START record of a session that has no sample yet, and nothing in flash.
+TelemetrySample session_header;
+bool session_pending;
+ADI_FEE_DEV_HANDLE hFeeDevice;
+
+void session_Init(void);
+void session_Record(const TelemetryRecord *record);
+#endif
+
+// A host command byte still waiting for its argument ('R'), or 0.
+uint8_t telemetry_command;
+
+void telemetry_Send(const uint8_t *data, uint16_t size);
+void telemetry_Command(void);
+
+void telemetry_Write(const uint8_t *data, size_t size);
+void print_TelemetrySample(const TelemetrySample *sample);
+void print_SessionMarker(uint8_t type, const TelemetrySample *sample);
+void print_EventFrame(uint8_t type, const TelemetrySample *sample);
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_ASCII)
+void print_Rates(const char *label, const TelemetrySample *header);
+#endif
+
+// Called by MainTask; never blocks.  The telemetry task is only woken once
+// TELEMETRY_BURST_SIZE records are queued, or for a session marker, so that
+// it formats and sends records in bursts.
+void TelemetryTask_Post(uint8_t type, const TelemetrySample *sample) {
+  TelemetryRecord record;
+
+  record.type = type;
+  if (sample != NULL) {
+    record.sample = *sample;
+  } else {
+    memset(&record.sample, 0, sizeof(record.sample));
+  }
+
+  if (!TelemetryRing_Push(&telemetry_ring, &record)) {
+    // Counted in telemetry_ring.dropped; the telemetry task is behind.
+    return;
+  }
+  TRACE_EVENT(TRACE_QUEUE_POST, TRACE_QUEUE_TELEMETRY_RING,
+              TelemetryRing_Depth(&telemetry_ring));
+
+  if ((type == TELEMETRY_FRAME_START || type == TELEMETRY_FRAME_END)
+      || TelemetryRing_Depth(&telemetry_ring) == TELEMETRY_BURST_SIZE) {
+    TRACE_SEM(TRACE_SEM_POST, telemetry_semaphore);
+    OSSemPost(telemetry_semaphore);
+  }
+}
+
+void TelemetryTask(void *arg) {
+  TelemetryRecord record;
+  uint8_t err;
+
+  if (!CrcService_Init()) {
+    printf("TelemetryTask: CRC peripheral check failed, "
+           "using software CRCs.\n");
+  }
+#if (1 == USE_SESSION_STORE)
+  session_Init();
+#endif
+
+  while (true) {
+    // Wait for a burst, but don't hold on to a partial one for too long.
+    TRACE_SEM(TRACE_SEM_PEND, telemetry_semaphore);
+    OSSemPend(telemetry_semaphore, TELEMETRY_FLUSH_TICKS, &err);
+    if (err != OS_ERR_NONE && err != OS_ERR_TIMEOUT) {
+      FAIL("OSSemPend: telemetry_semaphore");
+    }
+    // Bytes the UART refused earlier would otherwise wait for the next
+    // record, which may be a while on a timeout.
+    test_service();
+
+    while (TelemetryRing_Pop(&telemetry_ring, &record)) {
+      TRACE_EVENT(TRACE_QUEUE_PEND, TRACE_QUEUE_TELEMETRY_RING,
+                  TelemetryRing_Depth(&telemetry_ring));
+      if (record.type == TELEMETRY_FRAME_SAMPLE) {
+        print_TelemetrySample(&record.sample);
+      } else if (record.type == TELEMETRY_FRAME_START
+                 || record.type == TELEMETRY_FRAME_END) {
+        print_SessionMarker(record.type, &record.sample);
+      } else {
+        print_EventFrame(record.type, &record.sample);
+      }
+#if (1 == USE_SESSION_STORE)
+      session_Record(&record);
+#endif
+
+      if (record.type == TELEMETRY_FRAME_END) {
+        // Let the UART finish the session, then report on it.
+        test_flush();
+        printf("TelemetryTask: %u bytes sent, %u records dropped "
+               "(max depth %u/%u), %u UART records dropped "
+               "(high water %u/%u bytes).\n",
+               (unsigned) uart_tx.bytes_sent,
+               (unsigned) telemetry_ring.dropped,
+               (unsigned) telemetry_ring.max_depth,
+               (unsigned) TELEMETRY_RING_SIZE,
+               (unsigned) uart_tx.overflow_count,
+               (unsigned) uart_tx.high_water,
+               (unsigned) UART_TX_BUFFER_SIZE);
+#if (1 == USE_SESSION_STORE)
+        printf("TelemetryTask: %u sessions stored, %u page erases, "
+               "%u flash write errors.\n",
+               (unsigned) session_store.sessions,
+               (unsigned) session_store.erases,
+               (unsigned) session_store.write_errors);
+#endif
+      }
+    }
+
+    telemetry_Command();
+  }
+}
+
+#if (1 == USE_SESSION_STORE)
+/* Flash access for session_store: block 1, from SESSION_FLASH_BASE. Both
+   calls block until the flash controller is done. */
+bool session_FlashErase(void *context, uint16_t page) {
+  return ADI_FEE_SUCCESS ==
+         adi_FEE_PageErase(hFeeDevice,
+                           (SESSION_FLASH_BASE - 0x00040000u) / 2048 + page);
+}
+
+bool session_FlashWrite(void *context, uint32_t offset, const void *data,
+                        uint32_t size) {
+  return ADI_FEE_SUCCESS == adi_FEE_Write(hFeeDevice,
+                                          SESSION_FLASH_BASE + offset,
+                                          (const uint8_t *) data, size);
+}
+
+/* Opens flash block 1 and mounts the session store on it. */
+void session_Init(void) {
+  SessionFlash flash;
+
+  if (ADI_FEE_SUCCESS != adi_FEE_Init(ADI_FEE_DEVID_1, true, &hFeeDevice)) {
+    FAIL("adi_FEE_Init: ADI_FEE_DEVID_1");
+  }
+
+  flash.memory = (const uint8_t *) SESSION_FLASH_BASE;
+  flash.pages = SESSION_FLASH_PAGES;
+  flash.erase = session_FlashErase;
+  flash.write = session_FlashWrite;
+  flash.crc32 = CrcService_Crc32;
+  flash.context = NULL;
+  if (!SessionStore_Mount(&session_store, &flash)) {
+    FAIL("SessionStore_Mount");
+  }
+  printf("TelemetryTask: %u sessions in flash, %u bad pages.\n",
+         (unsigned) session_store.sessions,
+         (unsigned) session_store.bad_pages);
+}
+
+/* Adds bytes to the current session in flash and to its CRC. */
+void session_Append(const uint8_t *data, size_t size) {
+  session_crc = CrcService_Crc32(session_crc, data, size);
+  SessionStore_Append(&session_store, data, (uint16_t) size);
+}
+
+/* Stores a record the way the compressed format sends it, so a dump of the
+   store reads like a capture of the UART, END frame CRC included. A session
+   only goes to flash with its first sample: a START and END with nothing
+   measured in between costs no flash and no index entry. A flash error
+   loses the rest of the session; it is counted in
+   session_store.write_errors. */
+void session_Record(const TelemetryRecord *record) {
+  TelemetrySample summary;
+  size_t size;
+
+  if (record->type == TELEMETRY_FRAME_START) {
+    session_header = record->sample;
+    session_pending = true;
+    return;
+  }
+  if (record->type == TELEMETRY_FRAME_SAMPLE && session_pending) {
+    session_pending = false;
+    Telemetry_StreamReset(&session_stream);
+    size = Telemetry_EncodeFrame(session_stream_tx, TELEMETRY_FRAME_START, 0,
+                                 &session_header);
+    session_crc = CrcService_Crc32(0, session_stream_tx, size);
+    SessionStore_Begin(&session_store, session_stream_tx, (uint16_t) size);
+  } else if (record->type == TELEMETRY_FRAME_END) {
+    session_pending = false;
+  }
+  if (!session_store.in_session) {
+    return;
+  }
+
+  if (record->type == TELEMETRY_FRAME_SAMPLE) {
+    size = Telemetry_StreamEncode(&session_stream, &record->sample,
+                                  session_stream_tx);
+    if (size > 0) {
+      session_Append(session_stream_tx, size);
+    }
+  } else if (record->type == TELEMETRY_FRAME_END) {
+    size = Telemetry_StreamFlush(&session_stream, session_stream_tx);
+    if (size > 0) {
+      session_Append(session_stream_tx, size);
+    }
+    summary = record->sample;
+    summary.timestamp_us = session_crc;
+    size = Telemetry_EncodeFrame(session_stream_tx, TELEMETRY_FRAME_END,
+                                 session_stream.sequence, &summary);
+    SessionStore_End(&session_store, session_stream_tx, (uint16_t) size);
+  } else {
+    // Samples before the event go first, as on the UART.
+    size = Telemetry_StreamFlush(&session_stream, session_stream_tx);
+    if (size > 0) {
+      session_Append(session_stream_tx, size);
+    }
+    size = Telemetry_EncodeFrame(session_stream_tx, record->type,
+                                 session_stream.sequence, &record->sample);
+    session_Append(session_stream_tx, size);
+  }
+}
+
+/* Sends every stored session, oldest first, as the compressed telemetry
+   stream: the records are read straight out of flash and the UART is kept
+   busy until the last byte. A session cut short by a reset gets an END
+   frame, so the host sees where it stops. The dump takes seconds, so it
+   gives way as soon as MainTask queues a record (a new session): the
+   session being sent gets an END frame and the live telemetry follows,
+   before telemetry_ring can fill up. Such an END carries the CRC-32 of the
+   bytes sent for the session, as a stored one does, so the host can check
+   what it got. */
+void session_Dump(void) {
+  SessionReader reader;
+  TelemetrySample summary;
+  const uint8_t *data;
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+  uint32_t crc;
+  uint16_t size;
+  uint8_t type;
+  uint8_t i;
+  bool complete;
+
+  for (i = 0; i < session_store.sessions; i++) {
+    SessionStore_Open(&session_store, &session_store.index[i], &reader);
+    complete = session_store.index[i].complete;
+    crc = 0;
+    while (SessionStore_Read(&reader, &type, &data, &size)) {
+      if (TelemetryRing_Depth(&telemetry_ring) != 0) {
+        complete = false;
+        break;
+      }
+      crc = CrcService_Crc32(crc, data, size);
+      telemetry_Send(data, size);
+    }
+    if (!complete) {
+      memset(&summary, 0, sizeof(summary));
+      summary.timestamp_us = crc;
+      telemetry_Send(frame, (uint16_t) Telemetry_EncodeFrame(
+                              frame, TELEMETRY_FRAME_END, 0, &summary));
+    }
+    if (TelemetryRing_Depth(&telemetry_ring) != 0) {
+      return;
+    }
+  }
+  test_flush();
+}
+
+/* Lists the stored sessions, one line each. */
+void session_List(void) {
+  const SessionIndexEntry *entry;
+  char msg[MSG_MAXLEN];
+  uint8_t i;
+
+  for (i = 0; i < session_store.sessions; i++) {
+    entry = &session_store.index[i];
+    sprintf(msg, "SESSION %u %lu %s\r\n", (unsigned) entry->session,
+            (unsigned long) entry->bytes,
+            entry->complete ? "complete" : "partial");
+    telemetry_Send((const uint8_t *) msg, (uint16_t) strlen(msg));
+  }
+  sprintf(msg, "SESSIONS %u\r\n", (unsigned) session_store.sessions);
+  telemetry_Send((const uint8_t *) msg, (uint16_t) strlen(msg));
+  test_flush();
+}
+
+#endif /* USE_SESSION_STORE */
+
+/* Queues bytes for the UART, waiting for room instead of dropping them. */
+void telemetry_Send(const uint8_t *data, uint16_t size) {
+  UartTx_Service(&uart_tx);
+  while (UART_TX_BUFFER_SIZE - uart_tx.fill_length < size) {
+    OSTimeDly(1);
+    UartTx_Service(&uart_tx);
+  }
+  test_write(data, (int16_t) size);
+}
+
+/* Commands from the host, one byte each. 'T' dumps the trace recorder (see
+   Trace.h), even during a session: it is sent from this task between two
+   frames, and the records queue up meanwhile. 'R' and a digit 1-9 set the
+   output decimation (MainTask_SetDecimation), also during a session; a
+   RATE frame follows with the next sample. With the session store, 'L'
+   lists the stored sessions and 'D' dumps them; both are ignored while a
+   session is being measured, so the dump never competes with live
+   telemetry, and a session that starts during a dump cuts it short (see
+   session_Dump). */
+void telemetry_Command(void) {
+  uint8_t command;
+
+  while (test_read(&command, 1) == 1) {
+    if (telemetry_command == 'R') {
+      telemetry_command = 0;
+      if (command >= '1' && command <= '9') {
+        MainTask_SetDecimation((uint16_t) (command - '0'));
+      }
+      continue;
+    }
+    if (command == 'R') {
+      telemetry_command = command;
+      continue;
+    }
+#if (APP_TRACE_EN > 0u)
+    if (command == 'T') {
+      Trace_Dump(telemetry_Send);
+      test_flush();
+      continue;
+    }
+#endif
+#if (1 == USE_SESSION_STORE)
+    if (session_store.in_session || session_pending) {
+      continue;
+    }
+    if (command == 'L') {
+      session_List();
+    } else if (command == 'D') {
+      session_Dump();
+    }
+#endif
+  }
+}
+
+/* Simple conversion of a fixed32_t variable to string format. */
+void sprintf_fixed32(char *out, fixed32_t in) {
+  fixed32_t tmp;
+
+  if (in.full < 0) {
+    tmp.parts.fpart = (16 - in.parts.fpart) & 0x0F;
+    tmp.parts.ipart = in.parts.ipart;
+    if (0 != in.parts.fpart) {
+      tmp.parts.ipart++;
+    }
+    if (0 == tmp.parts.ipart) {
+      sprintf(out, "      -0.%04d", tmp.parts.fpart * FIXED32_LSB_SIZE);
+    } else {
+      sprintf(out, "%8d.%04d", tmp.parts.ipart,
+              tmp.parts.fpart * FIXED32_LSB_SIZE);
+    }
+  } else {
+    sprintf(out, "%8d.%04d", in.parts.ipart, in.parts.fpart * FIXED32_LSB_SIZE);
+  }
+}
+
+/* Sends bytes of the current session and adds them to its CRC. */
+void telemetry_Write(const uint8_t *data, size_t size) {
+  telemetry_crc = CrcService_Crc32(telemetry_crc, data, size);
+  test_write(data, (int16_t) size);
+}
+
+/* Helper function for printing fixed32_t (magnitude & phase) and uint15_t
+ * (pressure) results. */
+void print_TelemetrySample(const TelemetrySample *sample) {
+#if (TELEMETRY_FORMAT != TELEMETRY_FORMAT_ASCII)
+  // Binary frames skip sprintf entirely and are ~40% smaller on the wire.
+  size_t size;
+
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_COMPRESSED)
+  // Deltas are buffered until a block fills up, so usually nothing is sent.
+  size = Telemetry_StreamEncode(&telemetry_stream, sample,
+                                telemetry_stream_tx);
+  if (size > 0) {
+    telemetry_Write(telemetry_stream_tx, size);
+  }
+#else
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+
+  size = Telemetry_EncodeFrame(frame, TELEMETRY_FRAME_SAMPLE,
+                               telemetry_sequence++, sample);
+  telemetry_Write(frame, size);
+#endif
+#else
+  char msg[MSG_MAXLEN];
+  char tmp[MSG_MAXLEN];
+  fixed32_t value;
+
+  sprintf(msg, "%d", sample->pressure);
+
+  value.full = sample->magnitude;
+  sprintf_fixed32(tmp, value);
+  strcat(msg, tmp);
+
+  value.full = sample->phase;
+  sprintf_fixed32(tmp, value);
+  strcat(msg, tmp);
+
+  strcat(msg, "\r\n");
+
+  PRINT(msg);
+#endif /* TELEMETRY_FORMAT */
+}
+
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_ASCII)
+/* Prints a START or RATE header line: the raw DFT and output rates in Hz and
+ * the decimation ratio between them. */
+void print_Rates(const char *label, const TelemetrySample *header) {
+  char msg[MSG_MAXLEN];
+
+  sprintf(msg, "%s raw %lu.%03lu Hz, out %lu.%03lu Hz (%u:1)\r\n", label,
+          (unsigned long) header->magnitude / 1000,
+          (unsigned long) header->magnitude % 1000,
+          (unsigned long) header->timestamp_us / 1000,
+          (unsigned long) header->timestamp_us % 1000,
+          (unsigned) header->pressure);
+  PRINT(msg);
+}
+#endif
+
+/* Sends one point of a frequency sweep, one heart beat or a change of the
+ * sample rates; never delta encoded. The pressure field of the sample holds
+ * the frequency (TELEMETRY_SWEEP_HZ_PER_LSB), the heart rate
+ * (TELEMETRY_BEAT_RATE_PER_BPM) or the decimation ratio. The frame carries
+ * the sequence number of the next sample without using it up, so events
+ * sent in the middle of a session don't show up as lost samples on the
+ * host. In the compressed format the pending delta block goes out first,
+ * so that the host gets every sample before an event that follows it (a
+ * RATE frame changes the timebase of the samples after it). */
+void print_EventFrame(uint8_t type, const TelemetrySample *sample) {
+#if (TELEMETRY_FORMAT != TELEMETRY_FORMAT_ASCII)
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+  size_t size;
+
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_COMPRESSED)
+  size = Telemetry_StreamFlush(&telemetry_stream, telemetry_stream_tx);
+  if (size > 0) {
+    telemetry_Write(telemetry_stream_tx, size);
+  }
+  size = Telemetry_EncodeFrame(frame, type, telemetry_stream.sequence,
+                               sample);
+#else
+  size = Telemetry_EncodeFrame(frame, type, telemetry_sequence, sample);
+#endif
+  telemetry_Write(frame, size);
+#else
+  char msg[MSG_MAXLEN];
+  char tmp[MSG_MAXLEN];
+  fixed32_t value;
+
+  if (type == TELEMETRY_FRAME_RATE) {
+    print_Rates("RATE", sample);
+    return;
+  } else if (type == TELEMETRY_FRAME_BEAT) {
+    sprintf(msg, "BEAT %u.%u", sample->pressure / TELEMETRY_BEAT_RATE_PER_BPM,
+            sample->pressure % TELEMETRY_BEAT_RATE_PER_BPM);
+  } else {
+    sprintf(msg, "SWEEP %lu",
+            (unsigned long) sample->pressure * TELEMETRY_SWEEP_HZ_PER_LSB);
+  }
+
+  value.full = sample->magnitude;
+  sprintf_fixed32(tmp, value);
+  strcat(msg, tmp);
+
+  value.full = sample->phase;
+  sprintf_fixed32(tmp, value);
+  strcat(msg, tmp);
+
+  strcat(msg, "\r\n");
+
+  PRINT(msg);
+#endif /* TELEMETRY_FORMAT */
+}
+
+/* Marks the start or end of a measurement session on the data link. START
+ * carries the session header in sample (see Telemetry.h), END the CRC-32 of
+ * the bytes sent from START on. */
+void print_SessionMarker(uint8_t type, const TelemetrySample *sample) {
+#if (TELEMETRY_FORMAT != TELEMETRY_FORMAT_ASCII)
+  TelemetrySample summary;
+  size_t size;
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_COMPRESSED)
+  uint8_t *frame = telemetry_stream_tx;
+#else
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+#endif
+
+  if (type == TELEMETRY_FRAME_START) {
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_COMPRESSED)
+    Telemetry_StreamReset(&telemetry_stream);
+#else
+    telemetry_sequence = 0;
+#endif
+    telemetry_crc = 0;
+  } else {
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_COMPRESSED)
+    // Send the last, partially filled, delta block before the END frame.
+    size = Telemetry_StreamFlush(&telemetry_stream, telemetry_stream_tx);
+    if (size > 0) {
+      telemetry_Write(telemetry_stream_tx, size);
+    }
+#endif
+    summary = *sample;
+    summary.timestamp_us = telemetry_crc;
+    sample = &summary;
+  }
+
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_COMPRESSED)
+  size = Telemetry_EncodeFrame(frame, type, telemetry_stream.sequence,
+                               sample);
+#else
+  size = Telemetry_EncodeFrame(frame, type, telemetry_sequence++, sample);
+#endif
+  telemetry_Write(frame, size);
+#else
+  if (type == TELEMETRY_FRAME_START) {
+    print_Rates("START", sample);
+  } else {
+    PRINT("END\r\n");
+  }
+#endif /* TELEMETRY_FORMAT */
+}
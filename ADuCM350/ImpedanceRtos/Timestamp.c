@@ -0,0 +1,73 @@
+#include "ImpedanceRtos.h"
+
+ADI_GPT_HANDLE timestamp_gpt;
+
+// Timer wraps since Timestamp_Init, counted by the timeout interrupt.
+volatile uint32_t timestamp_wraps;
+
+static void timestamp_Callback(void *pCBParam, uint32_t Event, void *pArg) {
+  if (Event == ADI_GPT_EVENT_TIMEOUT) {
+    timestamp_wraps++;
+  }
+}
+
+void Timestamp_Init(void) {
+  if (SystemGetClockFrequency(ADI_SYS_CLOCK_PCLK) != TIMESTAMP_PCLK_HZ) {
+    FAIL("Timestamp_Init: PCLK is not 16 MHz");
+  }
+  if (ADI_GPT_SUCCESS != adi_GPT_Init(TIMESTAMP_GPT, &timestamp_gpt)) {
+    FAIL("adi_GPT_Init");
+  }
+  if (ADI_GPT_SUCCESS != adi_GPT_SetClockSelect(timestamp_gpt,
+                                                ADI_GPT_CLOCK_SELECT_PCLK)) {
+    FAIL("adi_GPT_SetClockSelect");
+  }
+  if (ADI_GPT_SUCCESS != adi_GPT_SetPrescaler(timestamp_gpt,
+                                              ADI_GPT_PRESCALER_16)) {
+    FAIL("adi_GPT_SetPrescaler");
+  }
+  if (ADI_GPT_SUCCESS != adi_GPT_SetCountMode(timestamp_gpt,
+                                              ADI_GPT_COUNT_UP)) {
+    FAIL("adi_GPT_SetCountMode");
+  }
+  if (ADI_GPT_SUCCESS != adi_GPT_SetFreeRunningMode(timestamp_gpt)) {
+    FAIL("adi_GPT_SetFreeRunningMode");
+  }
+  if (ADI_GPT_SUCCESS != adi_GPT_RegisterCallback(timestamp_gpt,
+                                                  timestamp_Callback, NULL)) {
+    FAIL("adi_GPT_RegisterCallback");
+  }
+
+  // The driver clears the timeout flag before it calls back; nothing may
+  // read the clock in between, so no other interrupt may preempt this one.
+  NVIC_SetPriority(TIMESTAMP_GPT_IRQ, 0);
+
+  if (ADI_GPT_SUCCESS != adi_GPT_SetTimerEnable(timestamp_gpt, true)) {
+    FAIL("adi_GPT_SetTimerEnable");
+  }
+}
+
+uint64_t Timestamp_Now(void) {
+  uint32_t wraps;
+  uint16_t count;
+  uint16_t status;
+
+  // Read again if the timeout interrupt ran in between.
+  do {
+    wraps = timestamp_wraps;
+    count = TIMESTAMP_GPT_REGS->GPTVAL;
+    status = TIMESTAMP_GPT_REGS->GPTSTA;
+  } while (wraps != timestamp_wraps);
+
+  // A wrap whose interrupt has not run yet, because the caller masks it or
+  // preempts it. The flag is read after the count, so a low count means the
+  // count was read after the wrap.
+  if ((status & BITM_GPT_GPTSTA_TMOUT) && count < 0x8000u) {
+    wraps++;
+  }
+  return ((uint64_t) wraps << 16) | count;
+}
+
+uint32_t Timestamp_Now32(void) {
+  return (uint32_t) Timestamp_Now();
+}
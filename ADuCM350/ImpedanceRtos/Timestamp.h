@@ -0,0 +1,32 @@
+#ifndef __TIMESTAMP_H__
+#define __TIMESTAMP_H__
+
+// Free-running microsecond clock for timestamps.
+//
+// General purpose timer TIMESTAMP_GPT counts up from Timestamp_Init() at
+// PCLK / 16, one count per microsecond, and wraps every 65.536 ms.  Its
+// timeout interrupt counts the wraps, which extend the 16-bit count to 48
+// bits (almost 9 years) in a 64-bit value.  Timestamp_Now() reads the timer
+// and the wrap count directly, takes a few cycles and no lock, and is safe
+// from tasks and from interrupt handlers of any priority, even when the
+// timeout interrupt is pending behind them; it only has to run at least once
+// every 32 ms while interrupts are masked.  Timestamp_Now32() is the low 32
+// bits, as carried by telemetry and DFT records, which wrap after 71 minutes
+// but still give correct differences across a wrap.
+
+#include <stdint.h>
+
+// Timer used, and the PCLK frequency it needs for microsecond counts.
+#define TIMESTAMP_GPT ADI_GPT_DEVID_0
+#define TIMESTAMP_GPT_REGS pADI_GPT0
+#define TIMESTAMP_GPT_IRQ TIMER0_IRQn
+#define TIMESTAMP_PCLK_HZ 16000000u
+
+// Opens and starts the timer; call once before the tasks start.
+extern void Timestamp_Init(void);
+
+// Microseconds since Timestamp_Init().
+extern uint64_t Timestamp_Now(void);
+extern uint32_t Timestamp_Now32(void);
+
+#endif  // __TIMESTAMP_H__
@@ -0,0 +1,101 @@
+#include "ImpedanceRtos.h"
+
+#if (APP_TRACE_EN > 0u)
+
+#if (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1u)) != 0
+#error "TRACE_RING_SIZE must be a power of two"
+#endif
+
+// Events per call of the send function, 128 bytes.
+#define TRACE_SEND_EVENTS 16u
+
+static TraceEvent trace_ring[TRACE_RING_SIZE];
+
+// Events recorded since the last dump; the next goes at trace_head modulo
+// TRACE_RING_SIZE.
+static uint32_t trace_head;
+
+// While set, Trace_Record() drops events, so that the dump does not
+// overwrite what it is sending.
+static volatile bool trace_paused;
+
+void Trace_Record(uint8_t type, uint8_t id, uint16_t arg) {
+  TraceEvent *event;
+#if OS_CRITICAL_METHOD == 3u
+  OS_CPU_SR cpu_sr = 0u;
+#endif
+
+  OS_ENTER_CRITICAL();
+  if (!trace_paused) {
+    event = &trace_ring[trace_head & (TRACE_RING_SIZE - 1u)];
+    event->timestamp_us = Timestamp_Now32();
+    event->type = type;
+    event->id = id;
+    event->arg = arg;
+    trace_head++;
+  }
+  OS_EXIT_CRITICAL();
+}
+
+static void trace_SendLine(TraceSendFn send, const char *line) {
+  send((const uint8_t *) line, (uint16_t) strlen(line));
+}
+
+void Trace_Dump(TraceSendFn send) {
+  char line[MSG_MAXLEN];
+  const TraceEvent *event;
+  uint32_t count;
+  uint32_t first;
+  uint32_t i;
+  uint32_t n;
+  uint32_t crc;
+  uint8_t prio;
+
+  trace_paused = true;
+  count = trace_head < TRACE_RING_SIZE ? trace_head : TRACE_RING_SIZE;
+  first = trace_head - count;
+
+  sprintf(line, "TRACE %u %lu\r\n", (unsigned) TRACE_RING_SIZE,
+          (unsigned long) (trace_head - count));
+  trace_SendLine(send, line);
+  for (prio = 0; prio <= OS_LOWEST_PRIO; prio++) {
+    if (OSTCBPrioTbl[prio] != NULL && OSTCBPrioTbl[prio] != OS_TCB_RESERVED) {
+      sprintf(line, "TASK %u %.32s\r\n", (unsigned) prio,
+              (const char *) OSTCBPrioTbl[prio]->OSTCBTaskName);
+      trace_SendLine(send, line);
+    }
+  }
+  for (i = 0; i < OS_MAX_EVENTS; i++) {
+    if (OSEventTbl[i].OSEventType != OS_EVENT_TYPE_UNUSED
+        && OSEventTbl[i].OSEventName[0] != '?') {
+      sprintf(line, "EVENT %lu %.32s\r\n", (unsigned long) i,
+              (const char *) OSEventTbl[i].OSEventName);
+      trace_SendLine(send, line);
+    }
+  }
+  sprintf(line, "RECORDS %lu\r\n", (unsigned long) count);
+  trace_SendLine(send, line);
+
+  // Oldest first, in runs that do not cross the end of the ring.
+  crc = 0;
+  for (i = 0; i < count; i += n) {
+    event = &trace_ring[(first + i) & (TRACE_RING_SIZE - 1u)];
+    n = TRACE_RING_SIZE - ((first + i) & (TRACE_RING_SIZE - 1u));
+    if (n > count - i) {
+      n = count - i;
+    }
+    if (n > TRACE_SEND_EVENTS) {
+      n = TRACE_SEND_EVENTS;
+    }
+    crc = CrcService_Crc32Soft(crc, (const uint8_t *) event,
+                               n * sizeof(TraceEvent));
+    send((const uint8_t *) event, (uint16_t) (n * sizeof(TraceEvent)));
+  }
+  sprintf(line, "END %08lx\r\n", (unsigned long) crc);
+  trace_SendLine(send, line);
+
+  trace_head = 0;
+  trace_paused = false;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+// Flight recorder for task switches, interrupts and inter-task events.
+//
+// Each event is 8 bytes in a RAM ring of TRACE_RING_SIZE: the Timestamp.h
+// microsecond clock (low 32 bits), a type, an id and a 16-bit argument.
+// Once full, the ring overwrites its oldest events, so it always holds the
+// last TRACE_RING_SIZE of them; recording takes a critical section of a few
+// dozen cycles and never blocks.  The events come from:
+//
+//   - App_TaskSwHook(): TRACE_TASK_SWITCH, id the priority switched in, arg
+//     the one switched out;
+//   - App_TimeTickHook(): TRACE_TICK;
+//   - the OSAL interrupt wrapper, _adi_osal_stdWrapper(), around every
+//     driver handler: TRACE_ISR_ENTER and TRACE_ISR_EXIT, id the exception
+//     number (16 + IRQn);
+//   - the tasks and callbacks themselves, as uC/OS-II has no hooks for
+//     them: TRACE_SEM_POST and TRACE_SEM_PEND, id the index of the event in
+//     OSEventTbl, arg its count before the call (a pend on 0 blocks); and
+//     TRACE_QUEUE_POST and TRACE_QUEUE_PEND (a record taken off), id one of
+//     TRACE_QUEUE_*, arg the queue depth after the call.
+//
+// Trace_Dump() stops recording, sends the ring oldest first through a send
+// function, empties it and starts again.  The dump is text lines, then the
+// raw events:
+//
+//   TRACE <ring size> <events overwritten since the last dump>
+//   TASK <priority> <name>          one per task
+//   EVENT <index> <name>            one per named semaphore, mutex or queue
+//   RECORDS <count>
+//   <count events of 8 bytes, little-endian, as TraceEvent>
+//   END <CRC-32 of the events, 8 hex digits>
+//
+// with "\r\n" line ends.  tools/tracedump.cpp turns it into a Chrome trace.
+// APP_TRACE_EN (os_cfg.h) is 0 unless the build sets it, as the Debug
+// configuration does; all of it is left out then, and the TRACE_* macros
+// compile to nothing.
+
+#include <stdint.h>
+
+#ifndef APP_TRACE_EN
+#define APP_TRACE_EN 0u
+#endif
+
+// Events kept; a power of two.  8 bytes each.
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 512u
+#endif
+
+// Event types.
+#define TRACE_TASK_SWITCH 1
+#define TRACE_ISR_ENTER 2
+#define TRACE_ISR_EXIT 3
+#define TRACE_TICK 4
+#define TRACE_SEM_POST 5
+#define TRACE_SEM_PEND 6
+#define TRACE_QUEUE_POST 7
+#define TRACE_QUEUE_PEND 8
+
+// Queue ids.
+#define TRACE_QUEUE_DFT_RING 0
+#define TRACE_QUEUE_TELEMETRY_RING 1
+
+typedef struct {
+  uint32_t timestamp_us;
+  uint8_t type;
+  uint8_t id;
+  uint16_t arg;
+} TraceEvent;
+
+// Gets the dump, at most 128 bytes at a time.
+typedef void (*TraceSendFn)(const uint8_t *data, uint16_t size);
+
+// From tasks and interrupt handlers, with interrupts enabled or not.
+extern void Trace_Record(uint8_t type, uint8_t id, uint16_t arg);
+
+// From one task at a time.
+extern void Trace_Dump(TraceSendFn send);
+
+#if (APP_TRACE_EN > 0u)
+#define TRACE_EVENT(type, id, arg) \
+  Trace_Record((type), (uint8_t) (id), (uint16_t) (arg))
+#define TRACE_SEM(type, event)                                    \
+  Trace_Record((type), (uint8_t) ((event) - OSEventTbl),          \
+               (uint16_t) (event)->OSEventCnt)
+#else
+#define TRACE_EVENT(type, id, arg)
+#define TRACE_SEM(type, event)
+#endif
+
+#endif  // __TRACE_H__
@@ -111,6 +111,7 @@ void UX_Button_Callback(void *pCBParam, uint32_t nEvent, void *EventArg) {
 
   ux_is_engaged = true;
   printf("UX: button pressed. Signaling semaphore.\n");
+  TRACE_SEM(TRACE_SEM_POST, ux_button_semaphore);
   OSSemPost(ux_button_semaphore);
 }
 
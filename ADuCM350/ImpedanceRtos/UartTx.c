@@ -0,0 +1,55 @@
+#include <string.h>
+
+#include "UartTx.h"
+
+void UartTx_Init(UartTx *tx, UartTxWriteFn write, void *context) {
+  memset(tx, 0, sizeof(*tx));
+  tx->write = write;
+  tx->context = context;
+}
+
+bool UartTx_Append(UartTx *tx, const void *data, uint16_t size) {
+  if (size > UART_TX_BUFFER_SIZE - tx->fill_length) {
+    // Never wait for the transport; drop the record instead.
+    tx->overflow_count++;
+    tx->overflow_bytes += size;
+    return false;
+  }
+
+  memcpy(&tx->buffer[tx->fill_index][tx->fill_length], data, size);
+  tx->fill_length += size;
+  if (tx->fill_length > tx->high_water) {
+    tx->high_water = tx->fill_length;
+  }
+  return true;
+}
+
+void UartTx_Service(UartTx *tx) {
+  uint16_t sent;
+
+  while (true) {
+    if (tx->drain_remaining == 0) {
+      if (tx->fill_length == 0) {
+        return;
+      }
+
+      // The drain buffer is done; swap so producers fill the other one.
+      tx->drain = tx->buffer[tx->fill_index];
+      tx->drain_remaining = tx->fill_length;
+      tx->fill_index ^= 1;
+      tx->fill_length = 0;
+    }
+
+    sent = tx->write(tx->context, tx->drain, tx->drain_remaining);
+    if (sent == 0) {
+      return;
+    }
+    tx->drain += sent;
+    tx->drain_remaining -= sent;
+    tx->bytes_sent += sent;
+  }
+}
+
+uint32_t UartTx_Pending(const UartTx *tx) {
+  return (uint32_t) tx->drain_remaining + tx->fill_length;
+}
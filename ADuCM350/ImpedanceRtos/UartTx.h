@@ -0,0 +1,58 @@
+#ifndef __UART_TX_H__
+#define __UART_TX_H__
+
+// Non-blocking, double-buffered transmit service for the data UART.
+//
+// Producers append complete records (lines or telemetry frames) to the fill
+// buffer and never wait: a record that does not fit is dropped as a whole and
+// counted.  UartTx_Service() hands the other (drain) buffer to the transport,
+// and swaps buffers once the drain buffer has been fully accepted.
+//
+// The transport is a write function that accepts as many bytes as it can
+// without blocking and returns that count.  On the device it is the UART
+// driver in non-blocking interrupt mode; on a host it can be any stand-in.
+// Like the rest of this directory's pure logic, this file depends on the C
+// standard library only.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of each of the two buffers, in bytes.
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 256
+#endif
+
+typedef uint16_t (*UartTxWriteFn)(void *context, const uint8_t *data,
+                                  uint16_t size);
+
+typedef struct {
+  uint8_t buffer[2][UART_TX_BUFFER_SIZE];
+  uint8_t fill_index;          // Buffer that producers append to.
+  uint16_t fill_length;        // Bytes in the fill buffer.
+  const uint8_t *drain;        // Next byte of the drain buffer to send.
+  uint16_t drain_remaining;    // Bytes of the drain buffer not yet sent.
+
+  UartTxWriteFn write;
+  void *context;
+
+  // Statistics.
+  uint32_t bytes_sent;
+  uint32_t overflow_count;     // Records dropped because the buffer was full.
+  uint32_t overflow_bytes;     // Bytes in those records.
+  uint16_t high_water;         // Largest fill level seen, in bytes.
+} UartTx;
+
+extern void UartTx_Init(UartTx *tx, UartTxWriteFn write, void *context);
+
+// Queues a record for transmission.  Returns false, and counts an overflow,
+// if the record does not fit in the fill buffer.
+extern bool UartTx_Append(UartTx *tx, const void *data, uint16_t size);
+
+// Moves as much data as the transport accepts right now.
+extern void UartTx_Service(UartTx *tx);
+
+// Bytes queued but not yet accepted by the transport.
+extern uint32_t UartTx_Pending(const UartTx *tx);
+
+#endif  // __UART_TX_H__
@@ -17,6 +17,7 @@
 */
 
 #include <includes.h>
+#include "Trace.h"
 
 /*
 *********************************************************************************************************
@@ -174,6 +175,9 @@ void App_TaskSwHook(void) {
 #if (APP_CFG_PROBE_OS_PLUGIN_EN > 0) && (OS_PROBE_HOOKS_EN > 0)
   OSProbe_TaskSwHook();
 #endif
+#if (APP_TRACE_EN > 0)
+  Trace_Record(TRACE_TASK_SWITCH, OSTCBHighRdy->OSTCBPrio, OSTCBCur->OSTCBPrio);
+#endif
 }
 #endif
 
@@ -208,6 +212,31 @@ void App_TimeTickHook(void) {
 #if (APP_CFG_PROBE_OS_PLUGIN_EN == DEF_ENABLED) && (OS_PROBE_HOOKS_EN > 0)
   OSProbe_TickHook();
 #endif
+#if (APP_TRACE_EN > 0)
+  Trace_Record(TRACE_TICK, 0, 0);
+#endif
 }
 #endif
 #endif
+
+#if (APP_TRACE_EN > 0)
+/*******************************************************************************
+*                                     INTERRUPT HOOKS (APPLICATION)
+*
+* Description : These functions are called by the OSAL interrupt wrapper,
+*               _adi_osal_stdWrapper(), before and after every driver handler.
+*               uC/OS-II itself has no interrupt hooks.
+*
+* Argument(s) : irq     is the exception number of the interrupt (16 + IRQn).
+*
+* Note(s)     : (1) Interrupts are enabled during these calls.
+*******************************************************************************/
+
+void App_TraceIsrEnter(uint32_t irq) {
+  Trace_Record(TRACE_ISR_ENTER, (uint8_t)irq, 0);
+}
+
+void App_TraceIsrExit(uint32_t irq) {
+  Trace_Record(TRACE_ISR_EXIT, (uint8_t)irq, 0);
+}
+#endif
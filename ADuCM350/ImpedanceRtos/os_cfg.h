@@ -30,6 +30,9 @@
 
                                        /* ---------------------- MISCELLANEOUS ----------------------- */
 #define OS_APP_HOOKS_EN           1u   /* Application-defined hooks are called from the uC/OS-II hooks */
+#ifndef APP_TRACE_EN                   /* Set by the Debug configuration, or with -DAPP_TRACE_EN=1u    */
+#define APP_TRACE_EN              0u   /* Record task switches, ISRs and events (see Trace.h)          */
+#endif
 #define OS_ARG_CHK_EN             1u   /* Enable (1) or Disable (0) argument checking                  */
 #define OS_CPU_HOOKS_EN           1u   /* uC/OS-II hooks are found in the processor port files         */
 
@@ -41,7 +44,7 @@
 #define OS_LOWEST_PRIO           10u   /* Defines the lowest priority that can be assigned ...         */
                                        /* ... MUST NEVER be higher than 254!                           */
 
-#define OS_MAX_EVENTS            10u   /* Max. number of event control blocks in your application      */
+#define OS_MAX_EVENTS            12u   /* Max. number of event control blocks in your application      */
 #define OS_MAX_FLAGS              2u   /* Max. number of Event Flag Groups    in your application      */
 #define OS_MAX_MEM_PART           2u   /* Max. number of memory partitions                             */
 #define OS_MAX_QS                 8u   /* Max. number of queue control blocks in your application      */
@@ -0,0 +1,583 @@
+// The AFE of the ADuCM350 on the host; see AfeSim.h.
+
+#include "AfeSim.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "afe_seqcrc.h"
+
+#define FIFO_SIZE 8
+#define CYCLE_NS 62.5
+
+// Sequencer commands: a register write, or a wait in AFE clock cycles.
+#define COMMAND_WRITE 0x80000000u
+#define COMMAND_OFFSET(command) (((command) >> 23) & 0xFCu)
+#define COMMAND_VALUE(command) ((command) & 0xFFFFFFu)
+#define COMMAND_WAIT(command) ((command) & 0x3FFFFFFFu)
+
+// Reserved in every interrupt status register: it is set whenever the
+// register is published, so a write by the program shows as its absence.
+#define INT_PUBLISHED 0x80000000u
+
+// Any AFE register, read-only ones included, from the AFE's side.
+#define AFE_REGISTER(offset) \
+  (*(volatile uint32_t *) ((uintptr_t) pADI_AFE + (offset)))
+
+#define DATA_SOURCE_DFT (2u << BITP_AFE_AFE_FIFO_CFG_DATA_FIFO_SOURCE_SEL)
+
+// The supply channel, as the calibrations in afe_lib.c scale it: 1.6 V over
+// the 12-bit DAC, 1/40 of it through the attenuator, and the ADC at unity
+// gain.
+#define DAC_VOLTS_PER_CODE (1.6 / 4095.0)
+#define DAC_ATTENUATION (1.0 / 40.0)
+#define ADC_CODES_PER_VOLT (65535.0 * 1.5 / 3.6)
+#define VREF_VOLTS 0.7
+#define MUX_TIA 0x02u               // TIA output.
+#define MUX_VREF 0x19u              // Vref - Vbias.
+#define MUX_RCAL 0x1Eu              // Across RCAL.
+
+typedef enum {
+  GROUP_CAPTURE,
+  GROUP_GENERATE,
+  GROUP_CMD_FIFO,
+  GROUP_DATA_FIFO,
+  GROUPS
+} AfeSimGroup;
+
+static const size_t int_offsets[GROUPS] = {
+  offsetof(ADI_AFE_TypeDef, AFE_ANALOG_CAPTURE_INT),
+  offsetof(ADI_AFE_TypeDef, AFE_ANALOG_GEN_INT),
+  offsetof(ADI_AFE_TypeDef, AFE_CMD_FIFO_INT),
+  offsetof(ADI_AFE_TypeDef, AFE_DATA_FIFO_INT),
+};
+
+static const size_t ien_offsets[GROUPS] = {
+  offsetof(ADI_AFE_TypeDef, AFE_ANALOG_CAPTURE_IEN),
+  offsetof(ADI_AFE_TypeDef, AFE_ANALOG_GEN_IEN),
+  offsetof(ADI_AFE_TypeDef, AFE_CMD_FIFO_IEN),
+  offsetof(ADI_AFE_TypeDef, AFE_DATA_FIFO_IEN),
+};
+
+static const int irqs[GROUPS] = {
+  AFE_CAPTURE_IRQn, AFE_GENERATE_IRQn, AFE_CMD_FIFO_IRQn, AFE_DATA_FIFO_IRQn,
+};
+
+typedef struct {
+  uint32_t words[FIFO_SIZE];
+  unsigned head;
+  unsigned count;
+} AfeSimFifo;
+
+static AfeSimConfig config;
+static AfeSimStats stats;
+
+// Register values as last published, to tell the program's writes.
+static uint32_t shadow_cfg;
+static uint32_t shadow_seq_cfg;
+static uint32_t shadow_fifo_cfg;
+static uint32_t shadow_seq_count;
+
+static uint32_t status[GROUPS];
+static bool levels[GROUPS];
+
+static AfeSimFifo cmd_fifo;
+static AfeSimFifo data_fifo;
+
+static bool seq_on;
+static uint64_t seq_at = CHIP_SIM_NEVER;  // Next command; never if stalled.
+static uint8_t seq_crc;
+static uint32_t seq_count;
+
+static bool dft_on;
+static uint64_t dft_at = CHIP_SIM_NEVER;
+static bool dft_rcal;
+
+static double *replay;                    // Real and imaginary, in turn.
+static size_t replay_count;
+static size_t replay_next;
+
+static uint64_t random_state;
+static AfeSimResult truth[AFE_SIM_TRUTH_SIZE];
+
+static uint64_t afeSim_Time(double ns) {
+  uint64_t time = (uint64_t) llround(ns / config.afe_speed);
+
+  return time > 0 ? time : 1;
+}
+
+static void afeSim_Push(AfeSimFifo *fifo, uint32_t word) {
+  fifo->words[(fifo->head + fifo->count) % FIFO_SIZE] = word;
+  fifo->count++;
+}
+
+static uint32_t afeSim_Pop(AfeSimFifo *fifo) {
+  uint32_t word = fifo->words[fifo->head];
+
+  fifo->head = (fifo->head + 1) % FIFO_SIZE;
+  fifo->count--;
+  return word;
+}
+
+static uint32_t afeSim_Ien(AfeSimGroup group) {
+  return AFE_REGISTER(ien_offsets[group]);
+}
+
+static void afeSim_Raise(AfeSimGroup group, uint32_t bits, uint64_t at) {
+  status[group] |= bits;
+  if (!levels[group] && (status[group] & afeSim_Ien(group))) {
+    levels[group] = true;
+    ChipSim_IrqLevel(irqs[group], true, at);
+  }
+}
+
+// After the program cleared status bits or changed the enables.
+static void afeSim_Levels(uint64_t now) {
+  AfeSimGroup group;
+  bool level;
+
+  for (group = GROUP_CAPTURE; group < GROUPS; group++) {
+    level = (status[group] & afeSim_Ien(group)) != 0;
+    if (level != levels[group]) {
+      levels[group] = level;
+      ChipSim_IrqLevel(irqs[group], level, now);
+    }
+  }
+}
+
+// FULL and EMPTY stay set as long as the FIFO is.
+static void afeSim_FifoStatus(uint64_t at) {
+  if (cmd_fifo.count == FIFO_SIZE) {
+    afeSim_Raise(GROUP_CMD_FIFO, BITM_AFE_AFE_CMD_FIFO_INT_CMD_FIFO_FULL, at);
+  } else if (cmd_fifo.count == 0) {
+    afeSim_Raise(GROUP_CMD_FIFO, BITM_AFE_AFE_CMD_FIFO_INT_CMD_FIFO_EMPTY, at);
+  }
+  if (data_fifo.count == FIFO_SIZE) {
+    afeSim_Raise(GROUP_DATA_FIFO, BITM_AFE_AFE_DATA_FIFO_INT_DATA_FIFO_FULL,
+                 at);
+  } else if (data_fifo.count == 0) {
+    afeSim_Raise(GROUP_DATA_FIFO, BITM_AFE_AFE_DATA_FIFO_INT_DATA_FIFO_EMPTY,
+                 at);
+  }
+}
+
+// The DMA requests: commands in while there is room, data out while there
+// is any.
+static void afeSim_Dma(uint64_t at) {
+  const uint32_t cmd_dma = BITM_AFE_AFE_FIFO_CFG_CMD_FIFO_EN
+                           | BITM_AFE_AFE_FIFO_CFG_CMD_FIFO_DMA_REQ_EN;
+  const uint32_t data_dma = BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN
+                            | BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_DMA_REQ_EN;
+  uint32_t word;
+
+  if ((shadow_fifo_cfg & cmd_dma) == cmd_dma) {
+    while (cmd_fifo.count < FIFO_SIZE
+           && ChipSim_DmaRead(AFE_TX_CHANn, &word, at)) {
+      afeSim_Push(&cmd_fifo, word);
+      if (seq_on && seq_at == CHIP_SIM_NEVER) {
+        seq_at = at;
+      }
+    }
+  }
+  if ((shadow_fifo_cfg & data_dma) == data_dma) {
+    while (data_fifo.count > 0
+           && ChipSim_DmaWrite(AFE_RX_CHANn, data_fifo.words[data_fifo.head],
+                               at)) {
+      afeSim_Pop(&data_fifo);
+    }
+  }
+  afeSim_FifoStatus(at);
+}
+
+static void afeSim_WriteFifoCfg(uint32_t value) {
+  if (!(value & BITM_AFE_AFE_FIFO_CFG_CMD_FIFO_EN)) {
+    cmd_fifo.count = 0;
+  }
+  if (!(value & BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN)) {
+    data_fifo.count = 0;
+  }
+  shadow_fifo_cfg = value;
+}
+
+// The DAC output, in volts from mid-scale: the code, corrected by half the
+// signed 12-bit offset calibration of the current attenuator setting, as
+// adi_AFE_ExciteChanCalAtten() and ...NoAtten() write it.  0 if the D
+// switches leave it unconnected.
+static double afeSim_DacVolts(void) {
+  bool atten = (pADI_AFE->AFE_DAC_CFG & BITM_AFE_AFE_DAC_CFG_DAC_ATTEN_EN) != 0;
+  uint32_t offset = (atten ? pADI_AFE->AFE_DAC_OFFSET_ATTEN
+                           : pADI_AFE->AFE_DAC_OFFSET_UNITY) & 0xFFFu;
+  int32_t code = (int32_t) (pADI_AFE->AFE_WG_DAC_CODE
+                            & BITM_AFE_AFE_WG_DAC_CODE_DAC_CODE);
+
+  if ((pADI_AFE->AFE_SW_CFG & BITM_AFE_AFE_SW_CFG_DMUX_STATE) == 0) {
+    return 0.0;
+  }
+  code += ((int32_t) (offset << 20) >> 20) / 2;
+  return (code - 0x800) * DAC_VOLTS_PER_CODE * (atten ? DAC_ATTENUATION : 1.0);
+}
+
+// The supply rejection filter settles, long before the calibrations read it,
+// on what an ideal ADC reads on MUX_SEL: Vref less Vbias, the DAC across
+// RCAL, the DAC through RCAL into the TIA, which inverts it, or nothing.
+static void afeSim_Supply(void) {
+  double volts;
+  double code;
+
+  switch (pADI_AFE->AFE_ADC_CFG & BITM_AFE_AFE_ADC_CFG_MUX_SEL) {
+    case MUX_VREF:
+      volts = VREF_VOLTS;
+      break;
+    case MUX_RCAL:
+      volts = afeSim_DacVolts();
+      break;
+    case MUX_TIA:
+      volts = -afeSim_DacVolts();
+      break;
+    default:
+      volts = 0.0;
+      break;
+  }
+  code = round(0x8000 + volts * ADC_CODES_PER_VOLT);
+  pADI_AFE->AFE_SUPPLY_LPF_RESULT =
+      (uint32_t) (code < 0.0 ? 0.0 : code > 65535.0 ? 65535.0 : code);
+}
+
+// The DFT runs while the ADC converts and the DFT is enabled, and measures
+// what the switch matrix connects when it starts.
+static void afeSim_WriteCfg(uint32_t value, uint64_t at) {
+  const uint32_t dft = BITM_AFE_AFE_CFG_ADC_CONV_EN | BITM_AFE_AFE_CFG_DFT_EN;
+  const uint32_t supply = BITM_AFE_AFE_CFG_ADC_CONV_EN
+                          | BITM_AFE_AFE_CFG_SUPPLY_LPF_EN;
+  bool on = (value & dft) == dft;
+
+  if ((value & supply) == supply && (shadow_cfg & supply) != supply) {
+    afeSim_Supply();
+  }
+
+  if (on && !dft_on) {
+    dft_at = at + afeSim_Time(config.dft_ns);
+    dft_rcal = pADI_AFE->AFE_SW_CFG == config.rcal_switches;
+  } else if (!on) {
+    dft_at = CHIP_SIM_NEVER;
+  }
+  dft_on = on;
+  shadow_cfg = value;
+}
+
+static void afeSim_WriteSeqCfg(uint32_t value, bool by_sequencer,
+                               uint64_t at) {
+  bool on = (value & BITM_AFE_AFE_SEQ_CFG_SEQ_EN) != 0;
+
+  if (on && !seq_on) {
+    seq_at = at;
+    stats.sequences++;
+  } else if (!on && seq_on) {
+    seq_at = CHIP_SIM_NEVER;
+    if (by_sequencer) {
+      afeSim_Raise(GROUP_CMD_FIFO, BITM_AFE_AFE_CMD_FIFO_INT_END_OF_SEQ, at);
+    }
+  }
+  seq_on = on;
+  shadow_seq_cfg = value;
+}
+
+// What the program wrote since the last call, all taken as written now.
+static void afeSim_Writes(uint64_t now) {
+  AfeSimGroup group;
+  uint32_t value;
+
+  for (group = GROUP_CAPTURE; group < GROUPS; group++) {
+    value = AFE_REGISTER(int_offsets[group]);
+    if (!(value & INT_PUBLISHED)) {
+      status[group] &= ~value;
+    }
+  }
+  if (pADI_AFE->AFE_SEQ_COUNT != shadow_seq_count) {
+    seq_count = 0;
+    seq_crc = ADI_AFE_SEQ_CRC8_INITIAL;
+  }
+  if (pADI_AFE->AFE_FIFO_CFG != shadow_fifo_cfg) {
+    afeSim_WriteFifoCfg(pADI_AFE->AFE_FIFO_CFG);
+  }
+  if (pADI_AFE->AFE_CFG != shadow_cfg) {
+    afeSim_WriteCfg(pADI_AFE->AFE_CFG, now);
+  }
+  if (pADI_AFE->AFE_SEQ_CFG != shadow_seq_cfg) {
+    afeSim_WriteSeqCfg(pADI_AFE->AFE_SEQ_CFG, false, now);
+  }
+  afeSim_Levels(now);
+}
+
+// One sequencer command, or the sequencer finding the FIFO empty.
+static void afeSim_Step(uint64_t at) {
+  uint32_t command, offset;
+
+  if (cmd_fifo.count == 0) {
+    stats.cmd_starvations++;
+    seq_at = CHIP_SIM_NEVER;
+    if (shadow_seq_cfg & BITM_AFE_AFE_SEQ_CFG_SEQ_STOP_ON_FIFO_EMPTY) {
+      pADI_AFE->AFE_SEQ_CFG = shadow_seq_cfg & ~BITM_AFE_AFE_SEQ_CFG_SEQ_EN;
+      afeSim_WriteSeqCfg(pADI_AFE->AFE_SEQ_CFG, true, at);
+    } else {
+      afeSim_Raise(GROUP_CMD_FIFO, BITM_AFE_AFE_CMD_FIFO_INT_CMD_FIFO_UDF, at);
+    }
+    return;
+  }
+
+  command = afeSim_Pop(&cmd_fifo);
+  stats.commands++;
+  seq_crc = adi_AFE_SeqCrc8Word(seq_crc, command);
+  seq_count++;
+  if (!(command & COMMAND_WRITE)) {
+    seq_at = at + afeSim_Time(COMMAND_WAIT(command) * CYCLE_NS);
+    return;
+  }
+
+  seq_at = at + afeSim_Time(CYCLE_NS);
+  offset = COMMAND_OFFSET(command);
+  if (offset == int_offsets[GROUP_CAPTURE]
+      || offset == int_offsets[GROUP_GENERATE]
+      || offset == int_offsets[GROUP_CMD_FIFO]
+      || offset == int_offsets[GROUP_DATA_FIFO]) {
+    status[(offset - int_offsets[GROUP_CAPTURE]) / 4] &= ~COMMAND_VALUE(command);
+    return;
+  }
+  AFE_REGISTER(offset) = COMMAND_VALUE(command);
+  if (offset == offsetof(ADI_AFE_TypeDef, AFE_CFG)) {
+    afeSim_WriteCfg(COMMAND_VALUE(command), at);
+  } else if (offset == offsetof(ADI_AFE_TypeDef, AFE_SEQ_CFG)) {
+    afeSim_WriteSeqCfg(COMMAND_VALUE(command), true, at);
+  } else if (offset == offsetof(ADI_AFE_TypeDef, AFE_FIFO_CFG)) {
+    afeSim_WriteFifoCfg(COMMAND_VALUE(command));
+  }
+}
+
+static double afeSim_Random(void) {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return ((random_state * 0x2545F4914F6CDD1Dull) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double afeSim_Noise(void) {
+  double u = afeSim_Random();
+
+  if (config.noise <= 0.0) {
+    return 0.0;
+  }
+  return config.noise * sqrt(-2.0 * log(u > 0.0 ? u : 1e-300))
+         * cos(2.0 * M_PI * afeSim_Random());
+}
+
+static int16_t afeSim_Counts(double value) {
+  value = round(value + afeSim_Noise());
+  return (int16_t) (value > INT16_MAX ? INT16_MAX
+                    : value < INT16_MIN ? INT16_MIN : value);
+}
+
+// The body as the DFT sees it at time at.
+static void afeSim_Body(uint64_t at, double *real, double *imag) {
+  double beat, pulse, ohms, counts, phase;
+
+  if (replay_count > 0) {
+    *real = replay[2 * replay_next];
+    *imag = replay[2 * replay_next + 1];
+    replay_next = (replay_next + 1) % replay_count;
+    return;
+  }
+  // A quick rise and a slower fall, at 20% of each beat.
+  beat = fmod(at / 1e9 * config.heart_bpm / 60.0, 1.0);
+  pulse = exp(-0.5 * pow((beat - 0.2) / (beat < 0.2 ? 0.05 : 0.12), 2));
+  ohms = config.z_ohms - config.z_pulse_ohms * pulse;
+  counts = config.rcal_counts * config.rcal_ohms / ohms;
+  phase = (config.rcal_phase_deg + config.z_phase_deg) * M_PI / 180.0;
+  *real = counts * cos(phase);
+  *imag = counts * sin(phase);
+}
+
+static void afeSim_Dft(uint64_t at) {
+  AfeSimResult *result = &truth[stats.dfts % AFE_SIM_TRUTH_SIZE];
+  double real, imag;
+
+  if (dft_rcal) {
+    real = config.rcal_counts * cos(config.rcal_phase_deg * M_PI / 180.0);
+    imag = config.rcal_counts * sin(config.rcal_phase_deg * M_PI / 180.0);
+  } else {
+    afeSim_Body(at, &real, &imag);
+  }
+  result->at = at;
+  result->rcal = dft_rcal;
+  result->real = afeSim_Counts(real);
+  result->imag = afeSim_Counts(imag);
+  stats.dfts++;
+
+  pADI_AFE->AFE_DFT_RESULT_REAL = (uint32_t) (int32_t) result->real;
+  pADI_AFE->AFE_DFT_RESULT_IMAG = (uint32_t) (int32_t) result->imag;
+  afeSim_Raise(GROUP_CAPTURE, BITM_AFE_AFE_ANALOG_CAPTURE_INT_DFT_RESULT_READY,
+               at);
+  if ((shadow_fifo_cfg & BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN)
+      && (shadow_fifo_cfg & BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_SOURCE_SEL)
+             == DATA_SOURCE_DFT) {
+    if (data_fifo.count + 2 > FIFO_SIZE) {
+      stats.data_overflows++;
+      afeSim_Raise(GROUP_DATA_FIFO, BITM_AFE_AFE_DATA_FIFO_INT_DATA_FIFO_OVF,
+                   at);
+    } else {
+      afeSim_Push(&data_fifo, (uint32_t) (int32_t) result->real);
+      afeSim_Push(&data_fifo, (uint32_t) (int32_t) result->imag);
+      stats.results_pushed++;
+    }
+  }
+
+  // The next DFT starts straight away.
+  dft_at = at + afeSim_Time(config.dft_ns);
+  dft_rcal = pADI_AFE->AFE_SW_CFG == config.rcal_switches;
+}
+
+static void afeSim_Publish(void) {
+  AfeSimGroup group;
+
+  for (group = GROUP_CAPTURE; group < GROUPS; group++) {
+    AFE_REGISTER(int_offsets[group]) = status[group] | INT_PUBLISHED;
+  }
+  AFE_REGISTER(offsetof(ADI_AFE_TypeDef, AFE_SEQ_CRC)) = seq_crc;
+  pADI_AFE->AFE_SEQ_COUNT = seq_count;
+  shadow_seq_count = seq_count;
+  AFE_REGISTER(offsetof(ADI_AFE_TypeDef, AFE_DATA_FIFO_READ)) =
+      data_fifo.count > 0 ? data_fifo.words[data_fifo.head] : 0u;
+}
+
+// Writes first: everything the AFE did since the last call comes after,
+// but nothing it did has reached the program yet.
+static uint64_t afeSim_Sync(uint64_t now) {
+  uint64_t at;
+
+  afeSim_Writes(now);
+  afeSim_Dma(now);
+  for (;;) {
+    if (seq_on && seq_at <= now && seq_at <= dft_at) {
+      at = seq_at;
+      afeSim_Step(at);
+    } else if (dft_at <= now) {
+      at = dft_at;
+      afeSim_Dft(at);
+    } else {
+      break;
+    }
+    afeSim_Dma(at);
+  }
+  afeSim_Publish();
+  afeSim_Levels(now);
+  return seq_on && seq_at < dft_at ? seq_at : dft_at;
+}
+
+static bool afeSim_LoadReplay(const char *path) {
+  FILE *file = fopen(path, "r");
+  char line[256];
+  double a, b, c, counts, phase;
+  size_t capacity = 0;
+
+  if (file == NULL) {
+    fprintf(stderr, "AfeSim: can't open %s\n", path);
+    return false;
+  }
+  replay_count = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (replay_count == capacity) {
+      capacity = capacity ? 2 * capacity : 1024;
+      replay = realloc(replay, 2 * capacity * sizeof(*replay));
+    }
+    switch (sscanf(line, "%lf %lf %lf", &a, &b, &c)) {
+      case 2:
+        replay[2 * replay_count] = a;
+        replay[2 * replay_count + 1] = b;
+        break;
+      case 3:
+        // As the body would read against RCAL: see MainTask.
+        if (b <= 0.0) {
+          continue;
+        }
+        counts = config.rcal_counts * config.rcal_ohms / b;
+        phase = (config.rcal_phase_deg + c) * M_PI / 180.0;
+        replay[2 * replay_count] = counts * cos(phase);
+        replay[2 * replay_count + 1] = counts * sin(phase);
+        break;
+      default:
+        continue;
+    }
+    replay_count++;
+  }
+  fclose(file);
+  if (replay_count == 0) {
+    fprintf(stderr, "AfeSim: no results in %s\n", path);
+    return false;
+  }
+  return true;
+}
+
+void AfeSim_Defaults(AfeSimConfig *config) {
+  // RCAL and the body as the evaluation board and the cuff see them.
+  config->afe_speed = 1.0;
+  config->dft_ns = 12.8e6;
+  config->rcal_switches = 0x8811;
+  config->rcal_ohms = 1000.0;
+  config->rcal_counts = 20000.0;
+  config->rcal_phase_deg = -30.0;
+  config->z_ohms = 1200.0;
+  config->z_pulse_ohms = 3.0;
+  config->z_phase_deg = -2.0;
+  config->heart_bpm = 72.0;
+  config->noise = 2.0;
+  config->replay_path = NULL;
+}
+
+bool AfeSim_Init(const AfeSimConfig *new_config) {
+  AfeSimGroup group;
+
+  config = *new_config;
+  memset(&stats, 0, sizeof(stats));
+  memset(status, 0, sizeof(status));
+  memset(levels, 0, sizeof(levels));
+  memset(&cmd_fifo, 0, sizeof(cmd_fifo));
+  memset(&data_fifo, 0, sizeof(data_fifo));
+  seq_on = false;
+  seq_at = CHIP_SIM_NEVER;
+  seq_crc = ADI_AFE_SEQ_CRC8_INITIAL;
+  seq_count = 0;
+  dft_on = false;
+  dft_at = CHIP_SIM_NEVER;
+  random_state = 0x9E3779B97F4A7C15ull;
+  free(replay);
+  replay = NULL;
+  replay_count = 0;
+  replay_next = 0;
+  if (config.replay_path != NULL && !afeSim_LoadReplay(config.replay_path)) {
+    return false;
+  }
+
+  shadow_cfg = pADI_AFE->AFE_CFG;
+  shadow_seq_cfg = pADI_AFE->AFE_SEQ_CFG;
+  shadow_fifo_cfg = pADI_AFE->AFE_FIFO_CFG;
+  for (group = GROUP_CAPTURE; group < GROUPS; group++) {
+    AFE_REGISTER(int_offsets[group]) = INT_PUBLISHED;
+  }
+  afeSim_Publish();
+  ChipSim_Add(afeSim_Sync);
+  return true;
+}
+
+const AfeSimStats *AfeSim_Stats(void) {
+  return &stats;
+}
+
+bool AfeSim_Result(uint64_t n, AfeSimResult *result) {
+  if (n >= stats.dfts || stats.dfts - n > AFE_SIM_TRUTH_SIZE) {
+    return false;
+  }
+  *result = truth[n % AFE_SIM_TRUTH_SIZE];
+  return true;
+}
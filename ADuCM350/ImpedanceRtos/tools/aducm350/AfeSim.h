@@ -0,0 +1,93 @@
+#ifndef __AFE_SIM_H__
+#define __AFE_SIM_H__
+
+// The AFE of the ADuCM350 on the host (see ChipSim.h): the sequencer and
+// its command FIFO, the DFT, the data FIFO, their DMA requests and their
+// interrupts, behind the AFE registers that afe.c programs.  With it, the
+// unmodified afe.c, adi_AFE_RunSequence() and this project's DFT callbacks
+// run on the host, for throughput and latency benchmarks.
+//
+// The sequencer takes one command per cycle of the 16 MHz AFE clock and
+// waits as its wait commands say; commands that write AFE registers act on
+// them, and the sequencer CRC and count are kept as the hardware keeps
+// them.  An empty command FIFO ends the sequence if SEQ_STOP_ON_FIFO_EMPTY
+// is set; otherwise it is an underflow, counted as a starvation, and the
+// sequencer stalls until the next command comes.  A DFT result is ready
+// dft_ns after ADC_CONV_EN and DFT_EN are both set, and every dft_ns after
+// that while they stay set; afe_speed divides every AFE time, so the same
+// sequences can be run at other rates.  Each result sets DFT_RESULT_READY,
+// the result registers and, with the data FIFO fed from the DFT, two data
+// FIFO entries, real then imaginary.  The FIFOs hold 8 entries.
+//
+// The DFT sees RCAL when AFE_SW_CFG holds rcal_switches at the start of the
+// DFT, and the body otherwise.  RCAL reads rcal_counts at rcal_phase_deg;
+// the body reads what its impedance would give against that RCAL: either a
+// pulsatile impedance, z_ohms less z_pulse_ohms at the top of each beat at
+// heart_bpm, or the results in replay_path, cycled.  Gaussian noise of
+// noise counts is added to both parts of every result.
+//
+// So that the calibrations of afe_lib.c get through, AFE_SUPPLY_LPF_RESULT
+// reads what an ideal chip would give once ADC_CONV_EN and SUPPLY_LPF_EN
+// are set: 0.7 V on Vref, the DAC output, offset calibration included,
+// across RCAL and, inverted, at the TIA, and mid-scale otherwise.
+//
+// Limits: the data FIFO is only drained by DMA, so reads of
+// AFE_DATA_FIFO_READ do not pop it; writes to AFE_CMD_FIFO_WRITE other than
+// by DMA are not seen; and, as for every simulated peripheral, a register
+// turned off and on again between two interrupt points is seen unchanged.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ChipSim.h"
+
+// Most recent results kept for checking (AfeSim_Result()).
+#define AFE_SIM_TRUTH_SIZE 4096
+
+typedef struct {
+  double afe_speed;         // AFE times are divided by this.
+  double dft_ns;            // From the DFT start to its result.
+  uint32_t rcal_switches;   // AFE_SW_CFG value that measures RCAL.
+  double rcal_ohms;
+  double rcal_counts;       // Magnitude of the RCAL DFT.
+  double rcal_phase_deg;
+  double z_ohms;            // Body impedance between beats.
+  double z_pulse_ohms;      // Drop in impedance at the top of a beat.
+  double z_phase_deg;       // Body phase against RCAL.
+  double heart_bpm;
+  double noise;             // Standard deviation, in DFT counts.
+  const char *replay_path;  // Recorded results, or NULL to synthesize.
+} AfeSimConfig;
+
+typedef struct {
+  uint64_t commands;          // Sequencer commands executed.
+  uint64_t dfts;              // DFT results.
+  uint64_t results_pushed;    // ... written to the data FIFO.
+  uint64_t data_overflows;    // ... lost to a full data FIFO.
+  uint64_t cmd_starvations;   // Command FIFO empty with the sequencer on.
+  uint64_t sequences;         // Sequences started.
+} AfeSimStats;
+
+typedef struct {
+  uint64_t at;              // When the result was ready, in ns.
+  bool rcal;
+  int16_t real;
+  int16_t imag;
+} AfeSimResult;
+
+// Replay files hold one result per line: "real imag" in DFT counts of the
+// body, or "pressure magnitude phase" as beatreplay reads them (ohms and
+// degrees, the pressure ignored).  Other lines are skipped.
+void AfeSim_Defaults(AfeSimConfig *config);
+
+// After ChipSim_Init().  Returns false if the replay file can't be read or
+// holds no result.
+bool AfeSim_Init(const AfeSimConfig *config);
+
+const AfeSimStats *AfeSim_Stats(void);
+
+// Result number n, counted from 0, if it is among the last
+// AFE_SIM_TRUTH_SIZE.
+bool AfeSim_Result(uint64_t n, AfeSimResult *result);
+
+#endif  // __AFE_SIM_H__
@@ -0,0 +1,554 @@
+// The ADuCM350 on the host; see ChipSim.h.
+
+#include "ChipSim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <ucos_ii.h>
+
+#include "dma.h"
+#include "system.h"
+
+// Peripheral registers, GPT0 up to the end of the USB block.
+#define REGISTERS_BASE 0x40000000ul
+#define REGISTERS_SIZE 0xB0000ul
+
+// The DMA descriptor table, primary then alternate, at the start of SRAM:
+// the drivers read it through DMAPDBPTR and DMAADBPTR, which hold 32 bits.
+#define DESCRIPTORS_BASE 0x20000000ul
+#define DESCRIPTORS_SIZE 0x1000ul
+
+#define CORE_VECTORS 16
+#define MAX_PERIPHERALS 8
+#define CLOCK_HZ 16000000u
+
+typedef struct {
+  bool enabled;
+  bool pending;
+  uint64_t pending_at;
+  bool level;
+  uint32_t priority;
+} ChipSimLine;
+
+// A channel's descriptor, as dma.c keeps it: the mode, the end addresses
+// and the units left.  The next unit is that many steps before the end.
+typedef struct {
+  ADI_DMA_MODE_TYPE mode;
+  uintptr_t src_end;
+  uintptr_t dst_end;
+  intptr_t src_step;
+  intptr_t dst_step;
+  unsigned width;
+  uint32_t remaining;
+} ChipSimDescriptor;
+
+// A channel: its primary and alternate descriptors, and which of the two
+// the controller is on.
+typedef struct {
+  bool enabled;
+  bool byte_swap;
+  ADI_DMA_CCD_TYPE active;
+  ChipSimDescriptor descriptors[2];
+} ChipSimDma;
+
+SCB_Type ChipSim_Scb;
+CoreDebug_Type ChipSim_CoreDebug;
+
+static ADI_NVIC_HANDLER vectors[CORE_VECTORS + ADI_INT_NUM_INT];
+static ChipSimLine lines[ADI_INT_NUM_INT];
+static ChipSimPeripheral peripherals[MAX_PERIPHERALS];
+static int peripheral_count;
+static uint64_t sim_now;
+
+static ChipSimDma channels[NUM_DMA_CHANNELSn];
+static ADI_DCC_TypeDef *const dcc[2] = {
+  (ADI_DCC_TypeDef *) DESCRIPTORS_BASE,
+  (ADI_DCC_TypeDef *) DESCRIPTORS_BASE + NUM_DMA_CHANNELSn,
+};
+
+static SysTick_Type systick;
+static uint64_t systick_start;
+static DWT_Type dwt;
+static uint32_t dwt_offset;
+
+static void chipSim_Map(uintptr_t base, size_t size, const char *what) {
+  void *mapped = mmap((void *) base, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (mapped != (void *) base) {
+    fprintf(stderr, "ChipSim: can't map the %s at 0x%lx\n", what,
+            (unsigned long) base);
+    exit(2);
+  }
+}
+
+// Before main(), so that no driver touches a register first.
+__attribute__((constructor)) static void chipSim_MapRegisters(void) {
+  chipSim_Map(REGISTERS_BASE, REGISTERS_SIZE, "peripheral registers");
+  chipSim_Map(DESCRIPTORS_BASE, DESCRIPTORS_SIZE, "DMA descriptors");
+}
+
+static void chipSim_DefaultHandler(void) {
+  fprintf(stderr, "ChipSim: interrupt %u has no handler\n",
+          (unsigned) OS_CPU_SimIntCur());
+  abort();
+}
+
+// The ISR of every device line: exception entry clears the pending bit and
+// calls the vector.
+static void chipSim_Dispatch(void) {
+  INT8U irq = OS_CPU_SimIntCur();
+
+  lines[irq].pending = false;
+  ((ADI_NVIC_HANDLER *) ChipSim_Scb.VTOR)[CORE_VECTORS + irq]();
+}
+
+static void chipSim_Pend(int irq, uint64_t at) {
+  ChipSimLine *line = &lines[irq];
+
+  if (!line->pending) {
+    line->pending = true;
+    line->pending_at = at;
+    if (line->enabled) {
+      OS_CPU_SimIntPend((INT8U) irq, at);
+    }
+  }
+}
+
+// Runs every peripheral, then pends the lines still held high: their ISR
+// may not have cleared the source, and the peripheral has just seen what it
+// did clear.
+static INT64U chipSim_Sync(INT64U now) {
+  uint64_t due = CHIP_SIM_NEVER, next;
+  int i;
+
+  // The port's clock goes back when it takes an interrupt late.
+  if (now < sim_now) {
+    now = sim_now;
+  }
+  sim_now = now;
+  for (i = 0; i < peripheral_count; i++) {
+    next = peripherals[i](now);
+    if (next < due) {
+      due = next;
+    }
+  }
+  for (i = 0; i < ADI_INT_NUM_INT; i++) {
+    if (lines[i].level && lines[i].enabled) {
+      chipSim_Pend(i, now);
+    }
+  }
+  return due;
+}
+
+void ChipSim_Init(void) {
+  int i;
+
+  for (i = 0; i < CORE_VECTORS + ADI_INT_NUM_INT; i++) {
+    vectors[i] = chipSim_DefaultHandler;
+  }
+  ChipSim_Scb.VTOR = (uintptr_t) vectors;
+  memset(lines, 0, sizeof(lines));
+  memset(channels, 0, sizeof(channels));
+  memset((void *) DESCRIPTORS_BASE, 0, DESCRIPTORS_SIZE);
+  pADI_DMA->DMAPDBPTR = (uint32_t) (uintptr_t) dcc[ADI_DMA_CCD_PRIMARY];
+  // Read-only on the chip, which works it out from DMAPDBPTR.
+  *(volatile uint32_t *) &pADI_DMA->DMAADBPTR =
+      (uint32_t) (uintptr_t) dcc[ADI_DMA_CCD_ALTERNATE];
+  peripheral_count = 0;
+  sim_now = 0;
+  for (i = 0; i < ADI_INT_NUM_INT; i++) {
+    OS_CPU_SimIntConnect((INT8U) i, chipSim_Dispatch);
+  }
+  OS_CPU_SimPeriphConnect(chipSim_Sync);
+}
+
+void ChipSim_Add(ChipSimPeripheral peripheral) {
+  if (peripheral_count == MAX_PERIPHERALS) {
+    fprintf(stderr, "ChipSim: too many peripherals\n");
+    exit(2);
+  }
+  peripherals[peripheral_count++] = peripheral;
+}
+
+void ChipSim_IrqPulse(int irq, uint64_t at) {
+  chipSim_Pend(irq, at);
+}
+
+void ChipSim_IrqLevel(int irq, bool level, uint64_t at) {
+  if (level && !lines[irq].level) {
+    chipSim_Pend(irq, at);
+  }
+  lines[irq].level = level;
+}
+
+// NVIC.  A disabled line keeps its pending bit, and is taken when it is
+// enabled again.
+void ChipSim_IrqEnable(int irq, _Bool enable) {
+  ChipSimLine *line;
+
+  if (irq < 0 || irq >= ADI_INT_NUM_INT || lines[irq].enabled == enable) {
+    return;
+  }
+  line = &lines[irq];
+  line->enabled = enable;
+  if (!enable) {
+    OS_CPU_SimIntClr((INT8U) irq);
+  } else if (line->pending) {
+    OS_CPU_SimIntPend((INT8U) irq, line->pending_at);
+  } else if (line->level) {
+    chipSim_Pend(irq, sim_now);
+  }
+}
+
+void ChipSim_IrqPend(int irq) {
+  if (irq >= 0 && irq < ADI_INT_NUM_INT) {
+    chipSim_Pend(irq, sim_now);
+  }
+}
+
+void ChipSim_IrqClear(int irq) {
+  if (irq >= 0 && irq < ADI_INT_NUM_INT) {
+    lines[irq].pending = false;
+    OS_CPU_SimIntClr((INT8U) irq);
+  }
+}
+
+_Bool ChipSim_IrqPending(int irq) {
+  return irq >= 0 && irq < ADI_INT_NUM_INT && lines[irq].pending;
+}
+
+void ChipSim_IrqPriority(int irq, uint32_t priority) {
+  if (irq >= 0 && irq < ADI_INT_NUM_INT) {
+    lines[irq].priority = priority;
+  }
+}
+
+uint32_t ChipSim_Ipsr(void) {
+  INT8U line = OS_CPU_SimIntCur();
+
+  if (line < ADI_INT_NUM_INT) {
+    return CORE_VECTORS + line;
+  }
+  return line == OS_CPU_SIM_INT_SYSTICK ? CORE_VECTORS - 1 : 0;
+}
+
+// SysTick and DWT: the registers are worked out from the simulated clock
+// each time they are looked at.
+static uint32_t chipSim_Cycles(void) {
+  return (uint32_t) (OS_CPU_SimTimeNs() * (CLOCK_HZ / 1000000u) / 1000u);
+}
+
+void ChipSim_SysTickStart(uint32_t ticks) {
+  systick.LOAD = ticks - 1u;
+  systick.CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk
+                 | SysTick_CTRL_ENABLE_Msk;
+  systick_start = OS_CPU_SimTimeNs();
+  OS_CPU_SysTickInit(ticks);
+}
+
+SysTick_Type *ChipSim_SysTick(void) {
+  uint64_t cycles;
+
+  if (systick.CTRL & SysTick_CTRL_ENABLE_Msk) {
+    cycles = (OS_CPU_SimTimeNs() - systick_start) * (CLOCK_HZ / 1000000u)
+             / 1000u;
+    systick.VAL = systick.LOAD - (uint32_t) (cycles % (systick.LOAD + 1u));
+  }
+  return &systick;
+}
+
+// A write to CYCCNT moves the count: it is noticed as a value other than
+// the one last read.
+DWT_Type *ChipSim_Dwt(void) {
+  static uint32_t last;
+  uint32_t cycles = chipSim_Cycles();
+
+  if (dwt.CYCCNT != last) {
+    dwt_offset = dwt.CYCCNT - cycles;
+  }
+  last = cycles + dwt_offset;
+  dwt.CYCCNT = last;
+  return &dwt;
+}
+
+// The dma.c API.
+static intptr_t chipSim_DmaStep(ADI_DMA_INCR_TYPE increment) {
+  switch (increment) {
+    case ADI_DMA_INCR_BYTE:
+    case ADI_DMA_INCR_HALFWORD:
+    case ADI_DMA_INCR_WORD:
+      return (intptr_t) 1 << increment;
+    case ADI_DMA_DECR_BYTE:
+    case ADI_DMA_DECR_HALFWORD:
+    case ADI_DMA_DECR_WORD:
+      return -((intptr_t) 1 << (increment - ADI_DMA_DECR_BYTE));
+    default:
+      return 0;
+  }
+}
+
+// The controller's cycle field of a descriptor's DMACDC, which the drivers
+// read back: the mode while the descriptor has units left, and 0 (stop)
+// once it is done.
+static void chipSim_DmaCycle(int chan, ADI_DMA_CCD_TYPE ccd, uint32_t mode) {
+  volatile uint32_t *cdc = &dcc[ccd][chan].DMACDC;
+
+  *cdc = (*cdc & ~DMA_CCD_CYCLE_MASK) | (mode & DMA_CCD_CYCLE_MASK);
+}
+
+static void chipSim_DmaStop(int chan) {
+  channels[chan].enabled = false;
+  chipSim_DmaCycle(chan, ADI_DMA_CCD_PRIMARY, ADI_DMA_MODE_INVALID);
+  chipSim_DmaCycle(chan, ADI_DMA_CCD_ALTERNATE, ADI_DMA_MODE_INVALID);
+}
+
+ADI_DMA_RESULT_TYPE adi_DMA_Init(DMA_CHANn_TypeDef chNum,
+                                 ADI_DMA_PRIORITY_TYPE priority) {
+  (void) priority;
+  if (chNum >= NUM_DMA_CHANNELSn) {
+    return ADI_DMA_ERR_INVALID_CHANNEL;
+  }
+  chipSim_DmaStop(chNum);
+  return ADI_DMA_SUCCESS;
+}
+
+ADI_DMA_RESULT_TYPE adi_DMA_UnInit(DMA_CHANn_TypeDef chNum) {
+  if (chNum >= NUM_DMA_CHANNELSn) {
+    return ADI_DMA_ERR_INVALID_CHANNEL;
+  }
+  chipSim_DmaStop(chNum);
+  return ADI_DMA_SUCCESS;
+}
+
+ADI_DMA_RESULT_TYPE adi_DMA_SetChannelAssign(DMA_CHANn_TypeDef chNum,
+                                             ADI_DMA_ASSIGN_TYPE controller) {
+  (void) controller;
+  return chNum < NUM_DMA_CHANNELSn ? ADI_DMA_SUCCESS
+                                   : ADI_DMA_ERR_INVALID_CHANNEL;
+}
+
+ADI_DMA_RESULT_TYPE adi_DMA_SetByteSwap(DMA_CHANn_TypeDef chNum,
+                                        bool_t flag) {
+  if (chNum >= NUM_DMA_CHANNELSn) {
+    return ADI_DMA_ERR_INVALID_CHANNEL;
+  }
+  channels[chNum].byte_swap = flag;
+  return ADI_DMA_SUCCESS;
+}
+
+ADI_DMA_RESULT_TYPE adi_DMA_GetState(ADI_DMA_STATE_TYPE *pStatusResult) {
+  *pStatusResult = ADI_DMA_STATE_IDLE;
+  return ADI_DMA_SUCCESS;
+}
+
+// Basic and ping-pong modes.  A descriptor in the invalid mode, with no
+// data, is what ends a ping-pong chain.  Writes to DMAALTCLR, which put a
+// channel back on its primary descriptor, are seen here, as the drivers
+// make them just before they submit.
+ADI_DMA_RESULT_TYPE adi_DMA_SubmitTransfer(ADI_DMA_TRANSFER_TYPE *pTransfer) {
+  ChipSimDma *channel;
+  ChipSimDescriptor *descriptor;
+  uint32_t length = pTransfer->DataLength;
+
+  if (pTransfer->Chan >= NUM_DMA_CHANNELSn) {
+    return ADI_DMA_ERR_INVALID_CHANNEL;
+  }
+  if (pTransfer->CCD != ADI_DMA_CCD_PRIMARY
+      && pTransfer->CCD != ADI_DMA_CCD_ALTERNATE) {
+    return ADI_DMA_ERR_INVALID_CCD;
+  }
+  if (pTransfer->Mode != ADI_DMA_MODE_INVALID
+      && pTransfer->Mode != ADI_DMA_MODE_BASIC
+      && pTransfer->Mode != ADI_DMA_MODE_PINGPONG) {
+    return ADI_DMA_ERR_INVALID_STATE;
+  }
+  if ((length == 0) != (pTransfer->Mode == ADI_DMA_MODE_INVALID)
+      || length > ADI_DMA_MAX_TRANSFER_SIZE) {
+    return ADI_DMA_ERR_INVALID_LENGTH;
+  }
+  channel = &channels[pTransfer->Chan];
+  if (pADI_DMA->DMAALTCLR & (1u << pTransfer->Chan)) {
+    pADI_DMA->DMAALTCLR &= ~(1u << pTransfer->Chan);
+    channel->active = ADI_DMA_CCD_PRIMARY;
+  }
+  descriptor = &channel->descriptors[pTransfer->CCD];
+  descriptor->mode = pTransfer->Mode;
+  descriptor->width = 1u << pTransfer->DataWidth;
+  descriptor->src_step = chipSim_DmaStep(pTransfer->SrcInc);
+  descriptor->dst_step = chipSim_DmaStep(pTransfer->DstInc);
+  if (length > 0) {
+    descriptor->src_end = (uintptr_t) pTransfer->pSrcData
+                          + (length - 1u) * descriptor->src_step;
+    descriptor->dst_end = (uintptr_t) pTransfer->pDstData
+                          + (length - 1u) * descriptor->dst_step;
+  }
+  descriptor->remaining = length;
+  chipSim_DmaCycle(pTransfer->Chan, pTransfer->CCD, pTransfer->Mode);
+  channel->enabled = true;
+  return ADI_DMA_SUCCESS;
+}
+
+ADI_DMA_RESULT_TYPE adi_DMA_ReSubmit(ADI_DMA_TRANSFER_TYPE *pTransfer) {
+  ChipSimDma *channel = &channels[pTransfer->Chan];
+
+  channel->descriptors[pTransfer->CCD].remaining = pTransfer->DataLength;
+  chipSim_DmaCycle(pTransfer->Chan, pTransfer->CCD,
+                   channel->descriptors[pTransfer->CCD].mode);
+  channel->enabled = true;
+  return ADI_DMA_SUCCESS;
+}
+
+ADI_DMA_RESULT_TYPE adi_DMA_GetRemainingCount(DMA_CHANn_TypeDef chNum,
+                                              uint32_t *pCount,
+                                              ADI_DMA_CCD_TYPE ccd) {
+  *pCount = channels[chNum].descriptors[ccd].remaining & 0x3FFu;
+  return ADI_DMA_SUCCESS;
+}
+
+void adi_DMA_PrintDescriptors(DMA_CHANn_TypeDef chNum) {
+  const ChipSimDma *channel = &channels[chNum];
+  const ChipSimDescriptor *descriptor;
+  int ccd;
+
+  printf("DMA %d: %s, on the %s descriptor\n", (int) chNum,
+         channel->enabled ? "enabled" : "disabled",
+         channel->active == ADI_DMA_CCD_PRIMARY ? "primary" : "alternate");
+  for (ccd = ADI_DMA_CCD_PRIMARY; ccd <= ADI_DMA_CCD_ALTERNATE; ccd++) {
+    descriptor = &channel->descriptors[ccd];
+    printf("  mode %d, %u units of %u left, src end 0x%lx, dst end 0x%lx\n",
+           (int) descriptor->mode, (unsigned) descriptor->remaining,
+           descriptor->width, (unsigned long) descriptor->src_end,
+           (unsigned long) descriptor->dst_end);
+  }
+}
+
+// The peripheral's side.
+static ChipSimDescriptor *chipSim_DmaNext(int chan) {
+  ChipSimDma *channel;
+  ChipSimDescriptor *descriptor;
+
+  if (chan < 0 || chan >= NUM_DMA_CHANNELSn || !channels[chan].enabled) {
+    return NULL;
+  }
+  channel = &channels[chan];
+  descriptor = &channel->descriptors[channel->active];
+  return descriptor->mode != ADI_DMA_MODE_INVALID && descriptor->remaining > 0
+             ? descriptor
+             : NULL;
+}
+
+bool ChipSim_DmaActive(int chan) {
+  return chipSim_DmaNext(chan) != NULL;
+}
+
+static uint32_t chipSim_DmaSwap(const ChipSimDma *channel,
+                                const ChipSimDescriptor *descriptor,
+                                uint32_t value) {
+  if (!channel->byte_swap) {
+    return value;
+  }
+  return descriptor->width == 4u   ? __builtin_bswap32(value)
+         : descriptor->width == 2u ? __builtin_bswap16((uint16_t) value)
+                                   : value;
+}
+
+// The channel's interrupt comes when a descriptor's last unit has gone.  In
+// basic mode the controller then disables the channel; in ping-pong mode it
+// goes on with the other descriptor, and stops if that one is invalid or
+// done too.
+static void chipSim_DmaUnitDone(int chan, uint64_t at) {
+  ChipSimDma *channel = &channels[chan];
+  ChipSimDescriptor *descriptor = &channel->descriptors[channel->active];
+
+  if (--descriptor->remaining > 0) {
+    return;
+  }
+  chipSim_DmaCycle(chan, channel->active, ADI_DMA_MODE_INVALID);
+  if (descriptor->mode == ADI_DMA_MODE_PINGPONG) {
+    channel->active = channel->active == ADI_DMA_CCD_PRIMARY
+                          ? ADI_DMA_CCD_ALTERNATE
+                          : ADI_DMA_CCD_PRIMARY;
+    if (chipSim_DmaNext(chan) == NULL) {
+      channel->enabled = false;
+    }
+  } else {
+    channel->enabled = false;
+  }
+  ChipSim_IrqPulse(DMA_SPIH_TX_IRQn + chan, at);
+}
+
+bool ChipSim_DmaRead(int chan, uint32_t *value, uint64_t at) {
+  const ChipSimDescriptor *descriptor = chipSim_DmaNext(chan);
+  uintptr_t src;
+
+  if (descriptor == NULL) {
+    return false;
+  }
+  src = descriptor->src_end
+        - (descriptor->remaining - 1u) * descriptor->src_step;
+  switch (descriptor->width) {
+    case 1:
+      *value = *(const volatile uint8_t *) src;
+      break;
+    case 2:
+      *value = *(const volatile uint16_t *) src;
+      break;
+    default:
+      *value = *(const volatile uint32_t *) src;
+      break;
+  }
+  *value = chipSim_DmaSwap(&channels[chan], descriptor, *value);
+  chipSim_DmaUnitDone(chan, at);
+  return true;
+}
+
+bool ChipSim_DmaWrite(int chan, uint32_t value, uint64_t at) {
+  const ChipSimDescriptor *descriptor = chipSim_DmaNext(chan);
+  uintptr_t dst;
+
+  if (descriptor == NULL) {
+    return false;
+  }
+  dst = descriptor->dst_end
+        - (descriptor->remaining - 1u) * descriptor->dst_step;
+  value = chipSim_DmaSwap(&channels[chan], descriptor, value);
+  switch (descriptor->width) {
+    case 1:
+      *(volatile uint8_t *) dst = (uint8_t) value;
+      break;
+    case 2:
+      *(volatile uint16_t *) dst = (uint16_t) value;
+      break;
+    default:
+      *(volatile uint32_t *) dst = value;
+      break;
+  }
+  chipSim_DmaUnitDone(chan, at);
+  return true;
+}
+
+// system.c: the clocks are fixed at 16 MHz, as this project runs them.
+void SystemInit(void) {}
+
+void SystemCoreClockUpdate(void) {}
+
+uint32_t SystemGetClockFrequency(ADI_SYS_CLOCK_ID id) {
+  (void) id;
+  return CLOCK_HZ;
+}
+
+ADI_SYS_RESULT_TYPE SystemEnableClock(ADI_SYS_CLOCK_GATE_ID id, bool_t bFlag) {
+  (void) id;
+  (void) bFlag;
+  return ADI_SYS_SUCCESS;
+}
+
+ADI_SYS_RESULT_TYPE SetSystemClockDivider(ADI_SYS_CLOCK_ID id, uint8_t div) {
+  (void) id;
+  (void) div;
+  return ADI_SYS_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#ifndef __CHIP_SIM_H__
+#define __CHIP_SIM_H__
+
+// The ADuCM350 on the host, around the POSIX uC/OS-II port: enough of the
+// chip for the drivers, the OSAL and this project's tasks to run unmodified,
+// with simulated peripherals (AfeSim.h) standing in for the hardware.
+//
+// The peripheral registers are plain memory at their addresses on the chip,
+// mapped when the program starts.  A simulated peripheral is a function the
+// port calls with the simulated time before any interrupt is taken and when
+// the peripheral asked to run next (OS_CPU_SimPeriphConnect()): it sees what
+// the program wrote to its registers since the last call, runs up to the
+// time given, writes back what the program reads, raises its interrupts, and
+// returns when it next needs to run.  So writes take effect at the next
+// interrupt point, not the instruction after, and a register written twice
+// in between is seen once, with the last value.
+//
+// The NVIC is modelled as the drivers use it: enables, pending bits (a
+// pulse stays pending while the line is disabled, a level pends again while
+// it is high), and the vector table at SCB->VTOR, which the OSAL fills in.
+// Priorities are not modelled; see core_cm3.h.  The DMA controller is a
+// stand-in for the dma.c API, in basic and ping-pong modes, moving data as
+// soon as the peripheral asks for it; link this instead of src/dma.c, whose
+// descriptors hold 32-bit addresses.  Of the descriptor table only the cycle
+// field of each DMACDC is kept, at DMAPDBPTR and DMAADBPTR, for the drivers
+// that read it back to see which descriptors are done.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <device.h>
+
+#if OS_CPU_SIM_INT_NBR != ADI_INT_NUM_INT + 1
+#error "build with -DOS_CPU_SIM_INT_NBR=62: every ADuCM350 interrupt, then the SysTick"
+#endif
+
+#define CHIP_SIM_NEVER UINT64_MAX
+
+// Brings a peripheral up to now (ns), and returns when it next needs to run,
+// or CHIP_SIM_NEVER.
+typedef uint64_t (*ChipSimPeripheral)(uint64_t now);
+
+// After OSInit(), before any driver is initialized.
+void ChipSim_Init(void);
+void ChipSim_Add(ChipSimPeripheral peripheral);
+
+// Interrupt request lines, by IRQn_Type.  A pulse sets the pending bit; a
+// level keeps setting it while it is high.  at is when it happened, no later
+// than the time the peripheral was called with.
+void ChipSim_IrqPulse(int irq, uint64_t at);
+void ChipSim_IrqLevel(int irq, bool level, uint64_t at);
+
+// The peripheral's side of a DMA channel.  Active while the channel is
+// enabled with units left.  ChipSim_DmaRead() takes the next unit from
+// memory (to the peripheral), ChipSim_DmaWrite() stores the next unit from
+// the peripheral; each returns false if the channel is not active, and the
+// last unit raises the channel's interrupt at time at.
+bool ChipSim_DmaActive(int chan);
+bool ChipSim_DmaRead(int chan, uint32_t *value, uint64_t at);
+bool ChipSim_DmaWrite(int chan, uint32_t value, uint64_t at);
+
+#endif  // __CHIP_SIM_H__
@@ -0,0 +1,224 @@
+// The I2C master of the ADuCM350 on the host; see I2cSim.h.
+
+#include "I2cSim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+
+#define CLOCK_HZ 16000000u
+#define FIFO_SIZE 2
+#define MAX_TRANSFER 1024
+
+// Status bits that reading I2CMSTA clears.
+#define STA_EVENTS (I2CMSTA_TCOMP | I2CMSTA_NACKADDR | I2CMSTA_NACKDATA \
+                    | I2CMSTA_ALOST)
+
+// I2CMSTA from the master's side.
+#define MSTA (*(volatile uint16_t *) &pADI_I2C->I2CMSTA)
+
+typedef enum {
+  BUS_IDLE,
+  BUS_ADDRESS,              // The address byte and its acknowledge.
+  BUS_WRITE,                // A data byte out, from shift.
+  BUS_READ,                 // A data byte in, data[next_read].
+  BUS_STOP
+} I2cSimState;
+
+static I2cSimStats stats;
+static const I2cSimSlave *slaves[I2C_SIM_MAX_SLAVES];
+static int slave_count;
+
+static I2cSimState state;
+static uint64_t next_at = CHIP_SIM_NEVER;  // End of the current bus step.
+static uint64_t start_at;
+static uint32_t period_ns;
+static const I2cSimSlave *slave;           // NULL if none answered.
+static bool reading;
+
+static uint8_t fifo[FIFO_SIZE];
+static int fifo_count;
+static uint8_t shift;
+static uint8_t data[MAX_TRANSFER];
+static int length;
+static int next_read;
+
+// One SCL period, as adi_I2C_SetMasterClock() sets I2CDIV up: HIGH + 3
+// cycles high, LOW + 1 low.
+static uint32_t i2cSim_Period(void) {
+  uint16_t div = pADI_I2C->I2CDIV;
+
+  return (uint32_t) ((((div >> 8) & 0xFFu) + 3u + (div & 0xFFu) + 1u)
+                     * (1000000000ull / CLOCK_HZ));
+}
+
+static void i2cSim_Raise(uint16_t bits, uint16_t enable, uint64_t at) {
+  MSTA |= bits;
+  if (pADI_I2C->I2CMCON & enable) {
+    ChipSim_IrqPulse(I2CM_IRQn, at);
+  }
+}
+
+// The DMA request of the transmit FIFO.
+static void i2cSim_Fill(uint64_t at) {
+  uint32_t value;
+
+  while (fifo_count < FIFO_SIZE && (pADI_I2C->I2CMCON & I2CMCON_TXDMA)
+         && ChipSim_DmaRead(I2CM_CHANn, &value, at)) {
+    fifo[fifo_count++] = (uint8_t) value;
+  }
+}
+
+static void i2cSim_Start(uint64_t at) {
+  uint16_t address = pADI_I2C->I2CADR1;
+  int i;
+
+  pADI_I2C->I2CADR1 = I2C_SIM_ADR_TAKEN;
+  period_ns = i2cSim_Period();
+  reading = (address & 1u) != 0;
+  slave = NULL;
+  fifo_count = 0;
+  length = 0;
+  next_read = 0;
+  for (i = 0; i < slave_count; i++) {
+    if (slaves[i]->address == ((address >> 1) & 0x7Fu)) {
+      slave = slaves[i];
+    }
+  }
+  if (!reading) {
+    i2cSim_Fill(at);
+  }
+  MSTA |= I2CMSTA_BUSY;
+  start_at = at;
+  state = BUS_ADDRESS;
+  next_at = at + 10u * period_ns;
+}
+
+// Takes the next byte to send out of the FIFO, or ends the write.
+static void i2cSim_NextWrite(uint64_t at) {
+  if (fifo_count == 0) {
+    state = BUS_STOP;
+    next_at = at + period_ns;
+    return;
+  }
+  shift = fifo[0];
+  fifo[0] = fifo[1];
+  fifo_count--;
+  i2cSim_Fill(at);
+  state = BUS_WRITE;
+  next_at = at + 9u * period_ns;
+}
+
+// The end of the current bus step, at next_at.
+static void i2cSim_Step(void) {
+  uint64_t at = next_at;
+  int count;
+
+  switch (state) {
+    case BUS_ADDRESS:
+      if (slave == NULL) {
+        stats.nacks++;
+        i2cSim_Raise(I2CMSTA_NACKADDR, I2CMCON_IENNACK, at);
+        state = BUS_STOP;
+        next_at = at + period_ns;
+      } else if (reading) {
+        length = (pADI_I2C->I2CMRXCNT & 0xFFu) + 1;
+        count = slave->read(data, length, at);
+        if (count < length) {
+          memset(data + count, 0xFF, (size_t) (length - count));
+        }
+        state = BUS_READ;
+        next_at = at + 9u * period_ns;
+      } else {
+        i2cSim_NextWrite(at);
+      }
+      break;
+
+    case BUS_WRITE:
+      if (length < MAX_TRANSFER) {
+        data[length] = shift;
+      }
+      length++;
+      i2cSim_NextWrite(at);
+      break;
+
+    case BUS_READ:
+      if (!(pADI_I2C->I2CMCON & I2CMCON_RXDMA)
+          || !ChipSim_DmaWrite(I2CM_CHANn, data[next_read], at)) {
+        *(volatile uint16_t *) &pADI_I2C->I2CMRX = data[next_read];
+        stats.rx_overflows++;
+      }
+      if (++next_read < length) {
+        next_at = at + 9u * period_ns;
+      } else {
+        state = BUS_STOP;
+        next_at = at + period_ns;
+      }
+      break;
+
+    case BUS_STOP:
+      if (slave != NULL && reading) {
+        stats.reads++;
+        stats.bytes_read += (uint64_t) length;
+      } else if (slave != NULL) {
+        stats.writes++;
+        stats.bytes_written += (uint64_t) length;
+        slave->write(data, length < MAX_TRANSFER ? length : MAX_TRANSFER, at);
+      }
+      stats.busy_ns += at - start_at;
+      MSTA &= (uint16_t) ~I2CMSTA_BUSY;
+      i2cSim_Raise(I2CMSTA_TCOMP, I2CMCON_IENCMP, at);
+      state = BUS_IDLE;
+      next_at = CHIP_SIM_NEVER;
+      break;
+
+    default:
+      next_at = CHIP_SIM_NEVER;
+      break;
+  }
+}
+
+static uint64_t i2cSim_Sync(uint64_t now) {
+  // The master interrupt has read the status since the events were raised.
+  if ((MSTA & STA_EVENTS) && !ChipSim_IrqPending(I2CM_IRQn)) {
+    MSTA &= (uint16_t) ~STA_EVENTS;
+  }
+  for (;;) {
+    if (state == BUS_IDLE) {
+      if ((pADI_I2C->I2CADR1 & I2C_SIM_ADR_TAKEN)
+          || !(pADI_I2C->I2CMCON & I2CMCON_MASEN)) {
+        break;
+      }
+      i2cSim_Start(now);
+    } else if (next_at <= now) {
+      i2cSim_Step();
+    } else {
+      break;
+    }
+  }
+  return next_at;
+}
+
+void I2cSim_Init(void) {
+  memset(&stats, 0, sizeof(stats));
+  slave_count = 0;
+  state = BUS_IDLE;
+  next_at = CHIP_SIM_NEVER;
+  pADI_I2C->I2CADR1 = I2C_SIM_ADR_TAKEN;
+  MSTA = 0;
+  ChipSim_Add(i2cSim_Sync);
+}
+
+void I2cSim_Attach(const I2cSimSlave *new_slave) {
+  if (slave_count == I2C_SIM_MAX_SLAVES) {
+    fprintf(stderr, "I2cSim: too many slaves\n");
+    exit(2);
+  }
+  slaves[slave_count++] = new_slave;
+}
+
+const I2cSimStats *I2cSim_Stats(void) {
+  return &stats;
+}
@@ -0,0 +1,63 @@
+#ifndef __I2C_SIM_H__
+#define __I2C_SIM_H__
+
+// The I2C master of the ADuCM350 on the host (see ChipSim.h), in DMA mode
+// as i2c.c drives it, and the slaves on its bus.  With it, the unmodified
+// i2c.c and PumpTask talk to a simulated pump module (arduino/PumpSim.h).
+//
+// A transfer starts when the program writes the address byte to I2CADR1
+// with MASEN set in I2CMCON, and the bus runs at the rate I2CDIV gives: the
+// start and the stop take one SCL period each, every byte and its
+// acknowledge nine.  A write takes its bytes from the master DMA channel
+// while the two-byte transmit FIFO has room, so that the DMA is done two
+// bytes before the bus is, and stops once the DMA has nothing left; the
+// slave gets the bytes at the stop, as the Wire library hands them over.  A
+// read asks the slave for its bytes as soon as the address is acknowledged
+// and hands I2CMRXCNT + 1 of them to the DMA, 0xFF past those the slave
+// gave.  BUSY is set in I2CMSTA from the start to the stop, and TCOMP at the
+// stop; an address no slave answers gives NACKADDR, then the stop.  Each
+// raises the master interrupt if I2CMCON enables it, and stays set until
+// that interrupt has been taken, as reading I2CMSTA clears it.
+//
+// The model takes the address byte out of I2CADR1 when the transfer
+// starts, and leaves I2C_SIM_ADR_TAKEN there, which no address byte is, so
+// that the next write of the same address is seen.
+//
+// Limits: only DMA mode, so the FIFOs are never seen by the program; 7-bit
+// addresses, no repeated start, no extended read, no clock stretching and
+// no other master; and a write to I2CADR1 during a transfer is taken after
+// its stop.
+
+#include <stdint.h>
+
+#include "ChipSim.h"
+
+#define I2C_SIM_ADR_TAKEN 0x8000u
+#define I2C_SIM_MAX_SLAVES 4
+
+typedef struct {
+  uint8_t address;          // 7-bit.
+  // A write of length bytes, at its stop (ns).
+  void (*write)(const uint8_t *data, int length, uint64_t at);
+  // A read of up to length bytes, once the address is through; returns how
+  // many the slave sends.
+  int (*read)(uint8_t *data, int length, uint64_t at);
+} I2cSimSlave;
+
+typedef struct {
+  uint64_t writes;          // Transfers to a slave that answered.
+  uint64_t reads;
+  uint64_t bytes_written;
+  uint64_t bytes_read;
+  uint64_t nacks;           // Addresses no slave answered.
+  uint64_t rx_overflows;    // Bytes read with no DMA to take them.
+  uint64_t busy_ns;         // Time the bus was taken.
+} I2cSimStats;
+
+// After ChipSim_Init().
+void I2cSim_Init(void);
+void I2cSim_Attach(const I2cSimSlave *slave);
+
+const I2cSimStats *I2cSim_Stats(void);
+
+#endif  // __I2C_SIM_H__
@@ -0,0 +1,107 @@
+// The transmit side of the ADuCM350 UART on the host; see UartSim.h.
+
+#include "UartSim.h"
+
+#include <string.h>
+
+#include "macros.h"
+
+#define CLOCK_HZ 16000000u
+
+// The registers the program only reads.
+#define TX (*(volatile uint16_t *) &pADI_UART->COMTX)
+#define IIR (*(volatile uint16_t *) &pADI_UART->COMIIR)
+#define LSR (*(volatile uint16_t *) &pADI_UART->COMLSR)
+
+static UartSimStats stats;
+static UartSimListener listener;
+
+static bool holding;            // A byte waits in the holding register.
+static uint8_t hold;
+static bool shifting;           // The shift register is sending shift.
+static uint8_t shift;
+static uint64_t shift_end;      // When its stop bit is done.
+
+// One character on the wire, in ns: start bit, data, parity and stop bits
+// at the baud rate of COMDIV and COMFBR; 0 if they give none.
+static uint64_t uartSim_CharacterNs(void) {
+  uint16_t lcr = pADI_UART->COMLCR;
+  uint16_t fbr = pADI_UART->COMFBR;
+  // M * 2048 + N, as the two fields sit in COMFBR.
+  uint64_t divisor = (uint64_t) (fbr & (COMFBR_DIVM_MSK | COMFBR_DIVN_MSK))
+                     * pADI_UART->COMDIV;
+  unsigned bits = 1u + 5u + (lcr & COMLCR_WLS_MSK)
+                  + ((lcr & COMLCR_PEN) ? 1u : 0u)
+                  + ((lcr & COMLCR_STOP) ? 2u : 1u);
+
+  // A bit is 64 / (M * 2048 + N) / COMDIV of the UART clock.
+  return bits * divisor * 1000000000ull / (64ull * CLOCK_HZ);
+}
+
+// Moves the holding register into the shift register at time at.
+static bool uartSim_Load(uint64_t at) {
+  uint64_t ns;
+
+  if (!holding || (pADI_UART->COMCON & COMCON_DISABLE)) {
+    return false;
+  }
+  ns = uartSim_CharacterNs();
+  if (ns == 0) {
+    return false;
+  }
+  shift = hold;
+  holding = false;
+  shifting = true;
+  shift_end = at + ns;
+  stats.busy_ns += ns;
+  return true;
+}
+
+static uint64_t uartSim_Sync(uint64_t now) {
+  bool interrupt;
+
+  // The characters done by now, each followed by the one that waited.
+  while (shifting && shift_end <= now) {
+    shifting = false;
+    stats.bytes++;
+    if (listener != NULL) {
+      listener(shift, shift_end);
+    }
+    uartSim_Load(shift_end);
+  }
+
+  if (!(TX & UART_SIM_TX_TAKEN)) {
+    if (holding) {
+      stats.overruns++;
+    }
+    hold = (uint8_t) TX;
+    holding = true;
+    TX = UART_SIM_TX_TAKEN;
+  }
+  if (!shifting) {
+    uartSim_Load(now);
+  }
+
+  LSR = (uint16_t) ((LSR & ~(COMLSR_THRE | COMLSR_TEMT))
+                    | (holding ? 0u : COMLSR_THRE)
+                    | (holding || shifting ? 0u : COMLSR_TEMT));
+  interrupt = !holding && (pADI_UART->COMIEN & COMIEN_ETBEI);
+  IIR = interrupt ? COMIIR_STA_TXBUFEMPTY : COMIIR_NINT;
+  ChipSim_IrqLevel(UART_IRQn, interrupt, now);
+  return shifting ? shift_end : CHIP_SIM_NEVER;
+}
+
+void UartSim_Init(UartSimListener new_listener) {
+  memset(&stats, 0, sizeof(stats));
+  listener = new_listener;
+  holding = false;
+  shifting = false;
+  TX = UART_SIM_TX_TAKEN;
+  LSR = COMLSR_THRE | COMLSR_TEMT;
+  IIR = COMIIR_NINT;
+  ChipSim_Add(uartSim_Sync);
+}
+
+const UartSimStats *UartSim_Stats(void) {
+  return &stats;
+}
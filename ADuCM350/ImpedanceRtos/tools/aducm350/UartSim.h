@@ -0,0 +1,48 @@
+#ifndef __UART_SIM_H__
+#define __UART_SIM_H__
+
+// The transmit side of the ADuCM350 UART on the host (see ChipSim.h), as
+// uart.c drives it in interrupt mode.  With it, the unmodified uart.c and
+// TelemetryTask send their bytes at the rate they would go out on the wire,
+// and a listener on the host gets each byte when its stop bit is done.
+//
+// A byte written to COMTX waits in the holding register until the shift
+// register is free, then takes a start bit, the word length, the parity bit
+// and the stop bits of COMLCR at the baud rate COMDIV and COMFBR give
+// (adi_UART_GetBaudRate()'s formula, off the 16 MHz UART clock).  THRE is
+// set in COMLSR while the holding register is empty, and TEMT while the
+// shift register is empty too.  COMIIR reads TXBUFEMPTY while THRE is set
+// and COMIEN enables ETBEI, and NINT otherwise; the UART interrupt line is
+// held high for as long.  The UART only sends while COMCON enables it.
+//
+// The model takes the byte out of COMTX when it sees it, and leaves
+// UART_SIM_TX_TAKEN there, which no byte is, so that the next write of the
+// same byte is seen.  A byte written while the holding register is full
+// overwrites it, as on the chip, and is counted as an overrun.
+//
+// Limits: nothing is received, so COMRX, DR and the receive interrupts stay
+// clear; no modem lines, loopback or break; and a byte is only seen at the
+// next interrupt point (see ChipSim.h), so one the program writes from a
+// task goes out once that task next waits or is interrupted.
+
+#include <stdint.h>
+
+#include "ChipSim.h"
+
+#define UART_SIM_TX_TAKEN 0x8000u
+
+// Gets every byte sent, at the end of its stop bit (ns).
+typedef void (*UartSimListener)(uint8_t byte, uint64_t at);
+
+typedef struct {
+  uint64_t bytes;           // Sent.
+  uint64_t overruns;        // Lost to a full holding register.
+  uint64_t busy_ns;         // Time the shift register was sending.
+} UartSimStats;
+
+// After ChipSim_Init().  listener may be NULL.
+void UartSim_Init(UartSimListener listener);
+
+const UartSimStats *UartSim_Stats(void);
+
+#endif  // __UART_SIM_H__
@@ -0,0 +1,181 @@
+#ifndef __CORE_CM3_H__
+#define __CORE_CM3_H__
+
+// Host stand-in for the CMSIS core_cm3.h, so the ADuCM350 drivers, the OSAL
+// and this project's code build on Linux against the POSIX uC/OS-II port
+// (uCOS-II/Ports/POSIX/GNU) and the simulated chip (ChipSim.h).  device.h
+// includes it as <core_cm3.h>; put this directory first on the include path.
+//
+// PRIMASK is the port's interrupt mask, so __disable_irq() and the OSAL's
+// critical regions hold off the simulated interrupts exactly as the kernel's
+// own critical sections do.  The IPSR tells which simulated interrupt is
+// running.  The NVIC, SCB->VTOR, the SysTick and the DWT cycle counter are
+// ChipSim's.  Priorities are recorded but not modelled: interrupt lines are
+// taken in IRQ number order, the SysTick last.
+
+#include <stdint.h>
+
+#include <os_cpu.h>
+
+#define __I volatile const
+#define __O volatile
+#define __IO volatile
+#define __ASM __asm__
+#define __INLINE inline
+#define __STATIC_INLINE static inline
+
+// The core peripherals, in ChipSim.c.  Interrupt numbers are IRQn_Type.
+typedef struct {
+  __I uint32_t CPUID;
+  __IO uint32_t ICSR;
+  __IO uintptr_t VTOR;
+  __IO uint32_t AIRCR;
+  __IO uint32_t SCR;
+  __IO uint32_t CCR;
+} SCB_Type;
+
+typedef struct {
+  __IO uint32_t CTRL;
+  __IO uint32_t LOAD;
+  __IO uint32_t VAL;
+  __I uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+  __IO uint32_t CTRL;
+  __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+  __IO uint32_t DHCSR;
+  __O uint32_t DCRSR;
+  __IO uint32_t DCRDR;
+  __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern SCB_Type ChipSim_Scb;
+extern CoreDebug_Type ChipSim_CoreDebug;
+
+extern uint32_t ChipSim_Ipsr(void);
+extern void ChipSim_IrqEnable(int irq, _Bool enable);
+extern void ChipSim_IrqPend(int irq);
+extern void ChipSim_IrqClear(int irq);
+extern _Bool ChipSim_IrqPending(int irq);
+extern void ChipSim_IrqPriority(int irq, uint32_t priority);
+extern void ChipSim_SysTickStart(uint32_t ticks);
+extern SysTick_Type *ChipSim_SysTick(void);
+extern DWT_Type *ChipSim_Dwt(void);
+
+// PRIMASK.
+static inline void __disable_irq(void) {
+  (void) OS_CPU_SR_Save();
+}
+
+static inline void __enable_irq(void) {
+  OS_CPU_SR_Restore(0u);
+}
+
+static inline uint32_t __get_PRIMASK(void) {
+  OS_CPU_SR primask = OS_CPU_SR_Save();
+
+  OS_CPU_SR_Restore(primask);
+  return primask;
+}
+
+static inline void __set_PRIMASK(uint32_t primask) {
+  if (primask != 0u) {
+    (void) OS_CPU_SR_Save();
+  } else {
+    OS_CPU_SR_Restore(0u);
+  }
+}
+
+static inline uint32_t __get_IPSR(void) {
+  return ChipSim_Ipsr();
+}
+
+// Barriers only keep the compiler from moving memory accesses across them;
+// the simulation runs on one host thread.
+static inline void __DSB(void) {
+  __asm__ __volatile__("" ::: "memory");
+}
+
+static inline void __DMB(void) {
+  __asm__ __volatile__("" ::: "memory");
+}
+
+static inline void __ISB(void) {
+  __asm__ __volatile__("" ::: "memory");
+}
+
+// Waiting for an interrupt is what the idle task does already.
+static inline void __WFI(void) {
+  OS_CPU_SimPoll();
+}
+
+static inline uint32_t __LDREXW(volatile uint32_t *address) {
+  return *address;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *address) {
+  *address = value;
+  return 0u;
+}
+
+// NVIC.
+static inline void NVIC_EnableIRQ(IRQn_Type irq) {
+  ChipSim_IrqEnable((int) irq, 1);
+}
+
+static inline void NVIC_DisableIRQ(IRQn_Type irq) {
+  ChipSim_IrqEnable((int) irq, 0);
+}
+
+static inline void NVIC_SetPendingIRQ(IRQn_Type irq) {
+  ChipSim_IrqPend((int) irq);
+}
+
+static inline void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+  ChipSim_IrqClear((int) irq);
+}
+
+static inline uint32_t NVIC_GetPendingIRQ(IRQn_Type irq) {
+  return ChipSim_IrqPending((int) irq) ? 1u : 0u;
+}
+
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+  ChipSim_IrqPriority((int) irq, priority);
+}
+
+// SCB: only the vector table offset, which points at ChipSim's table.
+#define SCB_SCR_SLEEPDEEP_Msk (1ul << 2)
+#define SCB_ICSR_PENDSVSET_Msk (1ul << 28)
+
+#define SCB (&ChipSim_Scb)
+
+// SysTick: SysTick_Config() starts the port's tick; the registers read the
+// simulated clock.
+#define SysTick_CTRL_COUNTFLAG_Msk (1ul << 16)
+#define SysTick_CTRL_CLKSOURCE_Msk (1ul << 2)
+#define SysTick_CTRL_TICKINT_Msk (1ul << 1)
+#define SysTick_CTRL_ENABLE_Msk (1ul << 0)
+#define SysTick_LOAD_RELOAD_Msk (0xFFFFFFul)
+
+#define SysTick (ChipSim_SysTick())
+
+static inline uint32_t SysTick_Config(uint32_t ticks) {
+  if (ticks - 1u > SysTick_LOAD_RELOAD_Msk) {
+    return 1u;
+  }
+  ChipSim_SysTickStart(ticks);
+  return 0u;
+}
+
+// DWT cycle counter, counting the simulated 16 MHz core clock.
+#define DWT_CTRL_CYCCNTENA_Msk (1ul << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1ul << 24)
+
+#define DWT (ChipSim_Dwt())
+#define CoreDebug (&ChipSim_CoreDebug)
+
+#endif  // __CORE_CM3_H__
@@ -0,0 +1,12 @@
+#ifndef __INTRINSICS_H__
+#define __INTRINSICS_H__
+
+// Host stand-in for IAR's <intrinsics.h>, which uC-CPU's cpu.h includes: the
+// CMSIS intrinsics of core_cm3.h under their IAR names.
+
+#include "core_cm3.h"
+
+#define __disable_interrupt() __disable_irq()
+#define __enable_interrupt() __enable_irq()
+
+#endif  // __INTRINSICS_H__
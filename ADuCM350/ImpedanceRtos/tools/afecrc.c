@@ -0,0 +1,129 @@
+// Checks the table-driven sequencer CRC-8 of the AFE driver on the host.
+//
+// Random sequences of every length up to -n commands are run through the
+// table kernel in afe_seqcrc.h, the loop afe.c puts around it, and compared
+// with the bitwise CRC afe.c had before and with Sweep_SequenceCrc.  Also
+// times the two kernels.  Exits non-zero on any mismatch.
+//
+// build: cc -O2 -I.. -I../../Eval-ADUCM350EBZ/inc -o afecrc afecrc.c
+//        ../Sweep.c
+// usage: afecrc [-n max_commands]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "afe_seqcrc.h"
+#include "Sweep.h"
+
+#define MAX_COMMANDS 4096
+
+static uint32_t commands[MAX_COMMANDS];
+
+// sequenceCRC() of afe.c, as it was before the table.
+static void crc8_bitwise(uint8_t *crc, uint32_t word) {
+  uint8_t i;
+  uint32_t data;
+
+  data = word;
+  for (i = 0; i < 32; i++) {
+    if (((data & 0x80000000) >> 24) ^ (*crc & 0x80)) {
+      *crc = *crc << 1;
+      *crc = *crc ^ ADI_AFE_SEQ_CRC8_POLYNOMIAL;
+    } else {
+      *crc = *crc << 1;
+    }
+    data = data << 1;
+  }
+}
+
+static uint8_t sequence_crc_bitwise(const uint32_t *data, uint32_t size) {
+  uint32_t i;
+  uint8_t crc;
+
+  crc = 0x01;
+  for (i = 0; i < size; i++) {
+    crc8_bitwise(&crc, data[i]);
+  }
+  return crc;
+}
+
+// sequenceCRC() of afe.c.
+static uint8_t sequence_crc_table(const uint32_t *data, uint32_t size) {
+  uint32_t i;
+  uint8_t crc;
+
+  crc = ADI_AFE_SEQ_CRC8_INITIAL;
+  for (i = 0; i < size; i++) {
+    crc = adi_AFE_SeqCrc8Word(crc, data[i]);
+  }
+  return crc;
+}
+
+static double time_ns_per_command(uint8_t (*crc)(const uint32_t *,
+                                                 uint32_t)) {
+  struct timespec start, end;
+  volatile uint8_t result = 0;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < 2000; i++) {
+    commands[0] ^= result;
+    result = crc(commands, 1000);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec))
+         / (2000.0 * 1000);
+}
+
+int main(int argc, char **argv) {
+  uint32_t max_commands = 256;
+  uint32_t count, offset, i;
+  uint8_t expected;
+  int errors = 0;
+  int n;
+
+  for (n = 1; n < argc; n++) {
+    if (n + 1 < argc && strcmp(argv[n], "-n") == 0) {
+      max_commands = (uint32_t) strtoul(argv[++n], NULL, 0);
+      if (max_commands > MAX_COMMANDS) {
+        fprintf(stderr, "-n: up to %d\n", MAX_COMMANDS);
+        return 2;
+      }
+    } else {
+      fprintf(stderr, "usage: %s [-n max_commands]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(350);
+  for (i = 0; i < MAX_COMMANDS; i++) {
+    commands[i] = (uint32_t) rand() << 16 ^ (uint32_t) rand();
+  }
+
+  // Every byte value in every position of a one-command sequence.
+  for (i = 0; i < 256 * 4; i++) {
+    uint32_t word = (i & 0xFFu) << (8 * (i >> 8));
+    if (sequence_crc_table(&word, 1) != sequence_crc_bitwise(&word, 1)) {
+      printf("mismatch: command 0x%08X\n", (unsigned) word);
+      errors++;
+    }
+  }
+
+  for (count = 0; count <= max_commands; count++) {
+    offset = (uint32_t) rand() % (MAX_COMMANDS - count + 1);
+    expected = sequence_crc_bitwise(commands + offset, count);
+    if (sequence_crc_table(commands + offset, count) != expected
+        || Sweep_SequenceCrc(commands + offset, count) != expected) {
+      printf("mismatch: %u commands\n", (unsigned) count);
+      errors++;
+    }
+  }
+
+  printf("kernels: table %.2f ns/command, bitwise %.2f ns/command\n",
+         time_ns_per_command(sequence_crc_table),
+         time_ns_per_command(sequence_crc_bitwise));
+  printf("%s\n", errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}
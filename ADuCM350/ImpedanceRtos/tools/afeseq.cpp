@@ -0,0 +1,1107 @@
+// AFE sequence compiler.
+//
+// Turns the readable sequence descriptions in Sequences.seq (see the top of
+// that file for the commands) into const C arrays, with the command words,
+// command count and CRC-8 of the safety word computed here.  The CRC is the
+// one the sequencer computes, with the driver's own kernel (afe_seqcrc.h),
+// so the firmware can run the arrays straight from flash with the hardware
+// CRC check.
+// Comments are wrapped as Python's textwrap does, which the first version
+// of this compiler used, so the output did not change when it was ported.
+// With --check, writes nothing and exits non-zero if the outputs are not up
+// to date.
+//
+// build: c++ -O2 -I../../Eval-ADUCM350EBZ/inc -o afeseq afeseq.cpp
+// usage: afeseq Sequences.seq -o Sequences [--check]
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "afe_seqcrc.h"
+
+// Sequencer MMR write: bit 31 set, register address bits 7:2 in bits 30:25,
+// 24-bit value (SEQ_MMR_WRITE in afe.h).  Wait: bit 31 clear, 30-bit timer.
+#define MMR_WRITE 0x80000000u
+#define MMR_DATA_MASK 0x00FFFFFF
+#define WAIT_MAX_CYCLES 0x3FFFFFFF
+
+#define ACLK_HZ 16000000
+
+// DAC LSB size in mV, before attenuator (1.6V / (2^12 - 1)).
+#define DAC_LSB_SIZE_MV 0.39072
+
+// Registers reachable by the sequencer (offsets from REG_AFE_AFE_CFG).
+static const struct {
+  const char *name;
+  uint32_t offset;
+} registers[] = {
+    {"AFE_CFG", 0x00},
+    {"AFE_SEQ_CFG", 0x04},
+    {"AFE_FIFO_CFG", 0x08},
+    {"AFE_SW_CFG", 0x0C},
+    {"AFE_DAC_CFG", 0x10},
+    {"AFE_WG_CFG", 0x14},
+    {"AFE_WG_DCLEVEL_1", 0x18},
+    {"AFE_WG_DCLEVEL_2", 0x1C},
+    {"AFE_WG_DELAY_1", 0x20},
+    {"AFE_WG_SLOPE_1", 0x24},
+    {"AFE_WG_DELAY_2", 0x28},
+    {"AFE_WG_SLOPE_2", 0x2C},
+    {"AFE_WG_FCW", 0x30},
+    {"AFE_WG_PHASE", 0x34},
+    {"AFE_WG_OFFSET", 0x38},
+    {"AFE_WG_AMPLITUDE", 0x3C},
+    {"AFE_ADC_CFG", 0x40},
+    {"AFE_SUPPLY_LPF_CFG", 0x44},
+    {"AFE_SW_FULL_CFG_MSB", 0x48},
+    {"AFE_SW_FULL_CFG_LSB", 0x4C},
+    {"AFE_WG_DAC_CODE", 0x54},
+    {"AFE_ANALOG_CAPTURE_IEN", 0x8C},
+    {"AFE_ANALOG_GEN_IEN", 0x90},
+    {"AFE_CMD_FIFO_IEN", 0x94},
+    {"AFE_DATA_FIFO_IEN", 0x98},
+    {"AFE_ADCMIN", 0xB8},
+    {"AFE_ADCMAX", 0xBC},
+    {"AFE_ADCDELTA", 0xC0},
+};
+
+// AFE_SW_CFG switch mux fields: name, bit position.
+static const struct {
+  const char *key;
+  const char *field;
+  int position;
+} mux_fields[] = {
+    {"d", "DMUX_STATE", 0},
+    {"p", "PMUX_STATE", 4},
+    {"n", "NMUX_STATE", 8},
+    {"t", "TMUX_STATE", 12},
+};
+
+struct SequenceError {
+  std::string message;
+  explicit SequenceError(const std::string &m) : message(m) {}
+};
+
+// The value of an expression: an integer, or a number with a fraction once
+// '/' or a literal with a point is involved.
+struct Value {
+  bool is_int;
+  long long i;
+  double d;
+};
+
+struct Define {
+  std::string name;
+  Value value;
+  std::string comment;
+};
+
+struct Word {
+  bool is_section;  // A section comment, output only.
+  uint32_t word;
+  std::string comment;
+};
+
+struct Sequence {
+  std::string name;
+  std::string comment;
+  // Fragments are pieces for the firmware to assemble: no safety word.
+  bool fragment;
+  std::vector<Word> sections;  // Words and section comments.
+  std::vector<uint32_t> words;
+};
+
+static std::string format(const char *fmt, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static std::string format(const char *fmt, ...) {
+  char text[512];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+  return text;
+}
+
+static std::string join(const std::vector<std::string> &parts,
+                        const char *separator) {
+  std::string text;
+  size_t i;
+
+  for (i = 0; i < parts.size(); i++) {
+    if (i > 0) {
+      text += separator;
+    }
+    text += parts[i];
+  }
+  return text;
+}
+
+static std::string strip(const std::string &text) {
+  size_t start = 0;
+  size_t end = text.size();
+
+  while (start < end && isspace((unsigned char) text[start])) {
+    start++;
+  }
+  while (end > start && isspace((unsigned char) text[end - 1])) {
+    end--;
+  }
+  return text.substr(start, end - start);
+}
+
+static std::vector<std::string> split(const std::string &text) {
+  std::vector<std::string> words;
+  size_t i = 0;
+  size_t start;
+
+  while (i < text.size()) {
+    while (i < text.size() && isspace((unsigned char) text[i])) {
+      i++;
+    }
+    start = i;
+    while (i < text.size() && !isspace((unsigned char) text[i])) {
+      i++;
+    }
+    if (i > start) {
+      words.push_back(text.substr(start, i - start));
+    }
+  }
+  return words;
+}
+
+static double value_Double(const Value &value) {
+  return value.is_int ? (double) value.i : value.d;
+}
+
+static Value value_Int(long long i) {
+  Value value = {true, i, 0.0};
+  return value;
+}
+
+static Value value_Double(double d) {
+  Value value = {false, 0, d};
+  return value;
+}
+
+static long long value_Int(const Value &value, const char *what) {
+  if (!value.is_int) {
+    throw SequenceError(format("%s must be an integer", what));
+  }
+  return value.i;
+}
+
+// As Python's %d: a fraction is cut off.
+static long long value_Truncate(const Value &value) {
+  return value.is_int ? value.i : (long long) value.d;
+}
+
+// As Python's repr(): the shortest digits that read back the same.
+static std::string value_Text(const Value &value) {
+  char digits[32];
+  char *exponent;
+  std::string mantissa;
+  std::string text;
+  int precision;
+  int e;
+
+  if (value.is_int) {
+    return format("%lld", value.i);
+  }
+  for (precision = 1; precision < 17; precision++) {
+    snprintf(digits, sizeof(digits), "%.*e", precision - 1, value.d);
+    if (strtod(digits, NULL) == value.d) {
+      break;
+    }
+  }
+  snprintf(digits, sizeof(digits), "%.*e", precision - 1, value.d);
+  exponent = strchr(digits, 'e');
+  e = atoi(exponent + 1);
+  *exponent = '\0';
+  for (char *c = digits; *c != '\0'; c++) {
+    if (isdigit((unsigned char) *c)) {
+      mantissa += *c;
+    }
+  }
+  text = value.d < 0 ? "-" : "";
+  if (e < -4 || e >= 16) {
+    text += mantissa.substr(0, 1);
+    if (mantissa.size() > 1) {
+      text += "." + mantissa.substr(1);
+    }
+    return text + format("e%c%02d", e < 0 ? '-' : '+', abs(e));
+  }
+  if (e < 0) {
+    return text + "0." + std::string(-e - 1, '0') + mantissa;
+  }
+  if ((int) mantissa.size() <= e + 1) {
+    return text + mantissa + std::string(e + 1 - mantissa.size(), '0') + ".0";
+  }
+  return text + mantissa.substr(0, e + 1) + "." + mantissa.substr(e + 1);
+}
+
+// Integers, defines and + - * / // ( ) only, with Python's meaning: '/'
+// gives a fraction and '//' rounds down.
+class Expression {
+ public:
+  Expression(const std::string &text, const std::vector<Define> &defines)
+      : text_(text), defines_(defines), pos_(0) {}
+
+  Value Evaluate() {
+    Value value;
+    size_t i;
+
+    for (i = 0; i < text_.size(); i++) {
+      if (!isalnum((unsigned char) text_[i]) && text_[i] != '_'
+          && !isspace((unsigned char) text_[i])
+          && strchr("+-*/().", text_[i]) == NULL) {
+        Fail();
+      }
+    }
+    value = Sum();
+    Skip();
+    if (pos_ != text_.size()) {
+      Fail();
+    }
+    return value;
+  }
+
+ private:
+  void Fail() { throw SequenceError("bad expression: " + text_); }
+
+  void Skip() {
+    while (pos_ < text_.size() && isspace((unsigned char) text_[pos_])) {
+      pos_++;
+    }
+  }
+
+  bool Take(const char *op) {
+    size_t n = strlen(op);
+
+    Skip();
+    if (text_.compare(pos_, n, op) != 0) {
+      return false;
+    }
+    // '/' is not the start of '//', nor '*' of '**'.
+    if (n == 1 && pos_ + 1 < text_.size() && text_[pos_ + 1] == op[0]
+        && (op[0] == '/' || op[0] == '*')) {
+      return false;
+    }
+    pos_ += n;
+    return true;
+  }
+
+  Value Sum() {
+    Value value = Product();
+    Value right;
+
+    for (;;) {
+      if (Take("+")) {
+        right = Product();
+        value = value.is_int && right.is_int
+                    ? value_Int(value.i + right.i)
+                    : value_Double(value_Double(value) + value_Double(right));
+      } else if (Take("-")) {
+        right = Product();
+        value = value.is_int && right.is_int
+                    ? value_Int(value.i - right.i)
+                    : value_Double(value_Double(value) - value_Double(right));
+      } else {
+        return value;
+      }
+    }
+  }
+
+  Value Product() {
+    Value value = Unary();
+    Value right;
+    long long quotient;
+
+    for (;;) {
+      if (Take("*")) {
+        right = Unary();
+        value = value.is_int && right.is_int
+                    ? value_Int(value.i * right.i)
+                    : value_Double(value_Double(value) * value_Double(right));
+      } else if (Take("//")) {
+        right = Unary();
+        if (value_Double(right) == 0.0) {
+          Fail();
+        }
+        if (value.is_int && right.is_int) {
+          quotient = value.i / right.i;
+          if ((value.i % right.i != 0) && ((value.i < 0) != (right.i < 0))) {
+            quotient--;
+          }
+          value = value_Int(quotient);
+        } else {
+          value = value_Double(floor(value_Double(value) / value_Double(right)));
+        }
+      } else if (Take("/")) {
+        right = Unary();
+        if (value_Double(right) == 0.0) {
+          Fail();
+        }
+        value = value_Double(value_Double(value) / value_Double(right));
+      } else {
+        return value;
+      }
+    }
+  }
+
+  Value Unary() {
+    Value value;
+
+    if (Take("-")) {
+      value = Unary();
+      return value.is_int ? value_Int(-value.i) : value_Double(-value.d);
+    }
+    if (Take("+")) {
+      return Unary();
+    }
+    return Primary();
+  }
+
+  Value Primary() {
+    std::string token;
+    size_t start;
+    size_t i;
+    char *end;
+
+    if (Take("(")) {
+      Value value = Sum();
+      if (!Take(")")) {
+        Fail();
+      }
+      return value;
+    }
+    Skip();
+    start = pos_;
+    while (pos_ < text_.size()
+           && (isalnum((unsigned char) text_[pos_]) || text_[pos_] == '_'
+               || text_[pos_] == '.')) {
+      pos_++;
+    }
+    token = text_.substr(start, pos_ - start);
+    if (token.empty()) {
+      Fail();
+    }
+    if (isalpha((unsigned char) token[0]) || token[0] == '_') {
+      // The last define of that name.
+      for (i = defines_.size(); i-- > 0;) {
+        if (defines_[i].name == token) {
+          return defines_[i].value;
+        }
+      }
+      Fail();
+    }
+    if (token.size() > 2 && token[0] == '0'
+        && (token[1] == 'x' || token[1] == 'X')) {
+      unsigned long long value = strtoull(token.c_str() + 2, &end, 16);
+      if (*end != '\0') {
+        Fail();
+      }
+      return value_Int((long long) value);
+    }
+    if (token.find('.') != std::string::npos) {
+      double value = strtod(token.c_str(), &end);
+      if (*end != '\0' || token == ".") {
+        Fail();
+      }
+      return value_Double(value);
+    }
+    for (i = 0; i < token.size(); i++) {
+      if (!isdigit((unsigned char) token[i])) {
+        Fail();
+      }
+    }
+    // No octal: "010" is an error, as in Python.
+    if (token.size() > 1 && token[0] == '0'
+        && token.find_first_not_of('0') != std::string::npos) {
+      Fail();
+    }
+    return value_Int(strtoll(token.c_str(), NULL, 10));
+  }
+
+  std::string text_;
+  const std::vector<Define> &defines_;
+  size_t pos_;
+};
+
+static Value evaluate(const std::string &text,
+                      const std::vector<Define> &defines) {
+  return Expression(text, defines).Evaluate();
+}
+
+static uint32_t safety_Word(const Sequence &sequence) {
+  uint8_t crc = ADI_AFE_SEQ_CRC8_INITIAL;
+  size_t i;
+
+  if (sequence.words.size() > 0xFFFF) {
+    throw SequenceError(sequence.name + " is too long");
+  }
+  for (i = 0; i < sequence.words.size(); i++) {
+    crc = adi_AFE_SeqCrc8Word(crc, sequence.words[i]);
+  }
+  return (uint32_t) (sequence.words.size() << 16) | crc;
+}
+
+static uint32_t mmr_Write(const std::string &name, long long value) {
+  size_t i;
+
+  for (i = 0; i < sizeof(registers) / sizeof(registers[0]); i++) {
+    if (name == registers[i].name) {
+      break;
+    }
+  }
+  if (i == sizeof(registers) / sizeof(registers[0])) {
+    throw SequenceError("unknown register " + name);
+  }
+  if (value < 0 || value > MMR_DATA_MASK) {
+    throw SequenceError(format("%s value 0x%llX does not fit 24 bits",
+                               name.c_str(), value));
+  }
+  return MMR_WRITE | (registers[i].offset << 23) | (uint32_t) value;
+}
+
+// frequency * 2^26 / 16 MHz, rounded, as FCW in MainTask.c used to be.
+static long long fcw(const Value &frequency) {
+  long long numerator;
+  long long quotient;
+
+  if (!frequency.is_int) {
+    return (long long) floor((frequency.d * (1 << 26) + ACLK_HZ / 2)
+                             / ACLK_HZ);
+  }
+  numerator = frequency.i * (1 << 26) + ACLK_HZ / 2;
+  quotient = numerator / ACLK_HZ;
+  if (numerator % ACLK_HZ != 0 && numerator < 0) {
+    quotient--;
+  }
+  return quotient;
+}
+
+static long long sine_Amplitude(const Value &vpeak_mv) {
+  return (long long) (value_Double(vpeak_mv) / DAC_LSB_SIZE_MV + 0.5);
+}
+
+static bool ends_With(const std::string &text, const char *suffix) {
+  size_t n = strlen(suffix);
+
+  return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
+}
+
+static long long wait_Cycles(const std::string &text,
+                             const std::vector<Define> &defines) {
+  static const char *const units[] = {"us", "ms", "cycles"};
+  double cycles;
+  Value value;
+  size_t unit;
+
+  for (unit = 0; unit < 3; unit++) {
+    if (ends_With(text, units[unit])) {
+      break;
+    }
+  }
+  if (unit == 3) {
+    throw SequenceError("wait needs a unit (us, ms or cycles): " + text);
+  }
+  value = evaluate(
+      strip(text.substr(0, text.size() - strlen(units[unit]))), defines);
+  if (unit == 0) {
+    cycles = value_Double(value) * ACLK_HZ / 1e6;
+  } else if (unit == 1) {
+    cycles = value_Double(value) * ACLK_HZ / 1e3;
+  } else {
+    cycles = value_Double(value);
+  }
+  // Halves go to even, as Python's round().
+  cycles = nearbyint(cycles);
+  if (cycles < 0 || cycles > WAIT_MAX_CYCLES) {
+    throw SequenceError("wait " + text + " out of range");
+  }
+  return (long long) cycles;
+}
+
+static std::string format_Time(long long cycles) {
+  double us = cycles * 1e6 / ACLK_HZ;
+
+  if (us >= 1000) {
+    return format("%gms", us / 1000);
+  }
+  return format("%gus", us);
+}
+
+static void sequence_Add(Sequence &sequence, uint32_t word,
+                         const std::string &comment) {
+  Word entry = {false, word, comment};
+
+  sequence.sections.push_back(entry);
+}
+
+static void compile_Command(Sequence &sequence,
+                            const std::vector<std::string> &words,
+                            const std::string &comment,
+                            const std::vector<Define> &defines) {
+  const std::string &command = words[0];
+  std::vector<std::string> args(words.begin() + 1, words.end());
+  std::vector<std::pair<std::string, std::string> > states;
+  std::vector<std::string> text;
+  uint32_t word;
+  long long value;
+  long long state;
+  size_t i;
+  size_t j;
+
+  if (command == "write") {
+    if (args.size() < 2) {
+      throw SequenceError("write REGISTER value");
+    }
+    value = value_Int(
+        evaluate(join(std::vector<std::string>(args.begin() + 1, args.end()),
+                      " "),
+                 defines),
+        "write value");
+    word = mmr_Write(args[0], value);
+    sequence_Add(sequence, word,
+                 !comment.empty() ? comment
+                 : format("%s = 0x%llX", args[0].c_str(), value));
+  } else if (command == "fcw") {
+    Value frequency = evaluate(join(args, " "), defines);
+    word = mmr_Write("AFE_WG_FCW", fcw(frequency));
+    sequence_Add(sequence, word,
+                 !comment.empty() ? comment
+                 : format("AFE_WG_FCW: SINE_FCW = %lld (%lld Hz)",
+                          fcw(frequency), value_Truncate(frequency)));
+  } else if (command == "amplitude") {
+    Value vpeak = evaluate(join(args, " "), defines);
+    word = mmr_Write("AFE_WG_AMPLITUDE", sine_Amplitude(vpeak));
+    sequence_Add(sequence, word,
+                 !comment.empty() ? comment
+                 : format("AFE_WG_AMPLITUDE: SINE_AMPLITUDE = %lld (%g mV)",
+                          sine_Amplitude(vpeak), value_Double(vpeak)));
+  } else if (command == "mux") {
+    for (i = 0; i < args.size(); i++) {
+      size_t equals = args[i].find('=');
+
+      if (equals == std::string::npos) {
+        throw SequenceError("mux needs d=, p=, n= and t=");
+      }
+      for (j = 0; j < states.size(); j++) {
+        if (states[j].first == args[i].substr(0, equals)) {
+          break;
+        }
+      }
+      if (j == states.size()) {
+        states.push_back(std::make_pair(args[i].substr(0, equals), ""));
+      }
+      states[j].second = args[i].substr(equals + 1);
+    }
+    value = 0;
+    for (i = 0; i < sizeof(mux_fields) / sizeof(mux_fields[0]); i++) {
+      for (j = 0; j < states.size(); j++) {
+        if (states[j].first == mux_fields[i].key) {
+          break;
+        }
+      }
+      if (j == states.size()) {
+        throw SequenceError("mux needs d=, p=, n= and t=");
+      }
+      state = value_Int(evaluate(states[j].second, defines), "mux state");
+      states.erase(states.begin() + j);
+      if (state < 0 || state > 0xF) {
+        throw SequenceError(format("mux state %lld out of range", state));
+      }
+      value |= state << mux_fields[i].position;
+      text.push_back(format("%s = %lld", mux_fields[i].field, state));
+    }
+    if (!states.empty()) {
+      std::vector<std::string> names;
+
+      for (j = 0; j < states.size(); j++) {
+        names.push_back(states[j].first);
+      }
+      throw SequenceError("unknown mux field " + join(names, ", "));
+    }
+    word = mmr_Write("AFE_SW_CFG", value);
+    sequence_Add(sequence, word,
+                 !comment.empty() ? comment
+                                  : "AFE_SW_CFG: " + join(text, ", "));
+  } else if (command == "wait") {
+    value = wait_Cycles(join(args, " "), defines);
+    sequence_Add(sequence, (uint32_t) value,
+                 !comment.empty() ? comment : "Wait " + format_Time(value));
+  } else if (command == "stop") {
+    sequence_Add(sequence, mmr_Write("AFE_SEQ_CFG", 0x2),
+                 !comment.empty() ? comment : "AFE_SEQ_CFG: SEQ_EN = 0");
+  } else {
+    throw SequenceError("unknown command " + command);
+  }
+}
+
+// Reads the defines and sequences, both in file order.
+static void parse(FILE *file, std::vector<Define> &defines,
+                  std::vector<Sequence> &sequences) {
+  std::vector<std::pair<Value, size_t> > repeats;  // Count, start.
+  std::vector<std::string> pending;  // Attached to the next item or word.
+  std::vector<std::string> words;
+  std::string line;
+  std::string text;
+  std::string comment;
+  Sequence sequence;
+  bool in_sequence = false;
+  char buffer[1024];
+  int number = 0;
+  size_t hash;
+  size_t i;
+
+  while (fgets(buffer, sizeof(buffer), file) != NULL) {
+    line = buffer;
+    // A line longer than the buffer comes in pieces.
+    while (line[line.size() - 1] != '\n'
+           && fgets(buffer, sizeof(buffer), file) != NULL) {
+      line += buffer;
+    }
+    number++;
+    hash = line.find('#');
+    text = line.substr(0, hash);
+    comment = hash == std::string::npos ? "" : strip(line.substr(hash + 1));
+    words = split(text);
+    try {
+      if (words.empty()) {
+        if (strip(line).empty()) {
+          pending.clear();
+        } else if (!comment.empty()) {
+          pending.push_back(comment);
+        }
+        continue;
+      }
+
+      if (words[0] == "define") {
+        if (in_sequence || words.size() < 3) {
+          throw SequenceError("define NAME value, outside sequences");
+        }
+        Define define;
+        define.name = words[1];
+        define.value = evaluate(
+            join(std::vector<std::string>(words.begin() + 2, words.end()),
+                 " "),
+            defines);
+        define.comment = join(pending, " ");
+        defines.push_back(define);
+      } else if (words[0] == "sequence" || words[0] == "fragment") {
+        if (in_sequence || words.size() != 2) {
+          throw SequenceError(words[0] + " NAME, outside sequences");
+        }
+        sequence = Sequence();
+        sequence.name = words[1];
+        sequence.comment = join(pending, " ");
+        sequence.fragment = words[0] == "fragment";
+        in_sequence = true;
+      } else if (!in_sequence) {
+        throw SequenceError(words[0] + " outside a sequence");
+      } else if (words[0] == "end") {
+        if (!repeats.empty()) {
+          throw SequenceError("repeat without endrepeat");
+        }
+        // Section comments only live in the output, not in the commands.
+        for (i = 0; i < sequence.sections.size(); i++) {
+          if (!sequence.sections[i].is_section) {
+            sequence.words.push_back(sequence.sections[i].word);
+          }
+        }
+        sequences.push_back(sequence);
+        in_sequence = false;
+      } else if (words[0] == "repeat") {
+        repeats.push_back(std::make_pair(
+            evaluate(join(std::vector<std::string>(words.begin() + 1,
+                                                   words.end()),
+                          " "),
+                     defines),
+            sequence.sections.size()));
+      } else if (words[0] == "endrepeat") {
+        if (repeats.empty()) {
+          throw SequenceError("endrepeat without repeat");
+        }
+        Value count_value = repeats.back().first;
+        size_t start = repeats.back().second;
+        size_t end = sequence.sections.size();
+        repeats.pop_back();
+        if (value_Double(count_value) < 1) {
+          throw SequenceError("repeat count must be at least 1");
+        }
+        long long count = value_Int(count_value, "repeat count");
+        for (; count > 1; count--) {
+          for (i = start; i < end; i++) {
+            sequence.sections.push_back(sequence.sections[i]);
+          }
+        }
+      } else {
+        if (!pending.empty()) {
+          // Section comment: shown in front of the next word.
+          Word section = {true, 0, join(pending, " ")};
+          sequence.sections.push_back(section);
+        }
+        compile_Command(sequence, words, comment, defines);
+      }
+      pending.clear();
+    } catch (const SequenceError &error) {
+      throw SequenceError(format("line %d: %s", number,
+                                 error.message.c_str()));
+    }
+  }
+  if (in_sequence) {
+    throw SequenceError("sequence " + sequence.name + " without end");
+  }
+}
+
+// Word wrapping as Python's textwrap.wrap(), with its defaults: chunks are
+// runs of spaces and words, words are also broken after the hyphen of a
+// hyphenated word, and a word longer than a line is cut.
+static bool is_Word(char c) {
+  return isalnum((unsigned char) c) || c == '_';
+}
+
+static bool is_Letter(char c) {
+  return isalpha((unsigned char) c) || c == '_';
+}
+
+static std::vector<std::string> wrap_Chunks(const std::string &text) {
+  std::vector<std::string> chunks;
+  size_t n = text.size();
+  size_t pos = 0;
+  size_t dashes;
+  size_t j;
+
+  // Pads: at(i) is '\0' past either end.
+  auto at = [&](long i) -> char {
+    return i < 0 || (size_t) i >= n ? '\0' : text[(size_t) i];
+  };
+  auto is_Punctuated = [&](char c) {
+    return is_Word(c) || (c != '\0' && strchr("!\"'&.,?", c) != NULL);
+  };
+  auto em_Dash = [&](size_t i) {
+    for (dashes = 0; at((long) (i + dashes)) == '-'; dashes++) {
+    }
+    return dashes >= 2 && is_Word(at((long) (i + dashes)));
+  };
+
+  while (pos < n) {
+    if (text[pos] == ' ') {
+      for (j = pos; j < n && text[j] == ' '; j++) {
+      }
+    } else if (is_Punctuated(at((long) pos - 1)) && em_Dash(pos)) {
+      j = pos + dashes;
+    } else {
+      for (j = pos + 1;; j++) {
+        long h = (long) j;
+
+        if (at(h) == '-'
+            && ((is_Letter(at(h - 2)) && is_Letter(at(h - 1)))
+                || (is_Letter(at(h - 3)) && at(h - 2) == '-'
+                    && is_Letter(at(h - 1))))
+            && is_Letter(at(h + 1))
+            && (is_Letter(at(h + 2))
+                || (at(h + 2) == '-' && is_Letter(at(h + 3))))) {
+          j++;
+          break;
+        }
+        if (j >= n || text[j] == ' ') {
+          break;
+        }
+        if (is_Punctuated(at(h - 1)) && em_Dash(j)) {
+          break;
+        }
+      }
+    }
+    chunks.push_back(text.substr(pos, j - pos));
+    pos = j;
+  }
+  return chunks;
+}
+
+static std::vector<std::string> wrap(const std::string &text, size_t width,
+                                     const std::string &initial_indent = "",
+                                     const std::string &subsequent_indent =
+                                         "") {
+  std::vector<std::string> lines;
+  std::vector<std::string> chunks;
+  std::vector<std::string> line;
+  std::string munged;
+  std::string indent;
+  size_t length;
+  size_t room;
+  size_t end;
+  size_t hyphen;
+  size_t next = 0;
+
+  // Tabs to 8 columns, any other white space to a space.
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\t') {
+      munged.append(8 - munged.size() % 8, ' ');
+    } else {
+      munged += isspace((unsigned char) text[i]) ? ' ' : text[i];
+    }
+  }
+  chunks = wrap_Chunks(munged);
+
+  while (next < chunks.size()) {
+    indent = lines.empty() ? initial_indent : subsequent_indent;
+    room = width > indent.size() ? width - indent.size() : 0;
+    line.clear();
+    length = 0;
+    if (strip(chunks[next]).empty() && !lines.empty()) {
+      next++;
+    }
+    while (next < chunks.size() && length + chunks[next].size() <= room) {
+      length += chunks[next].size();
+      line.push_back(chunks[next++]);
+    }
+    if (next < chunks.size() && chunks[next].size() > room) {
+      // Cut the long word, after a hyphen in it if there is one.
+      end = room < 1 ? 1 : room - length;
+      hyphen = end > 0 ? chunks[next].rfind('-', end - 1) : std::string::npos;
+      if (hyphen != std::string::npos && hyphen > 0
+          && chunks[next].find_first_not_of('-') < hyphen) {
+        end = hyphen + 1;
+      }
+      line.push_back(chunks[next].substr(0, end));
+      chunks[next].erase(0, end);
+    }
+    if (!line.empty() && strip(line.back()).empty()) {
+      line.pop_back();
+    }
+    if (!line.empty()) {
+      lines.push_back(indent + join(line, ""));
+    }
+  }
+  return lines;
+}
+
+// One /* */ per line, as the hand-written sequences in MainTask.c.
+static void c_Comment(std::vector<std::string> &out, const std::string &text,
+                      const std::string &indent) {
+  std::vector<std::string> lines = wrap(text, 74 - indent.size());
+  size_t i;
+
+  for (i = 0; i < lines.size(); i++) {
+    out.push_back(indent + "/* " + lines[i] + " */");
+  }
+}
+
+static void c_Word(std::vector<std::string> &out, uint32_t word,
+                   const std::string &comment) {
+  std::string prefix = format("    0x%08X, /* ", word);
+  std::vector<std::string> lines =
+      wrap(comment + " */", 80, prefix, std::string(prefix.size(), ' '));
+
+  out.insert(out.end(), lines.begin(), lines.end());
+}
+
+static std::string upper(std::string text) {
+  size_t i;
+
+  for (i = 0; i < text.size(); i++) {
+    text[i] = (char) toupper((unsigned char) text[i]);
+  }
+  return text;
+}
+
+static std::string emit_Header(const std::vector<Define> &defines,
+                               const std::vector<Sequence> &sequences,
+                               const std::string &source,
+                               const std::string &guard) {
+  std::vector<std::string> out;
+  size_t i;
+
+  out.push_back("/* Generated by tools/afeseq.cpp from " + source
+                + "; do not edit. */");
+  out.push_back("");
+  out.push_back("#ifndef " + guard);
+  out.push_back("#define " + guard);
+  out.push_back("");
+  out.push_back("#include <stdint.h>");
+  out.push_back("");
+  for (i = 0; i < defines.size(); i++) {
+    if (!defines[i].comment.empty()) {
+      c_Comment(out, defines[i].comment, "");
+    }
+    out.push_back("#define " + defines[i].name + " ("
+                  + value_Text(defines[i].value) + ")");
+  }
+  out.push_back("");
+  for (i = 0; i < sequences.size(); i++) {
+    const Sequence &sequence = sequences[i];
+
+    if (!sequence.comment.empty()) {
+      c_Comment(out, sequence.comment, "");
+    }
+    out.push_back(format("#define %s_LENGTH (%d)",
+                         upper(sequence.name).c_str(),
+                         (int) sequence.words.size() + !sequence.fragment));
+    out.push_back("extern const uint32_t " + sequence.name + "["
+                  + upper(sequence.name) + "_LENGTH];");
+    out.push_back("");
+  }
+  out.push_back("#endif /* " + guard + " */");
+  return join(out, "\n") + "\n";
+}
+
+static std::string emit_Source(const std::vector<Sequence> &sequences,
+                               const std::string &source,
+                               const std::string &header) {
+  std::vector<std::string> out;
+  uint32_t safety;
+  size_t i;
+  size_t j;
+
+  out.push_back("/* Generated by tools/afeseq.cpp from " + source
+                + "; do not edit. */");
+  out.push_back("");
+  out.push_back("#include \"" + header + "\"");
+  for (i = 0; i < sequences.size(); i++) {
+    const Sequence &sequence = sequences[i];
+
+    out.push_back("");
+    out.push_back("const uint32_t " + sequence.name + "["
+                  + upper(sequence.name) + "_LENGTH] = {");
+    if (!sequence.fragment) {
+      safety = safety_Word(sequence);
+      c_Word(out, safety,
+             format("Safety word: command count = %d, CRC = 0x%02X",
+                    (int) sequence.words.size(), safety & 0xFFu));
+    }
+    for (j = 0; j < sequence.sections.size(); j++) {
+      if (sequence.sections[j].is_section) {
+        c_Comment(out, sequence.sections[j].comment, "    ");
+      } else {
+        c_Word(out, sequence.sections[j].word, sequence.sections[j].comment);
+      }
+    }
+    out.push_back("};");
+  }
+  return join(out, "\n") + "\n";
+}
+
+static std::string base_Name(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// The file's text, with "\r\n" read as "\n"; false if it can't be read.
+static bool read_File(const std::string &path, std::string &text) {
+  FILE *file = fopen(path.c_str(), "rb");
+  int c;
+
+  if (file == NULL) {
+    return false;
+  }
+  text.clear();
+  while ((c = fgetc(file)) != EOF) {
+    if (c == '\n' && !text.empty() && text[text.size() - 1] == '\r') {
+      text[text.size() - 1] = '\n';
+    } else {
+      text += (char) c;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::pair<std::string, std::string> > outputs;
+  std::vector<std::string> stale;
+  std::vector<Sequence> sequences;
+  std::vector<Define> defines;
+  std::string existing;
+  std::string name;
+  std::string guard;
+  const char *input = NULL;
+  const char *output = NULL;
+  bool check = false;
+  FILE *file;
+  size_t i;
+
+  for (i = 1; i < (size_t) argc; i++) {
+    if (i + 1 < (size_t) argc
+        && (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0)) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "--check") == 0) {
+      check = true;
+    } else if (argv[i][0] != '-' && input == NULL) {
+      input = argv[i];
+    } else {
+      input = NULL;
+      break;
+    }
+  }
+  if (input == NULL || output == NULL) {
+    fprintf(stderr, "usage: %s input.seq -o output [--check]\n", argv[0]);
+    return 2;
+  }
+
+  file = fopen(input, "r");
+  if (file == NULL) {
+    perror(input);
+    return 1;
+  }
+  try {
+    parse(file, defines, sequences);
+    fclose(file);
+
+    // Sequences.h guards with __SEQUENCES_H__, SessionStore.h with
+    // __SESSION_STORE_H__.
+    name = base_Name(output);
+    guard = "__";
+    for (i = 0; i < name.size(); i++) {
+      if (i > 0 && isupper((unsigned char) name[i])) {
+        guard += '_';
+      }
+      guard += (char) toupper((unsigned char) name[i]);
+    }
+    guard += "_H__";
+    outputs.push_back(std::make_pair(
+        std::string(output) + ".c",
+        emit_Source(sequences, base_Name(input), name + ".h")));
+    outputs.push_back(std::make_pair(
+        std::string(output) + ".h",
+        emit_Header(defines, sequences, base_Name(input), guard)));
+  } catch (const SequenceError &error) {
+    fprintf(stderr, "%s: %s\n", input, error.message.c_str());
+    return 1;
+  }
+
+  for (i = 0; i < outputs.size(); i++) {
+    if (check) {
+      if (!read_File(outputs[i].first, existing)
+          || existing != outputs[i].second) {
+        stale.push_back(outputs[i].first);
+      }
+    } else {
+      file = fopen(outputs[i].first.c_str(), "wb");
+      if (file == NULL
+          || fwrite(outputs[i].second.data(), 1, outputs[i].second.size(),
+                    file) != outputs[i].second.size()
+          || fclose(file) != 0) {
+        perror(outputs[i].first.c_str());
+        return 1;
+      }
+    }
+  }
+  if (!stale.empty()) {
+    fprintf(stderr, "out of date: %s\n", join(stale, ", ").c_str());
+    return 1;
+  }
+  return 0;
+}
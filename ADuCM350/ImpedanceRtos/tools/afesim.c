@@ -0,0 +1,439 @@
+// Checks the simulated AFE (aducm350/AfeSim.h) against the unmodified
+// afe.c, and benchmarks the path of a DFT result to MainTask on the host.
+//
+// First seq_afe_acmeas2wire runs in blocking mode, as MainTask runs it at
+// start-up: its four results must be the DFTs the AFE made, RCAL first,
+// and the driver's sequencer CRC and count check must pass.  Then the
+// measurement loop runs for -t simulated seconds at each output rate in -r
+// (mHz, comma separated), and a task at MainTask's priority takes the
+// results as MainTask does: one DFT_RESULT_READY interrupt per result, or
+// with -b through the data FIFO and RX DMA a block at a time (DftBlock),
+// then through DftRing.  Every result must reach the task with the values
+// the AFE made, none lost, and the body results must come as fast as the
+// loop sequence runs.  Prints the results per second, the latency from the
+// result to the ISR and to the task, the deepest the ring got and the
+// sequencer counts.  -s runs the AFE that many times faster, -w is the
+// task's work per result in microseconds, -c the CPU scale (simulated ns
+// per host ns), -n the noise in DFT counts, and -f replays recorded
+// results (see AfeSim.h).  Exits non-zero on any failure.
+//
+// build: cc -O2 $SIM -o afesim afesim.c aducm350/ChipSim.c aducm350/AfeSim.c
+//        ../DftRing.c ../DftBlock.c ../DftRate.c ../Sequences.c
+//        $E/src/afe.c $E/src/adi_int.c $E/src/adi_nvic.c
+//        $(ls $O/*.c | grep -v _tls) $E/osal/uCOS-II/Ports/*.c
+//        $U/Source/ucos_ii.c $U/Ports/POSIX/GNU/os_cpu_c.c -lm
+//        with E, U, O and SIM as in Readme.txt, "Simulated AFE"
+// usage: afesim [-t seconds] [-r rate_mhz[,rate_mhz...]] [-b] [-s afe_speed]
+//               [-w work_us] [-c cpu_scale] [-n noise] [-f replay_file]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ucos_ii.h>
+
+#include "afe.h"
+#include "adi_rtos.h"
+
+#include "AfeSim.h"
+#include "ChipSim.h"
+#include "DftBlock.h"
+#include "DftRate.h"
+#include "DftRing.h"
+#include "Sequences.h"
+
+#define MAIN_PRIO 5
+#define MAX_RATES 16
+#define MAX_EVENTS 200000
+
+static OS_STK main_stack[512];
+
+static ADI_AFE_DEV_HANDLE hDevice;
+static OS_EVENT *dft_semaphore;
+static DftRing dft_ring;
+static DftBlock dft_block;
+static DftRatePlan dft_rate;
+static uint32_t seq_afe_loop[DFT_RATE_MAX_LENGTH];
+static volatile bool afe_loop_running;
+
+static double seconds = 5.0, work_us = 200.0;
+static bool use_blocks;
+static uint32_t rates[MAX_RATES];
+static int rate_count;
+static int errors;
+
+// Latencies of the current rate, in us, from the DFT result to the ISR and
+// to the task.
+static uint32_t isr_us[MAX_EVENTS];
+static uint32_t isr_count;
+static uint32_t task_us[MAX_EVENTS];
+static uint32_t task_count;
+
+// The application hooks this os_cfg.h asks for.
+void App_TaskCreateHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskDelHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskIdleHook(void) {}
+void App_TaskReturnHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskStatHook(void) {}
+void App_TaskSwHook(void) {}
+void App_TCBInitHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TimeTickHook(void) {}
+void App_TraceIsrEnter(uint32_t irq) { (void) irq; }
+void App_TraceIsrExit(uint32_t irq) { (void) irq; }
+
+static uint32_t now_us(void) {
+  return (uint32_t) (OS_CPU_SimTimeNs() / 1000u);
+}
+
+// Spins for about us simulated microseconds, calling nothing but the clock.
+static void busy(double us) {
+  INT64U end = OS_CPU_SimTimeNs() + (INT64U) (us * 1000.0);
+  volatile double x = 1.0;
+  int i;
+
+  while (OS_CPU_SimTimeNs() < end) {
+    for (i = 0; i < 100; i++) {
+      x = x * 1.0000001 + 1e-9;
+    }
+  }
+}
+
+// As in MainTask.c, with the latency noted.
+static void AFE_DFT_Callback(void *pCBParam, uint32_t Event, void *pArg) {
+  AfeSimResult result;
+
+  OSIntEnter();
+  if (AfeSim_Result(AfeSim_Stats()->dfts - 1, &result)
+      && isr_count < MAX_EVENTS) {
+    isr_us[isr_count++] = (uint32_t) ((OS_CPU_SimTimeNs() - result.at) / 1000u);
+  }
+  if (DftRing_Push(&dft_ring, (int16_t) pADI_AFE->AFE_DFT_RESULT_REAL,
+                   (int16_t) pADI_AFE->AFE_DFT_RESULT_IMAG, now_us())) {
+    OSSemPost(dft_semaphore);
+  }
+  OSIntExit();
+}
+
+static void AFE_DFT_BlockCallback(void *pCBParam, uint32_t Event,
+                                  void *pArg) {
+  ADI_AFE_DEV_HANDLE hDevice = (ADI_AFE_DEV_HANDLE) pCBParam;
+  AfeSimResult result;
+
+  OSIntEnter();
+  if (AfeSim_Result(AfeSim_Stats()->dfts - 1, &result)
+      && isr_count < MAX_EVENTS) {
+    isr_us[isr_count++] = (uint32_t) ((OS_CPU_SimTimeNs() - result.at) / 1000u);
+  }
+  adi_AFE_ProgramRxDMA(hDevice, DftBlock_Next(&dft_block), DFT_BLOCK_WORDS);
+  ADI_ENABLE_INT(DMA_AFE_RX_IRQn);
+  if (DftBlock_Publish(&dft_block, &dft_ring, now_us())) {
+    OSSemPost(dft_semaphore);
+  }
+  OSIntExit();
+}
+
+static void AFE_Loop_TxCallback(void *pCBParam, uint32_t Event, void *pArg) {
+  ADI_AFE_DEV_HANDLE hDevice = (ADI_AFE_DEV_HANDLE) pCBParam;
+
+  if (afe_loop_running) {
+    adi_AFE_ProgramTxDMA(hDevice, NULL, 0);
+    ADI_ENABLE_INT(DMA_AFE_TX_IRQn);
+  }
+}
+
+static int compare(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+static void print_Latency(const char *name, uint32_t *us, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+  qsort(us, count, sizeof(us[0]), compare);
+  printf("  %s latency us: p50 %u  p99 %u  p99.9 %u  max %u\n", name,
+         (unsigned) us[count / 2], (unsigned) us[count * 99 / 100],
+         (unsigned) us[count * 999 / 1000], (unsigned) us[count - 1]);
+}
+
+// The time one pass of the loop sequence takes the AFE: a cycle per
+// command, and the waits.
+static double loop_Ns(const uint32_t *sequence, double afe_speed) {
+  uint32_t i, cycles = 0, length = sequence[0] >> 16;
+
+  for (i = 1; i <= length; i++) {
+    if (sequence[i] & 0x80000000u) {
+      cycles++;
+    } else {
+      cycles += (sequence[i] & 0x3FFFFFFFu) ? sequence[i] & 0x3FFFFFFFu : 1;
+    }
+  }
+  return cycles * 62.5 / afe_speed;
+}
+
+// seq_afe_acmeas2wire in blocking mode, as MainTask starts.
+static void check_Blocking(void) {
+  uint16_t results[8];
+  uint64_t first = AfeSim_Stats()->dfts;
+  AfeSimResult result;
+  int i;
+
+  if (adi_AFE_RunSequence(hDevice, seq_afe_acmeas2wire, results, 8)) {
+    printf("seq_afe_acmeas2wire failed: CRC 0x%02X, %u commands\n",
+           (unsigned) pADI_AFE->AFE_SEQ_CRC,
+           (unsigned) pADI_AFE->AFE_SEQ_COUNT);
+    errors++;
+    return;
+  }
+  for (i = 0; i < 4; i++) {
+    if (!AfeSim_Result(first + i, &result)
+        || results[2 * i] != (uint16_t) result.real
+        || results[2 * i + 1] != (uint16_t) result.imag
+        || result.rcal != (i == 0)) {
+      printf("seq_afe_acmeas2wire result %d is %d%+dj, the AFE made %d%+dj "
+             "(%s)\n", i, (int16_t) results[2 * i],
+             (int16_t) results[2 * i + 1], result.real, result.imag,
+             result.rcal ? "RCAL" : "body");
+      errors++;
+    }
+  }
+  printf("seq_afe_acmeas2wire: RCAL %d%+dj, body %d%+dj; %u commands, "
+         "CRC 0x%02X\n", (int16_t) results[0], (int16_t) results[1],
+         (int16_t) results[2], (int16_t) results[3],
+         (unsigned) pADI_AFE->AFE_SEQ_COUNT,
+         (unsigned) pADI_AFE->AFE_SEQ_CRC);
+}
+
+static void acquisition_Start(void) {
+  if (use_blocks) {
+    adi_AFE_RegisterCallbackOnReceiveDMA(hDevice, AFE_DFT_BlockCallback, 0);
+    DftBlock_Init(&dft_block, dft_rate.dft_period_us);
+    adi_AFE_ProgramRxDMA(hDevice, DftBlock_Filling(&dft_block),
+                         DFT_BLOCK_WORDS);
+    ADI_ENABLE_INT(DMA_AFE_RX_IRQn);
+    pADI_AFE->AFE_FIFO_CFG |= BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN
+                              | BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_DMA_REQ_EN;
+  } else {
+    adi_AFE_RegisterAfeCallback(
+        hDevice, ADI_AFE_INT_GROUP_CAPTURE, AFE_DFT_Callback,
+        BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN);
+    adi_AFE_ClearInterruptSource(
+        hDevice, ADI_AFE_INT_GROUP_CAPTURE,
+        BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN);
+    adi_AFE_EnableInterruptSource(
+        hDevice, ADI_AFE_INT_GROUP_CAPTURE,
+        BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN, true);
+  }
+}
+
+static void acquisition_Stop(void) {
+  if (use_blocks) {
+    pADI_AFE->AFE_FIFO_CFG &= ~(BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_EN
+                                | BITM_AFE_AFE_FIFO_CFG_DATA_FIFO_DMA_REQ_EN);
+    ADI_DISABLE_INT(DMA_AFE_RX_IRQn);
+  } else {
+    adi_AFE_EnableInterruptSource(
+        hDevice, ADI_AFE_INT_GROUP_CAPTURE,
+        BITM_AFE_AFE_ANALOG_CAPTURE_IEN_DFT_RESULT_READY_IEN, false);
+  }
+}
+
+// Runs the loop at rate_mhz for the given time, checking every result the
+// task gets against what the AFE made.
+static void check_Loop(uint32_t rate_mhz, double afe_speed) {
+  const AfeSimStats *stats = AfeSim_Stats();
+  const DftRecord *record;
+  AfeSimResult result;
+  uint64_t next, n, start_ns, end_ns, starvations, overflows;
+  uint32_t taken = 0, body = 0, lost = 0, mismatched = 0, slack;
+  double expected;
+  bool first = true;
+  INT8U err;
+
+  if (!DftRate_Plan(&dft_rate, rate_mhz)) {
+    printf("%u mHz: no plan\n", (unsigned) rate_mhz);
+    errors++;
+    return;
+  }
+  DftRing_Init(&dft_ring, DFT_RING_DROP_NEWEST);
+  isr_count = task_count = 0;
+  starvations = stats->cmd_starvations;
+  overflows = stats->data_overflows;
+
+  // As afe_StartLoop() and dft_StartAcquisition().
+  adi_AFE_SeqAbort(hDevice);
+  DftRate_BuildLoop(&dft_rate, seq_afe_loop);
+  afe_loop_running = true;
+  adi_AFE_RegisterCallbackOnTransmitDMA(hDevice, AFE_Loop_TxCallback, 0);
+  adi_AFE_SetRunSequenceBlockingMode(hDevice, false);
+  if (adi_AFE_RunSequence(hDevice, seq_afe_loop, NULL, 0)) {
+    printf("%u mHz: the loop did not start\n", (unsigned) rate_mhz);
+    errors++;
+  }
+  adi_AFE_SetRunSequenceBlockingMode(hDevice, true);
+  next = stats->dfts;
+  acquisition_Start();
+  start_ns = OS_CPU_SimTimeNs();
+  end_ns = start_ns + (uint64_t) (seconds * 1e9);
+
+  while (OS_CPU_SimTimeNs() < end_ns || DftRing_Peek(&dft_ring) != NULL) {
+    if (OS_CPU_SimTimeNs() >= end_ns && afe_loop_running) {
+      // As afe_StopLoop() and dft_StopAcquisition(); what is queued is
+      // still taken.
+      afe_loop_running = false;
+      ADI_DISABLE_INT(DMA_AFE_TX_IRQn);
+      adi_AFE_SeqAbort(hDevice);
+      adi_AFE_RegisterCallbackOnTransmitDMA(hDevice, NULL, 0);
+      acquisition_Stop();
+    }
+    if (DftRing_Peek(&dft_ring) == NULL) {
+      OSSemPend(dft_semaphore, OS_TICKS_PER_SEC / 10, &err);
+    }
+    while ((record = DftRing_Peek(&dft_ring)) != NULL) {
+      // The result the AFE made with these values, skipping any lost.
+      for (n = next; AfeSim_Result(n, &result); n++) {
+        if (result.real == record->real && result.imag == record->imag) {
+          break;
+        }
+      }
+      if (n >= stats->dfts) {
+        mismatched++;
+      } else {
+        if (!first) {
+          lost += (uint32_t) (n - next);
+        }
+        first = false;
+        next = n + 1;
+        if (!result.rcal) {
+          body++;
+        }
+        if (task_count < MAX_EVENTS) {
+          task_us[task_count++] =
+              (uint32_t) ((OS_CPU_SimTimeNs() - result.at) / 1000u);
+        }
+      }
+      taken++;
+      DftRing_Release(&dft_ring);
+      busy(work_us);
+    }
+  }
+
+  // A pass of the loop is one RCAL and dfts_per_rcal body DFTs; the window
+  // may cut one pass short at either end, and a block short at the end.
+  expected = seconds * 1e9 / loop_Ns(seq_afe_loop, afe_speed)
+             * dft_rate.dfts_per_rcal;
+  slack = dft_rate.dfts_per_rcal + 1 + (use_blocks ? DFT_BLOCK_RESULTS : 0);
+  printf("%u.%03u Hz (%u DFTs per sample, idle %u us): %u results in "
+         "%.1f s, %.1f body DFTs/s of %.1f\n", (unsigned) (rate_mhz / 1000),
+         (unsigned) (rate_mhz % 1000), (unsigned) dft_rate.average,
+         (unsigned) dft_rate.idle_us, (unsigned) taken, seconds,
+         body / seconds, expected / seconds);
+  print_Latency("ISR", isr_us, isr_count);
+  print_Latency("task", task_us, task_count);
+  printf("  ring depth max %u, dropped %u; %llu starvations, %llu data "
+         "overflows\n", (unsigned) dft_ring.max_depth,
+         (unsigned) dft_ring.dropped,
+         (unsigned long long) (stats->cmd_starvations - starvations),
+         (unsigned long long) (stats->data_overflows - overflows));
+
+  if (mismatched != 0 || lost != 0 || dft_ring.dropped != 0) {
+    printf("  %u results not made by the AFE, %u lost, %u dropped\n",
+           (unsigned) mismatched, (unsigned) lost,
+           (unsigned) dft_ring.dropped);
+    errors++;
+  }
+  if (body + slack < expected || body > expected + slack) {
+    printf("  %u body DFTs, %.0f expected\n", (unsigned) body, expected);
+    errors++;
+  }
+  if (stats->cmd_starvations != starvations
+      || stats->data_overflows != overflows) {
+    printf("  the sequencer or the data FIFO fell behind\n");
+    errors++;
+  }
+}
+
+static double afe_speed;
+
+static void main_Task(void *arg) {
+  int i;
+
+  (void) arg;
+  if (adi_AFE_Init(&hDevice)) {
+    printf("adi_AFE_Init failed\n");
+    errors++;
+    OS_CPU_SimStop();
+  }
+  check_Blocking();
+  for (i = 0; i < rate_count; i++) {
+    check_Loop(rates[i], afe_speed);
+  }
+  OS_CPU_SimStop();
+}
+
+int main(int argc, char **argv) {
+  AfeSimConfig config;
+  const AfeSimStats *stats;
+  double scale = 20.0;
+  char *rate;
+  int i;
+
+  AfeSim_Defaults(&config);
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+      seconds = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+      for (rate = strtok(argv[++i], ","); rate != NULL && rate_count < MAX_RATES;
+           rate = strtok(NULL, ",")) {
+        rates[rate_count++] = (uint32_t) atol(rate);
+      }
+    } else if (strcmp(argv[i], "-b") == 0) {
+      use_blocks = true;
+    } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+      config.afe_speed = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+      work_us = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+      scale = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      config.noise = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-f") == 0) {
+      config.replay_path = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [-t seconds] [-r rate_mhz[,rate_mhz...]] "
+              "[-b] [-s afe_speed] [-w work_us] [-c cpu_scale] [-n noise] "
+              "[-f replay_file]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (rate_count == 0) {
+    rates[rate_count++] = DFT_RATE_MAX_MHZ;
+    rates[rate_count++] = 40000;
+    rates[rate_count++] = 10000;
+    rates[rate_count++] = 2000;
+  }
+  afe_speed = config.afe_speed;
+
+  OSInit();
+  OS_CPU_SimCpuScale(scale);
+  ChipSim_Init();
+  if (!AfeSim_Init(&config)) {
+    return 2;
+  }
+  dft_semaphore = OSSemCreate(0);
+  OSTaskCreate(main_Task, NULL, &main_stack[511], MAIN_PRIO);
+  OS_CPU_SysTickInit(OS_CPU_SIM_CLK_FREQ / OS_TICKS_PER_SEC);
+  OSStart();
+
+  stats = AfeSim_Stats();
+  printf("%.1f s simulated: %llu sequences, %llu commands, %llu DFTs, %llu "
+         "through the data FIFO; idle %.1f%%\n", OS_CPU_SimTimeNs() / 1e9,
+         (unsigned long long) stats->sequences,
+         (unsigned long long) stats->commands,
+         (unsigned long long) stats->dfts,
+         (unsigned long long) stats->results_pushed,
+         100.0 * OS_CPU_SimStats.IdleNs / OS_CPU_SimTimeNs());
+  printf("%s\n", errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}
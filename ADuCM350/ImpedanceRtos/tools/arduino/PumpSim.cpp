@@ -0,0 +1,186 @@
+// The pump module on the host; see PumpSim.h.
+
+#include "PumpSim.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "Wire.h"
+
+#include "../../../../Arduino/Final_Arduino_FW/Final_Arduino_FW.ino"
+
+#define STEP_US 50
+
+static PumpSimConfig config;
+static PumpSimStats stats;
+
+static double cuff_mmhg;
+static double oscillation_sigma;
+static uint64_t timer_us;
+static uint64_t random_state;
+static PumpSimSample truth[PUMP_SIM_TRUTH_SIZE];
+
+static double pumpSim_Random(void) {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return ((random_state * 0x2545F4914F6CDD1Dull) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double pumpSim_Noise(void) {
+  double u = pumpSim_Random();
+
+  if (config.noise <= 0.0) {
+    return 0.0;
+  }
+  return config.noise * sqrt(-2.0 * log(u > 0.0 ? u : 1e-300))
+         * cos(2.0 * M_PI * pumpSim_Random());
+}
+
+double PumpSim_MeanPressure(void) {
+  return config.diastolic_mmhg
+         + (config.systolic_mmhg - config.diastolic_mmhg) / 3.0;
+}
+
+// The shape of one beat, from 0 to 1 and back, at phase 0 to 1 in it: a
+// quick systolic rise, then the run-off.
+static double pumpSim_Beat(double phase) {
+  if (phase < 0.15) {
+    return sin(0.5 * M_PI * phase / 0.15);
+  }
+  return exp(-(phase - 0.15) / 0.25);
+}
+
+// What the arteries add to the cuff pressure at time us.
+static double pumpSim_Oscillation(uint64_t us) {
+  double from_mean = cuff_mmhg - PumpSim_MeanPressure();
+  double beats = us * 1e-6 * config.heart_bpm / 60.0;
+
+  if (cuff_mmhg <= 0.0) {
+    return 0.0;
+  }
+  return config.oscillation_mmhg
+         * exp(-from_mean * from_mean
+               / (2.0 * oscillation_sigma * oscillation_sigma))
+         * pumpSim_Beat(beats - floor(beats));
+}
+
+// The cuff over one step of the sketch, with the pins as it left them.
+static void pumpSim_Cuff(double dt) {
+  if (sim_pins[kSolenoidValvePin] == LOW) {
+    cuff_mmhg *= exp(-dt / config.valve_tau_s);
+  } else if (sim_pins[kMotorBrakePin] == LOW) {
+    cuff_mmhg += config.pump_mmhg_s
+                 * (1.0 - cuff_mmhg / config.pump_stall_mmhg) * dt;
+  } else {
+    cuff_mmhg -= config.leak_mmhg_s * dt;
+  }
+  if (cuff_mmhg < 0.0) {
+    cuff_mmhg = 0.0;
+  }
+  if (cuff_mmhg > stats.peak_mmhg) {
+    stats.peak_mmhg = cuff_mmhg;
+  }
+}
+
+// The transducer on the ADC; every read is a sample the sketch takes.
+static int pumpSim_AnalogRead(int pin) {
+  double mmhg = cuff_mmhg + pumpSim_Oscillation(sim_us);
+  double counts;
+  PumpSimSample *sample;
+
+  if (pin != kTransducerPin) {
+    return 0;
+  }
+  counts = round(config.counts_per_mmhg * mmhg + config.counts_offset
+                 + pumpSim_Noise());
+  counts = counts < 0.0 ? 0.0 : counts > 1023.0 ? 1023.0 : counts;
+  sample = &truth[stats.samples % PUMP_SIM_TRUTH_SIZE];
+  sample->at = sim_us * 1000u;
+  sample->sequence = sample_sequence;
+  sample->analog = (uint16_t) counts;
+  sample->mmhg = mmhg;
+  stats.samples++;
+  return (int) counts;
+}
+
+void PumpSim_Defaults(PumpSimConfig *defaults) {
+  defaults->pump_mmhg_s = 40.0;
+  defaults->pump_stall_mmhg = 350.0;
+  defaults->valve_tau_s = 0.3;
+  defaults->leak_mmhg_s = 3.0;
+  defaults->counts_per_mmhg = 2.4728;
+  defaults->counts_offset = 36.989;
+  defaults->noise = 0.5;
+  defaults->systolic_mmhg = 120.0;
+  defaults->diastolic_mmhg = 80.0;
+  defaults->heart_bpm = 72.0;
+  defaults->oscillation_mmhg = 1.5;
+  defaults->verbose = false;
+}
+
+void PumpSim_Init(const PumpSimConfig *new_config) {
+  config = *new_config;
+  memset(&stats, 0, sizeof(stats));
+  cuff_mmhg = 0.0;
+  // 0.55 of the largest oscillation at systolic.
+  oscillation_sigma = (config.systolic_mmhg - PumpSim_MeanPressure())
+                      / sqrt(2.0 * log(1.0 / 0.55));
+  random_state = 0x9E3779B97F4A7C15ull;
+  Serial.verbose = config.verbose;
+  sim_us = 0;
+  sim_analog_read = pumpSim_AnalogRead;
+  setup();
+  timer_us = sim_us;
+}
+
+void PumpSim_RunUntil(uint64_t at) {
+  uint64_t us = at / 1000u;
+  uint64_t period_us = ((uint64_t) OCR1A + 1) / 2;
+  int brake;
+
+  while (sim_us < us) {
+    pumpSim_Cuff(STEP_US * 1e-6);
+    sim_us += STEP_US;
+    if ((TIMSK1 & _BV(OCIE1A)) && sim_us >= timer_us) {
+      TIMER1_COMPA_vect();
+      timer_us += period_us;
+    }
+    brake = sim_pins[kMotorBrakePin];
+    loop();
+    if (brake == LOW && sim_pins[kMotorBrakePin] == HIGH) {
+      stats.inflated_at = sim_us * 1000u;
+    }
+  }
+}
+
+void PumpSim_Write(const uint8_t *data, int length, uint64_t at) {
+  PumpSim_RunUntil(at);
+  // The Wire library's buffer holds 32 bytes; the rest are not acknowledged.
+  Wire.masterWrite(data, length < 32 ? length : 32);
+  stats.writes++;
+}
+
+int PumpSim_Read(uint8_t *data, int length, uint64_t at) {
+  PumpSim_RunUntil(at);
+  Wire.masterRead(data, length);
+  stats.reads++;
+  return length;
+}
+
+double PumpSim_Pressure(uint64_t at) {
+  PumpSim_RunUntil(at);
+  return cuff_mmhg + pumpSim_Oscillation(sim_us);
+}
+
+bool PumpSim_Sample(uint64_t n, PumpSimSample *sample) {
+  if (n >= stats.samples || stats.samples - n > PUMP_SIM_TRUTH_SIZE) {
+    return false;
+  }
+  *sample = truth[n % PUMP_SIM_TRUTH_SIZE];
+  return true;
+}
+
+const PumpSimStats *PumpSim_Stats(void) {
+  return &stats;
+}
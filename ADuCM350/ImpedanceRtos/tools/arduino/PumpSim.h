@@ -0,0 +1,102 @@
+#ifndef __PUMP_SIM_H__
+#define __PUMP_SIM_H__
+
+// The pump module on the host: the Arduino's sketch,
+// Arduino/Final_Arduino_FW, unmodified (through Wire.h), with the pump, the
+// valve, the cuff on an arm and the pressure transducer it drives and
+// samples.  Its PumpSim_Write() and PumpSim_Read() are the I2C slave at
+// 0x77, for aducm350/I2cSim.h or any other master on the host.
+//
+// The sketch runs on the simulated time it is given, in ns as the rest of
+// the simulation counts it: its loop every 50 us, and its Timer1 sampling
+// interrupt when it is due.  It only runs when it is called, and then
+// catches up, so it costs nothing while nobody looks at it.
+//
+// The cuff holds pressure p (mmHg above the atmosphere).  With the motor's
+// brake released (kMotorBrakePin LOW) and the valve shut (kSolenoidValvePin
+// HIGH), the pump raises it by pump_mmhg_s less what the cuff pushes back,
+// down to nothing at pump_stall_mmhg.  With the valve open, p falls by a
+// factor of e every valve_tau_s; shut, with the pump off, it leaks away at
+// leak_mmhg_s, the slow deflation the oscillometric method measures on.
+// The arteries add an oscillation at heart_bpm, of oscillation_mmhg at the
+// top of each beat when p is the mean arterial pressure (diastolic plus a
+// third of the pulse pressure), and less above and below it: a Gaussian of
+// p, as wide as makes it 0.55 of that at systolic, and so about 0.85 at
+// diastolic.  The transducer reads counts_per_mmhg * p + counts_offset
+// (Arduino/transducer-pressure-relationship.txt), with Gaussian noise of
+// noise counts, on the 10-bit ADC.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Most recent samples kept for checking (PumpSim_Sample()).
+#define PUMP_SIM_TRUTH_SIZE 65536
+
+// Slave address the sketch answers.
+#define PUMP_SIM_ADDRESS 0x77
+
+typedef struct {
+  double pump_mmhg_s;       // Inflation rate of the empty cuff.
+  double pump_stall_mmhg;   // Pressure the pump can't go past.
+  double valve_tau_s;       // Deflation with the valve open.
+  double leak_mmhg_s;       // Deflation with it shut.
+  double counts_per_mmhg;   // Transducer.
+  double counts_offset;
+  double noise;             // Standard deviation, in ADC counts.
+  double systolic_mmhg;
+  double diastolic_mmhg;
+  double heart_bpm;
+  double oscillation_mmhg;  // Largest oscillation, at the mean pressure.
+  bool verbose;             // Prints what the sketch prints.
+} PumpSimConfig;
+
+typedef struct {
+  uint64_t at;              // When the sketch read the ADC, in ns.
+  uint16_t sequence;        // The sketch's sample_sequence for it.
+  uint16_t analog;          // What it read.
+  double mmhg;              // Cuff pressure then, oscillation included.
+} PumpSimSample;
+
+typedef struct {
+  uint64_t samples;         // Taken by the sketch.
+  uint64_t writes;          // I2C transfers.
+  uint64_t reads;
+  double peak_mmhg;         // Highest cuff pressure.
+  uint64_t inflated_at;     // When the pump last stopped, or 0.
+} PumpSimStats;
+
+void PumpSim_Defaults(PumpSimConfig *config);
+
+// Starts the sketch, at time 0.
+void PumpSim_Init(const PumpSimConfig *config);
+
+// Runs the sketch and the cuff up to time at, if they aren't there yet.
+void PumpSim_RunUntil(uint64_t at);
+
+// The I2C slave.  A write of length bytes, at its stop, and a read of
+// length bytes, once its address is through; the read fills them all in,
+// 0xFF past what the sketch sends, and returns length.
+void PumpSim_Write(const uint8_t *data, int length, uint64_t at);
+int PumpSim_Read(uint8_t *data, int length, uint64_t at);
+
+// The cuff pressure at time at, oscillation included.
+double PumpSim_Pressure(uint64_t at);
+
+// The mean arterial pressure of the model.
+double PumpSim_MeanPressure(void);
+
+// Sample number n, counted from 0, if it is among the last
+// PUMP_SIM_TRUTH_SIZE.
+bool PumpSim_Sample(uint64_t n, PumpSimSample *sample);
+
+const PumpSimStats *PumpSim_Stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __PUMP_SIM_H__
@@ -0,0 +1,107 @@
+// Just enough of the Arduino core and of the Wire library to run the pump
+// module's sketch on a host, against a simulated clock, ADC and I2C bus.
+//
+// The simulation (tools/pumpburst.cpp or PumpSim.cpp) owns sim_us, answers
+// analogRead() through sim_analog_read, fires the Timer1 compare interrupt
+// the sketch sets up, and plays the I2C master through Wire.masterWrite()
+// and Wire.masterRead().  Interrupts never nest here, so noInterrupts() and
+// interrupts() do nothing.
+
+#ifndef __ARDUINO_WIRE_SHIM_H__
+#define __ARDUINO_WIRE_SHIM_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+#define A3 17
+
+#define _BV(bit) (1 << (bit))
+#define ISR(vector) void vector(void)
+
+// Timer1 registers and the bits the sketch uses.
+#define WGM12 3
+#define CS11 1
+#define OCIE1A 1
+static uint8_t TCCR1A, TCCR1B, TIMSK1;
+static uint16_t TCNT1, OCR1A;
+
+// Simulated time, ADC and pins.
+static uint64_t sim_us;
+static int (*sim_analog_read)(int pin);
+static int sim_pins[32];
+
+static inline unsigned long micros(void) { return (unsigned long) (uint32_t) sim_us; }
+static inline int analogRead(int pin) { return sim_analog_read(pin); }
+static inline void pinMode(int pin, int mode) { (void) pin; (void) mode; }
+static inline void digitalWrite(int pin, int value) { sim_pins[pin] = value; }
+static inline void analogWrite(int pin, int value) { sim_pins[pin] = value; }
+static inline void noInterrupts(void) {}
+static inline void interrupts(void) {}
+
+class SerialShim {
+ public:
+  bool verbose;
+  void begin(long baud) { (void) baud; }
+  void print(const char *s) { if (verbose) fputs(s, stdout); }
+  void print(unsigned long v) { if (verbose) printf("%lu", v); }
+  void print(unsigned v) { print((unsigned long) v); }
+  void print(int v) { if (verbose) printf("%d", v); }
+  template <typename T> void println(T v) { print(v); print("\n"); }
+};
+
+static SerialShim Serial;
+
+// The slave side of the bus, and the master's view of it.
+class TwoWireShim {
+ public:
+  void begin(int address) { address_ = address; }
+  void onRequest(void (*handler)(void)) { on_request_ = handler; }
+  void onReceive(void (*handler)(int)) { on_receive_ = handler; }
+
+  int available(void) { return rx_length_ - rx_index_; }
+  int read(void) { return rx_index_ < rx_length_ ? rx_[rx_index_++] : -1; }
+  size_t write(const uint8_t *data, size_t length) {
+    // The real library keeps 32 bytes and drops the rest.
+    if (length > sizeof(tx_) - tx_length_) {
+      length = sizeof(tx_) - tx_length_;
+    }
+    memcpy(tx_ + tx_length_, data, length);
+    tx_length_ += (int) length;
+    return length;
+  }
+
+  // A master write of length bytes to the sketch's address.
+  void masterWrite(const uint8_t *data, int length) {
+    memcpy(rx_, data, length);
+    rx_length_ = length;
+    rx_index_ = 0;
+    on_receive_(length);
+  }
+
+  // A master read of length bytes; whatever the sketch doesn't write reads
+  // as 0xFF, as the released bus does.
+  void masterRead(uint8_t *data, int length) {
+    tx_length_ = 0;
+    on_request_();
+    memset(data, 0xFF, length);
+    memcpy(data, tx_, tx_length_ < length ? tx_length_ : length);
+  }
+
+  int address_;
+
+ private:
+  void (*on_request_)(void);
+  void (*on_receive_)(int);
+  uint8_t rx_[32];
+  int rx_length_, rx_index_;
+  uint8_t tx_[32];
+  int tx_length_;
+};
+
+static TwoWireShim Wire;
+
+#endif  // __ARDUINO_WIRE_SHIM_H__
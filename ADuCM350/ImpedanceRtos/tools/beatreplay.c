@@ -0,0 +1,160 @@
+// Runs BeatDetector over recorded sessions on the host, and times it.
+//
+// A session is a capture of the legacy ASCII output, one
+// "pressure magnitude phase" line per sample (the lines final.py prints);
+// other lines are skipped.  The magnitudes are fed to the detector as the
+// firmware does, sample_period_us apart.  Every beat is printed (-q: only
+// the summary), followed by the mean heart rate and the time per sample.
+// With -r, the run fails unless the median heart rate is within -t bpm of
+// the reference, so a set of sessions with known rates can be checked after
+// a change.
+//
+// The detector uses the CMSIS-DSP biquad, so the host build needs the
+// CMSIS-DSP sources (https://github.com/ARM-software/CMSIS-DSP):
+//
+// build: cc -O2 -I.. -I$CMSIS_DSP/Include -o beatreplay beatreplay.c
+//            ../BeatDetector.c
+//            $CMSIS_DSP/Source/FilteringFunctions/arm_biquad_cascade_df1_q31.c
+//            $CMSIS_DSP/Source/FilteringFunctions/arm_biquad_cascade_df1_init_q31.c
+//            -lm
+// usage: beatreplay [-p sample_period_us] [-q] [-r bpm [-t bpm]]
+//                   session.txt [session.txt ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BeatDetector.h"
+
+// 13 ms DFT plus settling, as in telemetry_benchmark.py.
+#define DEFAULT_SAMPLE_PERIOD_US 13158
+
+// Most samples in a session, and most beats for the median.
+#define MAX_SAMPLES 200000
+#define MAX_BEATS 4096
+
+// Times each session is run for the timing.
+#define TIMING_RUNS 20
+
+static int32_t magnitudes[MAX_SAMPLES];
+static uint16_t rates[MAX_BEATS];
+
+static int compare_rates(const void *a, const void *b) {
+  return (int) *(const uint16_t *) a - (int) *(const uint16_t *) b;
+}
+
+static uint32_t load(const char *path) {
+  char line[256];
+  double pressure, magnitude, phase;
+  uint32_t count = 0;
+  FILE *file;
+
+  file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return 0;
+  }
+  while (count < MAX_SAMPLES && fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "%lf %lf %lf", &pressure, &magnitude, &phase) != 3) {
+      continue;
+    }
+    // 28.4 fixed point, as sent by the firmware.
+    magnitudes[count++] = (int32_t) (magnitude * 16.0 + 0.5);
+  }
+  fclose(file);
+  return count;
+}
+
+static int replay(const char *path, uint32_t period_us, bool quiet,
+                  double reference_bpm, double tolerance_bpm) {
+  static BeatDetector detector;
+  uint32_t rate_mhz = 1000000000u / period_us;
+  uint32_t samples;
+  uint32_t count = 0;
+  uint32_t i;
+  Beat beat;
+  clock_t start;
+  double ns_per_sample;
+  double median = 0.0;
+  int run;
+
+  samples = load(path);
+  if (samples == 0) {
+    fprintf(stderr, "%s: no samples\n", path);
+    return 1;
+  }
+
+  BeatDetector_Init(&detector, rate_mhz);
+  for (i = 0; i < samples; i++) {
+    if (!BeatDetector_Add(&detector, i * period_us, magnitudes[i], &beat)) {
+      continue;
+    }
+    if (!quiet) {
+      printf("  %10.3f s  %6.1f bpm  %8.4f ohm\n", beat.timestamp_us / 1e6,
+             (double) beat.rate / BEAT_RATE_PER_BPM, beat.amplitude / 16.0);
+    }
+    if (beat.rate != 0 && count < MAX_BEATS) {
+      rates[count++] = beat.rate;
+    }
+  }
+
+  start = clock();
+  for (run = 0; run < TIMING_RUNS; run++) {
+    BeatDetector_Init(&detector, rate_mhz);
+    for (i = 0; i < samples; i++) {
+      BeatDetector_Add(&detector, i * period_us, magnitudes[i], &beat);
+    }
+  }
+  ns_per_sample = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9
+                  / ((double) samples * TIMING_RUNS);
+
+  if (count > 0) {
+    qsort(rates, count, sizeof(rates[0]), compare_rates);
+    median = (double) rates[count / 2] / BEAT_RATE_PER_BPM;
+  }
+  printf("%s: %u samples, %u beats, median %.1f bpm, %.0f ns/sample\n", path,
+         (unsigned) samples, (unsigned) detector.beats, median,
+         ns_per_sample);
+
+  if (reference_bpm > 0.0 && (count == 0 || median < reference_bpm
+                              - tolerance_bpm || median > reference_bpm
+                              + tolerance_bpm)) {
+    printf("%s: FAIL, expected %.1f +- %.1f bpm\n", path, reference_bpm,
+           tolerance_bpm);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t period_us = DEFAULT_SAMPLE_PERIOD_US;
+  double reference_bpm = 0.0;
+  double tolerance_bpm = 3.0;
+  bool quiet = false;
+  int sessions = 0;
+  int status = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+      period_us = (uint32_t) strtoul(argv[++i], NULL, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+      reference_bpm = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+      tolerance_bpm = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-q") == 0) {
+      quiet = true;
+    } else {
+      status |= replay(argv[i], period_us, quiet, reference_bpm,
+                       tolerance_bpm);
+      sessions++;
+    }
+  }
+  if (sessions == 0) {
+    fprintf(stderr, "usage: %s [-p sample_period_us] [-q] [-r bpm [-t bpm]] "
+            "session.txt ...\n", argv[0]);
+    return 2;
+  }
+  return status;
+}
@@ -0,0 +1,95 @@
+// Runs BpEstimator over recorded sessions on the host.
+//
+// A session is a capture of the legacy ASCII output, one
+// "pressure magnitude phase" line per sample (the lines final.py prints);
+// other lines are skipped.  The samples are fed to the estimator as the
+// firmware does, sample_period_us apart, and the envelope and the estimate
+// are printed.
+//
+// build: cc -O2 -I.. -o bpreplay bpreplay.c ../BpEstimator.c
+// usage: bpreplay [-p sample_period_us] [-s systolic_permille]
+//                 [-d diastolic_permille] session.txt [session.txt ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BpEstimator.h"
+
+// 13 ms DFT plus settling, as in telemetry_benchmark.py.
+#define DEFAULT_SAMPLE_PERIOD_US 13158
+
+static void print_mmhg(const char *name, int32_t pressure) {
+  printf("  %-10s %7.1f mmHg\n", name, (double) pressure / BP_PRESSURE_SCALE);
+}
+
+static int replay(const char *path, uint32_t period_us,
+                  uint16_t systolic_permille, uint16_t diastolic_permille) {
+  static BpEstimator estimator;
+  BpResult result;
+  char line[256];
+  double pressure, magnitude, phase;
+  uint32_t samples = 0;
+  FILE *file;
+  int i;
+
+  file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  BpEstimator_Init(&estimator, systolic_permille, diastolic_permille);
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "%lf %lf %lf", &pressure, &magnitude, &phase) != 3) {
+      continue;
+    }
+    BpEstimator_Add(&estimator, samples * period_us,
+                    (int32_t) (pressure * BP_PRESSURE_SCALE));
+    samples++;
+  }
+  fclose(file);
+
+  printf("%s: %u samples, %u envelope points, window %.1f s\n", path,
+         (unsigned) samples, (unsigned) estimator.count,
+         estimator.window_us / 1e6);
+  for (i = 0; i < estimator.count; i++) {
+    printf("  %7.1f mmHg  %6.2f mmHg p-p\n",
+           (double) estimator.points[i].pressure / BP_PRESSURE_SCALE,
+           (double) estimator.points[i].amplitude / BP_PRESSURE_SCALE);
+  }
+  if (!BpEstimator_Result(&estimator, &result)) {
+    printf("  no estimate\n");
+  }
+  print_mmhg("systolic", result.systolic);
+  print_mmhg("MAP", result.map);
+  print_mmhg("diastolic", result.diastolic);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t period_us = DEFAULT_SAMPLE_PERIOD_US;
+  uint16_t systolic_permille = BP_SYSTOLIC_RATIO_PERMILLE;
+  uint16_t diastolic_permille = BP_DIASTOLIC_RATIO_PERMILLE;
+  int status = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+      period_us = (uint32_t) strtoul(argv[++i], NULL, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+      systolic_permille = (uint16_t) strtoul(argv[++i], NULL, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+      diastolic_permille = (uint16_t) strtoul(argv[++i], NULL, 0);
+    } else {
+      status |= replay(argv[i], period_us, systolic_permille,
+                       diastolic_permille);
+    }
+  }
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s [-p sample_period_us] [-s systolic_permille] "
+            "[-d diastolic_permille] session.txt ...\n", argv[0]);
+    return 2;
+  }
+  return status;
+}
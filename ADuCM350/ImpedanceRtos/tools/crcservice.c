@@ -0,0 +1,163 @@
+// Checks the CRC service on the host, where its queue runs against the
+// bit-level model of the CRC peripheral.
+//
+// Every length up to -n bytes, at every alignment and from a random CRC, is
+// run through CrcService_Crc32 and through a batch of queued jobs, and
+// compared with a bitwise CRC-32 and with SessionStore_Crc32.  Also times
+// the software kernels.  Exits non-zero on any mismatch.
+//
+// build: cc -O2 -I.. -o crcservice crcservice.c ../CrcService.c
+//        ../SessionStore.c ../Telemetry.c
+// usage: crcservice [-n max_length]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CrcService.h"
+#include "SessionStore.h"
+
+#define MAX_LENGTH 4096
+#define BATCH 8
+
+static union {
+  uint32_t align;
+  uint8_t bytes[MAX_LENGTH + 4];
+} buffer;
+
+static uint32_t completed;
+static int done_errors;
+
+static uint32_t crc32_bitwise(uint32_t crc, const uint8_t *data,
+                              size_t length) {
+  uint8_t bit;
+
+  crc = ~crc;
+  while (length--) {
+    crc ^= *data++;
+    for (bit = 0; bit < 8; bit++) {
+      crc = (crc & 1u) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+    }
+  }
+  return ~crc;
+}
+
+// Job i of a batch starts from CRC i at buffer.bytes + i % 4 (see main).
+static void job_Done(void *context, const CrcJob *job) {
+  uint32_t i = (uint32_t) (size_t) context;
+
+  // Jobs must finish in the order they were submitted, each with its CRC.
+  if (i != completed++) {
+    printf("job %u done out of order\n", (unsigned) i);
+    done_errors++;
+  }
+  if (job->crc != crc32_bitwise(i, buffer.bytes + i % 4, job->length)) {
+    printf("job %u done with the wrong CRC\n", (unsigned) i);
+    done_errors++;
+  }
+}
+
+static double time_ns_per_byte(uint32_t (*crc32)(uint32_t, const uint8_t *,
+                                                 size_t)) {
+  struct timespec start, end;
+  volatile uint32_t crc = 0;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < 2000; i++) {
+    crc = crc32(crc, buffer.bytes, 2040);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec))
+         / (2000.0 * 2040);
+}
+
+int main(int argc, char **argv) {
+  static CrcJob jobs[BATCH];
+  uint32_t max_length = 1024;
+  uint32_t length, offset, seed, expected;
+  int errors = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      max_length = (uint32_t) strtoul(argv[++i], NULL, 0);
+      if (max_length > MAX_LENGTH) {
+        fprintf(stderr, "-n: up to %d\n", MAX_LENGTH);
+        return 2;
+      }
+    } else {
+      fprintf(stderr, "usage: %s [-n max_length]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(350);
+  for (i = 0; i < (int) sizeof(buffer.bytes); i++) {
+    buffer.bytes[i] = (uint8_t) rand();
+  }
+  if (!CrcService_Init()) {
+    printf("peripheral model failed the check in CrcService_Init\n");
+    errors++;
+  }
+  if (CrcService_Crc32(0, (const uint8_t *) "123456789", 9) != 0xCBF43926u) {
+    printf("check value mismatch\n");
+    errors++;
+  }
+
+  for (length = 0; length <= max_length; length++) {
+    for (offset = 0; offset < 4; offset++) {
+      seed = (uint32_t) rand() << 16 ^ (uint32_t) rand();
+      expected = crc32_bitwise(seed, buffer.bytes + offset, length);
+      if (CrcService_Crc32(seed, buffer.bytes + offset, length) != expected
+          || CrcService_Crc32Soft(seed, buffer.bytes + offset, length)
+                 != expected
+          || SessionStore_Crc32(seed, buffer.bytes + offset, length)
+                 != expected) {
+        printf("mismatch: length %u offset %u\n", (unsigned) length,
+               (unsigned) offset);
+        errors++;
+      }
+    }
+
+    // A batch of queued jobs, only polled once all are submitted.
+    completed = 0;
+    for (i = 0; i < BATCH; i++) {
+      jobs[i].data = buffer.bytes + i % 4;
+      jobs[i].length = length + (uint32_t) i;
+      jobs[i].crc = (uint32_t) i;
+      jobs[i].done = job_Done;
+      jobs[i].context = (void *) (size_t) i;
+      CrcService_Submit(&jobs[i]);
+    }
+    for (i = 0; i < BATCH; i++) {
+      if (CrcService_Wait(&jobs[i])
+          != crc32_bitwise((uint32_t) i, buffer.bytes + i % 4,
+                           length + (uint32_t) i)) {
+        printf("mismatch: job %d of length %u\n", i,
+               (unsigned) (length + i));
+        errors++;
+      }
+    }
+    if (completed != BATCH) {
+      printf("%u of %d jobs completed\n", (unsigned) completed, BATCH);
+      errors++;
+    }
+  }
+  errors += done_errors;
+
+  printf("%u jobs, %u bytes to the peripheral, %u in software, "
+         "max queue %u\n",
+         (unsigned) crc_service_stats.jobs,
+         (unsigned) crc_service_stats.hw_bytes,
+         (unsigned) crc_service_stats.sw_bytes,
+         (unsigned) crc_service_stats.max_queue);
+  printf("software kernels: byte table %.2f ns/byte, nibble table %.2f "
+         "ns/byte, bitwise %.2f ns/byte\n",
+         time_ns_per_byte(CrcService_Crc32Soft),
+         time_ns_per_byte(SessionStore_Crc32),
+         time_ns_per_byte(crc32_bitwise));
+  printf("%s\n", errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}
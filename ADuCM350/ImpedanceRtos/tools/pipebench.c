@@ -0,0 +1,228 @@
+// Runs a Pipeline over recorded sessions on the host and profiles it.
+//
+// A session is a capture of the legacy ASCII output, one
+// "pressure magnitude phase" line per sample (the lines final.py prints);
+// other lines are skipped.  The stages are given in order on the command
+// line, and the samples are fed to the pipeline in blocks of -n samples,
+// sample_period_us apart.  Each stage reports its samples in and out and the
+// time it took per input sample; the pipeline's cycle counter is a
+// nanosecond clock here.  With -o, the output samples are written in the
+// same format as the input.
+//
+// Stages (channels: m = magnitude, p = phase, P = pressure, default mp):
+//   decimate=RATIO[/ORDER][:CHANNELS]  ORDER 1 = boxcar (default), 2..3 = CIC
+//   average=LENGTH[:CHANNELS]
+//   clamp=MAX_STEP[:CHANNELS]          MAX_STEP in 28.4 units
+//   biquad=B0,B1,B2,A1,A2,SHIFT[:CHANNELS]
+//                                      Q31 >> SHIFT, A1/A2 negated (CMSIS)
+//
+// build: cc -O2 -I.. -o pipebench pipebench.c ../Pipeline.c
+// usage: pipebench [-p sample_period_us] [-n block] [-o out.txt]
+//                  STAGE [STAGE ...] session.txt [session.txt ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Pipeline.h"
+
+// 13 ms DFT plus settling, as in telemetry_benchmark.py.
+#define DEFAULT_SAMPLE_PERIOD_US 13158
+
+#define MAX_STAGES 8
+#define MAX_BLOCK 256
+
+static PipelineStage stages[MAX_STAGES];
+static uint8_t stage_count;
+
+static uint32_t clock_ns(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t) (now.tv_sec * 1000000000ull + now.tv_nsec);
+}
+
+static uint8_t parse_channels(const char *text) {
+  uint8_t channels = 0;
+
+  if (text == NULL) {
+    return PIPELINE_CHANNEL(PIPELINE_MAGNITUDE)
+           | PIPELINE_CHANNEL(PIPELINE_PHASE);
+  }
+  for (; *text != '\0'; text++) {
+    if (*text == 'm') {
+      channels |= PIPELINE_CHANNEL(PIPELINE_MAGNITUDE);
+    } else if (*text == 'p') {
+      channels |= PIPELINE_CHANNEL(PIPELINE_PHASE);
+    } else if (*text == 'P') {
+      channels |= PIPELINE_CHANNEL(PIPELINE_PRESSURE);
+    }
+  }
+  return channels;
+}
+
+// Configures the next stage from NAME=ARGS[:CHANNELS].  Returns false if
+// the argument is not a stage.
+static bool parse_stage(char *spec) {
+  char *args = strchr(spec, '=');
+  char *channels_text;
+  uint8_t channels;
+  long c[6];
+  PipelineStage *stage = &stages[stage_count];
+
+  if (args == NULL || stage_count == MAX_STAGES) {
+    return false;
+  }
+  *args++ = '\0';
+  channels_text = strchr(args, ':');
+  if (channels_text != NULL) {
+    *channels_text++ = '\0';
+  }
+  channels = parse_channels(channels_text);
+
+  if (strcmp(spec, "decimate") == 0) {
+    char *order = strchr(args, '/');
+
+    if (!Pipeline_DecimateStage(stage, channels, (uint16_t) atoi(args),
+                                (uint8_t) (order != NULL ? atoi(order + 1)
+                                                         : 1))) {
+      fprintf(stderr, "decimate: order 1..%d\n", PIPELINE_MAX_CIC_ORDER);
+      exit(2);
+    }
+  } else if (strcmp(spec, "average") == 0) {
+    if (!Pipeline_MovingAverageStage(stage, channels, (uint8_t) atoi(args))) {
+      fprintf(stderr, "average: length 1..%d\n", PIPELINE_MAX_AVERAGE);
+      exit(2);
+    }
+  } else if (strcmp(spec, "clamp") == 0) {
+    Pipeline_ClampStage(stage, channels, (int32_t) atol(args));
+  } else if (strcmp(spec, "biquad") == 0) {
+    int32_t coefficients[5];
+    int i;
+
+    if (sscanf(args, "%ld,%ld,%ld,%ld,%ld,%ld", &c[0], &c[1], &c[2], &c[3],
+               &c[4], &c[5]) != 6) {
+      fprintf(stderr, "biquad=B0,B1,B2,A1,A2,SHIFT\n");
+      exit(2);
+    }
+    for (i = 0; i < 5; i++) {
+      coefficients[i] = (int32_t) c[i];
+    }
+    Pipeline_BiquadStage(stage, channels, coefficients, (uint8_t) c[5]);
+  } else {
+    return false;
+  }
+  stage_count++;
+  return true;
+}
+
+static void write_block(FILE *out, const PipelineSample *samples,
+                        uint16_t count) {
+  uint16_t i;
+
+  for (i = 0; i < count; i++) {
+    fprintf(out, "%d%13.4f%13.4f\n",
+            (int) samples[i].value[PIPELINE_PRESSURE],
+            samples[i].value[PIPELINE_MAGNITUDE] / 16.0,
+            samples[i].value[PIPELINE_PHASE] / 16.0);
+  }
+}
+
+static int run(const char *path, uint32_t period_us, uint16_t block,
+               FILE *out) {
+  static PipelineSample samples[MAX_BLOCK];
+  Pipeline pipeline;
+  char line[256];
+  double pressure, magnitude, phase;
+  uint32_t total = 0;
+  uint16_t count = 0;
+  uint16_t left;
+  const PipelineStats *stats;
+  FILE *file;
+  uint8_t i;
+
+  file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  Pipeline_Init(&pipeline, stages, stage_count, clock_ns);
+  Pipeline_Reset(&pipeline);
+  Pipeline_ResetStats(&pipeline);
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "%lf %lf %lf", &pressure, &magnitude, &phase) != 3) {
+      continue;
+    }
+    samples[count].timestamp_us = total++ * period_us;
+    samples[count].value[PIPELINE_MAGNITUDE] = (int32_t) (magnitude * 16.0);
+    samples[count].value[PIPELINE_PHASE] = (int32_t) (phase * 16.0);
+    samples[count].value[PIPELINE_PRESSURE] = (int32_t) pressure;
+    if (++count == block) {
+      left = Pipeline_Process(&pipeline, samples, count);
+      if (out != NULL) {
+        write_block(out, samples, left);
+      }
+      count = 0;
+    }
+  }
+  fclose(file);
+  if (count > 0) {
+    left = Pipeline_Process(&pipeline, samples, count);
+    if (out != NULL) {
+      write_block(out, samples, left);
+    }
+  }
+
+  printf("%s: %u samples\n", path, (unsigned) total);
+  for (i = 0; i < stage_count; i++) {
+    stats = &stages[i].stats;
+    printf("  %u %-9s %8u in %8u out %8.1f ns/sample  max %u ns/call\n",
+           (unsigned) i, Pipeline_StageName(&stages[i]),
+           (unsigned) stats->samples_in, (unsigned) stats->samples_out,
+           stats->samples_in ? (double) stats->cycles / stats->samples_in
+                             : 0.0,
+           (unsigned) stats->max_cycles);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t period_us = DEFAULT_SAMPLE_PERIOD_US;
+  uint16_t block = 1;
+  FILE *out = NULL;
+  int sessions = 0;
+  int status = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+      period_us = (uint32_t) strtoul(argv[++i], NULL, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      block = (uint16_t) atoi(argv[++i]);
+      if (block == 0 || block > MAX_BLOCK) {
+        fprintf(stderr, "-n: 1..%d\n", MAX_BLOCK);
+        return 2;
+      }
+    } else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+      out = fopen(argv[++i], "w");
+      if (out == NULL) {
+        perror(argv[i]);
+        return 1;
+      }
+    } else if (!parse_stage(argv[i])) {
+      status |= run(argv[i], period_us, block, out);
+      sessions++;
+    }
+  }
+  if (sessions == 0) {
+    fprintf(stderr, "usage: %s [-p sample_period_us] [-n block] [-o out.txt] "
+            "STAGE [STAGE ...] session.txt ...\n", argv[0]);
+    return 2;
+  }
+  if (out != NULL) {
+    fclose(out);
+  }
+  return status;
+}
@@ -0,0 +1,225 @@
+// Checks the burst pressure protocol on the host: the pump module's sketch,
+// Arduino/Final_Arduino_FW, runs against a simulated cuff, clock and I2C
+// bus, and is read the way PumpTask reads it, through PressureBurst_Decode
+// into a PressureSlot.
+//
+// The master inflates the cuff, starts bursts and reads every -p ms on its
+// own clock, which runs -d ppm off the Arduino's.  Every sample published
+// must be the one the sketch read from the ADC with that sequence number,
+// dated within 500 us of when it was read, and every sample in between must
+// be counted as lost.  -e corrupts one byte in that fraction of the reads,
+// and -s stalls the master once for that many ms, longer than the ring
+// lasts, so both the CRC and the gap detection are exercised.  Exits
+// non-zero on any mismatch.
+//
+// build: c++ -O2 -I.. -Iarduino -o pumpburst pumpburst.cpp ../PressureBurst.c
+//        ../PressureSlot.c
+// usage: pumpburst [-t seconds] [-p poll_ms] [-d drift_ppm] [-e error_rate]
+//                  [-s stall_ms] [-v]
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "Wire.h"
+
+#include "../../../Arduino/Final_Arduino_FW/Final_Arduino_FW.ino"
+
+#include "PressureBurst.h"
+#include "PressureSlot.h"
+
+#define MAX_SAMPLES 65536
+
+// What the sketch read from the ADC, by sequence number.
+static uint64_t truth_us[MAX_SAMPLES];
+static uint16_t truth_value[MAX_SAMPLES];
+static uint32_t truth_count;
+
+// Cuff pressure in transducer counts.
+static double cuff = 54.0;
+static double cuff_peak;
+static uint64_t cuff_us;
+
+static void cuff_Update(void) {
+  double dt = (sim_us - cuff_us) / 1e6;
+
+  cuff_us = sim_us;
+  if (sim_pins[kSolenoidValvePin] == LOW) {
+    cuff -= 300.0 * dt;               // Valve open.
+  } else if (sim_pins[kMotorBrakePin] == LOW) {
+    cuff += 400.0 * dt;               // Pump running.
+  } else {
+    cuff -= 12.0 * dt;                // Slow leak.
+  }
+  if (cuff < 54.0) {
+    cuff = 54.0;
+  }
+  if (cuff > cuff_peak) {
+    cuff_peak = cuff;
+  }
+}
+
+static int sim_AnalogRead(int pin) {
+  int value;
+
+  cuff_Update();
+  // Oscillations of a few counts, as the pulse gives.
+  value = (int) lround(cuff + 3.0 * sin(2.0 * M_PI * 1.2 * sim_us / 1e6));
+  value = value < 0 ? 0 : value > 1023 ? 1023 : value;
+  if (pin == kTransducerPin && truth_count < MAX_SAMPLES) {
+    truth_us[truth_count] = sim_us;
+    truth_value[truth_count] = (uint16_t) value;
+    truth_count++;
+  }
+  return value;
+}
+
+// Runs the sketch up to time us: its loop, and Timer1 when it is due.
+static uint64_t timer_us;
+
+static void arduino_RunUntil(uint64_t us) {
+  uint64_t period_us = ((uint64_t) OCR1A + 1) / 2;
+
+  while (sim_us < us) {
+    if ((TIMSK1 & _BV(OCIE1A)) && sim_us >= timer_us) {
+      TIMER1_COMPA_vect();
+      timer_us += period_us;
+    }
+    loop();
+    sim_us += 50;
+  }
+}
+
+int main(int argc, char **argv) {
+  static PressureSlot slot;
+  static PressureBurst burst;
+  uint8_t command[4];
+  uint8_t frame[PRESSURE_BURST_FRAME_SIZE];
+  double seconds = 20.0, poll_ms = 20.0, drift_ppm = 50.0, error_rate = 0.01;
+  double stall_ms = 300.0;
+  bool stalled = false;
+  uint64_t read_us;
+  uint32_t local_us, offset_us = 123456789u;
+  uint32_t count, first, i, published, index;
+  uint32_t reads = 0, corrupted = 0;
+  int32_t error_us, max_error_us = 0;
+  int errors = 0;
+  int n;
+
+  for (n = 1; n < argc; n++) {
+    if (n + 1 < argc && strcmp(argv[n], "-t") == 0) {
+      seconds = atof(argv[++n]);
+    } else if (n + 1 < argc && strcmp(argv[n], "-p") == 0) {
+      poll_ms = atof(argv[++n]);
+    } else if (n + 1 < argc && strcmp(argv[n], "-d") == 0) {
+      drift_ppm = atof(argv[++n]);
+    } else if (n + 1 < argc && strcmp(argv[n], "-e") == 0) {
+      error_rate = atof(argv[++n]);
+    } else if (n + 1 < argc && strcmp(argv[n], "-s") == 0) {
+      stall_ms = atof(argv[++n]);
+    } else if (strcmp(argv[n], "-v") == 0) {
+      Serial.verbose = true;
+    } else {
+      fprintf(stderr, "usage: %s [-t seconds] [-p poll_ms] [-d drift_ppm] "
+              "[-e error_rate] [-s stall_ms] [-v]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(350);
+  sim_analog_read = sim_AnalogRead;
+  setup();
+  timer_us = sim_us;
+  arduino_RunUntil(100000);
+
+  // As PumpTask: the target pressure (180 mmHg), then bursts.
+  command[0] = 0x00;
+  command[1] = kRequestSetTargetPressure;
+  command[2] = 502 & 0xFF;
+  command[3] = 502 >> 8;
+  Wire.masterWrite(command, 4);
+  command[1] = PRESSURE_BURST_COMMAND;
+  command[2] = PRESSURE_BURST_MAX_SAMPLES;
+  Wire.masterWrite(command, 3);
+  first = truth_count;
+  PressureSlot_Init(&slot);
+  PressureBurst_Init(&burst);
+
+  read_us = sim_us;
+  while (sim_us < (uint64_t) (seconds * 1e6)) {
+    read_us += (uint64_t) (poll_ms * 1000.0);
+    if (!stalled && stall_ms > 0 && sim_us > (uint64_t) (seconds * 5e5)) {
+      read_us += (uint64_t) (stall_ms * 1000.0);
+      stalled = true;
+    }
+    arduino_RunUntil(read_us);
+
+    // The read starts now on the master's clock; the sketch answers once the
+    // address byte is through.
+    local_us = offset_us
+               + (uint32_t) (uint64_t) (sim_us * (1.0 + drift_ppm * 1e-6));
+    arduino_RunUntil(sim_us + 90);
+    Wire.masterRead(frame, PRESSURE_BURST_FRAME_SIZE);
+    reads++;
+    if (rand() < error_rate * RAND_MAX) {
+      frame[rand() % PRESSURE_BURST_FRAME_SIZE] ^= (uint8_t) (1 + rand() % 255);
+      corrupted++;
+    }
+
+    published = PressureBurst_Decode(&burst, frame, local_us, &slot);
+    count = frame[1] & PRESSURE_BURST_COUNT_MASK;
+    if (published != 0 && published != count) {
+      printf("read %u: %u samples published, %u in the frame\n",
+             (unsigned) reads, (unsigned) published, (unsigned) count);
+      errors++;
+    }
+
+    // Check what was published against what the sketch read.
+    index = (uint16_t) (frame[2] | (frame[3] << 8));
+    for (i = 0; i < published; i++, index++) {
+      const PressureReading *reading =
+          &slot.readings[(slot.sequence / 2 - published + i)
+                         & (PRESSURE_SLOT_HISTORY - 1)];
+      if (index >= truth_count || reading->analog != truth_value[index]) {
+        printf("read %u: sample %u is %u, the ADC read %u\n",
+               (unsigned) reads, (unsigned) index, (unsigned) reading->analog,
+               (unsigned) (index < truth_count ? truth_value[index] : 0));
+        errors++;
+        continue;
+      }
+      error_us = (int32_t) (reading->timestamp_us
+                            - (offset_us
+                               + (uint32_t) (uint64_t) (truth_us[index]
+                                                        * (1.0 + drift_ppm
+                                                                     * 1e-6))));
+      if (abs(error_us) > abs(max_error_us)) {
+        max_error_us = error_us;
+      }
+    }
+  }
+
+  // Everything from the burst command up to the last sample sent was either
+  // published or counted lost.
+  if (burst.samples + burst.lost != (uint16_t) (burst.next_sequence - first)) {
+    printf("%u published + %u lost, but %u sent\n", (unsigned) burst.samples,
+           (unsigned) burst.lost,
+           (unsigned) (uint16_t) (burst.next_sequence - first));
+    errors++;
+  }
+  if (abs(max_error_us) > 500) {
+    printf("timestamps up to %d us off\n", (int) max_error_us);
+    errors++;
+  }
+  if (!reached_target_pressure || cuff_peak < 502) {
+    printf("cuff not inflated (%.0f counts)\n", cuff_peak);
+    errors++;
+  }
+
+  printf("%u reads (%u corrupted), %u frames, %u bad; %u samples of %u "
+         "taken, %u lost; timestamps within %d us\n",
+         (unsigned) reads, (unsigned) corrupted, (unsigned) burst.frames,
+         (unsigned) burst.bad_frames, (unsigned) burst.samples,
+         (unsigned) (truth_count - first), (unsigned) burst.lost,
+         (int) max_error_us);
+  printf("%s\n", errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,405 @@
+// Checks the pump module and I2C stand-ins (arduino/PumpSim.h and
+// aducm350/I2cSim.h) with the unmodified PumpTask, i2c.c and Arduino
+// sketch: both sides of the cuff on the host, at simulated time.
+//
+// A task at MainTask's priority sets I2C up as i2c_Init() does, resumes
+// PumpTask and takes the readings PumpTask publishes, as MainTask does,
+// until the cuff is below LOWEST_PRESSURE_THRESHOLD_MMHG again; then it has
+// PumpTask deflate the cuff and waits to be resumed.  The cuff must have
+// been inflated to HIGH_PRESSURE and the readings must say when it got
+// there.  Every reading must be a sample the sketch took, with its value,
+// dated within 500 us of when it took it, and none may be missing.  The
+// oscillations must come through: the readings, less their mean over a
+// beat, must be largest within 15 mmHg of the mean arterial pressure.  The
+// cuff must be empty when PumpTask resumes the task.  Prints the
+// inflation, the readings, the oscillation envelope and the bus use.
+//
+// -t is the longest the measurement may take, in simulated seconds;
+// -p systolic/diastolic, -b the heart rate, -o the largest oscillation and
+// -l the leak, in mmHg/s, set up the cuff (see PumpSim.h); -n is the
+// transducer noise in counts, -c the CPU scale (simulated ns per host ns)
+// and -v prints what the sketch prints.  Exits non-zero on any failure.
+//
+// build: c++ -O2 -Iarduino -c arduino/PumpSim.cpp
+//        cc -O2 $SIM -I$CMSIS_DSP/Include -o pumpsim pumpsim.c PumpSim.o
+//        aducm350/ChipSim.c aducm350/I2cSim.c ../PumpTask.c
+//        ../PressureBurst.c ../PressureSlot.c
+//        $E/src/i2c.c $E/src/adi_int.c $E/src/adi_nvic.c
+//        $(ls $O/*.c | grep -v _tls) $E/osal/uCOS-II/Ports/*.c
+//        $U/Source/ucos_ii.c $U/Ports/POSIX/GNU/os_cpu_c.c -lstdc++ -lm
+//        with E, U, O and SIM as in Readme.txt, "Simulated AFE"
+// usage: pumpsim [-t seconds] [-p systolic/diastolic] [-b bpm] [-o mmhg]
+//                [-l mmhg_s] [-n noise] [-c cpu_scale] [-v]
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ImpedanceRtos.h"
+
+#include "ChipSim.h"
+#include "I2cSim.h"
+#include "arduino/PumpSim.h"
+
+#define MAX_READINGS 65536
+#define BAND_MMHG 10
+#define BANDS 30
+
+static OS_STK main_stack[512];
+static OS_STK pump_stack[TASK_PUMP_STK_SIZE];
+
+static double seconds = 120.0;
+static int errors;
+
+ADI_I2C_DEV_HANDLE i2cDevice;
+extern PressureBurst pressure_burst;
+
+// The readings PumpTask published, in order.
+static PressureReading readings[MAX_READINGS];
+static uint32_t reading_count;
+static uint32_t published;
+
+// The application hooks this os_cfg.h asks for.
+void App_TaskCreateHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskDelHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskIdleHook(void) {}
+void App_TaskReturnHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskStatHook(void) {}
+void App_TaskSwHook(void) {}
+void App_TCBInitHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TimeTickHook(void) {}
+void App_TraceIsrEnter(uint32_t irq) { (void) irq; }
+void App_TraceIsrExit(uint32_t irq) { (void) irq; }
+
+// Trace.c, left out.
+void Trace_Record(uint8_t type, uint8_t id, uint16_t arg) {
+  (void) type;
+  (void) id;
+  (void) arg;
+}
+
+// Timestamp.c, on the simulated clock.
+uint64_t Timestamp_Now(void) {
+  return OS_CPU_SimTimeNs() / 1000u;
+}
+
+uint32_t Timestamp_Now32(void) {
+  return (uint32_t) Timestamp_Now();
+}
+
+void test_Fail(char *FailureReason) {
+  printf("%s\nFAILED\n", FailureReason);
+  exit(1);
+}
+
+// As i2c_Init() in MainTask.c.
+static bool i2c_Setup(void) {
+  return adi_I2C_MasterInit(ADI_I2C_DEVID_0, &i2cDevice) == ADI_I2C_SUCCESS
+         && adi_I2C_SetMasterClock(i2cDevice, I2C_MASTER_CLOCK)
+                == ADI_I2C_SUCCESS
+         && adi_I2C_SetBlockingMode(i2cDevice, false) == ADI_I2C_SUCCESS
+         && adi_I2C_SetDmaMode(i2cDevice, true) == ADI_I2C_SUCCESS
+         && adi_I2C_RegisterCallback(i2cDevice, PumpTask_I2CCallback, NULL)
+                == ADI_I2C_SUCCESS;
+}
+
+
+// A reading in whole mmHg, as MainTask rounds it.
+static uint32_t reading_Mmhg(const PressureReading *reading) {
+  int32_t pressure16 = transducer_to_mmhg16(reading->analog);
+
+  return pressure16 > 0 ? (uint32_t) (pressure16 + 8) / 16 : 0;
+}
+
+// Takes the readings published since the last call, as MainTask would; the
+// I2C interrupt publishes them.
+static void readings_Take(void) {
+  uint32_t count;
+  OS_CPU_SR cpu_sr;
+
+  OS_ENTER_CRITICAL();
+  count = PressureSlot_Count(&pressure_slot);
+  if (count - published > PRESSURE_SLOT_HISTORY) {
+    printf("%u readings published before the task could take them\n",
+           (unsigned) (count - published - PRESSURE_SLOT_HISTORY));
+    errors++;
+    published = count - PRESSURE_SLOT_HISTORY;
+  }
+  while (published != count && reading_count < MAX_READINGS) {
+    readings[reading_count++] =
+        pressure_slot.readings[published++ & (PRESSURE_SLOT_HISTORY - 1)];
+  }
+  OS_EXIT_CRITICAL();
+}
+
+// A read before the burst command, as the ADuCM350 did without it: the
+// inflation flag and the newest sample.
+static void check_PlainRead(void) {
+  const PumpSimStats *pump = PumpSim_Stats();
+  uint8_t rx[3];
+  PumpSimSample newest, before;
+  uint16_t value;
+  INT8U err;
+
+  OSSemSet(pressure_semaphore, 0, &err);
+  if (adi_I2C_MasterReceive(i2cDevice, I2C_PUMP_SLAVE_ADDRESS, 0x0,
+                            ADI_I2C_NO_DATA_ADDRESSING_PHASE, rx, sizeof(rx),
+                            false) != ADI_I2C_SUCCESS) {
+    printf("adi_I2C_MasterReceive failed\n");
+    errors++;
+    return;
+  }
+  OSSemPend(pressure_semaphore, PRESSURE_I2C_TIMEOUT_TICKS, &err);
+  value = (uint16_t) (rx[1] | (rx[2] << 8));
+  // The read may have been answered just before the last sample.
+  if (err != OS_ERR_NONE || rx[0] != ARDUINO_STILL_INFLATING
+      || !PumpSim_Sample(pump->samples - 1, &newest)
+      || !PumpSim_Sample(pump->samples - 2, &before)
+      || (value != newest.analog && value != before.analog)) {
+    printf("plain read: %02X %u, expected %02X %u\n", (unsigned) rx[0],
+           (unsigned) value, (unsigned) ARDUINO_STILL_INFLATING,
+           (unsigned) newest.analog);
+    errors++;
+  }
+}
+
+// Every reading must be the sketch's sample, in order, dated within
+// 500 us; the readings must say when the cuff was inflated.
+static void check_Readings(void) {
+  const PumpSimStats *pump = PumpSim_Stats();
+  uint32_t inflated_us = (uint32_t) (pump->inflated_at / 1000u);
+  uint32_t i, mismatched = 0, misdated = 0, reached_at = 0;
+  int32_t error_us, worst_us = 0;
+  PumpSimSample sample, next;
+  uint64_t n = 0;
+
+  if (reading_count == 0) {
+    printf("no readings\n");
+    errors++;
+    return;
+  }
+  // The first reading is the sample taken nearest to it.
+  while (PumpSim_Sample(n, &sample) && PumpSim_Sample(n + 1, &next)
+         && next.at / 1000u <= readings[0].timestamp_us) {
+    n++;
+  }
+  if (PumpSim_Sample(n + 1, &next)
+      && next.at / 1000u - readings[0].timestamp_us
+             < readings[0].timestamp_us - sample.at / 1000u) {
+    n++;
+  }
+  for (i = 0; i < reading_count; i++) {
+    if (!PumpSim_Sample(n + i, &sample)
+        || sample.analog != readings[i].analog) {
+      mismatched++;
+      continue;
+    }
+    error_us = (int32_t) (readings[i].timestamp_us
+                          - (uint32_t) (sample.at / 1000u));
+    if (abs(error_us) > abs(worst_us)) {
+      worst_us = error_us;
+    }
+    if (abs(error_us) > 500) {
+      misdated++;
+    }
+    if (readings[i].status & PRESSURE_BURST_REACHED) {
+      if (reached_at == 0) {
+        reached_at = readings[i].timestamp_us;
+      }
+    } else if (reached_at != 0 || readings[i].timestamp_us > inflated_us) {
+      misdated++;
+    }
+  }
+
+  printf("inflated to %.1f mmHg (target %u counts) at %.2f s, reached at "
+         "%.2f s in the readings\n", pump->peak_mmhg,
+         (unsigned) mmhg_to_transducer(HIGH_PRESSURE), inflated_us / 1e6,
+         reached_at / 1e6);
+  printf("%u readings in %u frames, %u lost, %u bad frames; worst date "
+         "error %d us\n", (unsigned) reading_count,
+         (unsigned) pressure_burst.frames, (unsigned) pressure_burst.lost,
+         (unsigned) pressure_burst.bad_frames, (int) worst_us);
+
+  if (mismatched != 0 || misdated != 0 || pressure_burst.lost != 0
+      || pressure_burst.bad_frames != 0) {
+    printf("  %u readings not the sketch's samples, %u misdated or "
+           "misflagged\n", (unsigned) mismatched, (unsigned) misdated);
+    errors++;
+  }
+  if (pump->peak_mmhg < HIGH_PRESSURE || reached_at == 0
+      || reached_at + 1000000u / PRESSURE_POLL_HZ
+             + 2 * PRESSURE_BURST_PERIOD_US < inflated_us) {
+    printf("  the cuff was not inflated to %d mmHg, or the readings missed "
+           "it\n", HIGH_PRESSURE);
+    errors++;
+  }
+}
+
+// The oscillations the readings carry, less their mean over a beat, per
+// band of the mean, while the cuff leaks down.
+static void check_Oscillations(const PumpSimConfig *config) {
+  static double mmhg[MAX_READINGS + 1];
+  double sum[BANDS] = {0}, mean, rms, peak_rms = 0.0;
+  uint32_t count[BANDS] = {0}, i, window, band, peak = 0;
+
+  window = (uint32_t) (60e6 / config->heart_bpm / PRESSURE_BURST_PERIOD_US);
+  // Prefix sums of the pressure.
+  mmhg[0] = 0.0;
+  for (i = 0; i < reading_count; i++) {
+    mmhg[i + 1] = mmhg[i] + (readings[i].analog - config->counts_offset)
+                            / config->counts_per_mmhg;
+  }
+  for (i = window / 2; i + window - window / 2 <= reading_count; i++) {
+    if (!(readings[i - window / 2].status & PRESSURE_BURST_REACHED)) {
+      continue;
+    }
+    mean = (mmhg[i - window / 2 + window] - mmhg[i - window / 2]) / window;
+    band = (uint32_t) (mean / BAND_MMHG);
+    if (mean > 0.0 && band < BANDS) {
+      sum[band] += (mmhg[i + 1] - mmhg[i] - mean)
+                   * (mmhg[i + 1] - mmhg[i] - mean);
+      count[band]++;
+    }
+  }
+  printf("oscillations (rms, mmHg), mean arterial pressure %.1f mmHg:\n",
+         PumpSim_MeanPressure());
+  for (band = 0; band < BANDS; band++) {
+    if (count[band] < window) {
+      continue;
+    }
+    rms = sqrt(sum[band] / count[band]);
+    printf("  %3u-%3u mmHg: %.2f\n", (unsigned) (band * BAND_MMHG),
+           (unsigned) ((band + 1) * BAND_MMHG), rms);
+    if (rms > peak_rms) {
+      peak_rms = rms;
+      peak = band;
+    }
+  }
+  if (peak_rms == 0.0
+      || fabs((peak + 0.5) * BAND_MMHG - PumpSim_MeanPressure()) > 15.0) {
+    printf("  largest at %u mmHg\n",
+           (unsigned) ((peak + 0.5) * BAND_MMHG));
+    errors++;
+  }
+}
+
+static PumpSimConfig config;
+
+static void main_Task(void *arg) {
+  bool inflated = false;
+  uint32_t pressure;
+  uint64_t end_ns = (uint64_t) (seconds * 1e9);
+  double cuff;
+
+  (void) arg;
+  if (!i2c_Setup()) {
+    printf("i2c_Init failed\n");
+    errors++;
+    OS_CPU_SimStop();
+  }
+  OSTimeDly(OS_TICKS_PER_SEC / 10);
+  check_PlainRead();
+
+  // As MainTask: the pressure is read until it is down again.
+  OSTaskResume(TASK_PUMP_PRIO);
+  while (true) {
+    OSTimeDly(1);
+    readings_Take();
+    if (reading_count > 0) {
+      pressure = reading_Mmhg(&readings[reading_count - 1]);
+      if (inflated && pressure < LOWEST_PRESSURE_THRESHOLD_MMHG) {
+        break;
+      } else if (pressure > LOWEST_PRESSURE_THRESHOLD_MMHG * 1.1) {
+        inflated = true;
+      }
+    }
+    if (OS_CPU_SimTimeNs() >= end_ns || reading_count == MAX_READINGS) {
+      printf("the cuff was not down to %d mmHg after %.1f s\n",
+             LOWEST_PRESSURE_THRESHOLD_MMHG, OS_CPU_SimTimeNs() / 1e9);
+      errors++;
+      break;
+    }
+  }
+  PumpTask_Deflate();
+  OSTaskSuspend(OS_PRIO_SELF);
+
+  cuff = PumpSim_Pressure(OS_CPU_SimTimeNs());
+  printf("down at %.2f s; %.1f mmHg left when PumpTask resumed the task\n",
+         readings[reading_count - 1].timestamp_us / 1e6, cuff);
+  if (cuff > 5.0) {
+    errors++;
+  }
+  check_Readings();
+  check_Oscillations(&config);
+  OS_CPU_SimStop();
+}
+
+int main(int argc, char **argv) {
+  static const I2cSimSlave pump = {PUMP_SIM_ADDRESS, PumpSim_Write,
+                                   PumpSim_Read};
+  const I2cSimStats *bus;
+  const PumpSimStats *stats;
+  double scale = 20.0;
+  int i;
+
+  PumpSim_Defaults(&config);
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+      seconds = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0
+               && sscanf(argv[++i], "%lf/%lf", &config.systolic_mmhg,
+                         &config.diastolic_mmhg) == 2) {
+    } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+      config.heart_bpm = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+      config.oscillation_mmhg = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+      config.leak_mmhg_s = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      config.noise = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+      scale = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-v") == 0) {
+      config.verbose = true;
+    } else {
+      fprintf(stderr, "usage: %s [-t seconds] [-p systolic/diastolic] "
+              "[-b bpm] [-o mmhg] [-l mmhg_s] [-n noise] [-c cpu_scale] "
+              "[-v]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  OSInit();
+  OS_CPU_SimCpuScale(scale);
+  ChipSim_Init();
+  I2cSim_Init();
+  PumpSim_Init(&config);
+  I2cSim_Attach(&pump);
+  pressure_semaphore = OSSemCreate(0);
+  OSTaskCreate(main_Task, NULL, &main_stack[511], TASK_MAIN_PRIO);
+  OSTaskCreate(PumpTask, NULL, &pump_stack[TASK_PUMP_STK_SIZE - 1],
+               TASK_PUMP_PRIO);
+  OS_CPU_SysTickInit(OS_CPU_SIM_CLK_FREQ / OS_TICKS_PER_SEC);
+  OSStart();
+
+  stats = PumpSim_Stats();
+  bus = I2cSim_Stats();
+  printf("%.1f s simulated: %llu samples, %llu writes and %llu reads to the "
+         "sketch; bus busy %.2f%%, %llu bytes, %llu NACKs, %llu overflows; "
+         "idle %.1f%%\n", OS_CPU_SimTimeNs() / 1e9,
+         (unsigned long long) stats->samples,
+         (unsigned long long) stats->writes,
+         (unsigned long long) stats->reads,
+         100.0 * bus->busy_ns / OS_CPU_SimTimeNs(),
+         (unsigned long long) (bus->bytes_written + bus->bytes_read),
+         (unsigned long long) bus->nacks,
+         (unsigned long long) bus->rx_overflows,
+         100.0 * OS_CPU_SimStats.IdleNs / OS_CPU_SimTimeNs());
+  if (bus->nacks != 0 || bus->rx_overflows != 0) {
+    errors++;
+  }
+  printf("%s\n", errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}
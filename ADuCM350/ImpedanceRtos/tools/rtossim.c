@@ -0,0 +1,237 @@
+// Checks the uC/OS-II POSIX port (uCOS-II/Ports/POSIX/GNU) on the host, with
+// this project's os_cfg.h and task priorities.
+//
+// A periodic simulated interrupt posts a semaphore to a task at MainTask's
+// priority every -r microseconds, and the task does -w microseconds of work
+// per post.  A task at PumpTask's priority sleeps one tick at a time, and
+// one at UX_Task's priority computes without ever calling the kernel, so
+// the interrupt and the wakeups have to preempt it; with -u it sleeps
+// instead, and the idle task skips the time left.  The CPU scale is -s
+// simulated ns per host ns.  After -t simulated seconds, checks that every
+// post was taken, that the interrupt was not held off for a whole period
+// more than once in a thousand, that the ticks kept time, and that 99% of
+// the interrupt-to-task latencies stayed under -l microseconds; prints the
+// latency percentiles, the switch counts and the CPU headroom.  The host
+// adds its own hiccups to the longest latencies, times the CPU scale.
+// Exits non-zero on any failure.
+//
+// build: cc -O2 -I.. -I$U/Source -I$U/Ports/POSIX/GNU
+//        -I../../Eval-ADUCM350EBZ/osal/uCOS-II/Source -o rtossim rtossim.c
+//        $U/Source/ucos_ii.c $U/Ports/POSIX/GNU/os_cpu_c.c
+//        with U=../../uCOS-II-ADuCM350/Micrium/Software/uCOS-II
+// usage: rtossim [-t seconds] [-r period_us] [-w work_us] [-s cpu_scale]
+//                [-l max_latency_us] [-u]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ucos_ii.h>
+
+#define DFT_IRQ 2
+#define MAX_EVENTS 1000000
+
+#define MAIN_PRIO 5
+#define PUMP_PRIO 6
+#define UX_PRIO 8
+
+static OS_STK main_stack[512];
+static OS_STK pump_stack[512];
+static OS_STK ux_stack[512];
+
+static OS_EVENT *dft_semaphore;
+static double work_us = 100.0;
+static bool ux_sleeps;
+
+// When the ISR posted, by post number, and the latency of every post.
+static INT64U post_ns[MAX_EVENTS];
+static volatile INT32U posts;
+static INT32U taken;
+static INT32U latency_us[MAX_EVENTS];
+
+static INT32U pump_sleeps;
+static INT32U pump_late;
+static volatile INT64U ux_loops;
+
+// The application hooks this os_cfg.h asks for.
+void App_TaskCreateHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskDelHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskIdleHook(void) {}
+void App_TaskReturnHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskStatHook(void) {}
+void App_TaskSwHook(void) {}
+void App_TCBInitHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TimeTickHook(void) {}
+
+// Spins for about us simulated microseconds, calling nothing but the clock.
+static void busy(double us) {
+  INT64U end = OS_CPU_SimTimeNs() + (INT64U) (us * 1000.0);
+  volatile double x = 1.0;
+  int i;
+
+  while (OS_CPU_SimTimeNs() < end) {
+    for (i = 0; i < 100; i++) {
+      x = x * 1.0000001 + 1e-9;
+    }
+  }
+}
+
+static void dft_ISR(void) {
+  OSIntEnter();
+  if (posts < MAX_EVENTS) {
+    post_ns[posts] = OS_CPU_SimTimeNs();
+  }
+  posts++;
+  OSSemPost(dft_semaphore);
+  OSIntExit();
+}
+
+static void main_Task(void *arg) {
+  INT8U err;
+  INT64U latency_ns;
+
+  (void) arg;
+  for (;;) {
+    OSSemPend(dft_semaphore, 0, &err);
+    if (taken < MAX_EVENTS) {
+      latency_ns = OS_CPU_SimTimeNs() - post_ns[taken];
+      latency_us[taken] = (INT32U) (latency_ns / 1000u);
+    }
+    taken++;
+    busy(work_us);
+  }
+}
+
+static void pump_Task(void *arg) {
+  INT32U tick;
+  INT64U expect_ns, now_ns;
+  const INT64U tick_ns = 1000000000u / OS_TICKS_PER_SEC;
+
+  (void) arg;
+  for (;;) {
+    tick = OSTimeGet();
+    OSTimeDly(1);
+    pump_sleeps++;
+    now_ns = OS_CPU_SimTimeNs();
+    // The tick count and the clock agree to within one tick.
+    expect_ns = (INT64U) OSTimeGet() * tick_ns;
+    if (OSTimeGet() != tick + 1 || now_ns + tick_ns < expect_ns
+        || now_ns > expect_ns + tick_ns) {
+      pump_late++;
+    }
+  }
+}
+
+static void ux_Task(void *arg) {
+  volatile double x = 1.0;
+
+  (void) arg;
+  for (;;) {
+    if (ux_sleeps) {
+      OSTimeDly(10);
+    }
+    x = x * 1.0000001 + 1e-9;
+    ux_loops++;
+  }
+}
+
+static int compare(const void *a, const void *b) {
+  INT32U x = *(const INT32U *) a, y = *(const INT32U *) b;
+  return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+  double seconds = 10.0, period_us = 1000.0, scale = 20.0, max_latency = 500.0;
+  INT32U n, count, expected;
+  int errors = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+      seconds = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+      period_us = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+      work_us = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+      scale = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+      max_latency = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-u") == 0) {
+      ux_sleeps = true;
+    } else {
+      fprintf(stderr, "usage: %s [-t seconds] [-r period_us] [-w work_us] "
+              "[-s cpu_scale] [-l max_latency_us] [-u]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  OSInit();
+  OS_CPU_SimCpuScale(scale);
+  dft_semaphore = OSSemCreate(0);
+  OSTaskCreate(main_Task, NULL, &main_stack[511], MAIN_PRIO);
+  OSTaskCreate(pump_Task, NULL, &pump_stack[511], PUMP_PRIO);
+  OSTaskCreate(ux_Task, NULL, &ux_stack[511], UX_PRIO);
+
+  OS_CPU_SysTickInit(OS_CPU_SIM_CLK_FREQ / OS_TICKS_PER_SEC);
+  OS_CPU_SimIntConnect(DFT_IRQ, dft_ISR);
+  OS_CPU_SimIntPeriod(DFT_IRQ, (INT64U) (period_us * 1000.0));
+  OS_CPU_SimIntPend(DFT_IRQ, (INT64U) (period_us * 1000.0));
+  OS_CPU_SimStopAt((INT64U) (seconds * 1e9));
+  OSStart();
+
+  count = taken < MAX_EVENTS ? taken : MAX_EVENTS;
+  qsort(latency_us, count, sizeof(latency_us[0]), compare);
+  printf("%.1f s simulated: %u posts, %u taken; %u ticks; %llu UX loops\n",
+         OS_CPU_SimTimeNs() / 1e9, (unsigned) posts, (unsigned) taken,
+         (unsigned) OSTimeGet(), (unsigned long long) ux_loops);
+  if (count > 0) {
+    printf("latency us: p50 %u  p99 %u  p99.9 %u  max %u\n",
+           (unsigned) latency_us[count / 2],
+           (unsigned) latency_us[count * 99 / 100],
+           (unsigned) latency_us[count * 999 / 1000],
+           (unsigned) latency_us[count - 1]);
+  }
+  printf("%llu task switches, %llu from ISRs; %llu interrupts, %llu "
+         "preempting; interrupt lag max %llu us, mean %.1f us; idle %.1f%%\n",
+         (unsigned long long) OS_CPU_SimStats.CtxSwCtr,
+         (unsigned long long) OS_CPU_SimStats.IntCtxSwCtr,
+         (unsigned long long) OS_CPU_SimStats.IntCtr,
+         (unsigned long long) OS_CPU_SimStats.IntPreemptCtr,
+         (unsigned long long) OS_CPU_SimStats.IntLagMaxNs / 1000u,
+         OS_CPU_SimStats.IntCtr
+             ? OS_CPU_SimStats.IntLagTotNs / 1e3 / OS_CPU_SimStats.IntCtr
+             : 0.0,
+         100.0 * OS_CPU_SimStats.IdleNs / OS_CPU_SimTimeNs());
+
+  // The last post may still be waiting for the task when the run stops.
+  expected = (INT32U) (seconds * 1e6 / period_us);
+  if (taken + 1 < posts) {
+    printf("%u posts not taken\n", (unsigned) (posts - taken));
+    errors++;
+  }
+  if (posts + 1 + expected / 1000 < expected) {
+    printf("%u interrupts of %u missed\n", (unsigned) (expected - posts),
+           (unsigned) expected);
+    errors++;
+  }
+  if (pump_late != 0 || pump_sleeps + 2 < OSTimeGet()) {
+    printf("ticks off: %u late of %u sleeps\n", (unsigned) pump_late,
+           (unsigned) pump_sleeps);
+    errors++;
+  }
+  if (ux_loops == 0) {
+    printf("the UX task never ran\n");
+    errors++;
+  }
+  for (n = 0; n < count && latency_us[n] <= max_latency; n++) {
+  }
+  if (count - n > count / 100) {
+    printf("%u posts took longer than %.0f us\n", (unsigned) (count - n),
+           max_latency);
+    errors++;
+  }
+  printf("%s\n", errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,643 @@
+// Benchmarks the measurement pipeline end to end on the host: the
+// unmodified MainTask, PumpTask and TelemetryTask, with afe.c, i2c.c and
+// uart.c under them, on the simulated AFE, pump module and UART
+// (aducm350/AfeSim.h, arduino/PumpSim.h and aducm350/UartSim.h).
+//
+// A task at UX_Task's priority plays the user: for every output rate of -r
+// (mHz, comma separated) it sets both of MainTask's rates to it
+// (MainTask_SetRates()), presses the button and waits for the session to
+// end (UX_Disengage()).  With -d, it sets the output decimation to that
+// ratio once the session has DECIMATE_AFTER samples, as the 'R' command
+// does (MainTask_SetDecimation()), and back to 1 before the next session.
+// The telemetry is decoded as it leaves the UART.  For every rate it prints
+//   the samples per second sustained, from the SAMPLE frames over the span
+//   of their timestamps since the START or the last RATE frame, against
+//   what the rate plan and the decimation make with the RCAL DFTs taken
+//   out;
+//   the latency from the timestamp the DFT interrupt gave a result to the
+//   last byte of its SAMPLE frame on the wire: median, 99th and 99.9th
+//   percentiles and the largest;
+//   the high-water marks of dft_ring, telemetry_ring and uart_tx;
+//   and the CPU headroom, the time the idle task ran between the START and
+//   END frames.
+// A rate fails if its session doesn't end within -t seconds, sustains less
+// than 99% of the planned rate, drops or overwrites a result in any ring,
+// overflows uart_tx, loses or garbles a frame on the wire, or, with -d,
+// sends no RATE frame.
+//
+// The RTC and the flash controller are stand-ins here, at the level of
+// their drivers' calls: the count runs on the simulated clock and the alarm
+// never fires; the flash is memory at its address, a page erase takes
+// 20 ms and a write none.  -c is the CPU scale (simulated ns per host ns):
+// the higher, the slower the firmware runs.  -p sets the cuff (see
+// PumpSim.h) and -n the AFE's noise (see AfeSim.h).  -x writes the trace
+// recorder's dump (see Trace.h) to a file once the last session ends, as
+// the 'T' command sends it; tools/tracedump.cpp reads it.  -x needs
+// -DAPP_TRACE_EN=1u, as the build line below has it.
+//
+// build: c++ -O2 -Iarduino -c arduino/PumpSim.cpp
+//        cc -O2 $SIM -DUSE_SIM_HOOKS=1 -DAPP_TRACE_EN=1u
+//        -I$CMSIS_DSP/Include -o sessionsim sessionsim.c
+//        PumpSim.o aducm350/ChipSim.c aducm350/AfeSim.c aducm350/I2cSim.c
+//        aducm350/UartSim.c ../MainTask.c ../PumpTask.c ../TelemetryTask.c
+//        ../DftRing.c ../DftBlock.c ../DftRate.c ../Sequences.c ../Sweep.c
+//        ../Pipeline.c ../BpEstimator.c ../BeatDetector.c
+//        ../PressureBurst.c ../PressureSlot.c ../Telemetry.c
+//        ../TelemetryRing.c ../UartTx.c ../CrcService.c ../SessionStore.c
+//        ../Trace.c $E/src/afe.c $E/src/afe_lib.c $E/src/i2c.c $E/src/uart.c
+//        $E/src/adi_int.c $E/src/adi_nvic.c
+//        $(ls $O/*.c | grep -v _tls) $E/osal/uCOS-II/Ports/*.c
+//        $U/Source/ucos_ii.c $U/Ports/POSIX/GNU/os_cpu_c.c
+//        and the five CMSIS-DSP sources Readme.txt lists, -lstdc++ -lm
+//        with E, U, O and SIM as in Readme.txt, "Simulated AFE"
+// usage: sessionsim [-r mhz,mhz,...] [-t seconds] [-p systolic/diastolic]
+//                   [-n noise] [-c cpu_scale] [-d ratio] [-x trace_file]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ImpedanceRtos.h"
+
+#if (1 != USE_SIM_HOOKS)
+#error "build with -DUSE_SIM_HOOKS=1 (MainTask_SetRates)"
+#endif
+
+#include "AfeSim.h"
+#include "ChipSim.h"
+#include "I2cSim.h"
+#include "UartSim.h"
+#include "arduino/PumpSim.h"
+
+#define MAX_RATES 16
+#define MAX_SAMPLES 131072
+#define DECIMATE_AFTER 256
+
+#define FLASH_BLOCK_1 0x00040000u
+#define FLASH_BLOCK_SIZE 0x00040000u
+#define FLASH_PAGE_SIZE 2048u
+
+static OS_STK main_stack[TASK_MAIN_STK_SIZE];
+static OS_STK pump_stack[TASK_PUMP_STK_SIZE];
+static OS_STK telemetry_stack[TASK_TELEMETRY_STK_SIZE];
+static OS_STK user_stack[TASK_UX_STK_SIZE];
+
+static uint32_t rates[MAX_RATES];
+static int rate_count;
+static double seconds = 300.0;
+static uint16_t decimation;
+static int errors;
+#if (APP_TRACE_EN > 0u)
+static FILE *trace_file;
+#endif
+
+// ImpedanceRtos.c and UX.c.
+OS_EVENT *i2c_mutex;
+OS_EVENT *ux_button_semaphore;
+volatile bool ux_is_engaged;
+static OS_EVENT *session_semaphore;
+
+extern DftRing dft_ring;
+extern DftRatePlan dft_rate;
+
+// The session on the wire: the frames the UART sent since the button.
+typedef struct {
+  bool started, ended;
+  uint64_t start_at, end_at;    // START and END frames on the wire, ns.
+  uint64_t idle_at_start, idle_at_end;
+  uint32_t raw_mhz;             // From the START or last RATE frame.
+  uint32_t ratio;
+  uint32_t rate_changes;        // RATE frames.
+  uint32_t samples;
+  uint32_t at_rate;             // SAMPLE frames since START or RATE.
+  uint32_t first_us, last_us;   // Timestamps of the first and last of those.
+  uint32_t lost, bad;           // Frames missing from the sequence, CRC.
+  uint16_t next_sequence;
+} Session;
+
+static Session session;
+static uint32_t latency_us[MAX_SAMPLES];
+static uint8_t frame[TELEMETRY_FRAME_SIZE];
+static int frame_fill;
+static char message[9];
+
+// The application hooks this os_cfg.h asks for.
+void App_TaskCreateHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskDelHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskIdleHook(void) {}
+void App_TaskReturnHook(OS_TCB *ptcb) { (void) ptcb; }
+void App_TaskStatHook(void) {}
+void App_TCBInitHook(OS_TCB *ptcb) { (void) ptcb; }
+
+// The trace hooks, as app_hooks.c.
+void App_TaskSwHook(void) {
+#if (APP_TRACE_EN > 0u)
+  Trace_Record(TRACE_TASK_SWITCH, OSTCBHighRdy->OSTCBPrio, OSTCBCur->OSTCBPrio);
+#endif
+}
+
+void App_TimeTickHook(void) {
+#if (APP_TRACE_EN > 0u)
+  Trace_Record(TRACE_TICK, 0, 0);
+#endif
+}
+
+#if (APP_TRACE_EN > 0u)
+void App_TraceIsrEnter(uint32_t irq) {
+  Trace_Record(TRACE_ISR_ENTER, (uint8_t) irq, 0);
+}
+
+void App_TraceIsrExit(uint32_t irq) {
+  Trace_Record(TRACE_ISR_EXIT, (uint8_t) irq, 0);
+}
+
+static void trace_Write(const uint8_t *data, uint16_t size) {
+  fwrite(data, 1, size, trace_file);
+}
+#endif
+
+// Timestamp.c, on the simulated clock.
+uint64_t Timestamp_Now(void) {
+  return OS_CPU_SimTimeNs() / 1000u;
+}
+
+uint32_t Timestamp_Now32(void) {
+  return (uint32_t) Timestamp_Now();
+}
+
+void test_Fail(char *FailureReason) {
+  printf("%s\nFAILED\n", FailureReason);
+  exit(1);
+}
+
+void test_Perf(char *InfoString) {
+  printf("%s\n", InfoString);
+}
+
+// UX.c: the button is this program, and the LCD a line of output.
+void UX_Disengage() {
+  ux_is_engaged = false;
+  OSSemPost(session_semaphore);
+}
+
+void UX_LCD_ShowMessage(const uint8_t *text) {
+  memcpy(message, text, 8);
+}
+
+// rtc.c: the count is the simulated second plus what was set.
+static uint32_t rtc_offset;
+
+ADI_RTC_RESULT_TYPE adi_RTC_Init(ADI_RTC_DEV_ID_TYPE id,
+                                 ADI_RTC_HANDLE *const phDevice) {
+  (void) id;
+  *phDevice = (ADI_RTC_HANDLE) &rtc_offset;
+  return ADI_RTC_SUCCESS;
+}
+
+void adi_RTC_ClearFailSafe(void) {}
+
+ADI_RTC_RESULT_TYPE adi_RTC_UnInit(ADI_RTC_HANDLE const hDevice) {
+  (void) hDevice;
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_SetCount(ADI_RTC_HANDLE hDevice, uint32_t count) {
+  (void) hDevice;
+  rtc_offset = count - (uint32_t) (OS_CPU_SimTimeNs() / 1000000000u);
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_GetCount(ADI_RTC_HANDLE hDevice,
+                                     uint32_t *pCount) {
+  (void) hDevice;
+  *pCount = rtc_offset + (uint32_t) (OS_CPU_SimTimeNs() / 1000000000u);
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_SetTrim(ADI_RTC_HANDLE hDevice, uint16_t trim) {
+  (void) hDevice;
+  (void) trim;
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_EnableTrim(ADI_RTC_HANDLE hDevice, bool_t flag) {
+  (void) hDevice;
+  (void) flag;
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_EnableAlarm(ADI_RTC_HANDLE hDevice, bool_t flag) {
+  (void) hDevice;
+  (void) flag;
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_SetAlarm(ADI_RTC_HANDLE hDevice, uint32_t alarm) {
+  (void) hDevice;
+  (void) alarm;
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_EnableDevice(ADI_RTC_HANDLE hDevice,
+                                         bool_t flag) {
+  (void) hDevice;
+  (void) flag;
+  return ADI_RTC_SUCCESS;
+}
+
+ADI_RTC_RESULT_TYPE adi_RTC_RegisterCallback(ADI_RTC_HANDLE const hDevice,
+                                             ADI_CALLBACK const cbFunc,
+                                             uint32_t const cbWatch) {
+  (void) hDevice;
+  (void) cbFunc;
+  (void) cbWatch;
+  return ADI_RTC_SUCCESS;
+}
+
+// flash.c: block 1 is memory at its address.  Erasing a page holds the
+// task for the 20 ms it takes.
+static uint8_t *flash;
+
+ADI_FEE_RESULT_TYPE adi_FEE_Init(ADI_FEE_DEV_ID_TYPE const devID,
+                                 bool_t bRetryAborts,
+                                 ADI_FEE_DEV_HANDLE *const pHandle) {
+  (void) bRetryAborts;
+  if (devID != ADI_FEE_DEVID_1 || flash == NULL) {
+    return ADI_FEE_ERR_BAD_DEV_ID;
+  }
+  *pHandle = (ADI_FEE_DEV_HANDLE) flash;
+  return ADI_FEE_SUCCESS;
+}
+
+ADI_FEE_RESULT_TYPE adi_FEE_PageErase(ADI_FEE_DEV_HANDLE const hDevice,
+                                      const uint32_t PageNum) {
+  (void) hDevice;
+  if (PageNum >= FLASH_BLOCK_SIZE / FLASH_PAGE_SIZE) {
+    return ADI_FEE_ERR_INVALID_PARAMETER;
+  }
+  OSTimeDly(2);
+  memset(flash + PageNum * FLASH_PAGE_SIZE, 0xFF, FLASH_PAGE_SIZE);
+  return ADI_FEE_SUCCESS;
+}
+
+ADI_FEE_RESULT_TYPE adi_FEE_Write(ADI_FEE_DEV_HANDLE const hDevice,
+                                  const uint32_t nAddress,
+                                  const uint8_t *pData,
+                                  const uint32_t nBytes) {
+  uint32_t i;
+
+  (void) hDevice;
+  if (nAddress < FLASH_BLOCK_1
+      || nAddress - FLASH_BLOCK_1 + nBytes > FLASH_BLOCK_SIZE) {
+    return ADI_FEE_ERR_INVALID_ADDRESS;
+  }
+  // Programming only clears bits.
+  for (i = 0; i < nBytes; i++) {
+    flash[nAddress - FLASH_BLOCK_1 + i] &= pData[i];
+  }
+  return ADI_FEE_SUCCESS;
+}
+
+static bool flash_Map(void) {
+  void *at = mmap((void *) (uintptr_t) FLASH_BLOCK_1, FLASH_BLOCK_SIZE,
+                  PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+  if (at != (void *) (uintptr_t) FLASH_BLOCK_1) {
+    return false;
+  }
+  flash = at;
+  memset(flash, 0xFF, FLASH_BLOCK_SIZE);
+  return true;
+}
+
+// A frame off the wire, its last byte sent at time at.
+static void frame_Take(uint64_t at) {
+  uint8_t type = frame[2];
+  uint16_t sequence = (uint16_t) (frame[3] | (frame[4] << 8));
+  uint32_t timestamp_us = frame[5] | (frame[6] << 8) | (frame[7] << 16)
+                          | ((uint32_t) frame[8] << 24);
+
+  // A session is the frames from the last START; the sweep at startup
+  // comes before it.
+  if (type == TELEMETRY_FRAME_START) {
+    memset(&session, 0, sizeof(session));
+    session.started = true;
+    session.start_at = at;
+    session.idle_at_start = OS_CPU_SimStats.IdleNs;
+    session.raw_mhz = frame[11] | (frame[12] << 8) | (frame[13] << 16);
+    session.ratio = frame[9] | (frame[10] << 8);
+  } else if (!session.started || session.ended) {
+    return;
+  } else if (sequence != session.next_sequence) {
+    session.lost += (uint16_t) (sequence - session.next_sequence);
+  }
+  // The rates change from here on.
+  if (type == TELEMETRY_FRAME_RATE) {
+    session.raw_mhz = frame[11] | (frame[12] << 8) | (frame[13] << 16);
+    session.ratio = frame[9] | (frame[10] << 8);
+    session.rate_changes++;
+    session.at_rate = 0;
+  }
+  // Events carry the sequence number of the next sample without using it up.
+  session.next_sequence = sequence;
+  if (type == TELEMETRY_FRAME_START || type == TELEMETRY_FRAME_SAMPLE
+      || type == TELEMETRY_FRAME_END) {
+    session.next_sequence++;
+  }
+
+  if (type == TELEMETRY_FRAME_SAMPLE) {
+    if (session.at_rate == 0) {
+      session.first_us = timestamp_us;
+    }
+    session.last_us = timestamp_us;
+    if (session.samples < MAX_SAMPLES) {
+      latency_us[session.samples] = (uint32_t) (at / 1000u) - timestamp_us;
+    }
+    session.samples++;
+    session.at_rate++;
+  } else if (type == TELEMETRY_FRAME_END) {
+    session.ended = true;
+    session.end_at = at;
+    session.idle_at_end = OS_CPU_SimStats.IdleNs;
+  }
+}
+
+// Every byte the UART sends: frames are found by their sync bytes and kept
+// if their CRC is right.
+static void uart_Byte(uint8_t byte, uint64_t at) {
+  uint16_t crc;
+
+  if ((frame_fill == 0 && byte != TELEMETRY_SYNC_0)
+      || (frame_fill == 1 && byte != TELEMETRY_SYNC_1)) {
+    frame_fill = byte == TELEMETRY_SYNC_0 ? 1 : 0;
+    return;
+  }
+  frame[frame_fill++] = byte;
+  if (frame_fill < TELEMETRY_FRAME_SIZE) {
+    return;
+  }
+  frame_fill = 0;
+  crc = Telemetry_Crc16(0xFFFF, frame + 2, TELEMETRY_FRAME_SIZE - 4);
+  if (crc != (uint16_t) (frame[16] | (frame[17] << 8))) {
+    if (session.started && !session.ended) {
+      session.bad++;
+    }
+    return;
+  }
+  frame_Take(at);
+}
+
+static int latency_Compare(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static double latency_Ms(uint32_t count, double fraction) {
+  return latency_us[(uint32_t) (fraction * (count - 1))] / 1000.0;
+}
+
+// What the session sustained, against what it planned.
+static void session_Report(uint32_t rate_mhz) {
+  uint32_t count = session.samples < MAX_SAMPLES ? session.samples
+                                                 : MAX_SAMPLES;
+  double planned, sustained = 0.0, idle;
+  bool failed = false;
+
+  printf("%u mHz: ", (unsigned) rate_mhz);
+  if (!session.ended || session.at_rate < 2) {
+    printf("%s, %u samples\nFAILED\n",
+           session.started ? "no END frame" : "no START frame",
+           (unsigned) session.at_rate);
+    errors++;
+    return;
+  }
+  // The loop measures RCAL once every dfts_per_rcal DFTs.
+  planned = session.raw_mhz / 1000.0 * dft_rate.dfts_per_rcal
+            / (dft_rate.dfts_per_rcal + 1) / session.ratio;
+  sustained = (session.at_rate - 1) * 1e6
+              / (uint32_t) (session.last_us - session.first_us);
+  idle = (double) (session.idle_at_end - session.idle_at_start)
+         / (session.end_at - session.start_at);
+  qsort(latency_us, count, sizeof(latency_us[0]), latency_Compare);
+
+  printf("%u samples, %.2f/s of %.2f/s planned (%.1f%%), BP %.8s\n",
+         (unsigned) session.samples, sustained, planned,
+         100.0 * sustained / planned, message);
+  if (session.rate_changes != 0) {
+    printf("  %u RATE frames; %u samples at %u:1 since the last\n",
+           (unsigned) session.rate_changes, (unsigned) session.at_rate,
+           (unsigned) session.ratio);
+  }
+  printf("  latency p50 %.1f ms, p99 %.1f ms, p99.9 %.1f ms, max %.1f ms\n",
+         latency_Ms(count, 0.5), latency_Ms(count, 0.99),
+         latency_Ms(count, 0.999), latency_Ms(count, 1.0));
+  printf("  dft_ring %u/%u, telemetry_ring %u/%u, uart_tx %u/%u bytes; "
+         "idle %.1f%%\n", (unsigned) dft_ring.max_depth,
+         (unsigned) DFT_RING_SIZE, (unsigned) telemetry_ring.max_depth,
+         (unsigned) TELEMETRY_RING_SIZE, (unsigned) uart_tx.high_water,
+         (unsigned) UART_TX_BUFFER_SIZE, 100.0 * idle);
+
+  if (sustained < 0.99 * planned) {
+    printf("  rate not sustained\n");
+    failed = true;
+  }
+  if (dft_ring.dropped != 0 || dft_ring.overwritten != 0
+      || telemetry_ring.dropped != 0 || uart_tx.overflow_count != 0) {
+    printf("  %u DFT results dropped, %u overwritten; %u telemetry records "
+           "dropped; %u uart_tx overflows\n", (unsigned) dft_ring.dropped,
+           (unsigned) dft_ring.overwritten, (unsigned) telemetry_ring.dropped,
+           (unsigned) uart_tx.overflow_count);
+    failed = true;
+  }
+  if (decimation > 1 && session.rate_changes == 0) {
+    printf("  no RATE frame for the decimation\n");
+    failed = true;
+  }
+  if (session.lost != 0 || session.bad != 0) {
+    printf("  %u frames lost, %u with a bad CRC\n", (unsigned) session.lost,
+           (unsigned) session.bad);
+    failed = true;
+  }
+  printf("%s\n", failed ? "FAILED" : "ok");
+  if (failed) {
+    errors++;
+  }
+}
+
+// The user: a session at every rate, one after the other.
+static void user_Task(void *arg) {
+  OS_CPU_SR cpu_sr;
+  INT32U waited;
+  INT8U err;
+  int i;
+
+  (void) arg;
+  for (i = 0; i < rate_count; i++) {
+    MainTask_SetRates(rates[i], rates[i]);
+    MainTask_SetDecimation(1);
+    OS_ENTER_CRITICAL();
+    memset(&session, 0, sizeof(session));
+    memset(message, ' ', 8);
+    telemetry_ring.max_depth = 0;
+    telemetry_ring.dropped = 0;
+    uart_tx.high_water = 0;
+    uart_tx.overflow_count = 0;
+    OS_EXIT_CRITICAL();
+
+    ux_is_engaged = true;
+    OSSemPost(ux_button_semaphore);
+    waited = 0;
+    if (decimation > 1) {
+      while (session.samples < DECIMATE_AFTER && !session.ended
+             && waited < (INT32U) (seconds * OS_TICKS_PER_SEC)) {
+        OSTimeDly(1);
+        waited++;
+      }
+      MainTask_SetDecimation(decimation);
+    }
+    OSSemPend(session_semaphore,
+              (INT32U) (seconds * OS_TICKS_PER_SEC) - waited, &err);
+    if (err != OS_ERR_NONE) {
+      printf("%u mHz: the session did not end within %.0f s\nFAILED\n",
+             (unsigned) rates[i], seconds);
+      errors++;
+      break;
+    }
+    session_Report(rates[i]);
+  }
+#if (APP_TRACE_EN > 0u)
+  if (trace_file != NULL) {
+    Trace_Dump(trace_Write);
+    fclose(trace_file);
+  }
+#endif
+  OS_CPU_SimStop();
+}
+
+static bool rates_Parse(const char *text) {
+  DftRatePlan plan;
+  char *end;
+
+  rate_count = 0;
+  do {
+    if (rate_count == MAX_RATES) {
+      return false;
+    }
+    rates[rate_count] = (uint32_t) strtoul(text, &end, 10);
+    if (end == text || !DftRate_Plan(&plan, rates[rate_count])) {
+      return false;
+    }
+    rate_count++;
+    text = end + 1;
+  } while (*end == ',');
+  return *end == '\0';
+}
+
+int main(int argc, char **argv) {
+  static const I2cSimSlave pump = {PUMP_SIM_ADDRESS, PumpSim_Write,
+                                   PumpSim_Read};
+  const UartSimStats *uart;
+  AfeSimConfig afe;
+  PumpSimConfig cuff;
+  double scale = 20.0;
+  INT8U err;
+  int i;
+
+  AfeSim_Defaults(&afe);
+  PumpSim_Defaults(&cuff);
+  rates_Parse("19000,38000,76000");
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-r") == 0 && rates_Parse(argv[++i])) {
+    } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+      seconds = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0
+               && sscanf(argv[++i], "%lf/%lf", &cuff.systolic_mmhg,
+                         &cuff.diastolic_mmhg) == 2) {
+    } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      afe.noise = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+      scale = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+      decimation = (uint16_t) atoi(argv[++i]);
+#if (APP_TRACE_EN > 0u)
+    } else if (i + 1 < argc && strcmp(argv[i], "-x") == 0) {
+      trace_file = fopen(argv[++i], "wb");
+      if (trace_file == NULL) {
+        perror(argv[i]);
+        return 1;
+      }
+#endif
+    } else {
+      fprintf(stderr, "usage: %s [-r mhz,mhz,...] [-t seconds] "
+              "[-p systolic/diastolic] [-n noise] [-c cpu_scale] "
+              "[-d ratio] [-x trace_file]\n", argv[0]);
+      return 2;
+    }
+  }
+  // The body's pulse is the cuff's.
+  afe.heart_bpm = cuff.heart_bpm;
+  if (!flash_Map()) {
+    fprintf(stderr, "can't map flash at 0x%08X\n", (unsigned) FLASH_BLOCK_1);
+    return 1;
+  }
+
+  OSInit();
+  OS_CPU_SimCpuScale(scale);
+  ChipSim_Init();
+  if (!AfeSim_Init(&afe)) {
+    fprintf(stderr, "AfeSim_Init failed\n");
+    return 1;
+  }
+  I2cSim_Init();
+  PumpSim_Init(&cuff);
+  I2cSim_Attach(&pump);
+  UartSim_Init(uart_Byte);
+
+  // As ImpedanceRtos.c.
+  i2c_mutex = OSMutexCreate(1, &err);
+  ux_button_semaphore = OSSemCreate(0);
+  pressure_semaphore = OSSemCreate(0);
+  TelemetryRing_Init(&telemetry_ring);
+  telemetry_semaphore = OSSemCreate(0);
+  session_semaphore = OSSemCreate(0);
+  OSTaskCreate(MainTask, NULL, &main_stack[TASK_MAIN_STK_SIZE - 1],
+               TASK_MAIN_PRIO);
+  OSTaskCreate(PumpTask, NULL, &pump_stack[TASK_PUMP_STK_SIZE - 1],
+               TASK_PUMP_PRIO);
+  OSTaskCreate(TelemetryTask, NULL,
+               &telemetry_stack[TASK_TELEMETRY_STK_SIZE - 1],
+               TASK_TELEMETRY_PRIO);
+  OSTaskCreate(user_Task, NULL, &user_stack[TASK_UX_STK_SIZE - 1],
+               TASK_UX_PRIO);
+  OSTaskNameSet(TASK_MAIN_PRIO, (INT8U *) "MainTask", &err);
+  OSTaskNameSet(TASK_PUMP_PRIO, (INT8U *) "PumpTask", &err);
+  OSTaskNameSet(TASK_TELEMETRY_PRIO, (INT8U *) "TelemetryTask", &err);
+  OSTaskNameSet(TASK_UX_PRIO, (INT8U *) "user", &err);
+  OSEventNameSet(i2c_mutex, (INT8U *) "i2c_mutex", &err);
+  OSEventNameSet(ux_button_semaphore, (INT8U *) "ux_button_semaphore", &err);
+  OSEventNameSet(pressure_semaphore, (INT8U *) "pressure_semaphore", &err);
+  OSEventNameSet(telemetry_semaphore, (INT8U *) "telemetry_semaphore", &err);
+  OS_CPU_SysTickInit(OS_CPU_SIM_CLK_FREQ / OS_TICKS_PER_SEC);
+  OSStart();
+
+  uart = UartSim_Stats();
+  printf("%.1f s simulated: %llu bytes on the UART, busy %.2f%%, %llu "
+         "overruns; idle %.1f%%\n", OS_CPU_SimTimeNs() / 1e9,
+         (unsigned long long) uart->bytes,
+         100.0 * uart->busy_ns / OS_CPU_SimTimeNs(),
+         (unsigned long long) uart->overruns,
+         100.0 * OS_CPU_SimStats.IdleNs / OS_CPU_SimTimeNs());
+  if (uart->overruns != 0) {
+    errors++;
+  }
+  // A late TX DMA re-arm stalls the RCAL loop (see afe_StartLoop).
+  printf("AFE: %llu command FIFO starvations, %llu data FIFO overflows\n",
+         (unsigned long long) AfeSim_Stats()->cmd_starvations,
+         (unsigned long long) AfeSim_Stats()->data_overflows);
+  printf("%s\n", errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}
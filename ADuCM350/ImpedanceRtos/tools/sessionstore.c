@@ -0,0 +1,365 @@
+// Runs SessionStore against a RAM stand-in for the flash on the host.
+//
+// The stand-in behaves like the ADuCM350 flash as far as the store can
+// tell: erased bytes read as 0xFF, writes must be 8-byte aligned and may
+// only program erased bytes, and the erase count of every page is kept.
+// Each recorded session (the "pressure magnitude phase" lines final.py
+// prints; other lines are skipped) is stored -r times over, as the firmware
+// stores it: a START frame, the compressed telemetry stream and an END
+// frame with the CRC of the session, sample_period_us apart.  With -k the flash "loses power" in the
+// middle of every Nth write, which programs only half of it, and the store
+// is mounted again from what is left, as after a reset.
+//
+// At the end the store is mounted once more, every indexed session is read
+// back and compared with what was written (a prefix of it for sessions cut
+// short), and the erase counts show how evenly the ring wears.  With -o the
+// sessions are written out as the bulk-read command sends them, for
+// clientConnector/telemetry.py.  Exits with 1 on any mismatch.
+//
+// build: cc -O2 -I.. -o sessionstore sessionstore.c ../SessionStore.c
+//            ../Telemetry.c
+// usage: sessionstore [-p sample_period_us] [-n pages] [-r repeat]
+//                     [-k writes] [-o dump.bin] session.txt [session.txt ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SessionStore.h"
+#include "Telemetry.h"
+
+// 13 ms DFT plus settling, as in telemetry_benchmark.py.
+#define DEFAULT_SAMPLE_PERIOD_US 13158
+
+// The region the firmware uses: the upper 112 KB of flash bank 1.
+#define DEFAULT_PAGES 56
+
+#define MAX_SESSIONS 4096
+
+typedef struct {
+  uint8_t memory[SESSION_STORE_MAX_PAGES * SESSION_STORE_PAGE_SIZE];
+  uint16_t pages;
+  uint32_t erases[SESSION_STORE_MAX_PAGES];
+  uint32_t writes;
+  uint32_t kill_every;      // 0 = never.
+  bool killed;              // The last write was torn.
+  bool misuse;              // A write to programmed flash, or unaligned.
+} RamFlash;
+
+typedef struct {
+  uint8_t *bytes;
+  size_t length;
+  size_t size;
+} Buffer;
+
+static RamFlash flash;
+static SessionStore store;
+static Buffer expected[MAX_SESSIONS];
+
+static uint32_t clock_ns(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t) (now.tv_sec * 1000000000ull + now.tv_nsec);
+}
+
+static bool ram_Erase(void *context, uint16_t page) {
+  RamFlash *ram = (RamFlash *) context;
+
+  memset(ram->memory + (size_t) page * SESSION_STORE_PAGE_SIZE, 0xFF,
+         SESSION_STORE_PAGE_SIZE);
+  ram->erases[page]++;
+  return true;
+}
+
+static bool ram_Write(void *context, uint32_t offset, const void *data,
+                      uint32_t size) {
+  RamFlash *ram = (RamFlash *) context;
+  uint32_t i;
+
+  if (offset % 8 != 0 || size % 8 != 0
+      || offset + size > (uint32_t) ram->pages * SESSION_STORE_PAGE_SIZE) {
+    ram->misuse = true;
+    return false;
+  }
+  for (i = 0; i < size; i++) {
+    if (ram->memory[offset + i] != 0xFF) {
+      fprintf(stderr, "write to programmed flash at 0x%05x\n",
+              (unsigned) (offset + i));
+      ram->misuse = true;
+      return false;
+    }
+  }
+  if (ram->kill_every > 0 && ++ram->writes % ram->kill_every == 0) {
+    // Power fails halfway through.
+    memcpy(ram->memory + offset, data, size / 2);
+    ram->killed = true;
+    return false;
+  }
+  memcpy(ram->memory + offset, data, size);
+  return true;
+}
+
+static void buffer_Add(Buffer *buffer, const uint8_t *data, size_t length) {
+  if (buffer->length + length > buffer->size) {
+    buffer->size = (buffer->length + length) * 2;
+    buffer->bytes = realloc(buffer->bytes, buffer->size);
+    if (buffer->bytes == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  memcpy(buffer->bytes + buffer->length, data, length);
+  buffer->length += length;
+}
+
+static void mount(void) {
+  SessionFlash access;
+
+  access.memory = flash.memory;
+  access.pages = flash.pages;
+  access.erase = ram_Erase;
+  access.write = ram_Write;
+  access.crc32 = NULL;
+  access.context = &flash;
+  if (!SessionStore_Mount(&store, &access)) {
+    fprintf(stderr, "SessionStore_Mount failed\n");
+    exit(1);
+  }
+}
+
+// Stores bytes the way TelemetryTask does: in the session, or as its START
+// or END record.  After a torn write, mounts again and drops the session.
+static bool store_Add(uint8_t type, const uint8_t *data, uint16_t size) {
+  bool ok;
+
+  if (type == TELEMETRY_FRAME_START) {
+    ok = SessionStore_Begin(&store, data, size);
+  } else if (type == TELEMETRY_FRAME_END) {
+    ok = SessionStore_End(&store, data, size);
+  } else {
+    ok = SessionStore_Append(&store, data, size);
+  }
+  if (!ok && flash.killed) {
+    flash.killed = false;
+    mount();
+    return false;
+  }
+  if (!ok) {
+    fprintf(stderr, "SessionStore failed (%u write errors)\n",
+            (unsigned) store.write_errors);
+    exit(1);
+  }
+  if (type == TELEMETRY_FRAME_START && store.session < MAX_SESSIONS) {
+    expected[store.session].length = 0;
+  }
+  if (store.session < MAX_SESSIONS) {
+    buffer_Add(&expected[store.session], data, size);
+  }
+  return true;
+}
+
+static int replay(const char *path, uint32_t period_us, uint32_t *samples,
+                  uint32_t *ns) {
+  static TelemetryStream stream;
+  uint8_t out[TELEMETRY_STREAM_MAX_OUTPUT];
+  TelemetrySample sample;
+  char line[256];
+  double pressure, magnitude, phase;
+  uint32_t count = 0;
+  uint32_t start;
+  uint32_t crc;
+  size_t size;
+  FILE *file;
+
+  file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  // The START frame carries the session header: the output rate in mHz.
+  memset(&sample, 0, sizeof(sample));
+  sample.timestamp_us = 1000000000u / period_us;
+  sample.pressure = 1;
+  sample.magnitude = (int32_t) sample.timestamp_us;
+  Telemetry_StreamReset(&stream);
+  size = Telemetry_EncodeFrame(out, TELEMETRY_FRAME_START, 0, &sample);
+  crc = SessionStore_Crc32(0, out, size);
+  if (!store_Add(TELEMETRY_FRAME_START, out, (uint16_t) size)) {
+    fclose(file);
+    return 0;
+  }
+
+  start = clock_ns();
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "%lf %lf %lf", &pressure, &magnitude, &phase) != 3) {
+      continue;
+    }
+    sample.timestamp_us = count++ * period_us;
+    sample.pressure = (uint16_t) pressure;
+    sample.magnitude = (int32_t) (magnitude * 16.0);
+    sample.phase = (int32_t) (phase * 16.0);
+    size = Telemetry_StreamEncode(&stream, &sample, out);
+    crc = SessionStore_Crc32(crc, out, size);
+    if (size > 0 && !store_Add(TELEMETRY_FRAME_SAMPLE, out, (uint16_t) size)) {
+      fclose(file);
+      return 0;
+    }
+  }
+  fclose(file);
+
+  size = Telemetry_StreamFlush(&stream, out);
+  crc = SessionStore_Crc32(crc, out, size);
+  if (size > 0 && !store_Add(TELEMETRY_FRAME_SAMPLE, out, (uint16_t) size)) {
+    return 0;
+  }
+  // END carries the CRC-32 of the session, as the firmware sends it.
+  memset(&sample, 0, sizeof(sample));
+  sample.timestamp_us = crc;
+  size = Telemetry_EncodeFrame(out, TELEMETRY_FRAME_END, stream.sequence,
+                               &sample);
+  if (store_Add(TELEMETRY_FRAME_END, out, (uint16_t) size)) {
+    *ns += clock_ns() - start;
+    *samples += count;
+  }
+  return 0;
+}
+
+// Reads every indexed session back; returns the number of mismatches.
+static int verify(FILE *dump) {
+  SessionReader reader;
+  const SessionIndexEntry *entry;
+  const uint8_t *data;
+  Buffer read = {NULL, 0, 0};
+  TelemetrySample summary;
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+  uint16_t size;
+  uint8_t type;
+  int errors = 0;
+  uint8_t i;
+
+  for (i = 0; i < store.sessions; i++) {
+    entry = &store.index[i];
+    read.length = 0;
+    SessionStore_Open(&store, entry, &reader);
+    while (SessionStore_Read(&reader, &type, &data, &size)) {
+      buffer_Add(&read, data, size);
+    }
+    if (dump != NULL) {
+      fwrite(read.bytes, 1, read.length, dump);
+      if (!entry->complete) {
+        // As the firmware does for a session cut short: the CRC of what
+        // was read.
+        memset(&summary, 0, sizeof(summary));
+        summary.timestamp_us = SessionStore_Crc32(0, read.bytes, read.length);
+        fwrite(frame, 1, Telemetry_EncodeFrame(frame, TELEMETRY_FRAME_END, 0,
+                                               &summary), dump);
+      }
+    }
+
+    printf("  session %5u  page %2u+%4u  %6u bytes  %s", entry->session,
+           entry->page, entry->offset, (unsigned) entry->bytes,
+           entry->complete ? "complete" : "cut short");
+    if (entry->session >= MAX_SESSIONS
+        || read.length > expected[entry->session].length
+        || (entry->complete && read.length
+                               != expected[entry->session].length)
+        || memcmp(read.bytes, expected[entry->session].bytes,
+                  read.length) != 0) {
+      printf("  MISMATCH");
+      errors++;
+    }
+    printf("\n");
+  }
+  free(read.bytes);
+  return errors;
+}
+
+int main(int argc, char **argv) {
+  uint32_t period_us = DEFAULT_SAMPLE_PERIOD_US;
+  uint32_t samples = 0;
+  uint32_t ns = 0;
+  uint32_t min_erases;
+  uint32_t max_erases;
+  uint32_t start;
+  int repeat = 1;
+  int status = 0;
+  int first;
+  int errors;
+  int i;
+  int r;
+  FILE *dump = NULL;
+
+  flash.pages = DEFAULT_PAGES;
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+      period_us = (uint32_t) strtoul(argv[++i], NULL, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      flash.pages = (uint16_t) atoi(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+      repeat = atoi(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-k") == 0) {
+      flash.kill_every = (uint32_t) strtoul(argv[++i], NULL, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+      dump = fopen(argv[++i], "wb");
+      if (dump == NULL) {
+        perror(argv[i]);
+        return 1;
+      }
+    } else {
+      break;
+    }
+  }
+  first = i;
+  if (first == argc || flash.pages < 2
+      || flash.pages > SESSION_STORE_MAX_PAGES) {
+    fprintf(stderr, "usage: %s [-p sample_period_us] [-n pages (2..%d)] "
+            "[-r repeat] [-k writes] [-o dump.bin] session.txt ...\n",
+            argv[0], SESSION_STORE_MAX_PAGES);
+    return 2;
+  }
+
+  // Flash starts out erased.
+  memset(flash.memory, 0xFF, sizeof(flash.memory));
+  mount();
+  for (r = 0; r < repeat; r++) {
+    for (i = first; i < argc; i++) {
+      status |= replay(argv[i], period_us, &samples, &ns);
+    }
+  }
+
+  // As after a reset.
+  start = clock_ns();
+  mount();
+  printf("mounted %u pages in %.2f ms: %u sessions, %u bad pages\n",
+         (unsigned) flash.pages, (clock_ns() - start) / 1e6,
+         (unsigned) store.sessions, (unsigned) store.bad_pages);
+  errors = verify(dump);
+
+  min_erases = max_erases = flash.erases[0];
+  for (i = 1; i < flash.pages; i++) {
+    if (flash.erases[i] < min_erases) {
+      min_erases = flash.erases[i];
+    }
+    if (flash.erases[i] > max_erases) {
+      max_erases = flash.erases[i];
+    }
+  }
+  printf("%u samples stored, %.1f ns/sample; erases per page %u..%u\n",
+         (unsigned) samples, samples ? (double) ns / samples : 0.0,
+         (unsigned) min_erases, (unsigned) max_erases);
+  if (flash.misuse) {
+    printf("FAIL: flash written out of order\n");
+    status = 1;
+  }
+  if (errors > 0) {
+    printf("FAIL: %d sessions differ\n", errors);
+    status = 1;
+  }
+  if (dump != NULL) {
+    fclose(dump);
+  }
+  return status;
+}
@@ -0,0 +1,275 @@
+// Checks TelemetryDecoder.h against the encoder on the host.
+//
+// A session of -n synthetic samples (a deflation with a pulse on the
+// magnitude, jitter on the timestamps, and now and then a value out of the
+// range of the frame fields) is framed the way TelemetryTask does, with
+// START, BEAT and END frames around binary frames or the compressed stream,
+// and fed to the decoder in chunks of random size.  Every sample must come
+// back as it was encoded, and the session CRC must match.  -e then corrupts
+// that fraction of the bytes: every sample that still comes back must be
+// right, and the losses must show up in the counters.  With a capture file,
+// decodes it instead and prints one line per frame.  Exits non-zero on any
+// mismatch.
+//
+// build: c++ -O2 -I.. -o telemetrycheck telemetrycheck.cpp ../Telemetry.c
+//        ../CrcService.c
+// usage: telemetrycheck [-n samples] [-e error_rate] [capture_file]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "TelemetryDecoder.h"
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng_Next(void) {
+  rng_state = rng_state * 1103515245u + 12345u;
+  return rng_state >> 8;
+}
+
+static void session_Make(uint32_t count, bool compressed,
+                         std::vector<uint8_t> *out,
+                         std::vector<TelemetrySample> *samples) {
+  static TelemetryStream stream;
+  uint8_t frame[TELEMETRY_STREAM_MAX_OUTPUT];
+  TelemetrySample sample;
+  size_t size;
+  uint32_t crc;
+  uint32_t i;
+
+  // Session header: 76 Hz, no decimation.
+  sample.timestamp_us = 76000;
+  sample.pressure = 1;
+  sample.magnitude = 76000;
+  sample.phase = 0;
+  out->clear();
+  out->insert(out->end(), frame,
+              frame + Telemetry_EncodeFrame(frame, TELEMETRY_FRAME_START, 0,
+                                            &sample));
+  Telemetry_StreamReset(&stream);
+
+  sample.timestamp_us = 4000000000u;  // Wraps during the session.
+  for (i = 0; i < count; i++) {
+    sample.timestamp_us += 13158 + rng_Next() % 64 - 32;
+    sample.pressure = (uint16_t) (180 - i * 150 / count);
+    sample.magnitude = 16 * 1200 + (int32_t) ((i * 37) % 76) * 8
+                       - (int32_t) (rng_Next() % 16);
+    sample.phase = -16 * 12 + (int32_t) (rng_Next() % 8);
+    if (rng_Next() % 500 == 0) {
+      sample.magnitude = rng_Next() % 2 ? TELEMETRY_MAGNITUDE_MAX + 5 : -7;
+      sample.phase = rng_Next() % 2 ? 40000 : -40000;
+    }
+    if (compressed) {
+      size = Telemetry_StreamEncode(&stream, &sample, frame);
+    } else {
+      size = Telemetry_EncodeFrame(frame, TELEMETRY_FRAME_SAMPLE,
+                                   (uint16_t) i, &sample);
+    }
+    out->insert(out->end(), frame, frame + size);
+    if (i % 76 == 75) {
+      TelemetrySample beat = sample;
+
+      beat.pressure = 720;
+      beat.phase = 0;
+      size = Telemetry_EncodeFrame(frame, TELEMETRY_FRAME_BEAT,
+                                   (uint16_t) (i + 1), &beat);
+      out->insert(out->end(), frame, frame + size);
+    }
+
+    // What the decoder must return: the sample as the fields hold it.
+    // The next deltas are then taken from there.
+    if (sample.magnitude > TELEMETRY_MAGNITUDE_MAX) {
+      sample.magnitude = TELEMETRY_MAGNITUDE_MAX;
+    } else if (sample.magnitude < 0) {
+      sample.magnitude = 0;
+    }
+    if (sample.phase > INT16_MAX) {
+      sample.phase = INT16_MAX;
+    } else if (sample.phase < INT16_MIN) {
+      sample.phase = INT16_MIN;
+    }
+    samples->push_back(sample);
+  }
+  out->insert(out->end(), frame,
+              frame + Telemetry_StreamFlush(&stream, frame));
+
+  crc = CrcService_Crc32Soft(0, out->data(), out->size());
+  sample.timestamp_us = crc;
+  sample.pressure = 0;
+  sample.magnitude = 0;
+  sample.phase = 0;
+  size = Telemetry_EncodeFrame(frame, TELEMETRY_FRAME_END, (uint16_t) count,
+                               &sample);
+  out->insert(out->end(), frame, frame + size);
+}
+
+static int session_Check(uint32_t count, bool compressed, double error_rate) {
+  std::vector<TelemetrySample> samples;
+  std::vector<TelemetryFrame> frames;
+  std::vector<uint8_t> stream;
+  TelemetryDecoder decoder;
+  uint32_t decoded = 0;
+  uint32_t ends = 0;
+  uint32_t corrupted = 0;
+  size_t size;
+  size_t i;
+  int errors = 0;
+
+  session_Make(count, compressed, &stream, &samples);
+  for (i = 0; i < stream.size(); i++) {
+    if (rng_Next() % 1000000 < error_rate * 1e6) {
+      stream[i] ^= (uint8_t) (1u << rng_Next() % 8);
+      corrupted++;
+    }
+  }
+  for (i = 0; i < stream.size(); i += size) {
+    size = 1 + rng_Next() % 64;
+    if (size > stream.size() - i) {
+      size = stream.size() - i;
+    }
+    decoder.Feed(&stream[i], size, &frames);
+  }
+
+  for (i = 0; i < frames.size(); i++) {
+    const TelemetryFrame &frame = frames[i];
+    const TelemetrySample *expected;
+
+    if (frame.type == TELEMETRY_FRAME_END) {
+      ends++;
+    }
+    if (frame.type != TELEMETRY_FRAME_SAMPLE) {
+      continue;
+    }
+    decoded++;
+    if (frame.sequence >= count) {
+      printf("bad sequence %u\n", (unsigned) frame.sequence);
+      errors++;
+      continue;
+    }
+    expected = &samples[frame.sequence];
+    if (frame.sample.timestamp_us != expected->timestamp_us
+        || frame.sample.pressure != expected->pressure
+        || frame.sample.magnitude != expected->magnitude
+        || frame.sample.phase != expected->phase) {
+      if (errors++ < 5) {
+        printf("sample %u: %lu %u %ld %ld, expected %lu %u %ld %ld\n",
+               (unsigned) frame.sequence,
+               (unsigned long) frame.sample.timestamp_us,
+               (unsigned) frame.sample.pressure,
+               (long) frame.sample.magnitude, (long) frame.sample.phase,
+               (unsigned long) expected->timestamp_us,
+               (unsigned) expected->pressure, (long) expected->magnitude,
+               (long) expected->phase);
+      }
+    }
+  }
+
+  printf("%-10s %6lu bytes, %4lu corrupted: %5lu of %5lu samples, "
+         "%3lu lost, %3lu skipped deltas, %3lu crc errors, session %s\n",
+         compressed ? "compressed" : "binary", (unsigned long) stream.size(),
+         (unsigned long) corrupted, (unsigned long) decoded,
+         (unsigned long) count, (unsigned long) decoder.lost_frames,
+         (unsigned long) decoder.skipped_deltas,
+         (unsigned long) decoder.crc_errors,
+         decoder.sessions_verified ? "verified"
+         : decoder.session_crc_errors ? "crc mismatch" : "not seen");
+
+  if (corrupted == 0) {
+    if (decoded != count || ends != 1 || decoder.sessions_verified != 1
+        || decoder.lost_frames != 0 || decoder.crc_errors != 0
+        || decoder.skipped_bytes != 0) {
+      printf("clean stream not decoded in full\n");
+      errors++;
+    }
+  } else if (decoder.sessions_verified != 0) {
+    printf("corrupted session verified\n");
+    errors++;
+  } else if (decoded < count && decoder.lost_frames == 0
+             && decoder.skipped_deltas == 0) {
+    printf("%lu samples missing, none counted\n",
+           (unsigned long) (count - decoded));
+    errors++;
+  }
+  return errors;
+}
+
+static int capture_Decode(const char *path) {
+  static const char *const names[] = {"?",     "SAMPLE", "START", "END",
+                                      "DELTA", "SWEEP",  "BEAT",  "RATE"};
+  std::vector<TelemetryFrame> frames;
+  TelemetryDecoder decoder;
+  uint8_t data[4096];
+  size_t size;
+  size_t i;
+  FILE *file;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+  while ((size = fread(data, 1, sizeof(data), file)) != 0) {
+    decoder.Feed(data, size, &frames);
+    for (i = 0; i < frames.size(); i++) {
+      const TelemetryFrame &frame = frames[i];
+
+      printf("%-6s %5u %10lu %5u %9.4f %9.4f\n",
+             frame.type < 8 ? names[frame.type] : names[0],
+             (unsigned) frame.sequence,
+             (unsigned long) frame.sample.timestamp_us,
+             (unsigned) frame.sample.pressure, frame.sample.magnitude / 16.0,
+             frame.sample.phase / 16.0);
+    }
+    frames.clear();
+  }
+  fclose(file);
+  fprintf(stderr,
+          "%lu lost, %lu crc errors, %lu bytes skipped, %lu deltas skipped, "
+          "%lu sessions verified, %lu session crc errors\n",
+          (unsigned long) decoder.lost_frames,
+          (unsigned long) decoder.crc_errors,
+          (unsigned long) decoder.skipped_bytes,
+          (unsigned long) decoder.skipped_deltas,
+          (unsigned long) decoder.sessions_verified,
+          (unsigned long) decoder.session_crc_errors);
+  return decoder.session_crc_errors != 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t count = 3000;
+  double error_rate = 0.0005;
+  int errors = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      count = (uint32_t) strtoul(argv[++i], NULL, 0);
+      if (count == 0 || count > 65535) {
+        fprintf(stderr, "-n: 1 to 65535\n");
+        return 2;
+      }
+    } else if (i + 1 < argc && strcmp(argv[i], "-e") == 0) {
+      error_rate = atof(argv[++i]);
+    } else if (i + 1 == argc && argv[i][0] != '-') {
+      return capture_Decode(argv[i]);
+    } else {
+      fprintf(stderr,
+              "usage: telemetrycheck [-n samples] [-e error_rate] "
+              "[capture_file]\n");
+      return 2;
+    }
+  }
+
+  errors += session_Check(count, false, 0.0);
+  errors += session_Check(count, true, 0.0);
+  if (error_rate > 0.0) {
+    errors += session_Check(count, false, error_rate);
+    errors += session_Check(count, true, error_rate);
+  }
+
+  printf(errors ? "FAILED\n" : "ok\n");
+  return errors ? 1 : 0;
+}
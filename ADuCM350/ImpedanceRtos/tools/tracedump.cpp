@@ -0,0 +1,422 @@
+// Decodes the trace recorder's dump (see Trace.h) into a Chrome trace, to
+// open in chrome://tracing or Perfetto, and sums up where the time went.
+//
+// The input is whatever the UART sent, saved to a file: the last dump in it
+// is used, and anything around it (telemetry, messages) is skipped.  Its
+// CRC must match.  The trace has one row per task, by priority, with a
+// slice for each time the task ran, and an "Interrupts" row with a slice
+// for each interrupt handler and the ticks.  Semaphore posts and pends are
+// marked on the row of whatever made them, and the depth of DftRing and
+// TelemetryRing is drawn as a counter.  Times are microseconds from the
+// first event.
+//
+// For every task it prints the time it ran, less the interrupts that came
+// meanwhile, how often and for how long at most; and how long it took to
+// run after a post to the semaphore it blocked on, on average and at most,
+// which is the time lost to higher priority tasks and interrupts.  For
+// every interrupt, how often it came and the time it took.  Exits non-zero
+// if there is no complete dump.
+//
+// build: c++ -O2 -I.. -o tracedump tracedump.cpp
+// usage: tracedump [-o trace.json] capture_file
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+#define INTERRUPTS_ROW 1000
+
+// Exception number less 16, as in adi_sid_cm350.h.
+static const char *const irq_names[] = {
+    "WUT",         "EINT0",        "EINT1",        "EINT2",
+    "EINT3",       "EINT4",        "EINT5",        "EINT6",
+    "EINT7",       "EINT8",        "WDT",          "TIMER0",
+    "TIMER1",      "FLASH0",       "UART",         "SPI0",
+    "SPIH",        "I2CS",         "I2CM",         "DMA_ERR",
+    "DMA_SPIH_TX", "DMA_SPIH_RX",  "DMA_SPI0_TX",  "DMA_SPI0_RX",
+    "DMA_SPI1_TX", "DMA_SPI1_RX",  "DMA_UART_TX",  "DMA_UART_RX",
+    "DMA_I2CS_TX", "DMA_I2CS_RX",  "DMA_I2CM",     "DMA_AFE_TX",
+    "DMA_AFE_RX",  "DMA_CRC",      "DMA_PDI",      "DMA_I2S",
+    "USB_WAKEUP",  "USB",          "USB_DMA",      "I2S",
+    "TIMER2",      "FLASH1",       "SPI1",         "RTC",
+    "IRQ44",       "BEEP",         "LCD",          "GPIOA",
+    "GPIOB",       "IRQ49",        "AFE_CAPTURE",  "AFE_GENERATE",
+    "AFE_CMD_FIFO", "AFE_DATA_FIFO", "CAP",        "GP_FLASH",
+    "XTAL_OSC",    "PLL",          "RAND",         "PDI",
+    "PARITY"};
+
+static const char *const queue_names[] = {"dft_ring", "telemetry_ring"};
+
+struct Task {
+  std::string name;
+  uint64_t run_us = 0;          // Less interrupts.
+  uint32_t runs = 0;
+  uint64_t longest_us = 0;
+  uint64_t in_at = 0;           // Switched in, and the interrupt time then.
+  uint64_t isr_at_in = 0;
+  int pending = -1;             // Semaphore it blocked on.
+  bool ready = false;           // Posted since; ready_at is when.
+  uint64_t ready_at = 0;
+  uint32_t wakeups = 0;
+  uint64_t wake_us = 0;
+  uint64_t wake_max_us = 0;
+};
+
+struct Irq {
+  uint32_t count = 0;
+  uint64_t total_us = 0;
+  uint64_t longest_us = 0;
+};
+
+struct Dump {
+  uint32_t ring_size = 0;
+  uint32_t overwritten = 0;
+  std::map<int, std::string> tasks;
+  std::map<int, std::string> events;
+  std::vector<TraceEvent> records;
+};
+
+static FILE *json;
+static bool json_first = true;
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) {
+  int bit;
+
+  crc = ~crc;
+  while (size-- > 0) {
+    crc ^= *data++;
+    for (bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
+
+// The line at pos, without its "\r\n"; pos moves past it.
+static bool dump_Line(const std::string &in, size_t &pos, std::string &line) {
+  size_t end = in.find('\n', pos);
+
+  if (end == std::string::npos) {
+    return false;
+  }
+  line = in.substr(pos, end - pos);
+  if (!line.empty() && line[line.size() - 1] == '\r') {
+    line.erase(line.size() - 1);
+  }
+  pos = end + 1;
+  return true;
+}
+
+static bool dump_Parse(const std::string &in, Dump &dump) {
+  std::string line;
+  size_t pos = in.rfind("TRACE ");
+  uint32_t count;
+  uint32_t crc;
+  char name[64];
+  int id;
+
+  while (pos != std::string::npos && pos > 0 && in[pos - 1] != '\n') {
+    pos = in.rfind("TRACE ", pos - 1);
+  }
+  if (pos == std::string::npos || !dump_Line(in, pos, line)
+      || sscanf(line.c_str(), "TRACE %u %u", &dump.ring_size,
+                &dump.overwritten) != 2) {
+    fprintf(stderr, "no trace dump\n");
+    return false;
+  }
+  while (true) {
+    if (!dump_Line(in, pos, line)) {
+      fprintf(stderr, "dump cut short in its header\n");
+      return false;
+    }
+    if (sscanf(line.c_str(), "TASK %d %63[^\n]", &id, name) == 2) {
+      dump.tasks[id] = name;
+    } else if (sscanf(line.c_str(), "EVENT %d %63[^\n]", &id, name) == 2) {
+      dump.events[id] = name;
+    } else if (sscanf(line.c_str(), "RECORDS %u", &count) == 1) {
+      break;
+    } else {
+      fprintf(stderr, "bad dump line: %s\n", line.c_str());
+      return false;
+    }
+  }
+  if (in.size() - pos < count * sizeof(TraceEvent)) {
+    fprintf(stderr, "dump cut short: %u records expected\n", count);
+    return false;
+  }
+  dump.records.resize(count);
+  memcpy(dump.records.data(), in.data() + pos, count * sizeof(TraceEvent));
+  pos += count * sizeof(TraceEvent);
+  if (!dump_Line(in, pos, line) || sscanf(line.c_str(), "END %x", &crc) != 1) {
+    fprintf(stderr, "no END after the records\n");
+    return false;
+  }
+  if (crc != crc32(0, (const uint8_t *) dump.records.data(),
+                   count * sizeof(TraceEvent))) {
+    fprintf(stderr, "CRC mismatch: %08x sent\n", crc);
+    return false;
+  }
+  return true;
+}
+
+static void json_Event(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void json_Event(const char *format, ...) {
+  va_list args;
+
+  fprintf(json, json_first ? "\n  " : ",\n  ");
+  json_first = false;
+  va_start(args, format);
+  vfprintf(json, format, args);
+  va_end(args);
+}
+
+static void json_Row(int tid, const char *name, int sort) {
+  json_Event("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+             "\"args\":{\"name\":\"%s\"}}", tid, name);
+  json_Event("{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,"
+             "\"tid\":%d,\"args\":{\"sort_index\":%d}}", tid, sort);
+}
+
+static void json_Slice(int tid, const char *name, uint64_t from,
+                       uint64_t to) {
+  json_Event("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+             "\"ts\":%llu,\"dur\":%llu}", name, tid,
+             (unsigned long long) from, (unsigned long long) (to - from));
+}
+
+static void json_Instant(int tid, const char *name, uint64_t at,
+                         uint16_t count) {
+  json_Event("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+             "\"tid\":%d,\"ts\":%llu,\"args\":{\"count\":%u}}", name, tid,
+             (unsigned long long) at, (unsigned) count);
+}
+
+static std::string irq_Name(int exception) {
+  char name[16];
+
+  if (exception >= 16
+      && exception - 16 < (int) (sizeof(irq_names) / sizeof(irq_names[0]))) {
+    return irq_names[exception - 16];
+  }
+  snprintf(name, sizeof(name), "exception %d", exception);
+  return name;
+}
+
+int main(int argc, char **argv) {
+  const char *json_path = "trace.json";
+  const char *capture_path = NULL;
+  std::map<int, Task> tasks;
+  std::map<int, Irq> irqs;
+  std::vector<std::pair<int, uint64_t> > isr_stack;   // Exception, entered.
+  std::string in;
+  char buffer[4096];
+  size_t size;
+  FILE *file;
+  Dump dump;
+  uint64_t now = 0;
+  uint64_t isr_us = 0;          // Outermost handlers, to date.
+  uint32_t last_ts = 0;
+  uint32_t ticks = 0;
+  int current = -1;
+  int row;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+      json_path = argv[++i];
+    } else if (capture_path == NULL && argv[i][0] != '-') {
+      capture_path = argv[i];
+    } else {
+      capture_path = NULL;
+      break;
+    }
+  }
+  if (capture_path == NULL) {
+    fprintf(stderr, "usage: %s [-o trace.json] capture_file\n", argv[0]);
+    return 2;
+  }
+  file = fopen(capture_path, "rb");
+  if (file == NULL) {
+    perror(capture_path);
+    return 1;
+  }
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    in.append(buffer, size);
+  }
+  fclose(file);
+  if (!dump_Parse(in, dump)) {
+    printf("FAILED\n");
+    return 1;
+  }
+  if (dump.records.empty()) {
+    printf("no events recorded\nFAILED\n");
+    return 1;
+  }
+
+  json = fopen(json_path, "w");
+  if (json == NULL) {
+    perror(json_path);
+    return 1;
+  }
+  fprintf(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  json_Row(INTERRUPTS_ROW, "Interrupts", -1);
+  for (const auto &task : dump.tasks) {
+    tasks[task.first].name = task.second;
+    json_Row(task.first, task.second.c_str(), task.first);
+  }
+
+  last_ts = dump.records[0].timestamp_us;
+  for (const TraceEvent &event : dump.records) {
+    // 32-bit microseconds, which wrap; the differences don't.
+    now += (uint32_t) (event.timestamp_us - last_ts);
+    last_ts = event.timestamp_us;
+    row = !isr_stack.empty() ? INTERRUPTS_ROW : current >= 0 ? current : 0;
+
+    switch (event.type) {
+      case TRACE_TASK_SWITCH: {
+        // Before the first switch, whatever ran since the first event.
+        Task &out = tasks[event.arg];
+        Task &in_task = tasks[event.id];
+        uint64_t ran;
+
+        if (current < 0) {
+          current = event.arg;
+        }
+        if (current == event.arg) {
+          ran = now - out.in_at - (isr_us - out.isr_at_in);
+          out.run_us += ran;
+          out.runs++;
+          if (ran > out.longest_us) {
+            out.longest_us = ran;
+          }
+          json_Slice(event.arg, out.name.c_str(), out.in_at, now);
+        }
+        if (in_task.ready) {
+          in_task.ready = false;
+          in_task.wakeups++;
+          in_task.wake_us += now - in_task.ready_at;
+          if (now - in_task.ready_at > in_task.wake_max_us) {
+            in_task.wake_max_us = now - in_task.ready_at;
+          }
+        }
+        in_task.pending = -1;
+        in_task.in_at = now;
+        in_task.isr_at_in = isr_us;
+        current = event.id;
+        break;
+      }
+      case TRACE_ISR_ENTER:
+        isr_stack.push_back(std::make_pair((int) event.id, now));
+        break;
+      case TRACE_ISR_EXIT: {
+        // Entered before the first event if it isn't on the stack.
+        uint64_t from = 0;
+        Irq &irq = irqs[event.id];
+
+        if (!isr_stack.empty() && isr_stack.back().first == event.id) {
+          from = isr_stack.back().second;
+          isr_stack.pop_back();
+        } else if (!isr_stack.empty()) {
+          break;
+        }
+        irq.count++;
+        irq.total_us += now - from;
+        if (now - from > irq.longest_us) {
+          irq.longest_us = now - from;
+        }
+        if (isr_stack.empty()) {
+          isr_us += now - from;
+        }
+        json_Slice(INTERRUPTS_ROW, irq_Name(event.id).c_str(), from, now);
+        break;
+      }
+      case TRACE_TICK:
+        ticks++;
+        json_Instant(INTERRUPTS_ROW, "tick", now, 0);
+        break;
+      case TRACE_SEM_POST:
+      case TRACE_SEM_PEND: {
+        std::string name = dump.events.count(event.id)
+                               ? dump.events[event.id]
+                               : "event " + std::to_string(event.id);
+        bool post = event.type == TRACE_SEM_POST;
+
+        json_Instant(row, ((post ? "post " : "pend ") + name).c_str(), now,
+                     event.arg);
+        if (!post && event.arg == 0 && current >= 0) {
+          tasks[current].pending = event.id;
+          tasks[current].ready = false;
+        }
+        if (post && event.arg == 0) {
+          // Readies the highest priority task waiting, if any.
+          for (auto &task : tasks) {
+            if (task.second.pending == event.id && task.first != current) {
+              task.second.pending = -1;
+              task.second.ready = true;
+              task.second.ready_at = now;
+              break;
+            }
+          }
+        }
+        break;
+      }
+      case TRACE_QUEUE_POST:
+      case TRACE_QUEUE_PEND:
+        if (event.id < sizeof(queue_names) / sizeof(queue_names[0])) {
+          json_Event("{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%llu,"
+                     "\"args\":{\"depth\":%u}}", queue_names[event.id],
+                     (unsigned long long) now, (unsigned) event.arg);
+        }
+        break;
+      default:
+        fprintf(stderr, "unknown event type %u\n", (unsigned) event.type);
+        fclose(json);
+        printf("FAILED\n");
+        return 1;
+    }
+  }
+  if (current >= 0) {
+    Task &last = tasks[current];
+
+    last.run_us += now - last.in_at - (isr_us - last.isr_at_in);
+    json_Slice(current, last.name.c_str(), last.in_at, now);
+  }
+  fprintf(json, "\n]}\n");
+  fclose(json);
+
+  printf("%u events over %.3f ms, %u overwritten before them, %u ticks; "
+         "%s written\n", (unsigned) dump.records.size(), now / 1e3,
+         (unsigned) dump.overwritten, (unsigned) ticks, json_path);
+  printf("  %-20s %4s %9s %6s %6s %9s %7s %9s %9s\n", "task", "prio",
+         "ran ms", "%", "runs", "max ms", "wakes", "wake ms", "max ms");
+  for (const auto &task : tasks) {
+    const Task &t = task.second;
+
+    printf("  %-20s %4d %9.3f %5.1f%% %6u %9.3f %7u %9.3f %9.3f\n",
+           t.name.empty() ? "?" : t.name.c_str(), task.first,
+           t.run_us / 1e3, now ? 100.0 * t.run_us / now : 0.0,
+           (unsigned) t.runs, t.longest_us / 1e3, (unsigned) t.wakeups,
+           t.wakeups ? t.wake_us / 1e3 / t.wakeups : 0.0,
+           t.wake_max_us / 1e3);
+  }
+  printf("  %-20s %6s %9s %6s %9s\n", "interrupt", "count", "total ms", "%",
+         "max us");
+  for (const auto &irq : irqs) {
+    printf("  %-20s %6u %9.3f %5.1f%% %9llu\n", irq_Name(irq.first).c_str(),
+           (unsigned) irq.second.count, irq.second.total_us / 1e3,
+           now ? 100.0 * irq.second.total_us / now : 0.0,
+           (unsigned long long) irq.second.longest_us);
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,180 @@
+// Checks the UART transmit service on the host, against a simulated UART
+// that accepts a random number of bytes per call and stalls now and then.
+//
+// Records of random size, each one filled with its own number, are
+// appended between calls of UartTx_Service.  The bytes the UART receives
+// must be exactly the records UartTx_Append accepted, whole and in order;
+// the transport must only ever be handed the buffer producers are not
+// filling, from where it left off, and must get the other buffer only once
+// it has taken all of this one.  Append must refuse exactly the records
+// that do not fit in the fill buffer, and overflow_count, overflow_bytes,
+// high_water and bytes_sent must match.  Exits non-zero on any mismatch.
+//
+// build: cc -O2 -I.. -o uarttx uarttx.c ../UartTx.c
+// usage: uarttx [-n records] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "UartTx.h"
+
+#define MAX_RECORD 96
+#define MAX_RECEIVED (1u << 20)
+
+static UartTx tx;
+
+static uint8_t received[MAX_RECEIVED];
+static uint32_t received_length;
+
+// What the transport was handed last, and how much of it it took.
+static const uint8_t *last_data;
+static uint16_t last_size;
+static uint16_t last_sent;
+
+static uint32_t stalled;
+static uint32_t handovers;
+static int errors;
+
+static void fail(const char *what) {
+  if (errors++ < 10) {
+    printf("%s\n", what);
+  }
+}
+
+static uint16_t uart_Write(void *context, const uint8_t *data,
+                           uint16_t size) {
+  const uint8_t *drain = tx.buffer[tx.fill_index ^ 1];
+  uint16_t sent;
+
+  (void) context;
+  if (data < drain || data + size > drain + UART_TX_BUFFER_SIZE) {
+    fail("transport handed bytes outside the drain buffer");
+  }
+  if (last_sent != last_size) {
+    // The buffer must not change until the transport has taken all of it.
+    if (data != last_data + last_sent || size != last_size - last_sent) {
+      fail("transport not resumed where it left off");
+    }
+  } else if (data != drain) {
+    fail("new drain buffer not handed from its start");
+  } else {
+    handovers++;
+  }
+
+  // Stall for a while now and then, or take a random part.
+  if (stalled > 0) {
+    stalled--;
+    sent = 0;
+  } else if (rand() % 256 == 0) {
+    stalled = 1 + rand() % 8;
+    sent = 0;
+  } else {
+    sent = (uint16_t) (rand() % (size + 1));
+  }
+  if (received_length + sent > MAX_RECEIVED) {
+    fail("too many bytes received");
+    sent = 0;
+  }
+  memcpy(&received[received_length], data, sent);
+  received_length += sent;
+
+  last_data = data;
+  last_size = size;
+  last_sent = sent;
+  return sent;
+}
+
+int main(int argc, char **argv) {
+  static uint8_t expected[MAX_RECEIVED];
+  uint8_t record[MAX_RECORD];
+  uint32_t expected_length = 0;
+  uint32_t records = 10000;
+  uint32_t seed = 1;
+  uint32_t dropped = 0;
+  uint32_t dropped_bytes = 0;
+  uint32_t high_water = 0;
+  uint32_t fill;
+  uint32_t i;
+  uint16_t size;
+  bool fits;
+  bool accepted;
+
+  for (i = 1; i < (uint32_t) argc; i++) {
+    if (i + 1 < (uint32_t) argc && strcmp(argv[i], "-n") == 0) {
+      records = (uint32_t) strtoul(argv[++i], NULL, 0);
+    } else if (i + 1 < (uint32_t) argc && strcmp(argv[i], "-s") == 0) {
+      seed = (uint32_t) strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: %s [-n records] [-s seed]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (records > MAX_RECEIVED / MAX_RECORD) {
+    fprintf(stderr, "-n: up to %u\n", MAX_RECEIVED / MAX_RECORD);
+    return 2;
+  }
+  srand(seed);
+  UartTx_Init(&tx, uart_Write, NULL);
+
+  for (i = 0; i < records; i++) {
+    size = (uint16_t) (1 + rand() % MAX_RECORD);
+    memset(record, (int) (i & 0xFFu), size);
+
+    // The fill buffer is whatever is queued but not yet handed over.
+    fill = UartTx_Pending(&tx) - tx.drain_remaining;
+    fits = size <= UART_TX_BUFFER_SIZE - fill;
+    accepted = UartTx_Append(&tx, record, size);
+    if (accepted != fits) {
+      fail(fits ? "record refused that fits" : "record taken that overflows");
+    }
+    if (accepted) {
+      memcpy(&expected[expected_length], record, size);
+      expected_length += size;
+      if (fill + size > high_water) {
+        high_water = fill + size;
+      }
+    } else {
+      dropped++;
+      dropped_bytes += size;
+    }
+
+    // Often several records per call, as from the telemetry ring.
+    if (rand() % 2 == 0) {
+      UartTx_Service(&tx);
+    }
+  }
+  // Drain what is left; the stalls end on their own.
+  for (i = 0; i < 100000 && UartTx_Pending(&tx) != 0; i++) {
+    UartTx_Service(&tx);
+  }
+
+  if (UartTx_Pending(&tx) != 0) {
+    fail("not drained");
+  }
+  if (received_length != expected_length
+      || memcmp(received, expected, expected_length) != 0) {
+    fail("bytes received are not the records accepted");
+  }
+  if (tx.overflow_count != dropped || tx.overflow_bytes != dropped_bytes) {
+    fail("overflow counters wrong");
+  }
+  if (tx.high_water != high_water) {
+    fail("high water wrong");
+  }
+  if (tx.bytes_sent != received_length) {
+    fail("bytes_sent wrong");
+  }
+  if (dropped == 0 || handovers < 2) {
+    fail("no drops or no handovers; the check did not exercise them");
+  }
+
+  printf("%lu records, %lu dropped (%lu bytes), %lu bytes sent in %lu "
+         "buffers, high water %u/%u\n",
+         (unsigned long) records, (unsigned long) tx.overflow_count,
+         (unsigned long) tx.overflow_bytes, (unsigned long) tx.bytes_sent,
+         (unsigned long) handovers, (unsigned) tx.high_water,
+         (unsigned) UART_TX_BUFFER_SIZE);
+  printf(errors ? "FAILED\n" : "ok\n");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,174 @@
+/*
+*********************************************************************************************************
+*                                               uC/OS-II
+*                                         The Real-Time Kernel
+*
+*
+*                                (c) Copyright 2006, Micrium, Weston, FL
+*                                          All Rights Reserved
+*
+*                                        POSIX Simulation Port
+*
+* File      : OS_CPU.H
+* Version   : V2.89
+*
+* For       : Linux (x86-64, AArch64) and other POSIX hosts with <ucontext.h>
+* Mode      : Single host thread
+* Toolchain : GNU C Compiler
+*********************************************************************************************************
+*/
+
+#ifndef  OS_CPU_H
+#define  OS_CPU_H
+
+
+#ifdef   OS_CPU_GLOBALS
+#define  OS_CPU_EXT
+#else
+#define  OS_CPU_EXT  extern
+#endif
+
+/*
+*********************************************************************************************************
+*                                          SIMULATION DEFAULTS
+*
+* OS_CPU_SIM_CLK_FREQ      Frequency the SysTick counts at, in Hz.  OS_CPU_SysTickInit() takes a count of
+*                          this clock, as SysTick_Config() does on the target (16 MHz on the ADuCM350).
+*
+* OS_CPU_SIM_STK_SIZE      Size of the host stack each task runs on, in bytes.  Host code (the C library
+*                          in particular) needs far more stack than the target, so the stack passed to
+*                          OSTaskCreate() is not used; see OSTaskStkInit().
+*
+* OS_CPU_SIM_INT_NBR       Number of simulated interrupt lines.  Line 0 has the highest priority; the
+*                          last line is the SysTick, at the lowest, as the Cortex-M3 ports set it.
+*
+* OS_CPU_SIM_SLICE_US      Host microseconds between tries to preempt a task that is inside the C library
+*                          when an interrupt falls due.  0 turns preemption by the host timer off, so that
+*                          interrupts are only taken when a critical section ends, in the idle task and in
+*                          OS_CPU_SimPoll().
+*********************************************************************************************************
+*/
+
+#ifndef  OS_CPU_SIM_CLK_FREQ
+#define  OS_CPU_SIM_CLK_FREQ       16000000uL
+#endif
+
+#ifndef  OS_CPU_SIM_STK_SIZE
+#define  OS_CPU_SIM_STK_SIZE         262144uL
+#endif
+
+#ifndef  OS_CPU_SIM_INT_NBR
+#define  OS_CPU_SIM_INT_NBR              16u
+#endif
+
+#ifndef  OS_CPU_SIM_SLICE_US
+#define  OS_CPU_SIM_SLICE_US              5u
+#endif
+
+#define  OS_CPU_SIM_INT_SYSTICK   (OS_CPU_SIM_INT_NBR - 1u)
+
+/*
+*********************************************************************************************************
+*                                              DATA TYPES
+*                                         (Compiler Specific)
+*********************************************************************************************************
+*/
+
+typedef unsigned char       BOOLEAN;
+typedef unsigned char       INT8U;               /* Unsigned  8 bit quantity                           */
+typedef signed   char       INT8S;               /* Signed    8 bit quantity                           */
+typedef unsigned short      INT16U;              /* Unsigned 16 bit quantity                           */
+typedef signed   short      INT16S;              /* Signed   16 bit quantity                           */
+typedef unsigned int        INT32U;              /* Unsigned 32 bit quantity                           */
+typedef signed   int        INT32S;              /* Signed   32 bit quantity                           */
+typedef unsigned long long  INT64U;              /* Unsigned 64 bit quantity (simulated time)          */
+typedef signed   long long  INT64S;              /* Signed   64 bit quantity                           */
+typedef float               FP32;                /* Single precision floating point                    */
+typedef double              FP64;                /* Double precision floating point                    */
+
+typedef unsigned int        OS_STK;              /* Each stack entry is 32-bit wide, as on the target  */
+typedef unsigned int        OS_CPU_SR;           /* Simulated interrupt mask                           */
+
+typedef void              (*OS_CPU_SIM_ISR)(void);
+typedef INT64U            (*OS_CPU_SIM_PERIPH)(INT64U  now);
+
+typedef struct os_cpu_sim_stats {
+    INT64U  CtxSwCtr;                            /* Task level context switches                        */
+    INT64U  IntCtxSwCtr;                         /* Context switches on the way out of an ISR          */
+    INT64U  IntCtr;                              /* Interrupts taken                                   */
+    INT64U  IntPreemptCtr;                       /* ... of which preempted a running task              */
+    INT64U  IntLagMaxNs;                         /* Longest time an interrupt waited past its due time */
+    INT64U  IntLagTotNs;                         /* Sum of those waits                                 */
+    INT64U  IdleNs;                              /* Simulated time the idle task skipped               */
+} OS_CPU_SIM_STATS;
+
+/*
+*********************************************************************************************************
+*                                        Critical Section Management
+*
+* Method #3:  The simulated interrupt mask is a variable: OS_CPU_SR_Save() sets it and returns its previous
+*             value, and OS_CPU_SR_Restore() puts that back, taking any interrupt that fell due meanwhile
+*             once interrupts are enabled again.
+*********************************************************************************************************
+*/
+
+#define  OS_CRITICAL_METHOD   3u
+
+#if OS_CRITICAL_METHOD == 3u
+#define  OS_ENTER_CRITICAL()  {cpu_sr = OS_CPU_SR_Save();}
+#define  OS_EXIT_CRITICAL()   {OS_CPU_SR_Restore(cpu_sr);}
+#endif
+
+/*
+*********************************************************************************************************
+*                                          Host Miscellaneous
+*********************************************************************************************************
+*/
+
+#define  OS_STK_GROWTH        1u                  /* Stack grows from HIGH to LOW memory               */
+
+#define  OS_TASK_SW()         OSCtxSw()
+
+/*
+*********************************************************************************************************
+*                                            GLOBAL VARIABLES
+*********************************************************************************************************
+*/
+
+OS_CPU_EXT  OS_CPU_SIM_STATS  OS_CPU_SimStats;
+
+/*
+*********************************************************************************************************
+*                                              PROTOTYPES
+*********************************************************************************************************
+*/
+
+#if OS_CRITICAL_METHOD == 3u                      /* See OS_CPU_C.C                                    */
+OS_CPU_SR  OS_CPU_SR_Save(void);
+void       OS_CPU_SR_Restore(OS_CPU_SR cpu_sr);
+#endif
+
+void       OSCtxSw(void);
+void       OSIntCtxSw(void);
+void       OSStartHighRdy(void);
+
+void       OS_CPU_SysTickHandler(void);
+void       OS_CPU_SysTickInit(INT32U  cnts);
+
+                                                  /* Simulation control                                */
+INT64U     OS_CPU_SimTimeNs(void);
+void       OS_CPU_SimCpuScale(FP64  scale);
+void       OS_CPU_SimStopAt(INT64U  ns);
+void       OS_CPU_SimStop(void);
+void       OS_CPU_SimPoll(void);
+
+                                                  /* Interrupt injection                               */
+void       OS_CPU_SimIntConnect(INT8U  irq, OS_CPU_SIM_ISR  isr);
+void       OS_CPU_SimIntPend(INT8U  irq, INT64U  ns);
+void       OS_CPU_SimIntPeriod(INT8U  irq, INT64U  period_ns);
+void       OS_CPU_SimIntClr(INT8U  irq);
+INT8U      OS_CPU_SimIntCur(void);
+
+                                                  /* Simulated peripherals                             */
+void       OS_CPU_SimPeriphConnect(OS_CPU_SIM_PERIPH  sync);
+#endif
@@ -0,0 +1,1167 @@
+/*
+*********************************************************************************************************
+*                                               uC/OS-II
+*                                         The Real-Time Kernel
+*
+*
+*                                (c) Copyright 2006, Micrium, Weston, FL
+*                                          All Rights Reserved
+*
+*                                        POSIX Simulation Port
+*
+* File      : OS_CPU_C.C
+* Version   : V2.89
+*
+* For       : Linux (x86-64, AArch64) and other POSIX hosts with <ucontext.h>
+* Mode      : Single host thread
+* Toolchain : GNU C Compiler
+*
+* Notes     : 1) Every task is a ucontext with its own host stack, and all of them run on one host thread,
+*                so exactly one task runs at a time, as on the target.  A context switch is a
+*                swapcontext().
+*
+*             2) The port keeps a simulated clock, in nanoseconds.  While a task or an ISR runs, the clock
+*                advances with the host's execution time, times the CPU scale (see OS_CPU_SimCpuScale()):
+*                a scale of 50 makes every host microsecond count as 50 target microseconds, which is about
+*                how much slower the 16 MHz Cortex-M3 is.  When the idle task runs, nothing is left to do
+*                until the next interrupt, and the clock jumps straight to it.  So a simulation runs as
+*                fast as the host can execute the tasks, and the time the idle task skipped is the CPU
+*                headroom (OS_CPU_SimStats.IdleNs).
+*
+*             3) Interrupts are simulated by OS_CPU_SIM_INT_NBR lines.  A line has an ISR, the time it is
+*                next due and optionally a period; the SysTick is the last line.  A due interrupt is taken
+*                as soon as interrupts are enabled: when a critical section ends, in the idle task, in
+*                OS_CPU_SimPoll() and, while a task runs without calling the kernel, from a host timer
+*                signal set for when the next interrupt falls due.  The signal only preempts a task that is
+*                executing code of the program itself, never one inside the C library, so a task is never
+*                switched out holding a C library lock; it tries again every OS_CPU_SIM_SLICE_US.  (The program must not link the C library statically.)  How
+*                long interrupts waited past their due time is in OS_CPU_SimStats.
+*
+*             4) ISRs run with interrupts disabled and do not nest.  They use OSIntEnter()/OSIntExit() as
+*                on the target, and as with the PendSV there, OSIntCtxSw() only asks for the switch: it
+*                happens once no interrupt is left due, so every ISR runs to its end first.
+*
+*             5) Simulated peripherals connect a function with OS_CPU_SimPeriphConnect(), which brings them
+*                up to the current time and returns when they next need to run; it is called before any
+*                interrupt is taken and before the idle task skips time, and when that time comes.
+*
+*             6) OSStart() returns once the simulation is stopped, by OS_CPU_SimStop(), at the time set
+*                with OS_CPU_SimStopAt(), or when every task waits and no interrupt is pending.  The tasks
+*                are abandoned; the kernel can not be started again.
+*********************************************************************************************************
+*/
+
+#define  _GNU_SOURCE
+
+#define  OS_CPU_GLOBALS
+#include <ucos_ii.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+
+/*
+*********************************************************************************************************
+*                                            LOCAL DEFINES
+*********************************************************************************************************
+*/
+
+#define  OS_CPU_SIM_NEVER          (~(INT64U)0)
+#define  OS_CPU_SIM_HOST_GAP_NS     20000uLL     /* See OS_CPU_SimClk() Note #2                        */
+
+typedef struct os_cpu_sim_ctx {                  /* What OSTCBStkPtr points to for every task          */
+    ucontext_t   Ctx;
+    void       (*Task)(void *p_arg);
+    void        *Arg;
+} OS_CPU_SIM_CTX;
+
+/*
+*********************************************************************************************************
+*                                          LOCAL VARIABLES
+*********************************************************************************************************
+*/
+
+#if OS_TMR_EN > 0u
+static  INT16U            OSTmrCtr;
+#endif
+
+static  volatile  OS_CPU_SR  OS_CPU_SimIntDis = 1u;    /* Interrupts stay disabled until OSStart()     */
+static  volatile  BOOLEAN    OS_CPU_SimInSig;
+
+static  INT64U            OS_CPU_SimNow;         /* Simulated time, ns                                 */
+static  INT64U            OS_CPU_SimSeen;        /* Latest simulated time handed out                   */
+static  INT64U            OS_CPU_SimHostLast;    /* Host time the simulated clock was last advanced at */
+static  INT64U            OS_CPU_SimHostSync;    /* Host and CPU time at the last long step            */
+static  INT64U            OS_CPU_SimCpuSync;
+static  FP64              OS_CPU_SimScale = 1.0;
+static  INT64U            OS_CPU_SimEnd   = OS_CPU_SIM_NEVER;
+
+static  OS_CPU_SIM_ISR    OS_CPU_SimIntISR[OS_CPU_SIM_INT_NBR];
+static  INT64U            OS_CPU_SimIntDue[OS_CPU_SIM_INT_NBR];
+static  INT64U            OS_CPU_SimIntPer[OS_CPU_SIM_INT_NBR];
+static  INT64U            OS_CPU_SimIntNext = OS_CPU_SIM_NEVER;
+static  INT8U             OS_CPU_SimIntRun  = OS_CPU_SIM_INT_NBR;  /* Line whose ISR is running        */
+static  BOOLEAN           OS_CPU_SimIntSwReq;    /* OSIntCtxSw() was called                            */
+
+static  OS_CPU_SIM_PERIPH  OS_CPU_SimPeriph;     /* See OS_CPU_SimPeriphConnect()                      */
+static  INT64U            OS_CPU_SimPeriphDue = OS_CPU_SIM_NEVER;
+
+static  BOOLEAN           OS_CPU_SimTimerOn;     /* Preempting by the host timer                       */
+static  INT64U            OS_CPU_SimTimerAt  = OS_CPU_SIM_NEVER;  /* What the host timer is set for    */
+
+static  ucontext_t        OS_CPU_SimMainCtx;     /* Where OSStart() was called from                    */
+
+/*
+*********************************************************************************************************
+*                                        LOCAL FUNCTION PROTOTYPES
+*********************************************************************************************************
+*/
+
+static  INT64U   OS_CPU_SimHostNs  (clockid_t  clk);
+static  INT64U   OS_CPU_SimClk     (void);
+static  void     OS_CPU_SimClkHold (void);
+static  void     OS_CPU_SimIntNextUpdate(void);
+static  void     OS_CPU_SimIntTake (void);
+static  void     OS_CPU_SimIntSw   (void);
+static  void     OS_CPU_SimPeriphSync(void);
+static  void     OS_CPU_SimIdle    (void);
+static  void     OS_CPU_SimTaskStart(void);
+static  void     OS_CPU_SimSigHandler(int  sig, siginfo_t  *info, void  *uc);
+static  BOOLEAN  OS_CPU_SimInProgram(void  *uc);
+static  void     OS_CPU_SimTimerStart(BOOLEAN  on);
+static  void     OS_CPU_SimTimerArm(void);
+
+/*
+*********************************************************************************************************
+*                                       OS INITIALIZATION HOOK
+*                                            (BEGINNING)
+*
+* Description: This function is called by OSInit() at the beginning of OSInit().
+*
+* Arguments  : none
+*
+* Note(s)    : 1) Interrupts should be disabled during this call.
+*              2) Starts the simulated clock at 0 and clears every interrupt line.
+*********************************************************************************************************
+*/
+#if OS_CPU_HOOKS_EN > 0u
+void  OSInitHookBegin (void)
+{
+    INT8U  irq;
+
+
+    OS_CPU_SimNow      = 0u;
+    OS_CPU_SimSeen     = 0u;
+    OS_CPU_SimHostLast = OS_CPU_SimHostNs(CLOCK_MONOTONIC);
+    OS_CPU_SimHostSync = OS_CPU_SimHostLast;
+    OS_CPU_SimCpuSync  = OS_CPU_SimHostNs(CLOCK_THREAD_CPUTIME_ID);
+    for (irq = 0u; irq < OS_CPU_SIM_INT_NBR; irq++) {
+        OS_CPU_SimIntISR[irq] = (OS_CPU_SIM_ISR)0;
+        OS_CPU_SimIntDue[irq] = OS_CPU_SIM_NEVER;
+        OS_CPU_SimIntPer[irq] = 0u;
+    }
+    OS_CPU_SimIntNext   = OS_CPU_SIM_NEVER;
+    OS_CPU_SimIntRun    = OS_CPU_SIM_INT_NBR;
+    OS_CPU_SimPeriphDue = OS_CPU_SIM_NEVER;
+    memset(&OS_CPU_SimStats, 0, sizeof(OS_CPU_SimStats));
+
+#if OS_TMR_EN > 0u
+    OSTmrCtr = 0u;
+#endif
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                       OS INITIALIZATION HOOK
+*                                               (END)
+*
+* Description: This function is called by OSInit() at the end of OSInit().
+*
+* Arguments  : none
+*
+* Note(s)    : 1) Interrupts should be disabled during this call.
+*********************************************************************************************************
+*/
+#if OS_CPU_HOOKS_EN > 0u
+void  OSInitHookEnd (void)
+{
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                          TASK CREATION HOOK
+*
+* Description: This function is called when a task is created.
+*
+* Arguments  : ptcb   is a pointer to the task control block of the task being created.
+*
+* Note(s)    : 1) Interrupts are disabled during this call.
+*********************************************************************************************************
+*/
+#if OS_CPU_HOOKS_EN > 0u
+void  OSTaskCreateHook (OS_TCB *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TaskCreateHook(ptcb);
+#else
+    (void)ptcb;                                  /* Prevent compiler warning                           */
+#endif
+}
+#endif
+
+
+/*
+*********************************************************************************************************
+*                                           TASK DELETION HOOK
+*
+* Description: This function is called when a task is deleted.
+*
+* Arguments  : ptcb   is a pointer to the task control block of the task being deleted.
+*
+* Note(s)    : 1) Interrupts are disabled during this call.
+*              2) The task's host stack is not freed: a task deleting itself is still running on it.
+*********************************************************************************************************
+*/
+#if OS_CPU_HOOKS_EN > 0u
+void  OSTaskDelHook (OS_TCB *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TaskDelHook(ptcb);
+#else
+    (void)ptcb;                                  /* Prevent compiler warning                           */
+#endif
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                             IDLE TASK HOOK
+*
+* Description: This function is called by the idle task.  This hook has been added to allow you to do
+*              such things as STOP the CPU to conserve power.
+*
+* Arguments  : none
+*
+* Note(s)    : 1) Interrupts are enabled during this call.
+*              2) The simulated CPU 'stops' until the next interrupt: see OS_CPU_SimIdle().
+*********************************************************************************************************
+*/
+#if OS_CPU_HOOKS_EN > 0u
+void  OSTaskIdleHook (void)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TaskIdleHook();
+#endif
+    OS_CPU_SimIdle();
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                            TASK RETURN HOOK
+*
+* Description: This function is called if a task accidentally returns.  In other words, a task should
+*              either be an infinite loop or delete itself when done.
+*
+* Arguments  : ptcb      is a pointer to the task control block of the task that is returning.
+*
+* Note(s)    : none
+*********************************************************************************************************
+*/
+
+#if OS_CPU_HOOKS_EN > 0u
+void  OSTaskReturnHook (OS_TCB  *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TaskReturnHook(ptcb);
+#else
+    (void)ptcb;
+#endif
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                           STATISTIC TASK HOOK
+*
+* Description: This function is called every second by uC/OS-II's statistics task.  This allows your
+*              application to add functionality to the statistics task.
+*
+* Arguments  : none
+*********************************************************************************************************
+*/
+
+#if OS_CPU_HOOKS_EN > 0u
+void  OSTaskStatHook (void)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TaskStatHook();
+#endif
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                        INITIALIZE A TASK'S STACK
+*
+* Description: This function is called by either OSTaskCreate() or OSTaskCreateExt() to initialize the
+*              stack frame of the task being created.
+*
+* Arguments  : task          is a pointer to the task code
+*
+*              p_arg         is a pointer to a user supplied data area that will be passed to the task
+*                            when the task first executes.
+*
+*              ptos          is a pointer to the top of stack.  Not used: see note 1.
+*
+*              opt           specifies options that can be used to alter the behavior of OSTaskStkInit().
+*                            (see uCOS_II.H for OS_TASK_OPT_xxx).
+*
+* Returns    : A pointer to the task's host context, which uC/OS-II keeps in OSTCBStkPtr.
+*
+* Note(s)    : 1) The task runs on a host stack of OS_CPU_SIM_STK_SIZE bytes, because host code needs far
+*                 more stack than the target; the stack given to OSTaskCreate() stays untouched, and
+*                 OSTaskStkChk() reports it unused.
+*              2) Interrupts are enabled when your task starts executing.
+*********************************************************************************************************
+*/
+
+OS_STK *OSTaskStkInit (void (*task)(void *p_arg), void *p_arg, OS_STK *ptos, INT16U opt)
+{
+    OS_CPU_SIM_CTX  *pctx;
+
+
+    (void)ptos;                                  /* See Note #1                                        */
+    (void)opt;                                   /* 'opt' is not used, prevent warning                 */
+
+    pctx = (OS_CPU_SIM_CTX *)calloc(1u, sizeof(OS_CPU_SIM_CTX));
+    if (pctx == (OS_CPU_SIM_CTX *)0) {
+        fprintf(stderr, "OSTaskStkInit: out of memory\n");
+        abort();
+    }
+    pctx->Task = task;
+    pctx->Arg  = p_arg;
+
+    getcontext(&pctx->Ctx);
+    pctx->Ctx.uc_stack.ss_sp   = malloc(OS_CPU_SIM_STK_SIZE);
+    pctx->Ctx.uc_stack.ss_size = OS_CPU_SIM_STK_SIZE;
+    pctx->Ctx.uc_link          = (ucontext_t *)0;
+    if (pctx->Ctx.uc_stack.ss_sp == (void *)0) {
+        fprintf(stderr, "OSTaskStkInit: out of memory\n");
+        abort();
+    }
+    sigdelset(&pctx->Ctx.uc_sigmask, SIGALRM);
+    makecontext(&pctx->Ctx, OS_CPU_SimTaskStart, 0);
+
+    return ((OS_STK *)pctx);
+}
+
+/*
+*********************************************************************************************************
+*                                           TASK SWITCH HOOK
+*
+* Description: This function is called when a task switch is performed.  This allows you to perform other
+*              operations during a context switch.
+*
+* Arguments  : none
+*
+* Note(s)    : 1) Interrupts are disabled during this call.
+*              2) It is assumed that the global pointer 'OSTCBHighRdy' points to the TCB of the task that
+*                 will be 'switched in' (i.e. the highest priority task) and, 'OSTCBCur' points to the
+*                 task being switched out (i.e. the preempted task).
+*********************************************************************************************************
+*/
+#if (OS_CPU_HOOKS_EN > 0u) && (OS_TASK_SW_HOOK_EN > 0u)
+void  OSTaskSwHook (void)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TaskSwHook();
+#endif
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                           OS_TCBInit() HOOK
+*
+* Description: This function is called by OS_TCBInit() after setting up most of the TCB.
+*
+* Arguments  : ptcb    is a pointer to the TCB of the task being created.
+*
+* Note(s)    : 1) Interrupts may or may not be ENABLED during this call.
+*********************************************************************************************************
+*/
+#if OS_CPU_HOOKS_EN > 0u
+void  OSTCBInitHook (OS_TCB *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TCBInitHook(ptcb);
+#else
+    (void)ptcb;                                  /* Prevent compiler warning                           */
+#endif
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                               TICK HOOK
+*
+* Description: This function is called every tick.
+*
+* Arguments  : none
+*
+* Note(s)    : 1) Interrupts may or may not be ENABLED during this call.
+*********************************************************************************************************
+*/
+#if (OS_CPU_HOOKS_EN > 0u) && (OS_TIME_TICK_HOOK_EN > 0u)
+void  OSTimeTickHook (void)
+{
+#if OS_APP_HOOKS_EN > 0u
+    App_TimeTickHook();
+#endif
+
+#if OS_TMR_EN > 0u
+    OSTmrCtr++;
+    if (OSTmrCtr >= (OS_TICKS_PER_SEC / OS_TMR_CFG_TICKS_PER_SEC)) {
+        OSTmrCtr = 0;
+        OSTmrSignal();
+    }
+#endif
+}
+#endif
+
+/*
+*********************************************************************************************************
+*                                          SYS TICK HANDLER
+*
+* Description: Handle the system tick (SysTick) interrupt, which is used to generate the uC/OS-II tick
+*              interrupt.
+*
+* Arguments  : none.
+*
+* Note(s)    : 1) Connected to line OS_CPU_SIM_INT_SYSTICK by OS_CPU_SysTickInit().
+*********************************************************************************************************
+*/
+
+void  OS_CPU_SysTickHandler (void)
+{
+    OS_CPU_SR  cpu_sr;
+
+
+    OS_ENTER_CRITICAL();                         /* Tell uC/OS-II that we are starting an ISR          */
+    OSIntNesting++;
+    OS_EXIT_CRITICAL();
+
+    OSTimeTick();                                /* Call uC/OS-II's OSTimeTick()                       */
+
+    OSIntExit();                                 /* Tell uC/OS-II that we are leaving the ISR          */
+}
+
+/*
+*********************************************************************************************************
+*                                          INITIALIZE SYS TICK
+*
+* Description: Initialize the SysTick.
+*
+* Arguments  : cnts          is the number of SysTick counts between two OS tick interrupts, at
+*                            OS_CPU_SIM_CLK_FREQ.
+*
+* Note(s)    : 1) The first tick is due one period from now.
+*********************************************************************************************************
+*/
+
+void  OS_CPU_SysTickInit (INT32U  cnts)
+{
+    INT64U  period;
+
+
+    period = (INT64U)cnts * 1000000000uLL / OS_CPU_SIM_CLK_FREQ;
+    OS_CPU_SimIntConnect(OS_CPU_SIM_INT_SYSTICK, OS_CPU_SysTickHandler);
+    OS_CPU_SimIntPeriod(OS_CPU_SIM_INT_SYSTICK, period);
+    OS_CPU_SimIntPend(OS_CPU_SIM_INT_SYSTICK, OS_CPU_SimTimeNs() + period);
+}
+
+/*
+*********************************************************************************************************
+*                                       CRITICAL SECTION MANAGEMENT
+*
+* Description: Disable interrupts, returning whether they were disabled before; and restore that state.
+*
+* Arguments  : cpu_sr        is the state returned by OS_CPU_SR_Save().
+*
+* Note(s)    : 1) Enabling interrupts takes every interrupt due by now, as the NVIC would.
+*********************************************************************************************************
+*/
+
+OS_CPU_SR  OS_CPU_SR_Save (void)
+{
+    OS_CPU_SR  cpu_sr;
+
+
+    cpu_sr           = OS_CPU_SimIntDis;
+    OS_CPU_SimIntDis = 1u;
+    return (cpu_sr);
+}
+
+
+void  OS_CPU_SR_Restore (OS_CPU_SR  cpu_sr)
+{
+    if ((cpu_sr == 0u) && (OSRunning == OS_TRUE)) {
+        OS_CPU_SimIntTake();                     /* Still disabled: see OS_CPU_SimIntTake()            */
+    }
+    OS_CPU_SimIntDis = cpu_sr;
+}
+
+/*
+*********************************************************************************************************
+*                                          CONTEXT SWITCHING
+*
+* Description: OSStartHighRdy() starts the highest priority task; OSCtxSw() switches tasks from task
+*              level, and OSIntCtxSw() from OSIntExit().
+*
+* Arguments  : none
+*
+* Note(s)    : 1) Interrupts are disabled: every context is switched out, and so back in, inside a
+*                 critical section, so each task gets its own interrupt state back when it resumes.
+*              2) OSStartHighRdy() returns when the simulation stops (see OS_CPU_SimStop()).
+*              3) OSIntCtxSw() is called from an ISR, and only notes the switch, as the PendSV does on
+*                 the target; OS_CPU_SimIntTake() makes it once the ISRs are done.
+*********************************************************************************************************
+*/
+
+void  OSStartHighRdy (void)
+{
+#if (OS_CPU_HOOKS_EN > 0u) && (OS_TASK_SW_HOOK_EN > 0u)
+    OSTaskSwHook();
+#endif
+    OSRunning        = OS_TRUE;
+    OS_CPU_SimIntDis = 1u;
+    OS_CPU_SimTimerStart(OS_CPU_SIM_SLICE_US != 0u ? OS_TRUE : OS_FALSE);
+
+    swapcontext(&OS_CPU_SimMainCtx, &((OS_CPU_SIM_CTX *)OSTCBHighRdy->OSTCBStkPtr)->Ctx);
+
+    OS_CPU_SimTimerStart(OS_FALSE);              /* The simulation was stopped                         */
+    OS_CPU_SimIntDis = 1u;
+}
+
+
+void  OSCtxSw (void)
+{
+    OS_CPU_SIM_CTX  *pcur;
+
+
+#if (OS_CPU_HOOKS_EN > 0u) && (OS_TASK_SW_HOOK_EN > 0u)
+    OSTaskSwHook();
+#endif
+    OS_CPU_SimStats.CtxSwCtr++;
+    pcur       = (OS_CPU_SIM_CTX *)OSTCBCur->OSTCBStkPtr;
+    OSTCBCur   = OSTCBHighRdy;
+    OSPrioCur  = OSPrioHighRdy;
+    (void)OS_CPU_SimClk();
+    swapcontext(&pcur->Ctx, &((OS_CPU_SIM_CTX *)OSTCBHighRdy->OSTCBStkPtr)->Ctx);
+    OS_CPU_SimClkHold();                         /* The switch itself is the host's                    */
+}
+
+
+void  OSIntCtxSw (void)
+{
+    OS_CPU_SimIntSwReq = OS_TRUE;                /* See Note #3                                        */
+}
+
+
+static  void  OS_CPU_SimIntSw (void)
+{
+    OS_CPU_SIM_CTX  *pcur;
+
+
+#if (OS_CPU_HOOKS_EN > 0u) && (OS_TASK_SW_HOOK_EN > 0u)
+    OSTaskSwHook();
+#endif
+    OS_CPU_SimStats.IntCtxSwCtr++;
+    pcur       = (OS_CPU_SIM_CTX *)OSTCBCur->OSTCBStkPtr;
+    OSTCBCur   = OSTCBHighRdy;
+    OSPrioCur  = OSPrioHighRdy;
+    (void)OS_CPU_SimClk();
+    swapcontext(&pcur->Ctx, &((OS_CPU_SIM_CTX *)OSTCBHighRdy->OSTCBStkPtr)->Ctx);
+    OS_CPU_SimClkHold();                         /* The switch itself is the host's                    */
+}
+
+/*
+*********************************************************************************************************
+*                                           SIMULATED TIME
+*
+* Description: OS_CPU_SimTimeNs() returns the simulated time in nanoseconds since OSInit().
+*              OS_CPU_SimCpuScale() sets how many simulated nanoseconds a host nanosecond of execution is
+*              worth (1.0 until set).
+*
+* Arguments  : scale         is the new CPU scale.
+*
+* Note(s)    : 1) Both can be called from tasks, ISRs and before OSStart().
+*              2) Reading the time with interrupts enabled takes any interrupt due first, so that a task
+*                 polling the clock sees the interrupts that fell due before the time it reads.
+*********************************************************************************************************
+*/
+
+INT64U  OS_CPU_SimTimeNs (void)
+{
+    OS_CPU_SR  cpu_sr;
+    INT64U     now;
+
+
+    cpu_sr           = OS_CPU_SimIntDis;
+    OS_CPU_SimIntDis = 1u;
+    if ((cpu_sr == 0u) && (OSRunning == OS_TRUE)) {
+        OS_CPU_SimIntTake();                     /* Anything due happened before now                   */
+    }
+    now              = OS_CPU_SimClk();
+    OS_CPU_SimSeen   = now;
+    OS_CPU_SimIntDis = cpu_sr;
+    return (now);
+}
+
+
+void  OS_CPU_SimCpuScale (FP64  scale)
+{
+    OS_CPU_SR  cpu_sr;
+
+
+    cpu_sr           = OS_CPU_SimIntDis;
+    OS_CPU_SimIntDis = 1u;
+    (void)OS_CPU_SimClk();                       /* Time so far counts at the old scale                */
+    OS_CPU_SimScale  = scale;
+    OS_CPU_SimIntDis = cpu_sr;
+}
+
+/*
+*********************************************************************************************************
+*                                          SIMULATION CONTROL
+*
+* Description: OS_CPU_SimStopAt() stops the simulation once the simulated clock reaches 'ns';
+*              OS_CPU_SimStop() stops it now.  OSStart() then returns.
+*
+*              OS_CPU_SimPoll() takes any interrupt that is due, if interrupts are enabled.  Simulated
+*              peripherals call it where the code waits on them in a loop, as an interrupt would end the
+*              wait on the target.
+*
+* Arguments  : ns            is the simulated time to stop at.
+*********************************************************************************************************
+*/
+
+void  OS_CPU_SimStopAt (INT64U  ns)
+{
+    OS_CPU_SimEnd = ns;
+}
+
+
+void  OS_CPU_SimStop (void)
+{
+    if (OSRunning == OS_TRUE) {
+        OS_CPU_SimIntDis = 1u;
+        OS_CPU_SimTimerStart(OS_FALSE);
+        setcontext(&OS_CPU_SimMainCtx);
+    }
+}
+
+
+void  OS_CPU_SimPoll (void)
+{
+    OS_CPU_SR  cpu_sr;
+
+
+    OS_ENTER_CRITICAL();
+    OS_EXIT_CRITICAL();
+}
+
+/*
+*********************************************************************************************************
+*                                         INTERRUPT INJECTION
+*
+* Description: OS_CPU_SimIntConnect() sets the ISR of interrupt line 'irq'.  OS_CPU_SimIntPend() makes the
+*              interrupt due at simulated time 'ns' (now or earlier to take it as soon as interrupts are
+*              enabled), replacing any time it was due at before.  OS_CPU_SimIntPeriod() makes the line
+*              periodic: each time the interrupt is taken, it falls due again one period later; 0 makes it
+*              one-shot.  OS_CPU_SimIntClr() cancels the interrupt and the period.
+*
+* Arguments  : irq           is the interrupt line, 0 (highest priority) to OS_CPU_SIM_INT_NBR - 1.
+*
+*              isr           is the function to call; it uses OSIntEnter()/OSIntExit() around any kernel
+*                            service, as on the target.
+*
+*              ns            is the simulated time the interrupt is due at.
+*
+*              period_ns     is the period of the interrupt.
+*
+* Note(s)    : 1) Can be called from tasks, ISRs and before OSStart().
+*              2) A periodic interrupt taken late does not fall due once for every period missed: like a
+*                 pending bit, it is taken once, and falls due again at the next period after now.
+*********************************************************************************************************
+*/
+
+void  OS_CPU_SimIntConnect (INT8U  irq, OS_CPU_SIM_ISR  isr)
+{
+    if (irq < OS_CPU_SIM_INT_NBR) {
+        OS_CPU_SimIntISR[irq] = isr;
+    }
+}
+
+
+void  OS_CPU_SimIntPend (INT8U  irq, INT64U  ns)
+{
+    OS_CPU_SR  cpu_sr;
+
+
+    if (irq >= OS_CPU_SIM_INT_NBR) {
+        return;
+    }
+    OS_ENTER_CRITICAL();
+    OS_CPU_SimIntDue[irq] = ns;
+    OS_CPU_SimIntNextUpdate();
+    OS_CPU_SimTimerArm();
+    OS_EXIT_CRITICAL();
+}
+
+
+void  OS_CPU_SimIntPeriod (INT8U  irq, INT64U  period_ns)
+{
+    if (irq < OS_CPU_SIM_INT_NBR) {
+        OS_CPU_SimIntPer[irq] = period_ns;
+    }
+}
+
+
+void  OS_CPU_SimIntClr (INT8U  irq)
+{
+    OS_CPU_SR  cpu_sr;
+
+
+    if (irq >= OS_CPU_SIM_INT_NBR) {
+        return;
+    }
+    OS_ENTER_CRITICAL();
+    OS_CPU_SimIntDue[irq] = OS_CPU_SIM_NEVER;
+    OS_CPU_SimIntPer[irq] = 0u;
+    OS_CPU_SimIntNextUpdate();
+    OS_EXIT_CRITICAL();
+}
+
+/*
+*********************************************************************************************************
+*                                        CURRENT INTERRUPT LINE
+*
+* Description: Returns the line whose ISR is running, or OS_CPU_SIM_INT_NBR at task level: what the IPSR
+*              tells on the target.
+*********************************************************************************************************
+*/
+
+INT8U  OS_CPU_SimIntCur (void)
+{
+    return (OS_CPU_SimIntRun);
+}
+
+/*
+*********************************************************************************************************
+*                                        SIMULATED PERIPHERALS
+*
+* Description: Connects the function that runs the simulated peripherals.  It is called with the
+*              simulated time, brings the peripherals up to it, pending the interrupts they raise with
+*              OS_CPU_SimIntPend(), and returns the time they next need to run, or ~0 for never.
+*
+* Arguments  : sync          is the function, or 0 to disconnect it.
+*
+* Note(s)    : 1) It is called with interrupts disabled: before the interrupts due are taken, so the
+*                 peripherals see what the program wrote to them first; before the idle task skips time;
+*                 and at the time it returned, which the host timer and the idle task treat like an
+*                 interrupt falling due.
+*              2) The host time it takes does not count as simulated time: the peripherals work alongside
+*                 the CPU.
+*********************************************************************************************************
+*/
+
+void  OS_CPU_SimPeriphConnect (OS_CPU_SIM_PERIPH  sync)
+{
+    OS_CPU_SR  cpu_sr;
+
+
+    OS_ENTER_CRITICAL();
+    OS_CPU_SimPeriph    = sync;
+    OS_CPU_SimPeriphDue = OS_CPU_SIM_NEVER;
+    OS_CPU_SimIntNextUpdate();
+    OS_EXIT_CRITICAL();
+}
+
+/*
+*********************************************************************************************************
+*                                           LOCAL FUNCTIONS
+*********************************************************************************************************
+*/
+
+static  INT64U  OS_CPU_SimHostNs (clockid_t  clk)
+{
+    struct timespec  ts;
+
+
+    clock_gettime(clk, &ts);
+    return ((INT64U)ts.tv_sec * 1000000000uLL + (INT64U)ts.tv_nsec);
+}
+
+/*
+*********************************************************************************************************
+*                                      ADVANCE THE SIMULATED CLOCK
+*
+* Description: Advances the simulated clock by the host time since it was last advanced, times the CPU
+*              scale, and returns it.
+*
+* Note(s)    : 1) Called with interrupts disabled.
+*              2) The host time is the monotonic clock, which is cheap to read; but it also runs while the
+*                 host runs other processes.  The thread's CPU time does not, but takes a system call to
+*                 read.  So after a step longer than OS_CPU_SIM_HOST_GAP_NS, the time this thread spent off
+*                 the CPU since the last such step is taken out again.
+*********************************************************************************************************
+*/
+
+static  INT64U  OS_CPU_SimClk (void)
+{
+    INT64U  host;
+    INT64U  cpu;
+    INT64U  step;
+    INT64U  off;
+
+
+    host = OS_CPU_SimHostNs(CLOCK_MONOTONIC);
+    step = host - OS_CPU_SimHostLast;
+    if (step > OS_CPU_SIM_HOST_GAP_NS) {
+        cpu  = OS_CPU_SimHostNs(CLOCK_THREAD_CPUTIME_ID);
+        off  = (host - OS_CPU_SimHostSync) - (cpu - OS_CPU_SimCpuSync);
+        if ((INT64S)off > 0) {
+            step -= off < step ? off : step;
+        }
+        OS_CPU_SimHostSync = host;
+        OS_CPU_SimCpuSync  = cpu;
+    }
+    OS_CPU_SimNow     += (INT64U)((FP64)step * OS_CPU_SimScale);
+    OS_CPU_SimHostLast = host;
+    return (OS_CPU_SimNow);
+}
+
+                                                 /* Leave the host time since out of the clock         */
+static  void  OS_CPU_SimClkHold (void)
+{
+    OS_CPU_SimHostLast = OS_CPU_SimHostNs(CLOCK_MONOTONIC);
+}
+
+
+static  void  OS_CPU_SimIntNextUpdate (void)
+{
+    INT64U  next;
+    INT8U   irq;
+
+
+    next = OS_CPU_SimPeriphDue;
+    for (irq = 0u; irq < OS_CPU_SIM_INT_NBR; irq++) {
+        if (OS_CPU_SimIntDue[irq] < next) {
+            next = OS_CPU_SimIntDue[irq];
+        }
+    }
+    OS_CPU_SimIntNext = next;
+}
+
+/*
+*********************************************************************************************************
+*                                       TAKE THE DUE INTERRUPTS
+*
+* Description: Calls the ISR of every interrupt due by now, highest priority (lowest line) first, and
+*              stops the simulation if its end has come.
+*
+* Note(s)    : 1) Called with interrupts disabled, from a context that had them enabled.  Once no interrupt
+*                 is left due, the switch an ISR asked for in OSIntExit() is made; the rest of this loop
+*                 runs when this context is switched back in.
+*              2) An interrupt is often taken late: the host timer signal takes host time to arrive, the
+*                 task may have been inside the C library, or the host ran something else.  The context
+*                 went on running meanwhile, where on the target the interrupt would have preempted it on
+*                 time.  So unless the clock was read since the interrupt fell due, the clock goes back to
+*                 that time, the ISRs (and any task they make ready) run when they would have, and the time
+*                 the context ran past it is added back when it resumes.
+*********************************************************************************************************
+*/
+
+static  void  OS_CPU_SimIntTake (void)
+{
+    OS_CPU_SIM_ISR  isr;
+    BOOLEAN         preempt;
+    INT64U          now;
+    INT64U          owed;
+    INT64U          lag;
+    INT8U           irq;
+
+
+    preempt         = OS_CPU_SimInSig;
+    OS_CPU_SimInSig = OS_FALSE;                  /* The ISRs may switch to other contexts              */
+    owed            = 0u;
+    now             = OS_CPU_SimClk();
+    if (OS_CPU_SimIntNext < now) {               /* See Note #2                                        */
+        OS_CPU_SimNow = OS_CPU_SimIntNext > OS_CPU_SimSeen ? OS_CPU_SimIntNext : OS_CPU_SimSeen;
+        owed          = now - OS_CPU_SimNow;
+    }
+
+    for (;;) {
+        OS_CPU_SimPeriphSync();                  /* May pend interrupts due now                        */
+        now = OS_CPU_SimClk();
+        if (now >= OS_CPU_SimEnd) {
+            OS_CPU_SimStop();
+        }
+        if (OS_CPU_SimIntNext > now) {
+            if (OS_CPU_SimIntSwReq == OS_TRUE) {
+                OS_CPU_SimIntSwReq = OS_FALSE;
+                if (OSTCBHighRdy != OSTCBCur) {
+                    OS_CPU_SimIntSw();
+                }
+                continue;
+            }
+            OS_CPU_SimNow += owed;               /* Back to where this context was                     */
+            OS_CPU_SimTimerArm();
+            return;
+        }
+
+        for (irq = 0u; (irq < OS_CPU_SIM_INT_NBR) && (OS_CPU_SimIntDue[irq] > now); irq++) {
+            ;
+        }
+        if (irq == OS_CPU_SIM_INT_NBR) {         /* Only the peripherals are due: run them again       */
+            continue;
+        }
+        lag = now - OS_CPU_SimIntDue[irq];
+        if (OS_CPU_SimIntPer[irq] != 0u) {       /* See OS_CPU_SimIntPend() Note #2                    */
+            OS_CPU_SimIntDue[irq] += OS_CPU_SimIntPer[irq];
+            if (OS_CPU_SimIntDue[irq] <= now) {
+                OS_CPU_SimIntDue[irq] += ((now - OS_CPU_SimIntDue[irq]) / OS_CPU_SimIntPer[irq] + 1u)
+                                       * OS_CPU_SimIntPer[irq];
+            }
+        } else {
+            OS_CPU_SimIntDue[irq] = OS_CPU_SIM_NEVER;
+        }
+        OS_CPU_SimIntNextUpdate();
+
+        OS_CPU_SimStats.IntCtr++;
+        if (preempt == OS_TRUE) {
+            OS_CPU_SimStats.IntPreemptCtr++;
+        }
+        OS_CPU_SimStats.IntLagTotNs += lag;
+        if (lag > OS_CPU_SimStats.IntLagMaxNs) {
+            OS_CPU_SimStats.IntLagMaxNs = lag;
+        }
+
+        isr = OS_CPU_SimIntISR[irq];
+        if (isr != (OS_CPU_SIM_ISR)0) {
+            OS_CPU_SimIntRun = irq;
+            isr();
+            OS_CPU_SimIntRun = OS_CPU_SIM_INT_NBR;
+        }
+    }
+}
+
+/*
+*********************************************************************************************************
+*                                      RUN THE SIMULATED PERIPHERALS
+*
+* Description: Calls the function connected with OS_CPU_SimPeriphConnect() at the current time, outside the
+*              simulated clock, and notes when it next needs to run.
+*
+* Note(s)    : 1) Called with interrupts disabled.
+*********************************************************************************************************
+*/
+
+static  void  OS_CPU_SimPeriphSync (void)
+{
+    INT64U  now;
+    INT64U  due;
+
+
+    if (OS_CPU_SimPeriph == (OS_CPU_SIM_PERIPH)0) {
+        return;
+    }
+    now = OS_CPU_SimClk();
+    due = OS_CPU_SimPeriph(now);
+    OS_CPU_SimClkHold();                         /* See OS_CPU_SimPeriphConnect() Note #2              */
+    if (due <= now) {
+        due = now + 1u;
+    }
+    if (due != OS_CPU_SimPeriphDue) {
+        OS_CPU_SimPeriphDue = due;
+        OS_CPU_SimIntNextUpdate();
+        OS_CPU_SimTimerArm();
+    }
+}
+
+/*
+*********************************************************************************************************
+*                                           IDLE THE CPU
+*
+* Description: Called by the idle task: no task is ready, so nothing happens until the next interrupt,
+*              and the simulated clock jumps straight to it.
+*
+* Note(s)    : 1) With no interrupt pending and no end set, nothing would ever happen again: the
+*                 simulation stops.
+*********************************************************************************************************
+*/
+
+static  void  OS_CPU_SimIdle (void)
+{
+    OS_CPU_SR  cpu_sr;
+    INT64U     now;
+    INT64U     next;
+
+
+    cpu_sr           = OS_CPU_SimIntDis;
+    OS_CPU_SimIntDis = 1u;
+    OS_CPU_SimPeriphSync();
+    now              = OS_CPU_SimClk();
+    next             = OS_CPU_SimIntNext < OS_CPU_SimEnd ? OS_CPU_SimIntNext : OS_CPU_SimEnd;
+    if (next == OS_CPU_SIM_NEVER) {
+        fprintf(stderr, "uC/OS-II: every task waits and no interrupt is pending; stopping\n");
+        OS_CPU_SimStop();
+    }
+    if (next > now) {
+        OS_CPU_SimStats.IdleNs += next - now;
+        OS_CPU_SimNow           = next;
+    }
+    OS_CPU_SR_Restore(cpu_sr);
+}
+
+/*
+*********************************************************************************************************
+*                                         TASK ENTRY POINT
+*
+* Description: Where every task's context starts: enables interrupts and calls the task, as the
+*              exception return does on the target.
+*********************************************************************************************************
+*/
+
+static  void  OS_CPU_SimTaskStart (void)
+{
+    OS_CPU_SIM_CTX  *pctx;
+
+
+    OS_CPU_SimClkHold();
+    pctx = (OS_CPU_SIM_CTX *)OSTCBCur->OSTCBStkPtr;
+    OS_CPU_SR_Restore(0u);
+    pctx->Task(pctx->Arg);
+    OS_TaskReturn();
+}
+
+/*
+*********************************************************************************************************
+*                                      PREEMPTION BY THE HOST TIMER
+*
+* Description: OS_CPU_SimTimerStart() starts (or stops) the host timer.  OS_CPU_SimTimerArm() sets it to
+*              go off when the next interrupt falls due, at the current CPU scale.  The signal handler
+*              takes the interrupts due, preempting the running task, if interrupts are enabled and the
+*              task is executing the program's own code; otherwise it tries again OS_CPU_SIM_SLICE_US
+*              later, unless the task gets to them first.
+*
+* Note(s)    : 1) OS_CPU_SimTimerArm() is called with interrupts disabled.
+*********************************************************************************************************
+*/
+
+static  void  OS_CPU_SimTimerStart (BOOLEAN  on)
+{
+    static  BOOLEAN    installed;
+    struct  sigaction  sa;
+    struct  itimerval  itv;
+
+
+    if ((on == OS_TRUE) && (installed == OS_FALSE)) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = OS_CPU_SimSigHandler;
+        sa.sa_flags     = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGALRM, &sa, (struct sigaction *)0);
+        installed = OS_TRUE;
+    }
+    OS_CPU_SimTimerOn = on;
+    OS_CPU_SimTimerAt = OS_CPU_SIM_NEVER;
+    if (on == OS_FALSE) {
+        memset(&itv, 0, sizeof(itv));
+        setitimer(ITIMER_REAL, &itv, (struct itimerval *)0);
+    }
+}
+
+
+static  void  OS_CPU_SimTimerArm (void)
+{
+    struct  itimerval  itv;
+    INT64U             next;
+    INT64U             us;
+
+
+    next = OS_CPU_SimIntNext < OS_CPU_SimEnd ? OS_CPU_SimIntNext : OS_CPU_SimEnd;
+    if ((OS_CPU_SimTimerOn == OS_FALSE) || (next == OS_CPU_SimTimerAt)) {
+        return;                                  /* Already set for it                                 */
+    }
+    OS_CPU_SimTimerAt = next;
+    memset(&itv, 0, sizeof(itv));
+    if (next != OS_CPU_SIM_NEVER) {
+        us = next > OS_CPU_SimNow ? (INT64U)((FP64)(next - OS_CPU_SimNow) / OS_CPU_SimScale / 1000.0) : 0u;
+        if (us == 0u) {
+            us = 1u;
+        }
+        itv.it_value.tv_sec  = (time_t)(us / 1000000u);
+        itv.it_value.tv_usec = (suseconds_t)(us % 1000000u);
+    }
+    setitimer(ITIMER_REAL, &itv, (struct itimerval *)0);
+    OS_CPU_SimClkHold();
+}
+
+
+static  void  OS_CPU_SimSigHandler (int  sig, siginfo_t  *info, void  *uc)
+{
+    struct  itimerval  itv;
+    int                err;
+
+
+    (void)sig;
+    (void)info;
+    err               = errno;
+    OS_CPU_SimTimerAt = OS_CPU_SIM_NEVER;        /* The timer is no longer set                         */
+    if ((OS_CPU_SimIntDis != 0u) || (OSRunning != OS_TRUE) || (OS_CPU_SimInProgram(uc) == OS_FALSE)) {
+        memset(&itv, 0, sizeof(itv));            /* Wait until the task is out of the C library        */
+        itv.it_value.tv_usec = OS_CPU_SIM_SLICE_US;
+        setitimer(ITIMER_REAL, &itv, (struct itimerval *)0);
+        errno = err;
+        return;
+    }
+
+    OS_CPU_SimIntDis = 1u;
+    OS_CPU_SimInSig  = OS_TRUE;
+    OS_CPU_SimIntTake();
+    OS_CPU_SimClkHold();                         /* Nor is returning from the signal                   */
+    OS_CPU_SimIntDis = 0u;
+    errno            = err;
+}
+
+                                                 /* Was the task executing the program's own code?     */
+extern  char  __executable_start[];
+extern  char  etext[];
+
+static  BOOLEAN  OS_CPU_SimInProgram (void  *uc)
+{
+    char  *pc;
+
+
+#if   defined(__x86_64__)
+    pc = (char *)((ucontext_t *)uc)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__aarch64__)
+    pc = (char *)((ucontext_t *)uc)->uc_mcontext.pc;
+#else
+    (void)uc;
+    return (OS_FALSE);                           /* Interrupts only taken at the other points          */
+#endif
+#if defined(__x86_64__) || defined(__aarch64__)
+    return ((pc >= __executable_start) && (pc < etext) ? OS_TRUE : OS_FALSE);
+#endif
+}
@@ -19,6 +19,8 @@ volatile bool reached_target_pressure = false;
 unsigned int target_pressure = 0;
 unsigned int actual_pressure = 0;
 bool pressure_changed;
+bool inflating = false;
+int target_pressure_extra = 0;
 
 // I2C.
 const unsigned char kResponseStillInflating = (unsigned char) 0x23;
@@ -26,6 +28,49 @@ const unsigned char kResponsePressureAvailable = (unsigned char) 0x24;
 const unsigned char kRequestSetTargetPressure = (unsigned char) 0x42;
 unsigned char actual_pressure_tx[3];
 
+// Burst protocol (see PressureBurst.h on the ADuCM350).  Once the ADuCM350
+// has sent kRequestBurst, every read gets the samples taken since the read
+// before, up to the number it asked for, in one frame:
+//   marker, flags | count, first sequence number (16 bit), age of the newest
+//   sample sent in kBurstAgeUnitUs (16 bit), the samples (16 bit each),
+//   CRC-8 (0x07).
+const unsigned char kRequestBurst = (unsigned char) 0x43;
+const unsigned char kResponseBurst = (unsigned char) 0x25;
+const unsigned char kBurstReached = (unsigned char) 0x80;
+const unsigned char kBurstMaxSamples = 12;
+const unsigned char kBurstHeaderSize = 6;
+const unsigned long kBurstAgeUnitUs = 4;
+unsigned char burst_tx[kBurstHeaderSize + 2 * kBurstMaxSamples + 1];
+volatile bool burst_mode = false;
+volatile unsigned char burst_max_samples = kBurstMaxSamples;
+
+// The transducer is sampled by Timer1 every kSamplePeriodUs, into a ring of
+// kSampleRingSize samples numbered by sample_sequence.  Everything reads the
+// pressure from the ring; nothing else uses the ADC.
+const unsigned long kSamplePeriodUs = 5000;
+const unsigned int kSampleRingSize = 32;  // Power of two.
+volatile uint16_t sample_ring[kSampleRingSize];
+volatile uint16_t sample_sequence = 0;    // Number of the next sample.
+volatile unsigned long newest_sample_us = 0;
+uint16_t burst_sequence = 0;              // Next sample to send.
+
+ISR(TIMER1_COMPA_vect) {
+  sample_ring[sample_sequence & (kSampleRingSize - 1)] =
+      (uint16_t) analogRead(kTransducerPin);
+  newest_sample_us = micros();
+  sample_sequence++;
+}
+
+// The newest sample.
+unsigned int latestPressure() {
+  unsigned int value;
+
+  noInterrupts();
+  value = sample_ring[(uint16_t) (sample_sequence - 1) & (kSampleRingSize - 1)];
+  interrupts();
+  return value;
+}
+
 void receivePressure(int numBytes) {
   if (numBytes == 1) {
     // The ADUCM350 I2C implementation sends an address before a request;
@@ -43,6 +88,13 @@ void receivePressure(int numBytes) {
     unsigned int c1 = (unsigned int) Wire.read();
     unsigned int c2 = (unsigned int) Wire.read();
     pending_target_pressure = c1 | (c2 << 8);
+  } else if (command == kRequestBurst) {
+    unsigned char max_samples = (unsigned char) Wire.read();
+    burst_max_samples =
+        max_samples < kBurstMaxSamples ? max_samples : kBurstMaxSamples;
+    // Start from the samples taken from now on.
+    burst_sequence = sample_sequence;
+    burst_mode = true;
   } else {
     Serial.println("Unknown command: ");
     Serial.println(command);
@@ -52,9 +104,67 @@ void receivePressure(int numBytes) {
   }
 }
 
+unsigned char crc8(const unsigned char *data, unsigned char length) {
+  unsigned char crc = 0;
+
+  while (length--) {
+    crc ^= *data++;
+    for (unsigned char bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (unsigned char) ((crc << 1) ^ 0x07)
+                         : (unsigned char) (crc << 1);
+    }
+  }
+  return crc;
+}
+
+void sendBurst() {
+  // Runs in the TWI interrupt, so the sampling interrupt can't change the
+  // ring meanwhile.
+  uint16_t available = sample_sequence - burst_sequence;
+  unsigned long age = micros() - newest_sample_us;
+  unsigned char count;
+  unsigned char size;
+
+  // The ring only holds the newest kSampleRingSize samples; older ones are
+  // lost, and the ADuCM350 sees the gap in the sequence numbers.
+  if (available > kSampleRingSize) {
+    burst_sequence = sample_sequence - kSampleRingSize;
+    available = kSampleRingSize;
+  }
+  count = available < burst_max_samples ? available : burst_max_samples;
+
+  burst_tx[0] = kResponseBurst;
+  burst_tx[1] = count | (reached_target_pressure ? kBurstReached : 0);
+  burst_tx[2] = (unsigned char) burst_sequence;
+  burst_tx[3] = (unsigned char) (burst_sequence >> 8);
+  // The age of the newest sample sent, which is older if some are left.
+  age += (unsigned long) (available - count) * kSamplePeriodUs;
+  age /= kBurstAgeUnitUs;
+  if (age > 0xFFFF) {
+    age = 0xFFFF;
+  }
+  burst_tx[4] = (unsigned char) age;
+  burst_tx[5] = (unsigned char) (age >> 8);
+  for (unsigned char i = 0; i < count; i++) {
+    uint16_t value = sample_ring[(burst_sequence + i) & (kSampleRingSize - 1)];
+    burst_tx[kBurstHeaderSize + 2 * i] = (unsigned char) value;
+    burst_tx[kBurstHeaderSize + 2 * i + 1] = (unsigned char) (value >> 8);
+  }
+  size = kBurstHeaderSize + 2 * count;
+  burst_tx[size] = crc8(burst_tx, size);
+  burst_sequence += count;
+
+  Wire.write(burst_tx, size + 1);
+}
+
 void sendPressure() {
+  if (burst_mode) {
+    sendBurst();
+    return;
+  }
+
   // Send actual pressure as a response to the ADUCM350.
-  int val = analogRead(kTransducerPin);
+  int val = latestPressure();
 
   // Structure actual pressure data to appropriate bytes
   // to send over the I2C bus.
@@ -65,7 +175,7 @@ void sendPressure() {
   }
   actual_pressure_tx[1] = (unsigned char) val;
   actual_pressure_tx[2] = (unsigned char) (val >> 8);
-  
+
   // Send response to the ADUCM350.
   Wire.write(actual_pressure_tx, 3);
 }
@@ -74,6 +184,16 @@ void sendPressure() {
 void setup() {
   Serial.begin(9600);
 
+  // Sample the transducer every kSamplePeriodUs: Timer1 in CTC mode, 16 MHz
+  // clock divided by 8.
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);
+  TCNT1 = 0;
+  OCR1A = (uint16_t) (kSamplePeriodUs * 2 - 1);
+  TIMSK1 = _BV(OCIE1A);
+  interrupts();
+
   // Configure the I2C.
   Wire.begin(0x77);
   Wire.onRequest(sendPressure);
@@ -97,6 +217,15 @@ void setup() {
 }
 
 void loop() {
+  // Wait for the motor to inflate the cuff, without holding up the loop.
+  if (inflating && (int) latestPressure() >= target_pressure_extra) {
+    // Engage the motor's brake so that it stops.
+    digitalWrite(kMotorBrakePin, HIGH);
+    Serial.println("Done.");
+    inflating = false;
+    reached_target_pressure = true;
+  }
+
   // Set target pressure from pending value received from aducm350.
   pressure_changed = target_pressure != pending_target_pressure;
   if (!pressure_changed) {
@@ -105,15 +234,16 @@ void loop() {
   target_pressure = pending_target_pressure;
 
   // Read the pressure from the transducer.
-  actual_pressure = analogRead(kTransducerPin);
+  actual_pressure = latestPressure();
 
   if (target_pressure == 0) {
     Serial.println("Deflating cuff to 0...");
+    inflating = false;
     reached_target_pressure = true;
     // If the target pressure is set to 0, open the solenoid and let
     // all the air out.
     digitalWrite(kMotorBrakePin, HIGH);
-    // Turn on solenoid (shuts valve). 
+    // Turn on solenoid (shuts valve).
     digitalWrite(kSolenoidValvePin, LOW);
   } else if (target_pressure > actual_pressure) {
     reached_target_pressure = false;
@@ -127,19 +257,11 @@ void loop() {
     digitalWrite(kMotorBrakePin, LOW);
 
     // Over-inflate the cuff a bit because the pressure drops a bit more right after.
-    int target_pressure_extra = (int) (target_pressure * 1.1);
-
-    while (actual_pressure < target_pressure_extra) {
-      // Wait for the motor to inflate the cuff...
-      actual_pressure = analogRead(kTransducerPin);
-    }
-
-    // Engage the motor's brake so that it stops.
-    digitalWrite(kMotorBrakePin, HIGH);
-    Serial.println("Done.");
-    reached_target_pressure = true;
+    target_pressure_extra = (int) (target_pressure * 1.1);
+    inflating = true;
   } else {
     // Just let the air leak out slowly.
+    inflating = false;
     reached_target_pressure = true;
   }
-}
+}
@@ -8,7 +8,13 @@ import matplotlib.pyplot as plt
 import matplotlib.animation as animation
 import json
 import requests
+import os
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import telemetry
 #usage: python serialplot.py --port COM#
+
+# Must match TELEMETRY_FORMAT in ImpedanceRtos/Telemetry.h.
+BINARY_TELEMETRY = True
     
 def datacollection(ser):
     jsondata = {}
@@ -20,9 +26,38 @@ def datacollection(ser):
         print(str(rawinput))
         if(b'END' in rawinput):
             return jsondata
-        data = [float(val) for val in rawinput.split()]
+        # RATE, BEAT and SWEEP lines are not samples.
+        try:
+            data = [float(val) for val in rawinput.split()]
+        except ValueError:
+            continue
         if(len(data) == 3):
             jsondata["measurements"].append({"impedance_magnitude":data[1], "impedance_phase":data[2], "pressure":data[0]})
+
+def binarydatacollection(ser, decoder):
+    jsondata = {}
+
+    jsondata["userId"]="57047c575ce7f99a3d258a7b"
+    jsondata["measurements"] = []
+    while(True):
+        for frame in decoder.feed(ser.read(ser.in_waiting or 1)):
+            if(frame.type == telemetry.FRAME_END):
+                print("lost frames: %d, crc errors: %d" % (decoder.lost_frames, decoder.crc_errors))
+                return jsondata
+            if(frame.type == telemetry.FRAME_SAMPLE):
+                jsondata["measurements"].append(frame.as_measurement())
+
+def waitforstart(ser, decoder):
+    if(not BINARY_TELEMETRY):
+        while(True):
+            input = ser.readline()
+            print(str(input))
+            if(b'START' in input):
+                return
+    while(True):
+        for frame in decoder.feed(ser.read(ser.in_waiting or 1)):
+            if(frame.type == telemetry.FRAME_START):
+                return
             
 def plotdata(data):
     data["measurements"].pop(0)
@@ -69,20 +104,27 @@ def main():
   ser.open()
   ser.flush()
   print("waiting for start")
+  decoder = telemetry.FrameDecoder()
   while(True):
-    input = ser.readline()
-    print(str(input))
-    if(b'START' in input):
-        print("starting data collection")
+    waitforstart(ser, decoder)
+    print("starting data collection")
+    if(BINARY_TELEMETRY):
+        jsondata = binarydatacollection(ser, decoder)
+    else:
         jsondata = datacollection(ser)
-        # plotdata(jsondata)
-        # print(str(bpsamples))
-        
-        url = "http://capstone-martoneandrew.rhcloud.com/api/capstone/bp/"
-        r = requests.post(url, json=jsondata)
-        print("status from post: " +str(r.status_code))
+    if(not jsondata["measurements"]):
+        # A START and END with no samples is not a measurement.
+        print("empty session, not posted")
         print("waiting for start")
-        # break
+        continue
+    # plotdata(jsondata)
+    # print(str(bpsamples))
+    
+    url = "http://capstone-martoneandrew.rhcloud.com/api/capstone/bp/"
+    r = requests.post(url, json=jsondata)
+    print("status from post: " +str(r.status_code))
+    print("waiting for start")
+    # break
         
         
   
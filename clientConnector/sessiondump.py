@@ -0,0 +1,84 @@
+
+# Fetches the sessions stored in the device's flash.
+#
+# Sends the bulk-read command 'D' and reads the dump until the link goes
+# quiet.  The dump is the compressed telemetry stream of every stored
+# session, oldest first; each session is written to PREFIX<n>.txt as
+# "pressure magnitude phase" lines, the format final.py prints.  With
+# --list, prints the device's session list ('L') instead.  --file decodes a
+# dump saved earlier (or written by tools/sessionstore -o) without a device.
+#
+# usage: python sessiondump.py --port COM# [--list] [--prefix session]
+#        python sessiondump.py --file dump.bin [--prefix session]
+
+import sys, argparse
+
+import telemetry
+
+
+def read_dump(port, command):
+    import serial
+    ser = serial.Serial(port, 115200, timeout=1.0)
+    ser.reset_input_buffer()
+    ser.write(command)
+    data = bytearray()
+    while True:
+        chunk = ser.read(4096)
+        if not chunk:
+            break
+        data += chunk
+    ser.close()
+    return data
+
+
+def split_sessions(data):
+    decoder = telemetry.FrameDecoder()
+    sessions = []
+    current = None
+    for frame in decoder.feed(data):
+        if frame.type == telemetry.FRAME_START:
+            current = []
+            sessions.append(current)
+        elif frame.type == telemetry.FRAME_SAMPLE and current is not None:
+            current.append(frame)
+        elif frame.type == telemetry.FRAME_END:
+            current = None
+    return sessions, decoder
+
+
+def main():
+    parser = argparse.ArgumentParser(description="session store dump")
+    parser.add_argument('--port', dest='port')
+    parser.add_argument('--file', dest='file')
+    parser.add_argument('--list', dest='list', action='store_true')
+    parser.add_argument('--prefix', dest='prefix', default='session')
+    args = parser.parse_args()
+
+    if args.file:
+        data = open(args.file, 'rb').read()
+    elif args.port:
+        if args.list:
+            sys.stdout.write(read_dump(args.port, b'L').decode('ascii',
+                                                               'replace'))
+            return
+        data = read_dump(args.port, b'D')
+    else:
+        parser.error("--port or --file is required")
+
+    sessions, decoder = split_sessions(data)
+    for n, samples in enumerate(sessions):
+        path = "%s%d.txt" % (args.prefix, n)
+        with open(path, 'w') as out:
+            for f in samples:
+                out.write("%d%13.4f%13.4f\n" % (f.pressure, f.magnitude,
+                                                f.phase))
+        print("%s: %d samples" % (path, len(samples)))
+    print("%d bytes, %d sessions (%d verified, %d session CRC errors), "
+          "%d lost frames, %d CRC errors"
+          % (len(data), len(sessions), decoder.sessions_verified,
+             decoder.session_crc_errors, decoder.lost_frames,
+             decoder.crc_errors))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,317 @@
+
+# Decoder for the ImpedanceRtos telemetry stream (see
+# ADuCM350/ImpedanceRtos/Telemetry.h for the frame layout).
+#
+# usage:
+#   decoder = FrameDecoder()
+#   for frame in decoder.feed(ser.read(ser.in_waiting or 1)):
+#       ...
+
+import struct, zlib
+
+SYNC = b'\xa5\x5a'
+
+FRAME_SAMPLE = 0x01
+FRAME_START = 0x02
+FRAME_END = 0x03
+FRAME_DELTA = 0x04
+FRAME_SWEEP = 0x05
+FRAME_BEAT = 0x06
+FRAME_RATE = 0x07
+
+# Must match TELEMETRY_SWEEP_HZ_PER_LSB and TELEMETRY_BEAT_RATE_PER_BPM.
+SWEEP_HZ_PER_LSB = 10
+BEAT_RATE_PER_BPM = 10
+
+FRAME_SIZE = 18
+DELTA_HEADER_SIZE = 7
+
+# Must match TELEMETRY_KEYFRAME_INTERVAL and TELEMETRY_DELTA_BLOCK_SAMPLES.
+KEYFRAME_INTERVAL = 64
+DELTA_BLOCK_SAMPLES = 8
+
+# type, sequence, timestamp_us, pressure, magnitude (3 bytes), phase, crc
+_BODY = struct.Struct('<BHIH3shH')
+# type, sequence, count, length
+_DELTA_HEADER = struct.Struct('<BHBB')
+
+
+def crc16(data, crc=0xFFFF):
+    # CRC-16/CCITT-FALSE, matching Telemetry_Crc16() on the device.
+    for byte in bytearray(data):
+        crc ^= byte << 8
+        for _ in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+            else:
+                crc = (crc << 1) & 0xFFFF
+    return crc
+
+
+def _put_varint(out, value):
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+
+def _get_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def _zigzag(value):
+    return ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+
+
+def _unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def _saturate(magnitude, phase):
+    return max(0, min(magnitude, 0xFFFFFF)), max(-32768, min(phase, 32767))
+
+
+class Frame(object):
+    def __init__(self, type, sequence, timestamp_us, pressure, magnitude,
+                 phase):
+        self.type = type
+        self.sequence = sequence
+        self.timestamp_us = timestamp_us
+        self.pressure = pressure
+        # Raw 20.4 and 12.4 fixed point values.
+        self.raw_magnitude = magnitude
+        self.raw_phase = phase
+        self.magnitude = magnitude / 16.0
+        self.phase = phase / 16.0
+        # Sweep points carry the excitation frequency instead of pressure.
+        self.frequency = None
+        if type == FRAME_SWEEP:
+            self.frequency = pressure * SWEEP_HZ_PER_LSB
+        # Beats carry the heart rate (None for the first beat) instead.
+        self.heart_rate = None
+        if type == FRAME_BEAT and pressure:
+            self.heart_rate = pressure / float(BEAT_RATE_PER_BPM)
+        # START and RATE frames are the session header: the DFT and output
+        # sample rates in Hz and the number of DFTs averaged per sample.
+        self.raw_rate = self.output_rate = self.decimation = None
+        if type in (FRAME_START, FRAME_RATE) and pressure:
+            self.raw_rate = magnitude / 1000.0
+            self.output_rate = timestamp_us / 1000.0
+            self.decimation = pressure
+
+    def as_measurement(self):
+        return {"impedance_magnitude": self.magnitude,
+                "impedance_phase": self.phase,
+                "pressure": self.pressure}
+
+
+def encode_frame(type, sequence, timestamp_us=0, pressure=0, magnitude=0,
+                 phase=0):
+    # Same output as Telemetry_EncodeFrame(); magnitude/phase are 28.4 ints.
+    magnitude, phase = _saturate(magnitude, phase)
+    body = struct.pack('<BHIH', type, sequence & 0xFFFF,
+                       timestamp_us & 0xFFFFFFFF, pressure)
+    body += struct.pack('<I', magnitude)[:3] + struct.pack('<h', phase)
+    return SYNC + body + struct.pack('<H', crc16(body))
+
+
+class StreamEncoder(object):
+    # Same output as Telemetry_StreamEncode()/Telemetry_StreamFlush().
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.previous = None
+        self.previous_dt = 0
+        self.sequence = 0
+        self.since_key = 0
+        self.block = bytearray()
+        self.block_count = 0
+        self.block_sequence = 0
+
+    def flush(self):
+        if not self.block_count:
+            return b''
+        body = _DELTA_HEADER.pack(FRAME_DELTA, self.block_sequence & 0xFFFF,
+                                  self.block_count, len(self.block))
+        body += bytes(self.block)
+        self.block = bytearray()
+        self.block_count = 0
+        return SYNC + body + struct.pack('<H', crc16(body))
+
+    def encode(self, timestamp_us, pressure, magnitude, phase):
+        magnitude, phase = _saturate(magnitude, phase)
+        out = b''
+        if self.since_key == 0:
+            out = self.flush()
+            out += encode_frame(FRAME_SAMPLE, self.sequence, timestamp_us,
+                                pressure, magnitude, phase)
+            self.previous_dt = 0
+        else:
+            if not self.block_count:
+                self.block_sequence = self.sequence
+            dt = (timestamp_us - self.previous[0]) & 0xFFFFFFFF
+            if dt >= 0x80000000:
+                dt -= 0x100000000
+            _put_varint(self.block, _zigzag(dt - self.previous_dt))
+            _put_varint(self.block, _zigzag(pressure - self.previous[1]))
+            _put_varint(self.block, _zigzag(magnitude - self.previous[2]))
+            _put_varint(self.block, _zigzag(phase - self.previous[3]))
+            self.block_count += 1
+            self.previous_dt = dt
+            if self.block_count == DELTA_BLOCK_SAMPLES:
+                out = self.flush()
+        self.previous = (timestamp_us, pressure, magnitude, phase)
+        self.sequence += 1
+        self.since_key = (self.since_key + 1) % KEYFRAME_INTERVAL
+        return out
+
+
+class FrameDecoder(object):
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+        self.lost_frames = 0
+        self.skipped_bytes = 0
+        self.skipped_deltas = 0
+        # Sessions whose END frame CRC did (not) match the bytes received.
+        self.sessions_verified = 0
+        self.session_crc_errors = 0
+        self._session_crc = None
+        self._last_sequence = None
+        # Last decoded sample, needed to apply deltas; None until a key frame.
+        self._previous = None
+        self._previous_dt = 0
+
+    def _frame_size(self):
+        # Size of the frame at the start of the buffer, or None if unknown yet.
+        if len(self.buffer) < 3:
+            return None
+        if self.buffer[2] != FRAME_DELTA:
+            return FRAME_SIZE
+        if len(self.buffer) < DELTA_HEADER_SIZE:
+            return None
+        return DELTA_HEADER_SIZE + self.buffer[6] + 2
+
+    def feed(self, data):
+        # Returns the list of complete, CRC-checked frames found so far.
+        # Delta blocks are expanded into individual FRAME_SAMPLE frames.
+        self.buffer.extend(data)
+        frames = []
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # Keep a trailing 0xA5 in case the sync word is split.
+                keep = 1 if self.buffer[-1:] == SYNC[:1] else 0
+                self._skip(len(self.buffer) - keep)
+                break
+            if start:
+                self._skip(start)
+            size = self._frame_size()
+            if size is None or len(self.buffer) < size:
+                break
+
+            body = bytes(self.buffer[2:size])
+            if crc16(body[:-2]) != struct.unpack('<H', body[-2:])[0]:
+                # Not a frame (or a corrupted one); resync on the next byte.
+                self.crc_errors += 1
+                self._skip(1)
+                continue
+            self._track_session_crc(body, bytes(self.buffer[:size]))
+            del self.buffer[:size]
+
+            if body[0] == FRAME_DELTA:
+                frames.extend(self._decode_delta(body))
+            else:
+                frames.append(self._decode_frame(body))
+        return frames
+
+    def _skip(self, count):
+        # Bytes that are not a frame still count towards the session CRC:
+        # a session the device cut short can end in the middle of a frame.
+        if self._session_crc is not None:
+            self._session_crc = zlib.crc32(bytes(self.buffer[:count]),
+                                           self._session_crc) & 0xFFFFFFFF
+        self.skipped_bytes += count
+        del self.buffer[:count]
+
+    def _track_session_crc(self, body, frame):
+        # END carries the CRC-32 of the session's bytes from START on; a
+        # frame lost or dropped on the way shows up as a mismatch.
+        if body[0] == FRAME_START:
+            self._session_crc = zlib.crc32(frame) & 0xFFFFFFFF
+        elif body[0] == FRAME_END:
+            expected = struct.unpack('<I', body[3:7])[0]
+            if expected and self._session_crc is not None:
+                if expected == self._session_crc:
+                    self.sessions_verified += 1
+                else:
+                    self.session_crc_errors += 1
+            self._session_crc = None
+        elif self._session_crc is not None:
+            self._session_crc = zlib.crc32(frame, self._session_crc) \
+                & 0xFFFFFFFF
+
+    def _track_sequence(self, sequence, count=1):
+        # Returns False if frames were lost since the previous one.
+        in_order = True
+        if self._last_sequence is not None:
+            lost = (sequence - self._last_sequence - 1) & 0xFFFF
+            self.lost_frames += lost
+            in_order = lost == 0
+        self._last_sequence = (sequence + count - 1) & 0xFFFF
+        return in_order
+
+    def _decode_frame(self, body):
+        (type, sequence, timestamp_us, pressure, magnitude, phase,
+         crc) = _BODY.unpack(body)
+        magnitude = bytearray(magnitude)
+        magnitude = magnitude[0] | magnitude[1] << 8 | magnitude[2] << 16
+
+        if type == FRAME_START:
+            self._last_sequence = None
+            self._previous = None
+        elif type == FRAME_SAMPLE:
+            self._track_sequence(sequence)
+            # Absolute values: (re)synchronizes the delta decoder.
+            self._previous = (timestamp_us, pressure, magnitude, phase)
+            self._previous_dt = 0
+        return Frame(type, sequence, timestamp_us, pressure, magnitude, phase)
+
+    def _decode_delta(self, body):
+        type, sequence, count, length = _DELTA_HEADER.unpack(
+            body[:_DELTA_HEADER.size])
+        if not self._track_sequence(sequence, count):
+            self._previous = None
+        if self._previous is None:
+            # Cannot apply deltas without a base; wait for the next key frame.
+            self.skipped_deltas += count
+            return []
+
+        payload = bytearray(body[_DELTA_HEADER.size:-2])
+        pos = 0
+        frames = []
+        timestamp_us, pressure, magnitude, phase = self._previous
+        for i in range(count):
+            fields = []
+            for _ in range(4):
+                value, pos = _get_varint(payload, pos)
+                fields.append(_unzigzag(value))
+            self._previous_dt += fields[0]
+            timestamp_us = (timestamp_us + self._previous_dt) & 0xFFFFFFFF
+            pressure += fields[1]
+            magnitude += fields[2]
+            phase += fields[3]
+            frames.append(Frame(FRAME_SAMPLE, (sequence + i) & 0xFFFF,
+                                timestamp_us, pressure, magnitude, phase))
+        self._previous = (timestamp_us, pressure, magnitude, phase)
+        return frames
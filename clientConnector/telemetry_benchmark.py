@@ -0,0 +1,101 @@
+
+# Compares the telemetry formats on recorded sessions.
+#
+# A session is a capture of the legacy ASCII output, one
+# "pressure magnitude phase" line per sample (the lines final.py prints).
+# Each session is re-encoded in every format and decoded again, and the
+# achievable sample rate at the given baud rate is reported.
+#
+# usage: python telemetry_benchmark.py session1.txt [session2.txt ...]
+
+import sys, argparse
+
+import telemetry
+
+# 13 ms DFT plus settling, as programmed in seq_afe_acmeas2wire.
+DEFAULT_SAMPLE_PERIOD_US = 13158
+
+
+def load_session(path, period_us):
+    samples = []
+    for line in open(path):
+        try:
+            data = [float(val) for val in line.split()]
+        except ValueError:
+            continue
+        if len(data) != 3:
+            continue
+        timestamp_us = len(samples) * period_us
+        samples.append((timestamp_us, int(data[0]),
+                        int(round(data[1] * 16)), int(round(data[2] * 16))))
+    return samples
+
+
+def ascii_size(samples):
+    size = 0
+    for timestamp_us, pressure, magnitude, phase in samples:
+        size += len("%d%13.4f%13.4f\r\n" % (pressure, magnitude / 16.0,
+                                            phase / 16.0))
+    return size
+
+
+def binary_stream(samples):
+    out = bytearray()
+    for i, sample in enumerate(samples):
+        out += telemetry.encode_frame(telemetry.FRAME_SAMPLE, i, *sample)
+    return out
+
+
+def compressed_stream(samples):
+    encoder = telemetry.StreamEncoder()
+    out = bytearray()
+    for sample in samples:
+        out += encoder.encode(*sample)
+    out += encoder.flush()
+    return out
+
+
+def check(stream, samples):
+    decoder = telemetry.FrameDecoder()
+    decoded = [(f.timestamp_us, f.pressure, f.raw_magnitude, f.raw_phase)
+               for f in decoder.feed(stream)]
+    if decoded != samples:
+        raise Exception("round trip mismatch")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="telemetry benchmark")
+    parser.add_argument('sessions', nargs='+')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--period-us', type=int,
+                        default=DEFAULT_SAMPLE_PERIOD_US)
+    args = parser.parse_args()
+
+    # 8N1: 10 bits on the wire per byte.
+    bytes_per_second = args.baud / 10.0
+
+    samples = []
+    for path in args.sessions:
+        samples += load_session(path, args.period_us)
+    if not samples:
+        print("no samples found")
+        return
+
+    print("%d samples, %d baud" % (len(samples), args.baud))
+    print("%-12s %12s %14s %12s" % ("format", "bytes", "bytes/sample",
+                                    "samples/s"))
+    sizes = [("ascii", ascii_size(samples))]
+    for name, encode in (("binary", binary_stream),
+                         ("compressed", compressed_stream)):
+        stream = encode(samples)
+        check(bytes(stream), samples)
+        sizes.append((name, len(stream)))
+    for name, size in sizes:
+        per_sample = float(size) / len(samples)
+        print("%-12s %12d %14.2f %12.0f" % (name, size, per_sample,
+                                            bytes_per_second / per_sample))
+
+
+# call main
+if __name__ == '__main__':
+  main()